@@ -2,24 +2,685 @@
 #include "rpc/core_rpc_server_commands_defs.h"
 #include "storages/portable_storage_template_helper.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
-#include <boost/property_tree/ptree.hpp>
-#include <boost/property_tree/json_parser.hpp>
+#include "serialization/json_archive.h"
+#include "common/threadpool.h"
+#include "string_tools.h"
+#include "monero_tx_view.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ostream>
+#include <streambuf>
 
 using namespace std;
 using namespace boost;
 using namespace cryptonote;
 using namespace binary_utils;
 
+namespace
+{
+  /**
+   * Stream buffer appending straight to a string, so archives write into the output without a copy.
+   */
+  class string_append_buf: public std::streambuf
+  {
+  public:
+    string_append_buf(std::string &out) : out(out) {}
+  protected:
+    int_type overflow(int_type c) override {
+      if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        out.push_back(traits_type::to_char_type(c));
+      }
+      return traits_type::not_eof(c);
+    }
+    std::streamsize xsputn(const char *s, std::streamsize n) override {
+      out.append(s, n);
+      return n;
+    }
+  private:
+    std::string &out;
+  };
+
+  void append_json_string(std::string &out, const std::string &value) {
+    out.push_back('"');
+    for (char c : value) {
+      if (c == '"' || c == '\\') {
+        out.push_back('\\');
+        out.push_back(c);
+      } else if ((unsigned char)c < 0x20) {
+        char escaped[7];
+        snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)c);
+        out.append(escaped);
+      } else {
+        out.push_back(c);
+      }
+    }
+    out.push_back('"');
+  }
+
+  const size_t txs_per_parse_task = 16;
+
+  template<typename T>
+  void append_json_hex(std::string &out, const T &pod) {
+    out.push_back('"');
+    out.append(epee::string_tools::pod_to_hex(pod));
+    out.push_back('"');
+  }
+
+  /**
+   * Appends batch's tx t; input is the index of its first input, and is left past its last.
+   */
+  void append_compact_tx_json(std::string &out, const monero_multi_account_scanner::BlockBatch &batch, size_t t, size_t &input) {
+    out.append("{\"hash\":");
+    append_json_hex(out, batch.tx_hashes[t]);
+    out.append(",\"version\":" + std::to_string(batch.tx_versions[t]));
+    out.append(",\"unlock_time\":" + std::to_string(batch.tx_unlock_times[t]));
+    if (batch.tx_pub_keys[t] != crypto::null_pkey) {
+      out.append(",\"pub_key\":");
+      append_json_hex(out, batch.tx_pub_keys[t]);
+    }
+    uint32_t outputsBegin = batch.tx_outputs_begin[t];
+    uint32_t outputsEnd = batch.tx_outputs_begin[t + 1];
+    out.append(",\"additional_pub_keys\":[");
+    for (uint32_t o = outputsBegin; batch.tx_has_additional_pub_keys[t] && o < outputsEnd; o++) {
+      if (o > outputsBegin) out.push_back(',');
+      append_json_hex(out, batch.additional_pub_keys[o]);
+    }
+    out.append("],\"key_images\":[");
+    for (size_t first = input; input < batch.input_txs.size() && batch.input_txs[input] == t; input++) {
+      if (input > first) out.push_back(',');
+      append_json_hex(out, batch.input_key_images[input]);
+    }
+    out.append("],\"outputs\":[");
+    for (uint32_t o = outputsBegin; o < outputsEnd; o++) {
+      if (o > outputsBegin) out.push_back(',');
+      out.append("{\"key\":");
+      append_json_hex(out, batch.out_keys[o]);
+      out.append(",\"amount\":" + std::to_string(batch.out_amounts[o]) + "}");
+    }
+    uint8_t rctType = batch.tx_rct_types[t];
+    out.append("],\"rct_type\":" + std::to_string(rctType));
+    if (rctType != rct::RCTTypeNull) {
+      out.append(",\"ecdh_info\":[");
+      for (uint32_t o = outputsBegin; o < outputsEnd; o++) {
+        if (o > outputsBegin) out.push_back(',');
+        const rct::ecdhTuple &info = batch.out_ecdh_info[o];
+        out.push_back('{');
+        if (rctType != rct::RCTTypeBulletproof2) {
+          out.append("\"mask\":");
+          append_json_hex(out, info.mask);
+          out.push_back(',');
+        }
+        out.append("\"amount\":");
+        if (rctType == rct::RCTTypeBulletproof2) {
+          out.append("\"" + epee::string_tools::buff_to_hex_nodelimer(std::string(reinterpret_cast<const char *>(info.amount.bytes), 8)) + "\"");
+        } else {
+          append_json_hex(out, info.amount);
+        }
+        out.push_back('}');
+      }
+      out.append("],\"out_pk\":[");
+      for (uint32_t o = outputsBegin; o < outputsEnd; o++) {
+        if (o > outputsBegin) out.push_back(',');
+        append_json_hex(out, batch.out_commitments[o]);
+      }
+      out.push_back(']');
+    }
+    out.push_back('}');
+  }
+
+  /**
+   * Appends one block entry's compact JSON to out, or returns the error binary_blocks_to_json would throw.
+   */
+  bool append_compact_entry_json(std::string &out, const cryptonote::block_complete_entry &entry, size_t blockIdx, std::string &err) {
+    cryptonote::block block;
+    monero_tx_view::TxView view;
+    std::string miner_tx_blob;
+    if (!cryptonote::parse_and_validate_block_from_blob(entry.block, block)
+        || block.tx_hashes.size() != entry.txs.size() // as binary_blocks_to_json fails
+        || !view.parse(miner_tx_blob = cryptonote::tx_to_blob(block.miner_tx))
+        || !view.is_coinbase()) {
+      err = "failed to parse block blob at index " + std::to_string(blockIdx);
+      return false;
+    }
+    uint64_t height = view.coinbase_height();
+    monero_multi_account_scanner::BlockBatch batch;
+    batch.tx_outputs_begin.push_back(0);
+    monero_multi_account_scanner::append_tx(batch, view, cryptonote::get_transaction_hash(block.miner_tx), height, true);
+    for (size_t txIdx = 0; txIdx < entry.txs.size(); txIdx++) {
+      if (!view.parse(entry.txs[txIdx])) {
+        err = "failed to parse tx blob at index " + std::to_string(txIdx);
+        return false;
+      }
+      monero_multi_account_scanner::append_tx(batch, view, block.tx_hashes[txIdx], height, false);
+    }
+    size_t input = 0;
+    append_compact_block_json(out, cryptonote::get_block_hash(block), height, block.timestamp, block.prev_id, batch, 0, batch.n_txs(), input);
+    return true;
+  }
+
+  const size_t portable_storage_max_depth = 100;
+  const size_t json_flush_size = 64 * 1024;
+
+  /**
+   * Writes epee portable storage binary out as JSON while reading it, one value at a time, so no
+   * portable_storage tree is built; only the current nesting path and a small output buffer are held.
+   */
+  class binary_json_writer
+  {
+  public:
+    binary_json_writer(const char *buff_bin, size_t size, std::ostream &out) : begin(buff_bin), pos(buff_bin), end(buff_bin + size), out(out) {}
+
+    void write() {
+      uint32_t signature_a = read_le<uint32_t>();
+      uint32_t signature_b = read_le<uint32_t>();
+      uint8_t ver = read_le<uint8_t>();
+      if (signature_a != PORTABLE_STORAGE_SIGNATUREA || signature_b != PORTABLE_STORAGE_SIGNATUREB || ver != PORTABLE_STORAGE_FORMAT_VER) {
+        fail("invalid portable storage header");
+      }
+      write_section(0);
+      flush();
+    }
+
+  private:
+    const char *begin;
+    const char *pos;
+    const char *end;
+    std::ostream &out;
+    std::string buf;
+
+    void fail(const std::string &msg) {
+      throw std::runtime_error("binary_to_json: " + msg + " at offset " + std::to_string(pos - begin));
+    }
+
+    void need(uint64_t size) {
+      if (size > (uint64_t)(end - pos)) fail("unexpected end of data");
+    }
+
+    template<typename T>
+    T read_le() {
+      need(sizeof(T));
+      uint64_t v = 0;
+      for (size_t i = 0; i < sizeof(T); i++) v |= (uint64_t)(unsigned char)pos[i] << (8 * i);
+      pos += sizeof(T);
+      return (T)v;
+    }
+
+    uint64_t read_varint() {
+      need(1);
+      size_t size = (size_t)1 << ((unsigned char)*pos & PORTABLE_RAW_SIZE_MARK_MASK);
+      need(size);
+      uint64_t v = 0;
+      for (size_t i = 0; i < size; i++) v |= (uint64_t)(unsigned char)pos[i] << (8 * i);
+      pos += size;
+      return v >> 2;
+    }
+
+    /**
+     * Every section entry and array element takes at least one byte, so a count past the end is malformed.
+     */
+    uint64_t read_count() {
+      uint64_t count = read_varint();
+      need(count);
+      return count;
+    }
+
+    void put(char c) {
+      buf.push_back(c);
+      if (buf.size() >= json_flush_size) flush();
+    }
+
+    void put(const std::string &s) {
+      buf.append(s);
+      if (buf.size() >= json_flush_size) flush();
+    }
+
+    void flush() {
+      out.write(buf.data(), buf.size());
+      buf.clear();
+    }
+
+    void put_string(const char *s, size_t size) {
+      static const char hex[] = "0123456789abcdef";
+      buf.push_back('"');
+      for (size_t i = 0; i < size; i++) {
+        unsigned char c = s[i];
+        if (c == '"' || c == '\\') {
+          buf.push_back('\\');
+          buf.push_back(c);
+        } else if (c < 0x20 || c >= 0x7f) { // binary blobs stay valid JSON; json_to_binary reads \u00XX back as one byte
+          buf.append("\\u00");
+          buf.push_back(hex[c >> 4]);
+          buf.push_back(hex[c & 0xf]);
+        } else {
+          buf.push_back(c);
+        }
+        if (buf.size() >= json_flush_size) flush();
+      }
+      put('"');
+    }
+
+    void put_double(double v) {
+      if (!std::isfinite(v)) {
+        put("null");
+        return;
+      }
+      char printed[32];
+      snprintf(printed, sizeof(printed), "%.17g", v);
+      put(printed);
+      if (!strpbrk(printed, ".e")) put(".0"); // so json_to_binary reads it back as a double
+    }
+
+    void write_section(size_t depth) {
+      if (depth > portable_storage_max_depth) fail("nested too deeply");
+      uint64_t count = read_count();
+      put('{');
+      for (uint64_t i = 0; i < count; i++) {
+        if (i > 0) put(',');
+        uint8_t name_size = read_le<uint8_t>();
+        need(name_size);
+        put_string(pos, name_size);
+        pos += name_size;
+        put(':');
+        uint8_t type = read_le<uint8_t>();
+        if (type & SERIALIZE_FLAG_ARRAY) {
+          write_array(type & ~SERIALIZE_FLAG_ARRAY, depth + 1);
+        } else {
+          write_value(type, depth);
+        }
+      }
+      put('}');
+    }
+
+    void write_array(uint8_t type, size_t depth) {
+      if (depth > portable_storage_max_depth) fail("nested too deeply");
+      uint64_t count = read_count();
+      put('[');
+      for (uint64_t i = 0; i < count; i++) {
+        if (i > 0) put(',');
+        write_value(type, depth);
+      }
+      put(']');
+    }
+
+    void write_value(uint8_t type, size_t depth) {
+      switch (type) {
+        case SERIALIZE_TYPE_INT64: put(std::to_string((int64_t)read_le<uint64_t>())); break;
+        case SERIALIZE_TYPE_INT32: put(std::to_string((int32_t)read_le<uint32_t>())); break;
+        case SERIALIZE_TYPE_INT16: put(std::to_string((int16_t)read_le<uint16_t>())); break;
+        case SERIALIZE_TYPE_INT8: put(std::to_string((int8_t)read_le<uint8_t>())); break;
+        case SERIALIZE_TYPE_UINT64: put(std::to_string(read_le<uint64_t>())); break;
+        case SERIALIZE_TYPE_UINT32: put(std::to_string(read_le<uint32_t>())); break;
+        case SERIALIZE_TYPE_UINT16: put(std::to_string(read_le<uint16_t>())); break;
+        case SERIALIZE_TYPE_UINT8: put(std::to_string(read_le<uint8_t>())); break;
+        case SERIALIZE_TYPE_DUOBLE: {
+          uint64_t bits = read_le<uint64_t>();
+          double v;
+          memcpy(&v, &bits, sizeof(v));
+          put_double(v);
+          break;
+        }
+        case SERIALIZE_TYPE_STRING: {
+          uint64_t size = read_varint();
+          need(size);
+          put_string(pos, size);
+          pos += size;
+          break;
+        }
+        case SERIALIZE_TYPE_BOOL: put(read_le<uint8_t>() ? "true" : "false"); break;
+        case SERIALIZE_TYPE_OBJECT: write_section(depth + 1); break;
+        case SERIALIZE_TYPE_ARRAY: { // array of arrays; each element carries its own type
+          uint8_t element_type = read_le<uint8_t>();
+          if (!(element_type & SERIALIZE_FLAG_ARRAY)) fail("array element is not an array");
+          write_array(element_type & ~SERIALIZE_FLAG_ARRAY, depth + 1);
+          break;
+        }
+        default: fail("unknown type " + std::to_string(type));
+      }
+    }
+  };
+
+  /**
+   * Writes JSON out as epee portable storage binary while parsing it, straight into the output, so no
+   * portable_storage tree is built. Section and array counts are only known at their closing brackets,
+   * so they're written as 4 byte varints and filled in then; epee reads any varint width.
+   */
+  class json_binary_writer
+  {
+  public:
+    json_binary_writer(const std::string &buff_json, std::string &out) : begin(buff_json.c_str()), pos(buff_json.c_str()), end(buff_json.c_str() + buff_json.size()), out(out) {}
+
+    void write() {
+      out.clear();
+      append_le<uint32_t>(PORTABLE_STORAGE_SIGNATUREA);
+      append_le<uint32_t>(PORTABLE_STORAGE_SIGNATUREB);
+      append_le<uint8_t>(PORTABLE_STORAGE_FORMAT_VER);
+      skip_ws();
+      expect('{');
+      write_section(0);
+      skip_ws();
+      if (pos != end) fail("unexpected trailing characters");
+    }
+
+  private:
+    const char *begin;
+    const char *pos;
+    const char *end;
+    std::string &out;
+
+    void fail(const std::string &msg) {
+      throw std::runtime_error("json_to_binary: " + msg + " at offset " + std::to_string(pos - begin));
+    }
+
+    void skip_ws() {
+      while (pos != end && (*pos == ' ' || *pos == '\t' || *pos == '\r' || *pos == '\n')) pos++;
+    }
+
+    char peek() {
+      if (pos == end) fail("unexpected end of JSON");
+      return *pos;
+    }
+
+    void expect(char c) {
+      if (peek() != c) fail(std::string("expected '") + c + "'");
+      pos++;
+    }
+
+    void expect_word(const char *word) {
+      size_t size = strlen(word);
+      if ((size_t)(end - pos) < size || memcmp(pos, word, size) != 0) fail(std::string("expected ") + word);
+      pos += size;
+    }
+
+    template<typename T>
+    void append_le(T v) {
+      for (size_t i = 0; i < sizeof(T); i++) out.push_back((char)(((uint64_t)v >> (8 * i)) & 0xff));
+    }
+
+    void append_varint(uint64_t v) {
+      if (v <= 63) append_le<uint8_t>((v << 2) | PORTABLE_RAW_SIZE_MARK_BYTE);
+      else if (v <= 16383) append_le<uint16_t>((v << 2) | PORTABLE_RAW_SIZE_MARK_WORD);
+      else if (v <= 1073741823) append_le<uint32_t>((v << 2) | PORTABLE_RAW_SIZE_MARK_DWORD);
+      else if (v <= 4611686018427387903) append_le<uint64_t>((v << 2) | PORTABLE_RAW_SIZE_MARK_INT64);
+      else fail("value too large for a varint");
+    }
+
+    size_t reserve_count() {
+      size_t at = out.size();
+      append_le<uint32_t>(PORTABLE_RAW_SIZE_MARK_DWORD);
+      return at;
+    }
+
+    void fill_count(size_t at, uint64_t count) {
+      if (count > 1073741823) fail("too many entries");
+      uint32_t v = (uint32_t)(count << 2) | PORTABLE_RAW_SIZE_MARK_DWORD;
+      for (size_t i = 0; i < 4; i++) out[at + i] = (char)((v >> (8 * i)) & 0xff);
+    }
+
+    /**
+     * Type of the value at pos, or 0 for null.
+     */
+    uint8_t value_type() {
+      char c = peek();
+      switch (c) {
+        case '"': return SERIALIZE_TYPE_STRING;
+        case '{': return SERIALIZE_TYPE_OBJECT;
+        case '[': return SERIALIZE_TYPE_ARRAY;
+        case 't': case 'f': return SERIALIZE_TYPE_BOOL;
+        case 'n': return 0;
+      }
+      if (c != '-' && (c < '0' || c > '9')) fail("unexpected character");
+      for (const char *p = pos; p != end; p++) { // as epee's JSON loader: fractions are doubles, negatives int64, the rest uint64
+        if (*p == '.' || *p == 'e' || *p == 'E') return SERIALIZE_TYPE_DUOBLE;
+        if (*p != '-' && *p != '+' && (*p < '0' || *p > '9')) break;
+      }
+      return c == '-' ? SERIALIZE_TYPE_INT64 : SERIALIZE_TYPE_UINT64;
+    }
+
+    bool at_empty_array() {
+      const char *p = pos + 1;
+      while (p != end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) p++;
+      return p != end && *p == ']';
+    }
+
+    unsigned read_hex4() {
+      if (end - pos < 4) fail("truncated \\u escape");
+      unsigned v = 0;
+      for (size_t i = 0; i < 4; i++, pos++) {
+        char c = *pos;
+        v <<= 4;
+        if (c >= '0' && c <= '9') v |= c - '0';
+        else if (c >= 'a' && c <= 'f') v |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') v |= c - 'A' + 10;
+        else fail("invalid \\u escape");
+      }
+      return v;
+    }
+
+    /**
+     * Decodes the string at pos (past its opening quote) up to its closing quote, appending it to out
+     * when append, and returns its decoded size. \u escapes up to U+00FF are single bytes, as
+     * binary_to_json writes them; larger code points are UTF-8.
+     */
+    uint64_t read_string(bool append) {
+      uint64_t size = 0;
+      char bytes[4];
+      for (;;) {
+        char c = peek();
+        pos++;
+        if (c == '"') return size;
+        size_t n = 1;
+        bytes[0] = c;
+        if (c == '\\') {
+          char e = peek();
+          pos++;
+          switch (e) {
+            case '"': case '\\': case '/': bytes[0] = e; break;
+            case 'b': bytes[0] = '\b'; break;
+            case 'f': bytes[0] = '\f'; break;
+            case 'n': bytes[0] = '\n'; break;
+            case 'r': bytes[0] = '\r'; break;
+            case 't': bytes[0] = '\t'; break;
+            case 'u': {
+              unsigned cp = read_hex4();
+              if (cp >= 0xd800 && cp <= 0xdbff && end - pos >= 6 && pos[0] == '\\' && pos[1] == 'u') {
+                const char *high_end = pos;
+                pos += 2;
+                unsigned low = read_hex4();
+                if (low >= 0xdc00 && low <= 0xdfff) cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                else pos = high_end;
+              }
+              if (cp <= 0xff) {
+                bytes[0] = (char)cp;
+              } else if (cp <= 0x7ff) {
+                bytes[0] = (char)(0xc0 | (cp >> 6));
+                bytes[1] = (char)(0x80 | (cp & 0x3f));
+                n = 2;
+              } else if (cp <= 0xffff) {
+                bytes[0] = (char)(0xe0 | (cp >> 12));
+                bytes[1] = (char)(0x80 | ((cp >> 6) & 0x3f));
+                bytes[2] = (char)(0x80 | (cp & 0x3f));
+                n = 3;
+              } else {
+                bytes[0] = (char)(0xf0 | (cp >> 18));
+                bytes[1] = (char)(0x80 | ((cp >> 12) & 0x3f));
+                bytes[2] = (char)(0x80 | ((cp >> 6) & 0x3f));
+                bytes[3] = (char)(0x80 | (cp & 0x3f));
+                n = 4;
+              }
+              break;
+            }
+            default: fail("invalid escape");
+          }
+        }
+        if (append) out.append(bytes, n);
+        size += n;
+      }
+    }
+
+    /**
+     * Sizes the string at pos in one pass, so its size needn't be reserved and filled in,, then writes its varint size and bytes in a second.
+     */
+    void write_string(bool is_name) {
+      expect('"');
+      const char *start = pos;
+      uint64_t size = read_string(false);
+      if (is_name) {
+        if (size > 255) fail("name longer than 255 bytes");
+        append_le<uint8_t>(size);
+      } else {
+        append_varint(size);
+      }
+      pos = start;
+      read_string(true);
+    }
+
+    void write_section(size_t depth) {
+      if (depth > portable_storage_max_depth) fail("nested too deeply");
+      size_t count_at = reserve_count();
+      uint64_t count = 0;
+      skip_ws();
+      if (peek() == '}') {
+        pos++;
+        fill_count(count_at, count);
+        return;
+      }
+      for (;;) {
+        skip_ws();
+        size_t entry_at = out.size();
+        write_string(true);
+        skip_ws();
+        expect(':');
+        skip_ws();
+        uint8_t type = value_type();
+        if (type == 0) { // nulls and empty arrays are dropped, as epee's JSON loader does
+          expect_word("null");
+          out.resize(entry_at);
+        } else if (type == SERIALIZE_TYPE_ARRAY && at_empty_array()) {
+          pos++;
+          skip_ws();
+          pos++;
+          out.resize(entry_at);
+        } else if (type == SERIALIZE_TYPE_ARRAY) {
+          pos++;
+          write_array(depth + 1);
+          count++;
+        } else {
+          append_le<uint8_t>(type);
+          write_value(type, depth);
+          count++;
+        }
+        skip_ws();
+        char c = peek();
+        pos++;
+        if (c == '}') break;
+        if (c != ',') fail("expected ',' or '}'");
+      }
+      fill_count(count_at, count);
+    }
+
+    /**
+     * Writes the array at pos (past its '[') with its element type flagged; the type is the first
+     * element's, and every other element has to match it.
+     */
+    void write_array(size_t depth) {
+      if (depth > portable_storage_max_depth) fail("nested too deeply");
+      size_t type_at = out.size();
+      append_le<uint8_t>(0);
+      size_t count_at = reserve_count();
+      uint64_t count = 0;
+      uint8_t array_type = SERIALIZE_TYPE_OBJECT; // an empty array's type is arbitrary
+      skip_ws();
+      if (peek() == ']') {
+        pos++;
+      } else {
+        for (;;) {
+          skip_ws();
+          uint8_t type = value_type();
+          if (type == 0) fail("null in array");
+          if (count == 0) array_type = type;
+          else if (type != array_type) fail("mixed value types in array");
+          write_value(type, depth);
+          count++;
+          skip_ws();
+          char c = peek();
+          pos++;
+          if (c == ']') break;
+          if (c != ',') fail("expected ',' or ']'");
+        }
+      }
+      out[type_at] = (char)(array_type | SERIALIZE_FLAG_ARRAY);
+      fill_count(count_at, count);
+    }
+
+    void write_value(uint8_t type, size_t depth) {
+      switch (type) {
+        case SERIALIZE_TYPE_STRING: write_string(false); break;
+        case SERIALIZE_TYPE_OBJECT: pos++; write_section(depth + 1); break;
+        case SERIALIZE_TYPE_ARRAY: pos++; write_array(depth + 1); break;
+        case SERIALIZE_TYPE_BOOL:
+          if (*pos == 't') {
+            expect_word("true");
+            append_le<uint8_t>(1);
+          } else {
+            expect_word("false");
+            append_le<uint8_t>(0);
+          }
+          break;
+        case SERIALIZE_TYPE_INT64: {
+          char *number_end;
+          errno = 0;
+          long long v = strtoll(pos, &number_end, 10);
+          if (errno == ERANGE || number_end == pos) fail("invalid integer");
+          pos = number_end;
+          append_le<uint64_t>((uint64_t)v);
+          break;
+        }
+        case SERIALIZE_TYPE_UINT64: {
+          char *number_end;
+          errno = 0;
+          unsigned long long v = strtoull(pos, &number_end, 10);
+          if (errno == ERANGE || number_end == pos) fail("invalid integer");
+          pos = number_end;
+          append_le<uint64_t>(v);
+          break;
+        }
+        case SERIALIZE_TYPE_DUOBLE: {
+          char *number_end;
+          double v = strtod(pos, &number_end);
+          if (number_end == pos) fail("invalid number");
+          pos = number_end;
+          uint64_t bits;
+          memcpy(&bits, &v, sizeof(bits));
+          append_le<uint64_t>(bits);
+          break;
+        }
+      }
+    }
+  };
+}
+
 void binary_utils::json_to_binary(const std::string &buff_json, std::string &buff_bin) {
-  epee::serialization::portable_storage ps;
-  ps.load_from_json(buff_json);
-  ps.store_to_binary(buff_bin);
+  json_binary_writer(buff_json, buff_bin).write();
 }
 
 void binary_utils::binary_to_json(const std::string &buff_bin, std::string &buff_json) {
-  epee::serialization::portable_storage ps;
-  ps.load_from_binary(buff_bin);
-  ps.dump_as_json(buff_json);
+  binary_to_json(buff_bin.data(), buff_bin.size(), buff_json);
+}
+
+void binary_utils::binary_to_json(const std::string &buff_bin, std::ostream &out) {
+  binary_json_writer(buff_bin.data(), buff_bin.size(), out).write();
+}
+
+void binary_utils::binary_to_json(const char *buff_bin, size_t size, std::string &buff_json) {
+  buff_json.clear();
+  buff_json.reserve(2 * size);
+  string_append_buf buf(buff_json);
+  std::ostream out(&buf);
+  binary_json_writer(buff_bin, size, out).write();
 }
 
 void binary_utils::binary_blocks_to_json(const std::string &buff_bin, std::string &buff_json) {
@@ -28,48 +689,149 @@ void binary_utils::binary_blocks_to_json(const std::string &buff_bin, std::strin
   cryptonote::COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::response resp_struct;
   epee::serialization::load_t_from_binary(resp_struct, buff_bin);
 
-  // build property tree from deserialized blocks and transactions
-  boost::property_tree::ptree root;
-  boost::property_tree::ptree blocksNode;	// array of block strings
-  boost::property_tree::ptree txsNodes;		// array of txs per block (array of array)
-  for (int blockIdx = 0; blockIdx < resp_struct.blocks.size(); blockIdx++) {
-
-    // parse and validate block
-    cryptonote::block block;
-    if (cryptonote::parse_and_validate_block_from_blob(resp_struct.blocks[blockIdx].block, block)) {
-
-      // add block node to blocks node
-      boost::property_tree::ptree blockNode;
-      blockNode.put("", cryptonote::obj_to_json_str(block));	// TODO: no pretty print
-      blocksNode.push_back(std::make_pair("", blockNode));
-    } else {
+  // parse and validate blocks and their txs on the shared threadpool, each into its own slot;
+  // large blocks' txs are split across tasks
+  std::vector<cryptonote::block> blocks(resp_struct.blocks.size());
+  std::vector<std::vector<cryptonote::transaction>> txs(resp_struct.blocks.size());
+  std::vector<char> blockParsed(resp_struct.blocks.size(), 0);
+  std::vector<std::vector<char>> txParsed(resp_struct.blocks.size());
+  tools::threadpool &tpool = tools::threadpool::getInstance();
+  tools::threadpool::waiter waiter;
+  for (size_t blockIdx = 0; blockIdx < resp_struct.blocks.size(); blockIdx++) {
+    const cryptonote::block_complete_entry &entry = resp_struct.blocks[blockIdx];
+    txs[blockIdx].resize(entry.txs.size());
+    txParsed[blockIdx].resize(entry.txs.size(), 0);
+    tpool.submit(&waiter, [&entry, &blocks, &blockParsed, blockIdx] () {
+      try {
+        blockParsed[blockIdx] = cryptonote::parse_and_validate_block_from_blob(entry.block, blocks[blockIdx]);
+      } catch (const std::exception &) {} // the pool can't propagate exceptions; reported as a parse failure
+    });
+    for (size_t txBegin = 0; txBegin < entry.txs.size(); txBegin += txs_per_parse_task) {
+      size_t txEnd = std::min(entry.txs.size(), txBegin + txs_per_parse_task);
+      tpool.submit(&waiter, [&entry, &txs, &txParsed, blockIdx, txBegin, txEnd] () {
+        for (size_t txIdx = txBegin; txIdx < txEnd; txIdx++) {
+          try {
+            txParsed[blockIdx][txIdx] = cryptonote::parse_and_validate_tx_from_blob(entry.txs[txIdx], txs[blockIdx][txIdx]);
+          } catch (const std::exception &) {}
+        }
+      });
+    }
+  }
+  waiter.wait(&tpool);
+  // report the first failure in the order they were parsed in sequentially
+  for (size_t blockIdx = 0; blockIdx < resp_struct.blocks.size(); blockIdx++) {
+    if (!blockParsed[blockIdx]) {
       throw std::runtime_error("failed to parse block blob at index " + std::to_string(blockIdx));
     }
+    for (size_t txIdx = 0; txIdx < txParsed[blockIdx].size(); txIdx++) {
+      if (!txParsed[blockIdx][txIdx]) {
+        throw std::runtime_error("failed to parse tx blob at index " + std::to_string(txIdx));
+      }
+    }
+  }
+
+  // emit them as nested objects straight into buff_json, with no intermediate strings:
+  // {"blocks":[block, ...],"txs":[[tx, ...], ...],"status":"...","untrusted":bool}
+  buff_json.clear();
+  buff_json.reserve(2 * buff_bin.size());
+  string_append_buf buf(buff_json);
+  std::ostream out(&buf);
+  buff_json.append("{\"blocks\":[");
+  for (size_t blockIdx = 0; blockIdx < blocks.size(); blockIdx++) {
+    if (blockIdx > 0) buff_json.push_back(',');
+    json_archive<true> ar(out);
+    if (!::serialization::serialize(ar, blocks[blockIdx])) {
+      throw std::runtime_error("failed to serialize block at index " + std::to_string(blockIdx));
+    }
+  }
+  buff_json.append("],\"txs\":[");
+  for (size_t blockIdx = 0; blockIdx < txs.size(); blockIdx++) {
+    if (blockIdx > 0) buff_json.push_back(',');
+    buff_json.push_back('[');	// array of array of transactions, one array per block
+    for (size_t txIdx = 0; txIdx < txs[blockIdx].size(); txIdx++) {
+      if (txIdx > 0) buff_json.push_back(',');
+      json_archive<true> ar(out);
+      if (!txs[blockIdx][txIdx].serialize_base(ar)) { // pruned, as get_pruned_tx_json
+        throw std::runtime_error("failed to serialize tx at index " + std::to_string(txIdx));
+      }
+    }
+    buff_json.push_back(']');
+  }
+  buff_json.append("],\"status\":");
+  append_json_string(buff_json, resp_struct.status);
+  buff_json.append(",\"untrusted\":");
+  buff_json.append(resp_struct.untrusted ? "true" : "false");
+  buff_json.push_back('}');
+}
 
-    // parse and validate txs
-    boost::property_tree::ptree txsNode;
-    for (int txIdx = 0; txIdx < resp_struct.blocks[blockIdx].txs.size(); txIdx++) {
-       cryptonote::transaction tx;
-	     if (cryptonote::parse_and_validate_tx_from_blob(resp_struct.blocks[blockIdx].txs[txIdx], tx)) {
+void binary_utils::append_compact_block_json(
+  std::string &out,
+  const crypto::hash &hash,
+  uint64_t height,
+  uint64_t timestamp,
+  const crypto::hash &prev_id,
+  const monero_multi_account_scanner::BlockBatch &batch,
+  size_t txs_begin,
+  size_t txs_end,
+  size_t &input
+) {
+  out.append("{\"hash\":");
+  append_json_hex(out, hash);
+  out.append(",\"height\":" + std::to_string(height));
+  out.append(",\"timestamp\":" + std::to_string(timestamp));
+  out.append(",\"prev_id\":");
+  append_json_hex(out, prev_id);
+  out.append(",\"miner_tx\":");
+  append_compact_tx_json(out, batch, txs_begin, input);
+  out.append(",\"txs\":[");
+  for (size_t t = txs_begin + 1; t < txs_end; t++) {
+    if (t > txs_begin + 1) out.push_back(',');
+    append_compact_tx_json(out, batch, t, input);
+  }
+  out.append("]}");
+}
 
-        // add tx node to txs node
-        boost::property_tree::ptree txNode;
-        //std::cout << "PRUNED:\n" << binary_utils::get_pruned_tx_json(tx) << "\n";
-        txNode.put("", binary_utils::get_pruned_tx_json(tx));	// TODO: no pretty print
-        txsNode.push_back(std::make_pair("", txNode));
-      } else {
-        throw std::runtime_error("failed to parse tx blob at index " + std::to_string(txIdx));
+void binary_utils::binary_blocks_to_compact(const std::string &buff_bin, std::string &buff_json) {
+
+  // load binary rpc response to struct
+  cryptonote::COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::response resp_struct;
+  epee::serialization::load_t_from_binary(resp_struct, buff_bin);
+
+  // each block into its own slot on the shared threadpool, then concatenated in order
+  std::vector<std::string> blockJsons(resp_struct.blocks.size());
+  std::vector<std::string> blockErrs(resp_struct.blocks.size());
+  tools::threadpool &tpool = tools::threadpool::getInstance();
+  tools::threadpool::waiter waiter;
+  for (size_t blockIdx = 0; blockIdx < resp_struct.blocks.size(); blockIdx++) {
+    tpool.submit(&waiter, [&resp_struct, &blockJsons, &blockErrs, blockIdx] () {
+      try {
+        if (!append_compact_entry_json(blockJsons[blockIdx], resp_struct.blocks[blockIdx], blockIdx, blockErrs[blockIdx])) {
+          blockJsons[blockIdx].clear();
+        }
+      } catch (const std::exception &) { // the pool can't propagate exceptions
+        blockErrs[blockIdx] = "failed to parse block blob at index " + std::to_string(blockIdx);
       }
+    });
+  }
+  waiter.wait(&tpool);
+  size_t size = 64;
+  for (size_t blockIdx = 0; blockIdx < blockJsons.size(); blockIdx++) {
+    if (!blockErrs[blockIdx].empty()) {
+      throw std::runtime_error(blockErrs[blockIdx]);
     }
-    txsNodes.push_back(std::make_pair("", txsNode));	// array of array of transactions, one array per block
+    size += blockJsons[blockIdx].size() + 1;
+  }
+
+  buff_json.clear();
+  buff_json.reserve(size);
+  buff_json.append("{\"blocks\":[");
+  for (size_t blockIdx = 0; blockIdx < blockJsons.size(); blockIdx++) {
+    if (blockIdx > 0) buff_json.push_back(',');
+    buff_json.append(blockJsons[blockIdx]);
   }
-  root.add_child("blocks", blocksNode);
-  root.add_child("txs", txsNodes);
-  root.put("status", resp_struct.status);
-  root.put("untrusted", resp_struct.untrusted);	// TODO: loss of ints and bools
-
-  // convert root to string // TODO: common utility with serial_bridge
-  std::stringstream ss;
-  boost::property_tree::write_json(ss, root, false/*pretty*/);
-  buff_json = ss.str();
+  buff_json.append("],\"status\":");
+  append_json_string(buff_json, resp_struct.status);
+  buff_json.append(",\"untrusted\":");
+  buff_json.append(resp_struct.untrusted ? "true" : "false");
+  buff_json.push_back('}');
 }
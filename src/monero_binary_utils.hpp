@@ -4,6 +4,7 @@
 #include "cryptonote_basic.h"
 #include "serialization/keyvalue_serialization.h"	// TODO: consolidate with other binary deps?
 #include "storages/portable_storage.h"
+#include "monero_multi_account_scanner.hpp"
 
 /**
  * Collection of utilities for working with Monero's binary portable storage format.
@@ -15,20 +16,63 @@ namespace binary_utils
   using namespace cryptonote;
 
   /**
-   * TODO.
+   * Converts JSON to portable storage binary while parsing it, without building a portable_storage.
+   * Keys keep their JSON order; nulls and empty arrays are dropped, as epee's JSON loader drops them.
+   * Throws std::runtime_error on malformed JSON.
    */
   void json_to_binary(const std::string &buff_json, std::string &buff_bin);
 
   /**
-   * TODO.
+   * Converts portable storage binary to compact JSON while reading it, without building a portable_storage.
+   * String bytes outside printable ASCII are written as \u00XX escapes, which json_to_binary reads back as
+   * single bytes. Throws std::runtime_error on malformed binary.
    */
   void binary_to_json(const std::string &buff_bin, std::string &buff_json);
 
   /**
-   * TODO.
+   * Like binary_to_json but written to out in chunks, so memory use doesn't grow with the payload.
+   */
+  void binary_to_json(const std::string &buff_bin, std::ostream &out);
+
+  /**
+   * Like binary_to_json but reads size bytes at buff_bin in place, for binary the caller holds outside a std::string.
+   */
+  void binary_to_json(const char *buff_bin, size_t size, std::string &buff_json);
+
+  /**
+   * Converts a binary get_blocks_by_height response to JSON, with each block and pruned tx as a
+   * nested object: {"blocks":[...],"txs":[[...], ...],"status":"...","untrusted":bool}.
    */
   void binary_blocks_to_json(const std::string &buff_bin, std::string &buff_json);
 
+  /**
+   * Like binary_blocks_to_json but with only the fields scanning needs, read through
+   * monero_tx_view::TxView so txs' signatures and prunable data are never parsed:
+   * {"blocks":[{"hash","height","timestamp","prev_id","miner_tx":tx,"txs":[tx, ...]}, ...],"status","untrusted"}
+   * where tx is {"hash","version","unlock_time","pub_key","additional_pub_keys","key_images",
+   * "outputs":[{"key","amount"}, ...],"rct_type","ecdh_info":[{"mask","amount"}, ...],"out_pk"}.
+   * pub_key is omitted when extra has none, additional_pub_keys is empty unless there's one per
+   * output, and ecdh_info's mask is omitted for RCTTypeBulletproof2.
+   */
+  void binary_blocks_to_compact(const std::string &buff_bin, std::string &buff_json);
+
+  /**
+   * Appends one block in binary_blocks_to_compact's format, with its miner tx and txs read from
+   * batch[txs_begin, txs_end). input is the index of the miner tx's first input in batch, and is
+   * left past the block's last. monero_block_cache serves its cached blocks through this too.
+   */
+  void append_compact_block_json(
+    std::string &out,
+    const crypto::hash &hash,
+    uint64_t height,
+    uint64_t timestamp,
+    const crypto::hash &prev_id,
+    const monero_multi_account_scanner::BlockBatch &batch,
+    size_t txs_begin,
+    size_t txs_end,
+    size_t &input
+  );
+
   /**
    * Modified from core_rpc_server.cpp to return a string.
    */
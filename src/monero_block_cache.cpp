@@ -0,0 +1,619 @@
+//
+//  monero_key_image_store.cpp
+//  Copyright (c) 2014-2019, MyMonero.com
+//
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are
+//  permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright notice, this list of
+//	conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list
+//	of conditions and the following disclaimer in the documentation and/or other
+//	materials provided with the distribution.
+//
+//  3. Neither the name of the copyright holder nor the names of its contributors may be
+//	used to endorse or promote products derived from this software without specific
+//	prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+//  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+//  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+//  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+//  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//
+#include "monero_block_cache.hpp"
+#include "monero_binary_utils.hpp"
+#include "monero_tx_view.hpp"
+//
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <boost/thread/lock_guard.hpp>
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+#include "storages/portable_storage_template_helper.h"
+//
+using namespace std;
+using namespace crypto;
+using namespace cryptonote;
+using namespace monero_block_cache;
+using namespace monero_multi_account_scanner;
+//
+namespace
+{
+	// File layout: a Header, then each column back to back in the order _layout lists them, each
+	// padded to 8 bytes so the ones of uint64_t stay aligned in the mapping
+	const uint8_t file_magic[8] = { 'M', 'M', 'B', 'K', 'C', 0, 0, 1 }; // last byte is the version
+	struct Header
+	{
+		uint8_t magic[8];
+		uint64_t start_height;
+		uint64_t n_blocks;
+		uint64_t n_txs;
+		uint64_t n_outputs;
+		uint64_t n_inputs;
+		uint8_t checksum[8]; // leading bytes of H(everything after the header)
+		uint64_t reserved;
+	};
+	static_assert(sizeof(Header) == 64, "Header must be unpadded");
+	//
+	struct BlockColumns // what a segment has beyond its BlockBatch
+	{
+		std::vector<crypto::hash> block_hashes;
+		std::vector<crypto::hash> prev_ids;
+		std::vector<uint64_t> timestamps;
+		std::vector<uint32_t> block_txs_begin; // into the per tx arrays; one extra entry at the end
+	};
+	struct Columns // into a mapping, or a buffer being written
+	{
+		const crypto::hash *block_hashes;
+		const crypto::hash *prev_ids;
+		const uint64_t *timestamps;
+		const uint32_t *block_txs_begin;
+		const crypto::hash *tx_hashes;
+		const uint64_t *tx_unlock_times;
+		const uint8_t *tx_versions;
+		const uint8_t *tx_is_coinbase;
+		const uint8_t *tx_rct_types;
+		const crypto::public_key *tx_pub_keys;
+		const uint32_t *tx_outputs_begin;
+		const uint8_t *tx_has_additional_pub_keys;
+		const crypto::public_key *out_keys;
+		const crypto::public_key *additional_pub_keys;
+		const uint64_t *out_amounts;
+		const rct::ecdhTuple *out_ecdh_info;
+		const rct::key *out_commitments;
+		const crypto::key_image *input_key_images;
+		const uint32_t *input_txs;
+	};
+	template<typename T>
+	void _column(const uint8_t *base, size_t &offset, uint64_t n, const T *&column)
+	{
+		column = base != nullptr ? reinterpret_cast<const T *>(base + offset) : nullptr;
+		offset += (n * sizeof(T) + 7) & ~(size_t)7;
+	}
+	size_t _layout(const Header &h, const uint8_t *base, Columns &c) // returns the file size
+	{
+		size_t offset = sizeof(Header);
+		_column(base, offset, h.n_blocks, c.block_hashes);
+		_column(base, offset, h.n_blocks, c.prev_ids);
+		_column(base, offset, h.n_blocks, c.timestamps);
+		_column(base, offset, h.n_blocks + 1, c.block_txs_begin);
+		_column(base, offset, h.n_txs, c.tx_hashes);
+		_column(base, offset, h.n_txs, c.tx_unlock_times);
+		_column(base, offset, h.n_txs, c.tx_versions);
+		_column(base, offset, h.n_txs, c.tx_is_coinbase);
+		_column(base, offset, h.n_txs, c.tx_rct_types);
+		_column(base, offset, h.n_txs, c.tx_pub_keys);
+		_column(base, offset, h.n_txs + 1, c.tx_outputs_begin);
+		_column(base, offset, h.n_txs, c.tx_has_additional_pub_keys);
+		_column(base, offset, h.n_outputs, c.out_keys);
+		_column(base, offset, h.n_outputs, c.additional_pub_keys);
+		_column(base, offset, h.n_outputs, c.out_amounts);
+		_column(base, offset, h.n_outputs, c.out_ecdh_info);
+		_column(base, offset, h.n_outputs, c.out_commitments);
+		_column(base, offset, h.n_inputs, c.input_key_images);
+		_column(base, offset, h.n_inputs, c.input_txs);
+		return offset;
+	}
+	template<typename T>
+	void _write_column(const T *column, const std::vector<T> &values)
+	{
+		if (!values.empty()) {
+			memcpy(const_cast<T *>(column), values.data(), values.size() * sizeof(T));
+		}
+	}
+	void _checksum(const uint8_t *file, size_t size, uint8_t *out)
+	{
+		crypto::hash h;
+		crypto::cn_fast_hash(file + sizeof(Header), size - sizeof(Header), h);
+		memcpy(out, &h, 8);
+	}
+	//
+	// Building a segment
+	bool _new_segment_file(const vector<block_complete_entry> &entries, string &file, uint64_t &start_height, string &err_string)
+	{
+		BlockBatch batch;
+		BlockColumns blocks;
+		batch.tx_outputs_begin.push_back(0);
+		blocks.block_txs_begin.push_back(0);
+		monero_tx_view::TxView view;
+		for (size_t b = 0; b < entries.size(); b++) {
+			block block;
+			string miner_tx_blob;
+			if (!parse_and_validate_block_from_blob(entries[b].block, block)
+				|| block.tx_hashes.size() != entries[b].txs.size() // the put fails rather than guessing hashes
+				|| !view.parse(miner_tx_blob = tx_to_blob(block.miner_tx))
+				|| !view.is_coinbase()) {
+				err_string = "Failed to parse block blob at index " + std::to_string(b);
+				return false;
+			}
+			uint64_t height = view.coinbase_height();
+			if (b == 0) {
+				start_height = height;
+			} else if (height != start_height + b) {
+				err_string = "Blocks aren't consecutive at index " + std::to_string(b);
+				return false;
+			}
+			blocks.block_hashes.push_back(get_block_hash(block));
+			blocks.prev_ids.push_back(block.prev_id);
+			blocks.timestamps.push_back(block.timestamp);
+			append_tx(batch, view, get_transaction_hash(block.miner_tx), height, true);
+			for (size_t t = 0; t < entries[b].txs.size(); t++) {
+				if (!view.parse(entries[b].txs[t])) {
+					err_string = "Failed to parse tx blob at index " + std::to_string(t) + " of block index " + std::to_string(b);
+					return false;
+				}
+				append_tx(batch, view, block.tx_hashes[t], height, false);
+			}
+			blocks.block_txs_begin.push_back((uint32_t)batch.n_txs());
+		}
+		Header header{};
+		memcpy(header.magic, file_magic, sizeof(file_magic));
+		header.start_height = start_height;
+		header.n_blocks = entries.size();
+		header.n_txs = batch.n_txs();
+		header.n_outputs = batch.n_outputs();
+		header.n_inputs = batch.input_key_images.size();
+		Columns c;
+		file.assign(_layout(header, nullptr, c), '\0');
+		uint8_t *base = reinterpret_cast<uint8_t *>(&file[0]);
+		_layout(header, base, c);
+		_write_column(c.block_hashes, blocks.block_hashes);
+		_write_column(c.prev_ids, blocks.prev_ids);
+		_write_column(c.timestamps, blocks.timestamps);
+		_write_column(c.block_txs_begin, blocks.block_txs_begin);
+		_write_column(c.tx_hashes, batch.tx_hashes);
+		_write_column(c.tx_unlock_times, batch.tx_unlock_times);
+		_write_column(c.tx_versions, batch.tx_versions);
+		_write_column(c.tx_is_coinbase, batch.tx_is_coinbase);
+		_write_column(c.tx_rct_types, batch.tx_rct_types);
+		_write_column(c.tx_pub_keys, batch.tx_pub_keys);
+		_write_column(c.tx_outputs_begin, batch.tx_outputs_begin);
+		_write_column(c.tx_has_additional_pub_keys, batch.tx_has_additional_pub_keys);
+		_write_column(c.out_keys, batch.out_keys);
+		_write_column(c.additional_pub_keys, batch.additional_pub_keys);
+		_write_column(c.out_amounts, batch.out_amounts);
+		_write_column(c.out_ecdh_info, batch.out_ecdh_info);
+		_write_column(c.out_commitments, batch.out_commitments);
+		_write_column(c.input_key_images, batch.input_key_images);
+		_write_column(c.input_txs, batch.input_txs);
+		_checksum(base, file.size(), header.checksum);
+		memcpy(base, &header, sizeof(header));
+		return true;
+	}
+	string _segment_name(uint64_t start_height, uint64_t end_height)
+	{
+		char name[64];
+		snprintf(name, sizeof(name), "%020" PRIu64 "-%020" PRIu64 ".mbc", start_height, end_height);
+		return name;
+	}
+	//
+	// Reading
+	struct MappedRange // part of a mapped segment
+	{
+		const uint8_t *mapped;
+		uint64_t start_height;
+		uint64_t end_height;
+	};
+	template<typename T>
+	void _append(std::vector<T> &values, const T *column, size_t begin, size_t end)
+	{
+		values.insert(values.end(), column + begin, column + end);
+	}
+	void _assemble(const vector<MappedRange> &ranges, BlockBatch &batch, BlockColumns &blocks)
+	{
+		batch = BlockBatch{};
+		blocks = BlockColumns{};
+		batch.start_height = ranges.front().start_height;
+		batch.end_height = ranges.back().end_height;
+		batch.tx_outputs_begin.push_back(0);
+		blocks.block_txs_begin.push_back(0);
+		for (const MappedRange &range : ranges) {
+			const Header &header = *reinterpret_cast<const Header *>(range.mapped);
+			Columns c;
+			_layout(header, range.mapped, c);
+			size_t b0 = range.start_height - header.start_height;
+			size_t b1 = range.end_height - header.start_height;
+			size_t t0 = c.block_txs_begin[b0];
+			size_t t1 = c.block_txs_begin[b1];
+			size_t o0 = c.tx_outputs_begin[t0];
+			size_t o1 = c.tx_outputs_begin[t1];
+			size_t i0 = std::lower_bound(c.input_txs, c.input_txs + header.n_inputs, (uint32_t)t0) - c.input_txs;
+			size_t i1 = std::lower_bound(c.input_txs, c.input_txs + header.n_inputs, (uint32_t)t1) - c.input_txs;
+			uint32_t txs_base = (uint32_t)batch.n_txs();
+			uint32_t outputs_base = (uint32_t)batch.n_outputs();
+			//
+			_append(blocks.block_hashes, c.block_hashes, b0, b1);
+			_append(blocks.prev_ids, c.prev_ids, b0, b1);
+			_append(blocks.timestamps, c.timestamps, b0, b1);
+			for (size_t b = b0; b < b1; b++) {
+				blocks.block_txs_begin.push_back(c.block_txs_begin[b + 1] - t0 + txs_base);
+				for (size_t t = c.block_txs_begin[b]; t < c.block_txs_begin[b + 1]; t++) {
+					batch.tx_heights.push_back(header.start_height + b);
+				}
+			}
+			_append(batch.tx_versions, c.tx_versions, t0, t1);
+			_append(batch.tx_hashes, c.tx_hashes, t0, t1);
+			_append(batch.tx_unlock_times, c.tx_unlock_times, t0, t1);
+			_append(batch.tx_is_coinbase, c.tx_is_coinbase, t0, t1);
+			_append(batch.tx_rct_types, c.tx_rct_types, t0, t1);
+			_append(batch.tx_pub_keys, c.tx_pub_keys, t0, t1);
+			for (size_t t = t0; t < t1; t++) {
+				batch.tx_outputs_begin.push_back(c.tx_outputs_begin[t + 1] - o0 + outputs_base);
+			}
+			_append(batch.tx_has_additional_pub_keys, c.tx_has_additional_pub_keys, t0, t1);
+			_append(batch.out_keys, c.out_keys, o0, o1);
+			_append(batch.additional_pub_keys, c.additional_pub_keys, o0, o1);
+			_append(batch.out_amounts, c.out_amounts, o0, o1);
+			_append(batch.out_ecdh_info, c.out_ecdh_info, o0, o1);
+			_append(batch.out_commitments, c.out_commitments, o0, o1);
+			_append(batch.input_key_images, c.input_key_images, i0, i1);
+			for (size_t i = i0; i < i1; i++) {
+				batch.input_txs.push_back(c.input_txs[i] - t0 + txs_base);
+			}
+		}
+	}
+}
+//
+struct BlockCache::Segment
+{
+	string path;
+	uint64_t start_height;
+	uint64_t end_height;
+	uint64_t size;
+	const uint8_t *mapped = nullptr; // on first read
+	boost::mutex map_mutex; // so concurrent first readers map and checksum it once
+	//
+	~Segment()
+	{
+		if (mapped != nullptr) {
+			munmap(const_cast<uint8_t *>(mapped), size);
+		}
+	}
+	bool map() // false when unreadable or corrupt; reads the whole file, so call without the cache's mutex
+	{
+		boost::lock_guard<boost::mutex> lock(map_mutex);
+		if (mapped != nullptr) {
+			return true;
+		}
+		int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) {
+			return false;
+		}
+		struct stat st;
+		if (fstat(fd, &st) != 0 || (uint64_t)st.st_size != size || size < sizeof(Header)) {
+			::close(fd);
+			return false;
+		}
+		void *p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd); // the mapping keeps the file
+		if (p == MAP_FAILED) {
+			return false;
+		}
+		mapped = static_cast<const uint8_t *>(p);
+		Header header;
+		memcpy(&header, mapped, sizeof(header));
+		Columns c;
+		uint8_t checksum[8];
+		bool is_intact = memcmp(header.magic, file_magic, sizeof(file_magic)) == 0
+			&& header.start_height == start_height
+			&& header.n_blocks == end_height - start_height
+			&& header.n_txs < UINT32_MAX && header.n_outputs < UINT32_MAX && header.n_inputs < UINT32_MAX
+			&& _layout(header, mapped, c) == size;
+		if (is_intact) {
+			_checksum(mapped, size, checksum);
+			is_intact = memcmp(checksum, header.checksum, sizeof(checksum)) == 0
+				&& c.block_txs_begin[header.n_blocks] == header.n_txs
+				&& c.tx_outputs_begin[header.n_txs] == header.n_outputs;
+		}
+		if (!is_intact) {
+			munmap(const_cast<uint8_t *>(mapped), size);
+			mapped = nullptr;
+		}
+		return is_intact;
+	}
+};
+struct BlockCache::Range
+{
+	std::shared_ptr<Segment> segment; // held, so eviction doesn't unmap it under a reader
+	uint64_t start_height;
+	uint64_t end_height;
+};
+//
+BlockCache::~BlockCache()
+{
+}
+bool BlockCache::put(const vector<block_complete_entry> &blocks, string &err_string)
+{
+	if (blocks.empty()) {
+		return true;
+	}
+	string file;
+	uint64_t start_height;
+	if (!_new_segment_file(blocks, file, start_height, err_string)) {
+		return false;
+	}
+	if (file.size() > m_max_bytes) {
+		return true;
+	}
+	uint64_t end_height = start_height + blocks.size();
+	static std::atomic<uint64_t> n_temporary_files(0);
+	string temporary_path = m_directory + "/" + _segment_name(start_height, end_height) + ".tmp" + std::to_string(getpid()) + "_" + std::to_string(n_temporary_files++);
+	int fd = ::open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd < 0) {
+		err_string = "Failed to create block cache segment";
+		return false;
+	}
+	size_t written = 0;
+	while (written < file.size()) {
+		ssize_t n = ::write(fd, file.data() + written, file.size() - written);
+		if (n <= 0) {
+			break;
+		}
+		written += n;
+	}
+	::close(fd);
+	if (written != file.size()) {
+		unlink(temporary_path.c_str());
+		err_string = "Failed to write block cache segment";
+		return false;
+	}
+	//
+	boost::lock_guard<boost::mutex> lock(m_mutex);
+	// whatever overlaps is replaced, e.g. by a reorg's blocks
+	for (auto it = m_segments.begin(); it != m_segments.end(); ) {
+		uint64_t segment_start_height = it->first;
+		bool is_overlapping = it->second->start_height < end_height && start_height < it->second->end_height;
+		++it;
+		if (is_overlapping) {
+			_evict(segment_start_height);
+		}
+	}
+	std::shared_ptr<Segment> segment(new Segment);
+	segment->path = m_directory + "/" + _segment_name(start_height, end_height);
+	segment->start_height = start_height;
+	segment->end_height = end_height;
+	segment->size = file.size();
+	if (rename(temporary_path.c_str(), segment->path.c_str()) != 0) {
+		unlink(temporary_path.c_str());
+		err_string = "Failed to write block cache segment";
+		return false;
+	}
+	m_segments[start_height] = segment;
+	m_lru.push_front(start_height);
+	m_bytes += segment->size;
+	while (m_bytes > m_max_bytes) {
+		_evict(m_lru.back());
+	}
+	return true;
+}
+bool BlockCache::put_blocks_by_height_response(const string &buff_bin, string &err_string)
+{
+	COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::response resp_struct;
+	if (!epee::serialization::load_t_from_binary(resp_struct, buff_bin)) {
+		err_string = "Failed to load blocks by height response";
+		return false;
+	}
+	return put(resp_struct.blocks, err_string);
+}
+void BlockCache::_evict(uint64_t start_height)
+{
+	auto found = m_segments.find(start_height);
+	if (found == m_segments.end()) {
+		return;
+	}
+	unlink(found->second->path.c_str()); // readers still holding it keep their mapping
+	m_bytes -= found->second->size;
+	m_segments.erase(found);
+	m_lru.remove(start_height);
+	m_evictions++;
+}
+//
+bool BlockCache::has(uint64_t start_height, uint64_t end_height) const
+{
+	boost::lock_guard<boost::mutex> lock(m_mutex);
+	uint64_t height = start_height;
+	while (height < end_height) {
+		auto found = m_segments.upper_bound(height);
+		if (found == m_segments.begin()) {
+			return false;
+		}
+		--found;
+		if (found->second->end_height <= height) {
+			return false;
+		}
+		height = found->second->end_height;
+	}
+	return true;
+}
+bool BlockCache::_ranges(uint64_t start_height, uint64_t end_height, vector<Range> &ranges)
+{
+	ranges.clear();
+	uint64_t height = start_height;
+	while (height < end_height) {
+		auto found = m_segments.upper_bound(height);
+		if (found == m_segments.begin()) {
+			return false;
+		}
+		--found;
+		std::shared_ptr<Segment> segment = found->second;
+		if (segment->end_height <= height) {
+			return false;
+		}
+		m_lru.remove(segment->start_height);
+		m_lru.push_front(segment->start_height);
+		ranges.push_back(Range{ segment, height, std::min(end_height, segment->end_height) });
+		height = segment->end_height;
+	}
+	return true;
+}
+bool BlockCache::_get(uint64_t start_height, uint64_t end_height, vector<Range> &ranges)
+{
+	{
+		boost::lock_guard<boost::mutex> lock(m_mutex);
+		if (start_height >= end_height || !_ranges(start_height, end_height, ranges)) {
+			m_misses++;
+			return false;
+		}
+	}
+	// A segment's first read maps and checksums the whole file, so other readers and puts aren't held up by it
+	for (const Range &range : ranges) {
+		if (!range.segment->map()) {
+			boost::lock_guard<boost::mutex> lock(m_mutex);
+			auto found = m_segments.find(range.segment->start_height);
+			if (found != m_segments.end() && found->second == range.segment) { // unless already replaced
+				_evict(range.segment->start_height);
+			}
+			m_misses++;
+			ranges.clear();
+			return false;
+		}
+	}
+	boost::lock_guard<boost::mutex> lock(m_mutex);
+	m_hits++;
+	return true;
+}
+bool BlockCache::get_batch(uint64_t start_height, uint64_t end_height, BlockBatch &batch)
+{
+	vector<Range> ranges;
+	if (!_get(start_height, end_height, ranges)) {
+		return false;
+	}
+	vector<MappedRange> mapped_ranges;
+	for (const Range &range : ranges) {
+		mapped_ranges.push_back(MappedRange{ range.segment->mapped, range.start_height, range.end_height });
+	}
+	BlockColumns blocks;
+	_assemble(mapped_ranges, batch, blocks);
+	return true;
+}
+bool BlockCache::get_compact_json(uint64_t start_height, uint64_t end_height, string &buff_json)
+{
+	vector<Range> ranges;
+	if (!_get(start_height, end_height, ranges)) {
+		return false;
+	}
+	vector<MappedRange> mapped_ranges;
+	for (const Range &range : ranges) {
+		mapped_ranges.push_back(MappedRange{ range.segment->mapped, range.start_height, range.end_height });
+	}
+	BlockBatch batch;
+	BlockColumns blocks;
+	_assemble(mapped_ranges, batch, blocks);
+	//
+	buff_json.clear();
+	buff_json.append("{\"blocks\":[");
+	size_t input = 0;
+	for (size_t b = 0; b < blocks.block_hashes.size(); b++) {
+		if (b > 0) buff_json.push_back(',');
+		binary_utils::append_compact_block_json(
+			buff_json, blocks.block_hashes[b], start_height + b, blocks.timestamps[b], blocks.prev_ids[b],
+			batch, blocks.block_txs_begin[b], blocks.block_txs_begin[b + 1], input
+		);
+	}
+	buff_json.append("],\"status\":\"OK\",\"untrusted\":false}"); // only what was put is served
+	return true;
+}
+Stats BlockCache::stats() const
+{
+	boost::lock_guard<boost::mutex> lock(m_mutex);
+	return Stats{
+		m_segments.size(), m_bytes,
+		m_hits, m_misses, m_evictions
+	};
+}
+//
+bool monero_block_cache::new__block_cache(const string &directory, uint64_t max_bytes, std::unique_ptr<BlockCache> &cache, string &err_string)
+{
+	DIR *dir = opendir(directory.c_str());
+	if (dir == nullptr) {
+		err_string = "Block cache directory doesn't exist";
+		return false;
+	}
+	typedef BlockCache::Segment Segment;
+	std::unique_ptr<BlockCache> opened(new BlockCache);
+	opened->m_directory = directory;
+	opened->m_max_bytes = max_bytes;
+	vector<std::pair<time_t, std::shared_ptr<Segment>>> found; // by modification time
+	while (dirent *entry = readdir(dir)) {
+		string name = entry->d_name;
+		string path = directory + "/" + name;
+		uint64_t start_height, end_height;
+		struct stat st;
+		if (name.find(".mbc.tmp") != string::npos) { // left by a put that didn't finish
+			unlink(path.c_str());
+			continue;
+		}
+		if (sscanf(name.c_str(), "%" SCNu64 "-%" SCNu64 ".mbc", &start_height, &end_height) != 2
+			|| name != _segment_name(start_height, end_height)
+			|| start_height >= end_height
+			|| ::stat(path.c_str(), &st) != 0) {
+			continue;
+		}
+		std::shared_ptr<Segment> segment(new Segment);
+		segment->path = path;
+		segment->start_height = start_height;
+		segment->end_height = end_height;
+		segment->size = (uint64_t)st.st_size;
+		found.push_back(std::make_pair(st.st_mtime, segment));
+	}
+	closedir(dir);
+	std::sort(found.begin(), found.end(), [] (const std::pair<time_t, std::shared_ptr<Segment>> &a, const std::pair<time_t, std::shared_ptr<Segment>> &b) {
+		return a.first > b.first;
+	});
+	boost::lock_guard<boost::mutex> lock(opened->m_mutex);
+	for (const auto &entry : found) { // newest first; an older segment overlapping a newer one is dropped
+		const std::shared_ptr<Segment> &segment = entry.second;
+		auto next = opened->m_segments.lower_bound(segment->start_height);
+		bool is_overlapping = (next != opened->m_segments.end() && next->second->start_height < segment->end_height)
+			|| (next != opened->m_segments.begin() && std::prev(next)->second->end_height > segment->start_height);
+		if (is_overlapping) {
+			unlink(segment->path.c_str());
+			continue;
+		}
+		opened->m_segments[segment->start_height] = segment;
+		opened->m_lru.push_back(segment->start_height);
+		opened->m_bytes += segment->size;
+	}
+	while (opened->m_bytes > opened->m_max_bytes) {
+		opened->_evict(opened->m_lru.back());
+	}
+	cache = std::move(opened);
+	return true;
+}
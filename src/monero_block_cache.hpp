@@ -0,0 +1,106 @@
+//
+//  monero_block_cache.hpp
+//  Copyright (c) 2014-2019, MyMonero.com
+//
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are
+//  permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright notice, this list of
+//	conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list
+//	of conditions and the following disclaimer in the documentation and/or other
+//	materials provided with the distribution.
+//
+//  3. Neither the name of the copyright holder nor the names of its contributors may be
+//	used to endorse or promote products derived from this software without specific
+//	prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+//  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+//  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+//  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+//  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//
+#ifndef monero_block_cache_hpp
+#define monero_block_cache_hpp
+//
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include "crypto.h"
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
+#include "monero_multi_account_scanner.hpp"
+//
+namespace monero_block_cache
+{
+	// Local cache of the scanning-relevant part of get_blocks_by_height responses, so clients
+	// scanning overlapping ranges don't each refetch and reparse the same blocks. Every put range
+	// becomes one segment file: a header then one column per field - block hashes, prev ids,
+	// timestamps and tx counts per height; a BlockBatch's tx, output (keys, amounts, ecdh info,
+	// commitments) and input (key images) columns. Segments are built with monero_tx_view, so
+	// txs' signatures and prunable data are never parsed, and written to a temporary file that's
+	// renamed into place. They're mapped on first read, which checks their checksum, and served
+	// as BlockBatches (for monero_multi_account_scanner::Engine) or as
+	// binary_utils::binary_blocks_to_compact JSON. Whole segments are evicted least recently used
+	// first to keep the directory under max_bytes; a put overlapping cached ranges replaces them,
+	// so a reorged range is just put again. Columns are in host byte order - the cache is local.
+	// Safe to call from multiple threads.
+	struct Stats
+	{
+		size_t segments;
+		uint64_t bytes; // on disk
+		uint64_t hits; // get calls served
+		uint64_t misses; // get calls for ranges which weren't fully cached
+		uint64_t evictions;
+	};
+	//
+	class BlockCache
+	{
+	public:
+		~BlockCache();
+		//
+		// Segments larger than max_bytes aren't kept; that's not an error
+		bool put(const std::vector<cryptonote::block_complete_entry> &blocks, std::string &err_string); // consecutive, ascending
+		bool put_blocks_by_height_response(const std::string &buff_bin, std::string &err_string);
+		//
+		bool has(uint64_t start_height, uint64_t end_height) const; // [start, end)
+		// false, with batch or buff_json untouched, when [start, end) isn't fully cached
+		bool get_batch(uint64_t start_height, uint64_t end_height, monero_multi_account_scanner::BlockBatch &batch);
+		bool get_compact_json(uint64_t start_height, uint64_t end_height, std::string &buff_json);
+		Stats stats() const;
+	private:
+		struct Segment;
+		struct Range;
+		friend bool new__block_cache(const std::string &directory, uint64_t max_bytes, std::unique_ptr<BlockCache> &cache, std::string &err_string);
+		BlockCache() {}
+		//
+		bool _ranges(uint64_t start_height, uint64_t end_height, std::vector<Range> &ranges); // must hold mutex; doesn't map them
+		bool _get(uint64_t start_height, uint64_t end_height, std::vector<Range> &ranges);
+		void _evict(uint64_t start_height); // must hold mutex
+		//
+		std::string m_directory;
+		uint64_t m_max_bytes = 0;
+		mutable boost::mutex m_mutex;
+		std::map<uint64_t, std::shared_ptr<Segment>> m_segments; // by start height; ranges don't overlap
+		std::list<uint64_t> m_lru; // segment start heights, most recently used first
+		uint64_t m_bytes = 0;
+		uint64_t m_hits = 0;
+		uint64_t m_misses = 0;
+		uint64_t m_evictions = 0;
+	};
+	// Opens the cache in directory (which must exist), indexing the segments already there
+	bool new__block_cache(const std::string &directory, uint64_t max_bytes, std::unique_ptr<BlockCache> &cache, std::string &err_string);
+}
+//
+#endif /* monero_block_cache_hpp */
@@ -0,0 +1,174 @@
+//
+//  monero_key_image_store.cpp
+//  Copyright (c) 2014-2019, MyMonero.com
+//
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are
+//  permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright notice, this list of
+//	conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list
+//	of conditions and the following disclaimer in the documentation and/or other
+//	materials provided with the distribution.
+//
+//  3. Neither the name of the copyright holder nor the names of its contributors may be
+//	used to endorse or promote products derived from this software without specific
+//	prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+//  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+//  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+//  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+//  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//
+#include "monero_buffer_registry.hpp"
+//
+#include <map>
+#include <unordered_map>
+#include <cstring>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+//
+using namespace std;
+using namespace monero_buffer_registry;
+//
+namespace
+{
+	// A pooled buffer is reused for sizes from half its capacity (less this slack) up to its capacity
+	const size_t reuse_slack = 4096;
+	//
+	struct Registry
+	{
+		boost::mutex mutex;
+		Handle next_handle = 1;
+		std::unordered_map<Handle, std::shared_ptr<std::string>> buffers;
+		std::multimap<size_t, std::unique_ptr<std::string>> pool; // by capacity
+		size_t live_buffers = 0;
+		size_t live_bytes = 0;
+		size_t pooled_bytes = 0;
+		uint64_t allocations = 0;
+		uint64_t reuses = 0;
+	};
+	Registry &_registry()
+	{
+		static Registry *registry = new Registry; // never destroyed, so buffers released during static destruction still have somewhere to go
+		return *registry;
+	}
+	void _release(std::string *buffer)
+	{ // a buffer's last reference is gone; pool it, evicting the largest pooled ones if it doesn't fit
+		Registry &registry = _registry();
+		std::unique_ptr<std::string> owned(buffer);
+		boost::lock_guard<boost::mutex> lock(registry.mutex);
+		registry.live_buffers--;
+		registry.live_bytes -= owned->size();
+		size_t capacity = owned->capacity();
+		if (capacity > max_pooled_bytes) {
+			return;
+		}
+		while (registry.pooled_bytes + capacity > max_pooled_bytes) {
+			auto largest = std::prev(registry.pool.end());
+			registry.pooled_bytes -= largest->first;
+			registry.pool.erase(largest);
+		}
+		registry.pooled_bytes += capacity;
+		registry.pool.emplace(capacity, std::move(owned));
+	}
+	Handle _register(Registry &registry, std::unique_ptr<std::string> buffer)
+	{ // registry.mutex is held
+		Handle handle = registry.next_handle++;
+		registry.live_buffers++;
+		registry.live_bytes += buffer->size();
+		registry.buffers.emplace(handle, std::shared_ptr<std::string>(buffer.release(), _release));
+		return handle;
+	}
+}
+//
+Handle monero_buffer_registry::allocate(size_t size)
+{
+	Registry &registry = _registry();
+	std::unique_ptr<std::string> buffer;
+	{
+		boost::lock_guard<boost::mutex> lock(registry.mutex);
+		registry.allocations++;
+		auto found = registry.pool.lower_bound(size);
+		if (found != registry.pool.end() && found->first <= 2 * size + reuse_slack) {
+			registry.pooled_bytes -= found->first;
+			buffer = std::move(found->second);
+			registry.pool.erase(found);
+			registry.reuses++;
+		}
+	}
+	if (buffer == nullptr) {
+		buffer.reset(new std::string);
+		buffer->reserve(size);
+	}
+	buffer->resize(size); // within capacity, so a reused buffer isn't reallocated
+	//
+	boost::lock_guard<boost::mutex> lock(registry.mutex);
+	return _register(registry, std::move(buffer));
+}
+Handle monero_buffer_registry::adopt(std::string &&buffer)
+{
+	Registry &registry = _registry();
+	std::unique_ptr<std::string> owned(new std::string(std::move(buffer)));
+	boost::lock_guard<boost::mutex> lock(registry.mutex);
+	registry.allocations++;
+	return _register(registry, std::move(owned));
+}
+bool monero_buffer_registry::fill(Handle handle, size_t offset, const void *data, size_t size)
+{
+	std::shared_ptr<const std::string> buffer = acquire(handle);
+	if (buffer == nullptr || offset > buffer->size() || size > buffer->size() - offset) {
+		return false;
+	}
+	memcpy(const_cast<char *>(buffer->data()) + offset, data, size);
+	return true;
+}
+char *monero_buffer_registry::data(Handle handle)
+{
+	std::shared_ptr<const std::string> buffer = acquire(handle);
+	return buffer == nullptr ? nullptr : const_cast<char *>(buffer->data());
+}
+std::shared_ptr<const std::string> monero_buffer_registry::acquire(Handle handle)
+{
+	Registry &registry = _registry();
+	boost::lock_guard<boost::mutex> lock(registry.mutex);
+	auto found = registry.buffers.find(handle);
+	if (found == registry.buffers.end()) {
+		return nullptr;
+	}
+	return found->second;
+}
+bool monero_buffer_registry::free(Handle handle)
+{
+	std::shared_ptr<std::string> buffer; // released outside the lock, as _release takes it
+	Registry &registry = _registry();
+	{
+		boost::lock_guard<boost::mutex> lock(registry.mutex);
+		auto found = registry.buffers.find(handle);
+		if (found == registry.buffers.end()) {
+			return false;
+		}
+		buffer = std::move(found->second);
+		registry.buffers.erase(found);
+	}
+	return true;
+}
+Stats monero_buffer_registry::stats()
+{
+	Registry &registry = _registry();
+	boost::lock_guard<boost::mutex> lock(registry.mutex);
+	return Stats{
+		registry.live_buffers, registry.live_bytes,
+		registry.pool.size(), registry.pooled_bytes,
+		registry.allocations, registry.reuses
+	};
+}
@@ -0,0 +1,69 @@
+//
+//  monero_buffer_registry.hpp
+//  Copyright (c) 2014-2019, MyMonero.com
+//
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are
+//  permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright notice, this list of
+//	conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list
+//	of conditions and the following disclaimer in the documentation and/or other
+//	materials provided with the distribution.
+//
+//  3. Neither the name of the copyright holder nor the names of its contributors may be
+//	used to endorse or promote products derived from this software without specific
+//	prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+//  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+//  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+//  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+//  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//
+#ifndef monero_buffer_registry_hpp
+#define monero_buffer_registry_hpp
+//
+#include <memory>
+#include <string>
+//
+namespace monero_buffer_registry
+{
+	// Process-wide registry of binary buffers handed across the bridge by handle instead of by raw
+	// pointer, so they can be freed and aren't truncated to an int on the way back. Buffers are
+	// std::strings, so the binary_utils functions read them in place. Freed buffers go back to a
+	// pool bounded by max_pooled_bytes and are reused by later allocations of a similar size, so a
+	// steady stream of requests stops allocating. Safe to call from multiple threads; a buffer
+	// mustn't be filled while it's being read.
+	typedef uint64_t Handle; // 0 is never a handle
+	static const size_t max_pooled_bytes = 64 * 1024 * 1024;
+	//
+	struct Stats
+	{
+		size_t live_buffers; // allocated and not yet freed, or freed while still acquired
+		size_t live_bytes;
+		size_t pooled_buffers;
+		size_t pooled_bytes; // capacity kept for reuse
+		uint64_t allocations; // by allocate() and adopt()
+		uint64_t reuses; // allocations served from the pool
+	};
+	//
+	Handle allocate(size_t size); // contents are unspecified until filled
+	Handle adopt(std::string &&buffer); // registers an already filled buffer without copying it
+	bool fill(Handle handle, size_t offset, const void *data, size_t size); // false for unknown handles or out of bounds writes
+	char *data(Handle handle); // for callers writing in place (e.g. from JS over the wasm heap); null for unknown handles
+	// The buffer stays valid while the returned pointer is held, even if it's freed meanwhile; null for unknown handles
+	std::shared_ptr<const std::string> acquire(Handle handle);
+	bool free(Handle handle); // false for unknown handles
+	Stats stats();
+}
+//
+#endif /* monero_buffer_registry_hpp */
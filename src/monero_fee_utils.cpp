@@ -60,9 +60,9 @@ uint64_t monero_fee_utils::get_base_fee( // added as of v8
 uint64_t monero_fee_utils::estimated_tx_network_fee(
 	uint64_t base_fee,
 	uint32_t priority,
-	use_fork_rules_fn_type use_fork_rules_fn
+	const ForkRules &fork_rules
 ) {
-	uint64_t fee_multiplier = get_fee_multiplier(priority, default_priority(), get_fee_algorithm(use_fork_rules_fn), use_fork_rules_fn);
+	uint64_t fee_multiplier = get_fee_multiplier(priority, default_priority(), get_fee_algorithm(fork_rules), fork_rules);
 	std::vector<uint8_t> extra; // blank extra
 	size_t est_tx_size = estimate_rct_tx_size(2, fixed_mixinsize(), 2, extra.size(), true/*bulletproof*/); // typically ~14kb post-rct, pre-bulletproofs
 	uint64_t estimated_fee = calculate_fee_from_size(base_fee, est_tx_size, fee_multiplier);
@@ -71,22 +71,14 @@ uint64_t monero_fee_utils::estimated_tx_network_fee(
 }
 uint64_t monero_fee_utils::get_upper_transaction_weight_limit(
 	uint64_t upper_transaction_weight_limit__or_0_for_default,
-	use_fork_rules_fn_type use_fork_rules_fn
+	const ForkRules &fork_rules
 ) {
 	if (upper_transaction_weight_limit__or_0_for_default > 0)
 		return upper_transaction_weight_limit__or_0_for_default;
-	uint64_t full_reward_zone = use_fork_rules_fn(5, 10) ? CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V5 : use_fork_rules_fn(2, 10) ? CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V2 : CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V1;
-	if (use_fork_rules_fn(8, 10))
-		return full_reward_zone / 2 - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE;
-	else
-		return full_reward_zone - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE;
+	return fork_rules.upper_transaction_weight_limit;
 }
-uint64_t monero_fee_utils::get_fee_multiplier(
-	uint32_t priority,
-	uint32_t default_priority,
-	int fee_algorithm,
-	use_fork_rules_fn_type use_fork_rules_fn
-) {
+namespace
+{
 	static const struct
 	{
 		size_t count;
@@ -99,9 +91,15 @@ uint64_t monero_fee_utils::get_fee_multiplier(
 		{ 4, {1, 4, 20, 166} },
 		{ 4, {1, 5, 25, 1000} },
 	};
-	
+}
+uint64_t monero_fee_utils::get_fee_multiplier(
+	uint32_t priority,
+	uint32_t default_priority,
+	int fee_algorithm,
+	const ForkRules &fork_rules
+) {
 	if (fee_algorithm == -1)
-		fee_algorithm = get_fee_algorithm(use_fork_rules_fn);
+		fee_algorithm = fork_rules.fee_algorithm;
 	
 	// 0 -> default (here, x1 till fee algorithm 2, x4 from it)
 	if (priority == 0)
@@ -126,16 +124,9 @@ uint64_t monero_fee_utils::get_fee_multiplier(
 	THROW_WALLET_EXCEPTION_IF (false, error::invalid_priority);
 	return 1;
 }
-int monero_fee_utils::get_fee_algorithm(use_fork_rules_fn_type use_fork_rules_fn)
+int monero_fee_utils::get_fee_algorithm(const ForkRules &fork_rules)
 {
-	// changes at v3, v5, v8
-	if (use_fork_rules_fn(HF_VERSION_PER_BYTE_FEE, 0))
-		return 3;
-	if (use_fork_rules_fn(5, 0))
-		return 2;
-	if (use_fork_rules_fn(3, -720 * 14))
-		return 1;
-	return 0;
+	return fork_rules.fee_algorithm;
 }
 size_t monero_fee_utils::estimate_rct_tx_size(int n_inputs, int mixin, int n_outputs, size_t extra_size, bool bulletproof)
 {
@@ -213,11 +204,256 @@ uint64_t monero_fee_utils::estimate_tx_weight(bool use_rct, int n_inputs, int mi
 	}
 	return size;
 }
+//
+namespace
+{
+	size_t _n_bulletproof_LR(size_t n_outputs) // L and R each have this many elements
+	{
+		size_t log_padded_outputs = 0;
+		while (((size_t)1<<log_padded_outputs) < n_outputs)
+			++log_padded_outputs;
+		return 6 + log_padded_outputs;
+	}
+}
+size_t monero_fee_utils::varint_size(uint64_t v)
+{
+	size_t n = 1;
+	while (v >= 0x80) {
+		v >>= 7;
+		n++;
+	}
+	return n;
+}
+size_t monero_fee_utils::exact_rct_tx_size(
+	const std::vector<std::vector<uint64_t>> &ring_global_indices,
+	size_t n_outputs,
+	size_t extra_size,
+	uint64_t fee,
+	uint64_t unlock_time,
+	rct::RCTType rct_type
+) {
+	THROW_WALLET_EXCEPTION_IF(rct_type != rct::RCTTypeSimple && rct_type != rct::RCTTypeBulletproof && rct_type != rct::RCTTypeBulletproof2, error::wallet_internal_error, "Unsupported rct type");
+	THROW_WALLET_EXCEPTION_IF(ring_global_indices.empty() || n_outputs == 0, error::wallet_internal_error, "Expected inputs and outputs");
+	const size_t n_inputs = ring_global_indices.size();
+	const size_t ring_size = ring_global_indices[0].size();
+	bool bulletproof = rct_type != rct::RCTTypeSimple;
+	size_t size = 0;
+	//
+	// tx prefix
+	size += varint_size(2/*version*/) + varint_size(unlock_time);
+	size += varint_size(n_inputs);
+	for (const auto &ring : ring_global_indices) {
+		THROW_WALLET_EXCEPTION_IF(ring.size() != ring_size, error::wallet_internal_error, "Expected all rings to be the same size");
+		size += 1/*variant tag*/ + varint_size(0/*amount*/) + varint_size(ring.size());
+		uint64_t prev = 0;
+		for (uint64_t global_index : ring) { // key_offsets are relative
+			THROW_WALLET_EXCEPTION_IF(global_index < prev, error::wallet_internal_error, "Expected ring global indices to be ascending");
+			size += varint_size(global_index - prev);
+			prev = global_index;
+		}
+		size += sizeof(crypto::key_image);
+	}
+	size += varint_size(n_outputs);
+	size += n_outputs * (varint_size(0/*amount*/) + 1/*variant tag*/ + sizeof(crypto::public_key));
+	size += varint_size(extra_size) + extra_size;
+	//
+	// rct base
+	size += 1/*type*/ + varint_size(fee);
+	if (rct_type == rct::RCTTypeSimple)
+		size += n_inputs * sizeof(rct::key); // pseudoOuts
+	size += n_outputs * (rct_type == rct::RCTTypeBulletproof2 ? 8 : 2 * sizeof(rct::key)); // ecdhInfo
+	size += n_outputs * sizeof(rct::key); // outPk - only commitment is saved
+	//
+	// rct prunable
+	if (bulletproof) {
+		size += rct_type == rct::RCTTypeBulletproof2 ? varint_size(1) : sizeof(uint32_t); // number of bulletproofs
+		size_t n_LR = _n_bulletproof_LR(n_outputs);
+		size += 9 * sizeof(rct::key) + 2 * (varint_size(n_LR) + n_LR * sizeof(rct::key));
+	} else {
+		size += n_outputs * (2*64*32+32+64*32); // rangeSigs
+	}
+	size += n_inputs * (2 * sizeof(rct::key) * ring_size + sizeof(rct::key)); // MGs
+	if (bulletproof)
+		size += n_inputs * sizeof(rct::key); // pseudoOuts
+	//
+	return size;
+}
+uint64_t monero_fee_utils::exact_tx_weight(
+	const std::vector<std::vector<uint64_t>> &ring_global_indices,
+	size_t n_outputs,
+	size_t extra_size,
+	uint64_t fee,
+	uint64_t unlock_time,
+	rct::RCTType rct_type
+) {
+	uint64_t weight = exact_rct_tx_size(ring_global_indices, n_outputs, extra_size, fee, unlock_time, rct_type);
+	if (rct_type != rct::RCTTypeSimple && n_outputs > 2)
+	{ // same clawback as get_transaction_weight
+		const uint64_t bp_base = 368;
+		size_t n_LR = _n_bulletproof_LR(n_outputs);
+		const size_t n_padded_outputs = (size_t)1 << (n_LR - 6);
+		const uint64_t bp_size = 32 * (9 + 2 * n_LR);
+		weight += (bp_base * n_padded_outputs - bp_size) * 4 / 5;
+	}
+	return weight;
+}
+//
+// Compile-time weight tables: estimate_tx_weight for rct txs at weight_table_mixin with extra_size
+// 0, indexed by [bulletproof][n_inputs][n_outputs]. The estimate is linear in extra_size, so it's
+// added at lookup. (C++11 constexpr, hence the single-expression recursion.)
+namespace
+{
+	constexpr size_t _log_padded_outputs(size_t n_outputs, size_t log_padded_outputs)
+	{
+		return ((size_t)1<<log_padded_outputs) >= n_outputs ? log_padded_outputs : _log_padded_outputs(n_outputs, log_padded_outputs + 1);
+	}
+	constexpr uint64_t _table_rct_tx_size(bool bulletproof, size_t n_inputs, size_t n_outputs)
+	{ // estimate_rct_tx_size with extra_size 0
+		return 1 + 6
+			+ n_inputs * (1+6+(monero_fee_utils::weight_table_mixin+1)*2+32)
+			+ n_outputs * (6+32)
+			+ 1
+			+ (bulletproof
+				? (2 * (6 + _log_padded_outputs(n_outputs, 0)) + 4 + 5) * 32 + 3
+				: (2*64*32+32+64*32) * n_outputs)
+			+ n_inputs * (64 * (monero_fee_utils::weight_table_mixin+1) + 32)
+			+ 32 * n_inputs
+			+ 2 * 32 * n_outputs
+			+ 32 * n_outputs
+			+ 4;
+	}
+	constexpr uint64_t _table_bp_clawback(size_t log_padded_outputs)
+	{
+		return (368 * ((uint64_t)1<<log_padded_outputs) - 32 * (9 + 2 * (6 + log_padded_outputs))) * 4 / 5;
+	}
+	constexpr uint64_t _table_tx_weight(bool bulletproof, size_t n_inputs, size_t n_outputs)
+	{ // estimate_tx_weight with extra_size 0
+		return _table_rct_tx_size(bulletproof, n_inputs, n_outputs)
+			+ (bulletproof && n_outputs > 2 ? _table_bp_clawback(_log_padded_outputs(n_outputs, 2)) : 0);
+	}
+	//
+	template<size_t... Is> struct index_list {};
+	template<size_t N, size_t... Is> struct make_index_list : make_index_list<N - 1, N - 1, Is...> {};
+	template<size_t... Is> struct make_index_list<0, Is...> { typedef index_list<Is...> type; };
+	//
+	struct WeightTableRow
+	{
+		uint64_t by_n_outputs[monero_fee_utils::weight_table_max_outputs + 1];
+	};
+	struct WeightTable
+	{
+		WeightTableRow by_n_inputs[monero_fee_utils::weight_table_max_inputs + 1];
+	};
+	template<size_t... Os>
+	constexpr WeightTableRow _weight_table_row(bool bulletproof, size_t n_inputs, index_list<Os...>)
+	{
+		return WeightTableRow{{ _table_tx_weight(bulletproof, n_inputs, Os)... }};
+	}
+	template<size_t... Is>
+	constexpr WeightTable _weight_table(bool bulletproof, index_list<Is...>)
+	{
+		return WeightTable{{ _weight_table_row(bulletproof, Is, make_index_list<monero_fee_utils::weight_table_max_outputs + 1>::type())... }};
+	}
+	constexpr WeightTable _weight_tables[2] = {
+		_weight_table(false, make_index_list<monero_fee_utils::weight_table_max_inputs + 1>::type()),
+		_weight_table(true, make_index_list<monero_fee_utils::weight_table_max_inputs + 1>::type())
+	};
+	static_assert(_weight_tables[1].by_n_inputs[2].by_n_outputs[2] == 2677, "Unexpected 2-in/2-out bulletproof weight");
+}
+uint64_t monero_fee_utils::tabled_tx_weight(bool use_rct, int n_inputs, int mixin, int n_outputs, size_t extra_size, bool bulletproof)
+{
+	if (use_rct && mixin == weight_table_mixin
+		&& n_inputs >= 0 && (size_t)n_inputs <= weight_table_max_inputs
+		&& n_outputs >= 0 && (size_t)n_outputs <= weight_table_max_outputs) {
+		return _weight_tables[bulletproof ? 1 : 0].by_n_inputs[n_inputs].by_n_outputs[n_outputs] + extra_size;
+	}
+	return estimate_tx_weight(use_rct, n_inputs, mixin, n_outputs, extra_size, bulletproof);
+}
+//
+monero_fee_utils::FeeParams monero_fee_utils::new__fee_params(
+	uint64_t fee_per_b,
+	uint32_t priority,
+	uint64_t fee_quantization_mask,
+	int mixin,
+	size_t extra_size,
+	bool bulletproof,
+	const ForkRules &fork_rules
+) {
+	FeeParams params;
+	params.base_fee = get_base_fee(fee_per_b);
+	params.fee_multiplier = get_fee_multiplier(priority, default_priority(), get_fee_algorithm(fork_rules), fork_rules);
+	params.fee_quantization_mask = fee_quantization_mask;
+	params.mixin = mixin;
+	params.extra_size = extra_size;
+	params.bulletproof = bulletproof;
+	return params;
+}
+uint64_t monero_fee_utils::FeeParams::estimated_fee(int n_inputs, int n_outputs) const
+{
+	return calculate_fee_from_weight(base_fee, tabled_tx_weight(true/*use_rct*/, n_inputs, mixin, n_outputs, extra_size, bulletproof), fee_multiplier, fee_quantization_mask);
+}
+//
+uint64_t monero_fee_utils::FeeMatrix::fee(size_t priority_idx, int n_inputs, int n_outputs) const
+{
+	size_t n_cols = max_outputs - min_outputs + 1;
+	size_t n_rows = max_inputs - min_inputs + 1;
+	return fees[(priority_idx * n_rows + (n_inputs - min_inputs)) * n_cols + (n_outputs - min_outputs)];
+}
+bool monero_fee_utils::new__fee_matrix(
+	uint64_t fee_per_b,
+	uint64_t fee_quantization_mask,
+	uint64_t min_inputs, uint64_t max_inputs,
+	uint64_t min_outputs, uint64_t max_outputs,
+	size_t extra_size,
+	const ForkRules &fork_rules,
+	FeeMatrixRetVals &retVals
+) {
+	retVals = {};
+	if (min_inputs < 1 || max_inputs < min_inputs || min_outputs < 1 || max_outputs < min_outputs) {
+		retVals.did_error = true;
+		retVals.err_string = "Invalid input or output count range";
+		return false;
+	}
+	if (max_inputs > (uint64_t)fee_matrix_max_inputs || max_outputs > (uint64_t)fee_matrix_max_outputs) {
+		retVals.did_error = true;
+		retVals.err_string = "Input or output count range too large";
+		return false;
+	}
+	FeeMatrix &matrix = retVals.matrix;
+	matrix.min_inputs = (int)min_inputs;
+	matrix.max_inputs = (int)max_inputs;
+	matrix.min_outputs = (int)min_outputs;
+	matrix.max_outputs = (int)max_outputs;
+	//
+	int fee_algorithm = fork_rules.fee_algorithm;
+	int mixin = fixed_mixinsize();
+	bool bulletproof = true; // as in send_step1
+	const uint64_t base_fee = get_base_fee(fee_per_b);
+	vector<uint64_t> fee_multipliers;
+	for (size_t i = 0; i < multipliers[fee_algorithm].count; i++) {
+		matrix.priorities.push_back(i + 1);
+		fee_multipliers.push_back(multipliers[fee_algorithm].multipliers[i]);
+	}
+	//
+	size_t n_rows = max_inputs - min_inputs + 1;
+	size_t n_cols = max_outputs - min_outputs + 1;
+	matrix.fees.resize(fee_multipliers.size() * n_rows * n_cols);
+	for (int n_inputs = matrix.min_inputs; n_inputs <= matrix.max_inputs; n_inputs++) {
+		for (int n_outputs = matrix.min_outputs; n_outputs <= matrix.max_outputs; n_outputs++) {
+			uint64_t weight = tabled_tx_weight(true/*use_rct*/, n_inputs, mixin, n_outputs, extra_size, bulletproof);
+			for (size_t p = 0; p < fee_multipliers.size(); p++) {
+				matrix.fees[(p * n_rows + (n_inputs - matrix.min_inputs)) * n_cols + (n_outputs - matrix.min_outputs)] = calculate_fee_from_weight(base_fee, weight, fee_multipliers[p], fee_quantization_mask);
+			}
+		}
+	}
+	return true;
+}
+//
 uint64_t monero_fee_utils::estimate_fee(bool use_per_byte_fee, bool use_rct, int n_inputs, int mixin, int n_outputs, size_t extra_size, bool bulletproof, uint64_t base_fee, uint64_t fee_multiplier, uint64_t fee_quantization_mask)
 {
 	if (use_per_byte_fee)
 	{
-		const size_t estimated_tx_weight = estimate_tx_weight(use_rct, n_inputs, mixin, n_outputs, extra_size, bulletproof);
+		const size_t estimated_tx_weight = tabled_tx_weight(use_rct, n_inputs, mixin, n_outputs, extra_size, bulletproof);
 		return calculate_fee_from_weight(base_fee, estimated_tx_weight, fee_multiplier, fee_quantization_mask);
 	}
 	else
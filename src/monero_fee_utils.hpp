@@ -41,20 +41,22 @@
 #include "cryptonote_format_utils.h"
 //
 #include "monero_fork_rules.hpp"
+#include "tools__ret_vals.hpp"
 //
 namespace monero_fee_utils
 {
 	using namespace std;
 	using namespace boost;
+	using namespace tools;
 	using namespace cryptonote;
 	using namespace monero_fork_rules;
 	using namespace crypto;
 	//
 	uint32_t default_priority();
 	//
-	uint64_t get_upper_transaction_weight_limit(uint64_t upper_transaction_weight_limit__or_0_for_default, use_fork_rules_fn_type use_fork_rules_fn);
-	uint64_t get_fee_multiplier(uint32_t priority, uint32_t default_priority, int fee_algorithm, use_fork_rules_fn_type use_fork_rules_fn);
-	int get_fee_algorithm(use_fork_rules_fn_type use_fork_rules_fn);
+	uint64_t get_upper_transaction_weight_limit(uint64_t upper_transaction_weight_limit__or_0_for_default, const ForkRules &fork_rules);
+	uint64_t get_fee_multiplier(uint32_t priority, uint32_t default_priority, int fee_algorithm, const ForkRules &fork_rules);
+	int get_fee_algorithm(const ForkRules &fork_rules);
 	uint64_t get_base_fee(uint64_t fee_per_b);
 	//
 	uint64_t estimate_fee(bool use_per_byte_fee, bool use_rct, int n_inputs, int mixin, int n_outputs, size_t extra_size, bool bulletproof, uint64_t base_fee, uint64_t fee_multiplier, uint64_t fee_quantization_mask);
@@ -67,10 +69,92 @@ namespace monero_fee_utils
 	size_t estimate_rct_tx_size(int n_inputs, int mixin, int n_outputs, size_t extra_size, bool bulletproof);
 	uint64_t estimate_tx_weight(bool use_rct, int n_inputs, int mixin, int n_outputs, size_t extra_size, bool bulletproof);
 	size_t estimate_tx_size(bool use_rct, int n_inputs, int mixin, int n_outputs, size_t extra_size, bool bulletproof);
+	//
+	// Exact counterparts of the above for when the rings are known, i.e. between prepare and sign.
+	// Sizes are computed from the structure alone, including every varint, without serializing.
+	// Only simple RingCT txs with at most one (aggregated, padded) bulletproof are supported.
+	size_t varint_size(uint64_t v);
+	size_t exact_rct_tx_size(
+		const std::vector<std::vector<uint64_t>> &ring_global_indices, // per input; absolute and ascending
+		size_t n_outputs,
+		size_t extra_size, // final, i.e. including the tx pub key(s) which construct_tx adds
+		uint64_t fee,
+		uint64_t unlock_time,
+		rct::RCTType rct_type // RCTTypeSimple, RCTTypeBulletproof or RCTTypeBulletproof2
+	);
+	uint64_t exact_tx_weight( // equal to get_transaction_weight() of the constructed tx
+		const std::vector<std::vector<uint64_t>> &ring_global_indices,
+		size_t n_outputs,
+		size_t extra_size,
+		uint64_t fee,
+		uint64_t unlock_time,
+		rct::RCTType rct_type
+	);
+	//
+	// Same as estimate_tx_weight, but looked up in compile-time tables for rct txs at the fixed ring
+	// size with up to weight_table_max_inputs inputs and 16 outputs; falls back to computing otherwise
+	static const int weight_table_mixin = 10;
+	static const size_t weight_table_max_inputs = 32;
+	static const size_t weight_table_max_outputs = 16; // BULLETPROOF_MAX_OUTPUTS
+	uint64_t tabled_tx_weight(bool use_rct, int n_inputs, int mixin, int n_outputs, size_t extra_size, bool bulletproof);
+	//
+	// Everything about a send's fee which doesn't depend on its input/output counts, resolved once
+	// so that e.g. step1's output-gathering loop only does table lookups
+	struct FeeParams
+	{
+		uint64_t base_fee;
+		uint64_t fee_multiplier;
+		uint64_t fee_quantization_mask;
+		int mixin;
+		size_t extra_size;
+		bool bulletproof;
+		//
+		uint64_t estimated_fee(int n_inputs, int n_outputs) const; // same as estimate_fee with use_per_byte_fee and use_rct
+	};
+	FeeParams new__fee_params(
+		uint64_t fee_per_b,
+		uint32_t priority,
+		uint64_t fee_quantization_mask,
+		int mixin,
+		size_t extra_size,
+		bool bulletproof,
+		const ForkRules &fork_rules
+	);
+	//
+	// Per-byte fees for every valid priority x n_inputs x n_outputs in the given ranges, e.g. for a
+	// fee-preview UI; weights are computed once and shared across priorities. Ranges are bounded by
+	// the weight tables' input limit and BULLETPROOF_MAX_OUTPUTS; others are an error, not a throw
+	static const int fee_matrix_max_inputs = weight_table_max_inputs;
+	static const int fee_matrix_max_outputs = weight_table_max_outputs; // BULLETPROOF_MAX_OUTPUTS
+	struct FeeMatrix
+	{
+		vector<uint32_t> priorities; // 1...n, as valid under the fork's fee algorithm
+		int min_inputs;
+		int max_inputs;
+		int min_outputs;
+		int max_outputs;
+		vector<uint64_t> fees; // flattened [priority index][n_inputs - min_inputs][n_outputs - min_outputs]
+		//
+		uint64_t fee(size_t priority_idx, int n_inputs, int n_outputs) const;
+	};
+	struct FeeMatrixRetVals: RetVals_base
+	{
+		FeeMatrix matrix;
+	};
+	bool new__fee_matrix(
+		uint64_t fee_per_b,
+		uint64_t fee_quantization_mask,
+		uint64_t min_inputs, uint64_t max_inputs, // as given, so a caller's out of range values can't wrap
+		uint64_t min_outputs, uint64_t max_outputs,
+		size_t extra_size,
+		const ForkRules &fork_rules,
+		FeeMatrixRetVals &retVals
+	);
+	//
 	uint64_t estimated_tx_network_fee( // convenience function for size + calc
 		uint64_t fee_per_b,
 		uint32_t priority, // when priority=0, falls back to monero_fee_utils::default_priority()
-		use_fork_rules_fn_type use_fork_rules_fn // this is extracted to a function so that implementations can optionally query the daemon (although this presently implies that such a call remains blocking)
+		const ForkRules &fork_rules // may be built from a use_fork_rules_fn_type so that implementations can optionally query the daemon (although this presently implies that such a call remains blocking)
 	);
 }
 
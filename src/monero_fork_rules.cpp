@@ -34,6 +34,7 @@
 //
 //
 #include "monero_fork_rules.hpp"
+#include "cryptonote_config.h"
 //
 using namespace monero_fork_rules;
 //
@@ -56,6 +57,33 @@ bool monero_fork_rules::lightwallet_hardcoded__use_fork_rules(uint8_t version, i
 //	return close_enough;	
 }
 //
+ForkRules::ForkRules(const use_fork_rules_fn_type &use_fork_rules_fn)
+	: fork_version(0)
+{
+	use_per_byte_fee = use_fork_rules_fn(HF_VERSION_PER_BYTE_FEE, 0);
+	use_smaller_bp = use_fork_rules_fn(HF_VERSION_SMALLER_BP, -10);
+	// fee algorithm changes at v3, v5, v8
+	if (use_per_byte_fee) {
+		fee_algorithm = 3;
+	} else if (use_fork_rules_fn(5, 0)) {
+		fee_algorithm = 2;
+	} else if (use_fork_rules_fn(3, -720 * 14)) {
+		fee_algorithm = 1;
+	} else {
+		fee_algorithm = 0;
+	}
+	uint64_t full_reward_zone = use_fork_rules_fn(5, 10) ? CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V5 : use_fork_rules_fn(2, 10) ? CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V2 : CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V1;
+	if (use_fork_rules_fn(8, 10))
+		upper_transaction_weight_limit = full_reward_zone / 2 - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE;
+	else
+		upper_transaction_weight_limit = full_reward_zone - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE;
+}
+ForkRules::ForkRules(uint8_t fork_version)
+	: ForkRules(make_use_fork_rules_fn(fork_version))
+{
+	this->fork_version = fork_version;
+}
+//
 // Protocol / Defaults
 uint32_t monero_fork_rules::fixed_ringsize()
 {
@@ -57,6 +57,22 @@ namespace monero_fork_rules
 			: use_fork_rules_fn_type(lightwallet_hardcoded__use_fork_rules);
 	}
 	//
+	// The fork rules a send depends on, each resolved once up front so that fee and transfer code
+	// reads plain fields instead of calling through use_fork_rules_fn_type every time. Functions
+	// take it by const reference; a use_fork_rules_fn_type converts implicitly, so callers which
+	// still hold one keep working.
+	struct ForkRules
+	{
+		ForkRules(const use_fork_rules_fn_type &use_fork_rules_fn); // fork_version is left 0
+		explicit ForkRules(uint8_t fork_version); // same as from make_use_fork_rules_fn(fork_version)
+		//
+		uint8_t fork_version; // 0 if unknown
+		bool use_per_byte_fee;
+		bool use_smaller_bp;
+		int fee_algorithm;
+		uint64_t upper_transaction_weight_limit; // the default, i.e. when none is given
+	};
+	//
 	uint32_t fixed_ringsize(); // not mixinsize, which would be ringsize-1
 	uint32_t fixed_mixinsize(); // not ringsize, which would be mixinsize+1
 	//
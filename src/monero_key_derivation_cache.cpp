@@ -0,0 +1,154 @@
+//
+//  monero_key_derivation_cache.cpp
+//  Copyright (c) 2014-2019, MyMonero.com
+//
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are
+//  permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright notice, this list of
+//	conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list
+//	of conditions and the following disclaimer in the documentation and/or other
+//	materials provided with the distribution.
+//
+//  3. Neither the name of the copyright holder nor the names of its contributors may be
+//	used to endorse or promote products derived from this software without specific
+//	prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+//  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+//  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+//  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+//  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//
+#include "monero_key_derivation_cache.hpp"
+//
+#include <list>
+#include <unordered_map>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include "memwipe.h"
+//
+using namespace std;
+using namespace crypto;
+using namespace monero_key_derivation_cache;
+//
+namespace
+{
+	typedef std::pair<crypto::hash, crypto::key_derivation> cache_entry;
+	//
+	struct DerivationCache
+	{
+		boost::mutex mutex;
+		std::list<cache_entry> lru; // most recently used at the front
+		std::unordered_map<crypto::hash, std::list<cache_entry>::iterator> index;
+		size_t capacity = default_capacity;
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t evictions = 0;
+		//
+		~DerivationCache()
+		{
+			wipe_all();
+		}
+		void evict_to(size_t n) // must hold mutex
+		{
+			while (lru.size() > n) {
+				cache_entry &entry = lru.back();
+				index.erase(entry.first);
+				memwipe(&entry.second, sizeof(entry.second));
+				lru.pop_back();
+				evictions++;
+			}
+		}
+		void wipe_all() // must hold mutex, or be destructing
+		{
+			for (cache_entry &entry : lru) {
+				memwipe(&entry.second, sizeof(entry.second));
+			}
+			lru.clear();
+			index.clear();
+		}
+	};
+	DerivationCache &_cache()
+	{
+		static DerivationCache cache;
+		return cache;
+	}
+	crypto::hash _cache_key(const crypto::public_key &tx_pub_key, const crypto::secret_key &view_secret_key)
+	{
+		unsigned char buf[sizeof(crypto::public_key) + sizeof(crypto::secret_key)];
+		memcpy(buf, &tx_pub_key, sizeof(crypto::public_key));
+		memcpy(buf + sizeof(crypto::public_key), &view_secret_key, sizeof(crypto::secret_key));
+		crypto::hash key;
+		crypto::cn_fast_hash(buf, sizeof(buf), key);
+		memwipe(buf, sizeof(buf));
+		return key;
+	}
+}
+//
+bool monero_key_derivation_cache::generate_key_derivation(
+	const crypto::public_key &tx_pub_key,
+	const crypto::secret_key &view_secret_key,
+	crypto::key_derivation &derivation
+) {
+	DerivationCache &cache = _cache();
+	crypto::hash key = _cache_key(tx_pub_key, view_secret_key);
+	{
+		boost::lock_guard<boost::mutex> lock(cache.mutex);
+		auto found = cache.index.find(key);
+		if (found != cache.index.end()) {
+			cache.lru.splice(cache.lru.begin(), cache.lru, found->second);
+			derivation = found->second->second;
+			cache.hits++;
+			return true;
+		}
+		cache.misses++;
+	}
+	// computed outside the lock so that threads deriving for different txs don't serialize
+	if (!crypto::generate_key_derivation(tx_pub_key, view_secret_key, derivation)) {
+		return false;
+	}
+	boost::lock_guard<boost::mutex> lock(cache.mutex);
+	if (cache.capacity == 0 || cache.index.find(key) != cache.index.end()) {
+		return true; // disabled, or another thread got here first
+	}
+	cache.lru.emplace_front(key, derivation);
+	cache.index[key] = cache.lru.begin();
+	cache.evict_to(cache.capacity);
+	//
+	return true;
+}
+Stats monero_key_derivation_cache::stats()
+{
+	DerivationCache &cache = _cache();
+	boost::lock_guard<boost::mutex> lock(cache.mutex);
+	return Stats{
+		cache.hits, cache.misses, cache.evictions,
+		cache.lru.size(), cache.capacity
+	};
+}
+void monero_key_derivation_cache::set_capacity(size_t capacity)
+{
+	DerivationCache &cache = _cache();
+	boost::lock_guard<boost::mutex> lock(cache.mutex);
+	cache.capacity = capacity;
+	cache.evict_to(capacity);
+}
+void monero_key_derivation_cache::clear()
+{
+	DerivationCache &cache = _cache();
+	boost::lock_guard<boost::mutex> lock(cache.mutex);
+	cache.wipe_all();
+	cache.hits = 0;
+	cache.misses = 0;
+	cache.evictions = 0;
+}
@@ -0,0 +1,64 @@
+//
+//  monero_key_derivation_cache.hpp
+//  Copyright (c) 2014-2019, MyMonero.com
+//
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are
+//  permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright notice, this list of
+//	conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list
+//	of conditions and the following disclaimer in the documentation and/or other
+//	materials provided with the distribution.
+//
+//  3. Neither the name of the copyright holder nor the names of its contributors may be
+//	used to endorse or promote products derived from this software without specific
+//	prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+//  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+//  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+//  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+//  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//
+#ifndef monero_key_derivation_cache_hpp
+#define monero_key_derivation_cache_hpp
+//
+#include "crypto.h"
+//
+namespace monero_key_derivation_cache
+{
+	// Outputs of the same transaction share one key derivation a*R, so it's memoized here instead
+	// of being recomputed for every key image and every rct mask. Entries are keyed by a hash of
+	// (tx pub key, view secret key) so no secret key material is retained, and derivations are
+	// wiped when evicted or cleared. Safe to call from multiple threads.
+	struct Stats
+	{
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t evictions;
+		size_t size;
+		size_t capacity;
+	};
+	static const size_t default_capacity = 4096;
+	//
+	// Same contract as crypto::generate_key_derivation; failures are not cached
+	bool generate_key_derivation(
+		const crypto::public_key &tx_pub_key,
+		const crypto::secret_key &view_secret_key,
+		crypto::key_derivation &derivation
+	);
+	Stats stats();
+	void set_capacity(size_t capacity); // evicts down to the new capacity; 0 disables caching
+	void clear(); // wipes all entries and resets the counters
+}
+//
+#endif /* monero_key_derivation_cache_hpp */
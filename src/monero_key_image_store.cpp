@@ -0,0 +1,443 @@
+//
+//  monero_key_image_store.cpp
+//  Copyright (c) 2014-2019, MyMonero.com
+//
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are
+//  permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright notice, this list of
+//	conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list
+//	of conditions and the following disclaimer in the documentation and/or other
+//	materials provided with the distribution.
+//
+//  3. Neither the name of the copyright holder nor the names of its contributors may be
+//	used to endorse or promote products derived from this software without specific
+//	prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+//  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+//  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+//  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+//  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//
+#include "monero_key_image_store.hpp"
+//
+#include <array>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include "chacha.h"
+#include "memwipe.h"
+#include "string_tools.h"
+//
+using namespace std;
+using namespace crypto;
+using namespace monero_key_image_store;
+using namespace monero_key_image_utils;
+//
+namespace
+{
+	// File layout: a header of magic followed by an account check value, then Records back to back.
+	// Everything is byte arrays, so the layout is the same on every platform and records can be
+	// read straight out of the mapping.
+	const uint8_t file_magic[8] = { 'M', 'M', 'K', 'I', 'S', 0, 0, 1 }; // last byte is the version
+	const size_t header_size = 32;
+	const size_t tag_size = 16;
+	const size_t checksum_size = 8;
+	//
+	struct Record
+	{
+		uint8_t tag[tag_size]; // leading bytes of H(tag key || tx pub key || out index); the first 8 are also the cipher iv
+		uint8_t encrypted_key_image[sizeof(crypto::key_image)];
+		uint8_t checksum[checksum_size]; // leading bytes of H(tag || encrypted key image)
+	};
+	static_assert(sizeof(Record) == tag_size + sizeof(crypto::key_image) + checksum_size, "Record must be unpadded");
+	static_assert(tag_size >= CHACHA_IV_SIZE, "Tags double as the cipher iv");
+	//
+	typedef std::array<uint8_t, tag_size> Tag;
+	struct TagHash
+	{
+		size_t operator()(const Tag &tag) const
+		{ // tags are hash output already
+			size_t h;
+			memcpy(&h, tag.data(), sizeof(h));
+			return h;
+		}
+	};
+	//
+	struct AccountFile
+	{
+		int fd = -1;
+		uint8_t *mapped = nullptr; // the records which were in the file when it was opened
+		size_t mapped_size = 0;
+		uint64_t end_offset = 0; // always header_size + n * sizeof(Record)
+		crypto::hash tag_key;
+		crypto::hash cipher_key;
+		std::unordered_map<Tag, const Record *, TagHash> index; // into mapped or appended
+		std::deque<Record> appended; // records written since opening; deque so index pointers stay valid
+		//
+		~AccountFile()
+		{
+			if (mapped != nullptr) {
+				munmap(mapped, mapped_size);
+			}
+			if (fd >= 0) {
+				fsync(fd);
+				::close(fd); // also releases the flock
+			}
+			memwipe(&tag_key, sizeof(tag_key));
+			memwipe(&cipher_key, sizeof(cipher_key));
+		}
+	};
+	//
+	struct KeyImageStore
+	{
+		boost::mutex mutex;
+		bool is_open = false;
+		string directory;
+		// keyed by the file name hash; null when the file couldn't be used, so it isn't retried every call
+		std::unordered_map<crypto::hash, std::unique_ptr<AccountFile>> accounts;
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t appended = 0;
+	};
+	KeyImageStore &_store()
+	{
+		static KeyImageStore store;
+		return store;
+	}
+	//
+	// Per-account values, each from its own domain so none of them can be derived from another
+	crypto::hash _derived(char domain, const crypto::secret_key &sec_viewKey, const crypto::public_key &pub_spendKey)
+	{
+		static const char prefix[] = "mymonero key image store";
+		unsigned char buf[sizeof(prefix) + 1 + sizeof(crypto::secret_key) + sizeof(crypto::public_key)];
+		unsigned char *p = buf;
+		memcpy(p, prefix, sizeof(prefix)); p += sizeof(prefix);
+		*p = domain; p += 1;
+		memcpy(p, &sec_viewKey, sizeof(crypto::secret_key)); p += sizeof(crypto::secret_key);
+		memcpy(p, &pub_spendKey, sizeof(crypto::public_key));
+		crypto::hash h;
+		crypto::cn_fast_hash(buf, sizeof(buf), h);
+		memwipe(buf, sizeof(buf));
+		return h;
+	}
+	Tag _tag(const AccountFile &file, const crypto::public_key &tx_pub_key, uint64_t out_index)
+	{
+		unsigned char buf[sizeof(crypto::hash) + sizeof(crypto::public_key) + 8];
+		memcpy(buf, &file.tag_key, sizeof(crypto::hash));
+		memcpy(buf + sizeof(crypto::hash), &tx_pub_key, sizeof(crypto::public_key));
+		for (size_t i = 0; i < 8; i++) { // little endian, independent of the host
+			buf[sizeof(crypto::hash) + sizeof(crypto::public_key) + i] = (out_index >> (8 * i)) & 0xff;
+		}
+		crypto::hash h;
+		crypto::cn_fast_hash(buf, sizeof(buf), h);
+		memwipe(buf, sizeof(buf));
+		Tag tag;
+		memcpy(tag.data(), &h, tag_size);
+		return tag;
+	}
+	void _checksum(const Record &record, uint8_t *out)
+	{
+		crypto::hash h;
+		crypto::cn_fast_hash(&record, offsetof(Record, checksum), h);
+		memcpy(out, &h, checksum_size);
+	}
+	bool _is_intact(const Record &record)
+	{
+		uint8_t checksum[checksum_size];
+		_checksum(record, checksum);
+		return memcmp(checksum, record.checksum, checksum_size) == 0;
+	}
+	void _crypt(const AccountFile &file, const Record &record, const void *in, void *out)
+	{ // chacha20 is a stream cipher, so this both encrypts and decrypts. Each (tx pub key, out index) has its own tag, so ivs don't repeat under a key with differing plaintexts
+		crypto::chacha20(in, sizeof(crypto::key_image), reinterpret_cast<const uint8_t *>(&file.cipher_key), record.tag, reinterpret_cast<char *>(out));
+	}
+	//
+	std::unique_ptr<AccountFile> _opened_account_file(
+		const string &directory,
+		const crypto::hash &name_hash,
+		const crypto::secret_key &sec_viewKey,
+		const crypto::public_key &pub_spendKey
+	) {
+		string path = directory + "/" + epee::string_tools::pod_to_hex(name_hash).substr(0, 2 * tag_size) + ".kis";
+		std::unique_ptr<AccountFile> file(new AccountFile);
+		file->fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+		if (file->fd < 0) {
+			return nullptr;
+		}
+		if (flock(file->fd, LOCK_EX | LOCK_NB) != 0) {
+			return nullptr; // another process has this account open; it'll just compute instead
+		}
+		uint8_t header[header_size] = {};
+		{
+			crypto::hash check = _derived('c', sec_viewKey, pub_spendKey);
+			memcpy(header, file_magic, sizeof(file_magic));
+			memcpy(header + sizeof(file_magic), &check, header_size - sizeof(file_magic));
+			memwipe(&check, sizeof(check));
+		}
+		struct stat st;
+		if (fstat(file->fd, &st) != 0) {
+			return nullptr;
+		}
+		uint64_t file_size = (uint64_t)st.st_size;
+		if (file_size < header_size) { // new, or the header write was torn
+			if (ftruncate(file->fd, 0) != 0
+				|| pwrite(file->fd, header, header_size, 0) != (ssize_t)header_size
+				|| fsync(file->fd) != 0) {
+				return nullptr;
+			}
+			file_size = header_size;
+		}
+		size_t n_records = (file_size - header_size) / sizeof(Record);
+		file->mapped_size = header_size + n_records * sizeof(Record);
+		void *mapped = mmap(nullptr, file->mapped_size, PROT_READ, MAP_SHARED, file->fd, 0);
+		if (mapped == MAP_FAILED) {
+			return nullptr;
+		}
+		file->mapped = static_cast<uint8_t *>(mapped);
+		bool is_own_file = memcmp(file->mapped, header, header_size) == 0;
+		memwipe(header, sizeof(header));
+		if (!is_own_file) {
+			return nullptr; // unknown version, or a name collision; never overwrite it
+		}
+		file->tag_key = _derived('t', sec_viewKey, pub_spendKey);
+		file->cipher_key = _derived('k', sec_viewKey, pub_spendKey);
+		//
+		const Record *records = reinterpret_cast<const Record *>(file->mapped + header_size);
+		file->index.reserve(n_records);
+		size_t n_intact = 0;
+		for (; n_intact < n_records; n_intact++) {
+			const Record &record = records[n_intact];
+			if (!_is_intact(record)) {
+				break; // everything from a torn append onwards is dropped
+			}
+			Tag tag;
+			memcpy(tag.data(), record.tag, tag_size);
+			file->index.emplace(tag, &record);
+		}
+		file->end_offset = header_size + n_intact * sizeof(Record);
+		if (file_size != file->end_offset) { // trailing partial or torn records; cut them so appends stay aligned
+			if (ftruncate(file->fd, file->end_offset) != 0) {
+				return nullptr;
+			}
+		}
+		return file;
+	}
+	AccountFile *_account_file( // must hold mutex; null when the store is closed or the file is unusable
+		KeyImageStore &store,
+		const crypto::secret_key &sec_viewKey,
+		const crypto::public_key &pub_spendKey
+	) {
+		if (!store.is_open) {
+			return nullptr;
+		}
+		crypto::hash name_hash = _derived('f', sec_viewKey, pub_spendKey);
+		auto found = store.accounts.find(name_hash);
+		if (found != store.accounts.end()) {
+			return found->second.get();
+		}
+		std::unique_ptr<AccountFile> file = _opened_account_file(store.directory, name_hash, sec_viewKey, pub_spendKey);
+		AccountFile *ptr = file.get();
+		store.accounts.emplace(name_hash, std::move(file));
+		return ptr;
+	}
+	bool _lookup(const AccountFile &file, const Tag &tag, crypto::key_image &key_image)
+	{
+		auto found = file.index.find(tag);
+		if (found == file.index.end()) {
+			return false;
+		}
+		_crypt(file, *found->second, found->second->encrypted_key_image, &key_image);
+		return true;
+	}
+	void _append(KeyImageStore &store, AccountFile &file, const Tag &tag, const crypto::key_image &key_image)
+	{ // must hold mutex
+		if (file.index.find(tag) != file.index.end()) {
+			return; // another thread got here first
+		}
+		Record record;
+		memcpy(record.tag, tag.data(), tag_size);
+		_crypt(file, record, &key_image, record.encrypted_key_image);
+		_checksum(record, record.checksum);
+		ssize_t written = pwrite(file.fd, &record, sizeof(record), file.end_offset);
+		if (written != (ssize_t)sizeof(record)) {
+			if (written > 0) {
+				ftruncate(file.fd, file.end_offset); // best effort; the next open drops it anyway
+			}
+			return;
+		}
+		file.end_offset += sizeof(record);
+		file.appended.push_back(record);
+		file.index.emplace(tag, &file.appended.back());
+		store.appended++;
+	}
+	bool _is_account_spend_key(const crypto::public_key &pub_spendKey, const crypto::secret_key &sec_spendKey)
+	{ // key images from any other spend key are wrong for the account, and stored they'd be served to every later lookup
+		crypto::public_key derived;
+		return crypto::secret_key_to_public_key(sec_spendKey, derived) && derived == pub_spendKey;
+	}
+}
+//
+bool monero_key_image_store::open(const string &directory, string &err_string)
+{
+	struct stat st;
+	if (::stat(directory.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+		err_string = "Key image store directory doesn't exist";
+		return false;
+	}
+	KeyImageStore &store = _store();
+	boost::lock_guard<boost::mutex> lock(store.mutex);
+	store.accounts.clear();
+	store.directory = directory;
+	store.is_open = true;
+	store.hits = 0;
+	store.misses = 0;
+	store.appended = 0;
+	//
+	return true;
+}
+void monero_key_image_store::close()
+{
+	KeyImageStore &store = _store();
+	boost::lock_guard<boost::mutex> lock(store.mutex);
+	store.accounts.clear();
+	store.is_open = false;
+}
+bool monero_key_image_store::is_open()
+{
+	KeyImageStore &store = _store();
+	boost::lock_guard<boost::mutex> lock(store.mutex);
+	return store.is_open;
+}
+Stats monero_key_image_store::stats()
+{
+	KeyImageStore &store = _store();
+	boost::lock_guard<boost::mutex> lock(store.mutex);
+	size_t accounts = 0;
+	size_t size = 0;
+	for (const auto &entry : store.accounts) {
+		if (entry.second != nullptr) {
+			accounts++;
+			size += entry.second->index.size();
+		}
+	}
+	return Stats{
+		store.hits, store.misses, store.appended,
+		accounts, size
+	};
+}
+//
+bool monero_key_image_store::new__key_image(
+	const crypto::public_key& account_pub_spend_key,
+	const crypto::secret_key& account_sec_spend_key,
+	const crypto::secret_key& account_sec_view_key,
+	const crypto::public_key& tx_public_key,
+	uint64_t out_index,
+	KeyImageRetVals &retVals
+) {
+	KeyImageStore &store = _store();
+	{
+		boost::lock_guard<boost::mutex> lock(store.mutex);
+		AccountFile *file = _account_file(store, account_sec_view_key, account_pub_spend_key);
+		if (file != nullptr) {
+			retVals = {};
+			if (_lookup(*file, _tag(*file, tx_public_key, out_index), retVals.calculated_key_image)) {
+				store.hits++;
+				return true;
+			}
+			store.misses++;
+		}
+	}
+	// computed outside the lock so that threads working on other outputs don't serialize
+	if (!monero_key_image_utils::new__key_image(
+		account_pub_spend_key, account_sec_spend_key, account_sec_view_key,
+		tx_public_key, out_index,
+		retVals
+	)) {
+		return false;
+	}
+	if (!_is_account_spend_key(account_pub_spend_key, account_sec_spend_key)) {
+		return true;
+	}
+	boost::lock_guard<boost::mutex> lock(store.mutex);
+	AccountFile *file = _account_file(store, account_sec_view_key, account_pub_spend_key); // may have been closed meanwhile
+	if (file != nullptr) {
+		_append(store, *file, _tag(*file, tx_public_key, out_index), retVals.calculated_key_image);
+	}
+	return true;
+}
+bool monero_key_image_store::new__key_images(
+	const crypto::public_key& account_pub_spend_key,
+	const crypto::secret_key& account_sec_spend_key,
+	const crypto::secret_key& account_sec_view_key,
+	const std::vector<KeyImageOutput> &outputs,
+	bool verify_ephemeral_keys,
+	KeyImagesRetVals &retVals
+) {
+	retVals = {};
+	retVals.calculated_key_images.resize(outputs.size());
+	vector<size_t> missing; // indices into outputs
+	KeyImageStore &store = _store();
+	{
+		boost::lock_guard<boost::mutex> lock(store.mutex);
+		AccountFile *file = _account_file(store, account_sec_view_key, account_pub_spend_key);
+		for (size_t i = 0; i < outputs.size(); i++) {
+			if (file != nullptr && _lookup(*file, _tag(*file, outputs[i].tx_public_key, outputs[i].out_index), retVals.calculated_key_images[i])) {
+				store.hits++;
+				continue;
+			}
+			if (file != nullptr) {
+				store.misses++;
+			}
+			missing.push_back(i);
+		}
+	}
+	if (missing.empty()) {
+		return true;
+	}
+	vector<KeyImageOutput> missing_outputs;
+	missing_outputs.reserve(missing.size());
+	for (size_t i : missing) {
+		missing_outputs.push_back(outputs[i]);
+	}
+	KeyImagesRetVals computed;
+	if (!monero_key_image_utils::new__key_images(
+		account_pub_spend_key, account_sec_spend_key, account_sec_view_key,
+		missing_outputs, verify_ephemeral_keys,
+		computed
+	)) {
+		retVals.did_error = true;
+		retVals.err_string = computed.err_string;
+		retVals.calculated_key_images.clear();
+		return false;
+	}
+	bool persist = _is_account_spend_key(account_pub_spend_key, account_sec_spend_key);
+	boost::lock_guard<boost::mutex> lock(store.mutex);
+	AccountFile *file = persist ? _account_file(store, account_sec_view_key, account_pub_spend_key) : nullptr;
+	for (size_t j = 0; j < missing.size(); j++) {
+		retVals.calculated_key_images[missing[j]] = computed.calculated_key_images[j];
+		if (file != nullptr) {
+			_append(store, *file, _tag(*file, missing_outputs[j].tx_public_key, missing_outputs[j].out_index), computed.calculated_key_images[j]);
+		}
+	}
+	return true;
+}
@@ -0,0 +1,86 @@
+//
+//  monero_key_image_store.hpp
+//  Copyright (c) 2014-2019, MyMonero.com
+//
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are
+//  permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright notice, this list of
+//	conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list
+//	of conditions and the following disclaimer in the documentation and/or other
+//	materials provided with the distribution.
+//
+//  3. Neither the name of the copyright holder nor the names of its contributors may be
+//	used to endorse or promote products derived from this software without specific
+//	prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+//  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+//  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+//  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+//  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//
+#ifndef monero_key_image_store_hpp
+#define monero_key_image_store_hpp
+//
+#include <string>
+#include "crypto.h"
+#include "monero_key_image_utils.hpp"
+//
+namespace monero_key_image_store
+{
+	// Key images of a returning wallet's outputs, persisted so they aren't re-derived on every
+	// login or send. Each account gets one append-only file in the store directory, named by a
+	// hash of its keys. Records are fixed size and hold a keyed lookup tag for
+	// (tx_pub_key, out_index) and the key image encrypted with chacha20 under a key derived from
+	// the view secret key, so the files reveal neither the account nor which outputs it owns.
+	// Opening an account file maps it and indexes the tags for O(1) lookup without decrypting
+	// anything. Every record carries a checksum, so a record torn by a crash is dropped (and the
+	// file truncated back to it) on the next open. Appends aren't fsync'd; the store is a cache,
+	// and losing the tail only means recomputing it. The store is off until open() is called.
+	// Safe to call from multiple threads.
+	struct Stats
+	{
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t appended;
+		size_t accounts; // account files currently open
+		size_t size; // records across open account files
+	};
+	//
+	bool open(const std::string &directory, std::string &err_string); // directory must exist
+	void close(); // unmaps and closes all account files, wiping the derived keys
+	bool is_open();
+	Stats stats();
+	//
+	// Same contracts as their monero_key_image_utils counterparts; read the store first and append
+	// whatever had to be computed. They only compute when the store is closed, and only append
+	// when account_sec_spend_key is the secret key of account_pub_spend_key.
+	bool new__key_image(
+		const crypto::public_key& account_pub_spend_key,
+		const crypto::secret_key& account_sec_spend_key,
+		const crypto::secret_key& account_sec_view_key,
+		const crypto::public_key& tx_public_key,
+		uint64_t out_index,
+		monero_key_image_utils::KeyImageRetVals &retVals
+	);
+	bool new__key_images(
+		const crypto::public_key& account_pub_spend_key,
+		const crypto::secret_key& account_sec_spend_key,
+		const crypto::secret_key& account_sec_view_key,
+		const std::vector<monero_key_image_utils::KeyImageOutput> &outputs,
+		bool verify_ephemeral_keys, // only applies to key images which aren't stored yet
+		monero_key_image_utils::KeyImagesRetVals &retVals
+	);
+}
+//
+#endif /* monero_key_image_store_hpp */
@@ -33,6 +33,11 @@
 //
 //
 #include "monero_key_image_utils.hpp"
+#include "monero_key_derivation_cache.hpp"
+//
+#include <algorithm>
+#include <cstring>
+#include "memwipe.h"
 //
 using namespace crypto;
 using namespace cryptonote;
@@ -55,7 +60,7 @@ bool monero_key_image_utils::new__key_image(
 	//   compute x = Hs(D || i) + b      (and check if P==x*G)
 	//   compute I = x*Hp(P)"
 	crypto::key_derivation derivation;
-	r = crypto::generate_key_derivation(tx_public_key, account_sec_view_key, derivation);
+	r = monero_key_derivation_cache::generate_key_derivation(tx_public_key, account_sec_view_key, derivation);
 	if (!r) {
 		retVals.did_error = true;
 		std::ostringstream ss{};
@@ -95,6 +100,66 @@ bool monero_key_image_utils::new__key_image(
 	//
 	return true;
 }
+//
+bool monero_key_image_utils::new__key_images(
+	const crypto::public_key& account_pub_spend_key,
+	const crypto::secret_key& account_sec_spend_key,
+	const crypto::secret_key& account_sec_view_key,
+	const std::vector<KeyImageOutput> &outputs,
+	bool verify_ephemeral_keys,
+	KeyImagesRetVals &retVals
+) {
+	retVals = {};
+	retVals.calculated_key_images.resize(outputs.size());
+	//
+	// visit outputs grouped by tx_public_key
+	std::vector<size_t> order(outputs.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&outputs] (size_t a, size_t b) {
+		return memcmp(&outputs[a].tx_public_key, &outputs[b].tx_public_key, sizeof(crypto::public_key)) < 0;
+	});
+	crypto::key_derivation derivation;
+	bool have_derivation = false;
+	cryptonote::keypair in_ephemeral; // sec is scrubbed on destruction
+	for (size_t n = 0; n < order.size(); n++) {
+		const KeyImageOutput &output = outputs[order[n]];
+		if (!have_derivation || output.tx_public_key != outputs[order[n - 1]].tx_public_key) {
+			if (!monero_key_derivation_cache::generate_key_derivation(output.tx_public_key, account_sec_view_key, derivation)) {
+				retVals.did_error = true;
+				std::ostringstream ss{};
+				ss << "failed to generate_key_derivation(" << output.tx_public_key << ", <sec view key>)";
+				retVals.err_string = ss.str();
+				memwipe(&derivation, sizeof(derivation));
+				return false;
+			}
+			have_derivation = true;
+		}
+		if (!crypto::derive_public_key(derivation, output.out_index, account_pub_spend_key, in_ephemeral.pub)) {
+			retVals.did_error = true;
+			std::ostringstream ss{};
+			ss << "failed to derive_public_key (<derivation>, " << output.out_index << ", " << account_pub_spend_key << ")";
+			retVals.err_string = ss.str();
+			memwipe(&derivation, sizeof(derivation));
+			return false;
+		}
+		crypto::derive_secret_key(derivation, output.out_index, account_sec_spend_key, in_ephemeral.sec);
+		if (verify_ephemeral_keys) {
+			crypto::public_key out_pkey_test;
+			if (!crypto::secret_key_to_public_key(in_ephemeral.sec, out_pkey_test) || in_ephemeral.pub != out_pkey_test) {
+				retVals.did_error = true;
+				retVals.err_string = "derived secret key doesn't match derived public key";
+				memwipe(&derivation, sizeof(derivation));
+				return false;
+			}
+		}
+		crypto::generate_key_image(in_ephemeral.pub, in_ephemeral.sec, retVals.calculated_key_images[order[n]]);
+	}
+	memwipe(&derivation, sizeof(derivation));
+	//
+	return true;
+}
 
 //+ (NSString *)new_keyImageFrom_tx_pub_key:(NSString *)tx_pub_key_NSString
 //sec_spendKey:(NSString *)sec_spendKey_NSString
@@ -35,6 +35,7 @@
 #ifndef monero_key_image_utils_hpp
 #define monero_key_image_utils_hpp
 //
+#include <vector>
 #include "crypto.h"
 #include "cryptonote_basic.h"
 //
@@ -55,6 +56,27 @@ namespace monero_key_image_utils
 		uint64_t out_index,
 		KeyImageRetVals &KeyImageRetVals
 	);
+	//
+	// Batch variant: outputs are grouped by tx_public_key so each derivation is done once, and
+	// the P == x*G consistency check (a further scalar multiplication per output) can be skipped
+	// by callers who trust their inputs
+	struct KeyImageOutput
+	{
+		crypto::public_key tx_public_key;
+		uint64_t out_index;
+	};
+	struct KeyImagesRetVals: RetVals_base
+	{
+		std::vector<crypto::key_image> calculated_key_images; // one per output, in order
+	};
+	bool new__key_images(
+		const crypto::public_key& account_pub_spend_key,
+		const crypto::secret_key& account_sec_spend_key,
+		const crypto::secret_key& account_sec_view_key,
+		const std::vector<KeyImageOutput> &outputs,
+		bool verify_ephemeral_keys,
+		KeyImagesRetVals &retVals
+	);
 }
 //
 #endif /* monero_key_image_utils_hpp */
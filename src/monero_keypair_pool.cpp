@@ -0,0 +1,157 @@
+//
+//  monero_keypair_pool.cpp
+//  Copyright (c) 2014-2019, MyMonero.com
+//
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are
+//  permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright notice, this list of
+//	conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list
+//	of conditions and the following disclaimer in the documentation and/or other
+//	materials provided with the distribution.
+//
+//  3. Neither the name of the copyright holder nor the names of its contributors may be
+//	used to endorse or promote products derived from this software without specific
+//	prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+//  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+//  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+//  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+//  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//
+#include "monero_keypair_pool.hpp"
+//
+#include <vector>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+//
+using namespace std;
+using namespace crypto;
+using namespace cryptonote;
+using namespace monero_keypair_pool;
+//
+namespace
+{
+	struct KeypairPool
+	{
+		boost::mutex mutex;
+		boost::condition_variable refill_needed;
+		boost::thread refill_thread;
+		std::vector<cryptonote::keypair> keypairs; // secret_key is scrubbed on destruction
+		size_t target_size = 0;
+		bool running = false;
+		uint64_t pooled = 0;
+		uint64_t inline_generated = 0;
+		//
+		~KeypairPool()
+		{
+			{
+				boost::lock_guard<boost::mutex> lock(mutex);
+				running = false;
+			}
+			refill_needed.notify_all();
+			if (refill_thread.joinable()) {
+				refill_thread.join();
+			}
+		}
+	};
+	KeypairPool &_pool()
+	{
+		static KeypairPool pool;
+		return pool;
+	}
+	cryptonote::keypair _generated_keypair()
+	{
+		cryptonote::keypair k;
+		crypto::generate_keys(k.pub, k.sec);
+		return k;
+	}
+	void _refill_loop(KeypairPool &pool)
+	{
+		boost::unique_lock<boost::mutex> lock(pool.mutex);
+		while (pool.running) {
+			if (pool.keypairs.size() >= pool.target_size) {
+				pool.refill_needed.wait(lock);
+				continue;
+			}
+			lock.unlock();
+			cryptonote::keypair k = _generated_keypair(); // generated without holding the lock
+			lock.lock();
+			if (pool.running && pool.keypairs.size() < pool.target_size) {
+				pool.keypairs.push_back(k);
+			}
+		}
+	}
+}
+//
+void monero_keypair_pool::start(size_t target_size)
+{
+	KeypairPool &pool = _pool();
+	boost::lock_guard<boost::mutex> lock(pool.mutex);
+	if (pool.running || target_size == 0) {
+		return;
+	}
+	pool.target_size = target_size;
+	pool.keypairs.reserve(target_size); // no reallocation (and so no stray copies of secrets) while running
+	pool.running = true;
+	pool.refill_thread = boost::thread(_refill_loop, boost::ref(pool));
+}
+void monero_keypair_pool::stop()
+{
+	KeypairPool &pool = _pool();
+	{
+		boost::lock_guard<boost::mutex> lock(pool.mutex);
+		if (!pool.running) {
+			return;
+		}
+		pool.running = false;
+	}
+	pool.refill_needed.notify_all();
+	pool.refill_thread.join();
+	//
+	boost::lock_guard<boost::mutex> lock(pool.mutex);
+	pool.keypairs.clear();
+	pool.keypairs.shrink_to_fit();
+}
+bool monero_keypair_pool::is_running()
+{
+	KeypairPool &pool = _pool();
+	boost::lock_guard<boost::mutex> lock(pool.mutex);
+	return pool.running;
+}
+cryptonote::keypair monero_keypair_pool::new_keypair()
+{
+	KeypairPool &pool = _pool();
+	{
+		boost::lock_guard<boost::mutex> lock(pool.mutex);
+		if (pool.running && !pool.keypairs.empty()) {
+			cryptonote::keypair k = pool.keypairs.back();
+			pool.keypairs.pop_back();
+			pool.pooled++;
+			pool.refill_needed.notify_one();
+			return k;
+		}
+		pool.inline_generated++;
+		if (pool.running) {
+			pool.refill_needed.notify_one();
+		}
+	}
+	return _generated_keypair();
+}
+Stats monero_keypair_pool::stats()
+{
+	KeypairPool &pool = _pool();
+	boost::lock_guard<boost::mutex> lock(pool.mutex);
+	return Stats{ pool.pooled, pool.inline_generated, pool.keypairs.size() };
+}
@@ -0,0 +1,60 @@
+//
+//  monero_keypair_pool.hpp
+//  Copyright (c) 2014-2019, MyMonero.com
+//
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are
+//  permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright notice, this list of
+//	conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list
+//	of conditions and the following disclaimer in the documentation and/or other
+//	materials provided with the distribution.
+//
+//  3. Neither the name of the copyright holder nor the names of its contributors may be
+//	used to endorse or promote products derived from this software without specific
+//	prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+//  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+//  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+//  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+//  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//
+#ifndef monero_keypair_pool_hpp
+#define monero_keypair_pool_hpp
+//
+#include "cryptonote_basic.h"
+//
+namespace monero_keypair_pool
+{
+	// Keypairs for tx keys, additional tx keys and the dummy 0-change address, generated ahead of
+	// time on a background thread so transaction construction doesn't pay for them on the calling
+	// thread. The pool is off until start() is called (e.g. builds without threads never start it),
+	// and new_keypair() generates inline whenever the pool is stopped or drained. Secret keys are
+	// scrubbed when they leave the pool and when the pool is stopped.
+	struct Stats
+	{
+		uint64_t pooled; // keypairs handed out from the pool
+		uint64_t inline_generated; // keypairs generated on the calling thread
+		size_t size;
+	};
+	static const size_t default_target_size = 64;
+	//
+	void start(size_t target_size = default_target_size);
+	void stop(); // joins the refill thread and wipes the pool
+	bool is_running();
+	//
+	cryptonote::keypair new_keypair();
+	Stats stats();
+}
+//
+#endif /* monero_keypair_pool_hpp */
@@ -0,0 +1,316 @@
+//
+//  monero_key_image_store.cpp
+//  Copyright (c) 2014-2019, MyMonero.com
+//
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are
+//  permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright notice, this list of
+//	conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list
+//	of conditions and the following disclaimer in the documentation and/or other
+//	materials provided with the distribution.
+//
+//  3. Neither the name of the copyright holder nor the names of its contributors may be
+//	used to endorse or promote products derived from this software without specific
+//	prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+//  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+//  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+//  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+//  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//
+#include "monero_multi_account_scanner.hpp"
+#include "monero_rct_utils.hpp"
+//
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+#include "storages/portable_storage_template_helper.h"
+#include "ringct/rctOps.h"
+#include "common/threadpool.h"
+#include "memwipe.h"
+//
+using namespace std;
+using namespace crypto;
+using namespace cryptonote;
+using namespace monero_multi_account_scanner;
+//
+void monero_multi_account_scanner::append_tx(
+	BlockBatch &batch,
+	const monero_tx_view::TxView &view,
+	const crypto::hash &tx_hash,
+	uint64_t height,
+	bool is_coinbase
+) {
+	uint32_t tx_index = (uint32_t)batch.n_txs();
+	batch.tx_hashes.push_back(tx_hash);
+	batch.tx_heights.push_back(height);
+	batch.tx_unlock_times.push_back(view.unlock_time());
+	batch.tx_is_coinbase.push_back(is_coinbase);
+	batch.tx_versions.push_back((uint8_t)view.version());
+	batch.tx_rct_types.push_back(view.rct_type());
+	crypto::public_key tx_pub_key;
+	batch.tx_pub_keys.push_back(view.tx_pub_key(tx_pub_key) ? tx_pub_key : crypto::null_pkey);
+	vector<crypto::public_key> additional_pub_keys = view.additional_tx_pub_keys();
+	bool has_additional = !additional_pub_keys.empty() && additional_pub_keys.size() == view.n_outputs();
+	batch.tx_has_additional_pub_keys.push_back(has_additional);
+	bool is_rct = view.rct_type() != rct::RCTTypeNull;
+	for (size_t i = 0; i < view.n_outputs(); i++) {
+		batch.out_keys.push_back(view.output_key(i));
+		batch.additional_pub_keys.push_back(has_additional ? additional_pub_keys[i] : crypto::null_pkey);
+		batch.out_amounts.push_back(view.output_amount(i));
+		batch.out_ecdh_info.push_back(is_rct ? view.ecdh_info(i) : rct::ecdhTuple{});
+		batch.out_commitments.push_back(is_rct ? view.out_pk(i) : rct::zero());
+	}
+	batch.tx_outputs_begin.push_back((uint32_t)batch.n_outputs()); // this tx's end; the next one's begin
+	for (size_t i = 0; i < view.n_inputs(); i++) {
+		batch.input_key_images.push_back(view.key_image(i));
+		batch.input_txs.push_back(tx_index);
+	}
+}
+bool monero_multi_account_scanner::new__block_batch(
+	const vector<block_complete_entry> &blocks,
+	BlockBatch &batch,
+	string &err_string
+) {
+	batch = BlockBatch{};
+	batch.tx_outputs_begin.push_back(0);
+	monero_tx_view::TxView view;
+	for (size_t b = 0; b < blocks.size(); b++) {
+		block block;
+		string miner_tx_blob;
+		if (!parse_and_validate_block_from_blob(blocks[b].block, block)
+			|| block.tx_hashes.size() != blocks[b].txs.size() // v2 txs' hashes aren't their blob hashes, so there's no fallback
+			|| !view.parse(miner_tx_blob = tx_to_blob(block.miner_tx))
+			|| !view.is_coinbase()) {
+			err_string = "Failed to parse block blob at index " + std::to_string(b);
+			return false;
+		}
+		uint64_t height = view.coinbase_height();
+		if (b == 0) {
+			batch.start_height = height;
+		}
+		batch.end_height = height + 1;
+		append_tx(batch, view, get_transaction_hash(block.miner_tx), height, true);
+		for (size_t t = 0; t < blocks[b].txs.size(); t++) {
+			if (!view.parse(blocks[b].txs[t])) {
+				err_string = "Failed to parse tx blob at index " + std::to_string(t) + " of block index " + std::to_string(b);
+				return false;
+			}
+			append_tx(batch, view, block.tx_hashes[t], height, false);
+		}
+	}
+	return true;
+}
+bool monero_multi_account_scanner::new__block_batch_from_blocks_by_height_response(
+	const string &buff_bin,
+	BlockBatch &batch,
+	string &err_string
+) {
+	COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::response resp_struct;
+	if (!epee::serialization::load_t_from_binary(resp_struct, buff_bin)) {
+		err_string = "Failed to load blocks by height response";
+		return false;
+	}
+	return new__block_batch(resp_struct.blocks, batch, err_string);
+}
+//
+Engine::Engine(size_t n_shards) :
+	m_n_shards(n_shards != 0 ? n_shards : std::max<size_t>(1, tools::threadpool::getInstance().get_max_concurrency()))
+{
+}
+Engine::~Engine()
+{
+	for (crypto::secret_key &sec_viewKey : m_sec_viewKeys) {
+		memwipe(&sec_viewKey, sizeof(sec_viewKey));
+	}
+}
+void Engine::add_account(uint64_t account_id, const crypto::secret_key &sec_viewKey, const crypto::public_key &pub_spendKey)
+{
+	auto found = m_account_indices.find(account_id);
+	if (found != m_account_indices.end()) {
+		m_sec_viewKeys[found->second] = sec_viewKey;
+		m_pub_spendKeys[found->second] = pub_spendKey;
+		return;
+	}
+	m_account_indices[account_id] = m_account_ids.size();
+	m_account_ids.push_back(account_id);
+	m_sec_viewKeys.push_back(sec_viewKey);
+	m_pub_spendKeys.push_back(pub_spendKey);
+}
+bool Engine::remove_account(uint64_t account_id)
+{
+	auto found = m_account_indices.find(account_id);
+	if (found == m_account_indices.end()) {
+		return false;
+	}
+	size_t i = found->second;
+	size_t last = m_account_ids.size() - 1;
+	if (i != last) { // swap the last account into its place
+		m_account_ids[i] = m_account_ids[last];
+		m_sec_viewKeys[i] = m_sec_viewKeys[last];
+		m_pub_spendKeys[i] = m_pub_spendKeys[last];
+		m_account_indices[m_account_ids[i]] = i;
+	}
+	memwipe(&m_sec_viewKeys[last], sizeof(m_sec_viewKeys[last]));
+	m_account_ids.pop_back();
+	m_sec_viewKeys.pop_back();
+	m_pub_spendKeys.pop_back();
+	m_account_indices.erase(account_id);
+	for (auto it = m_known_key_images.begin(); it != m_known_key_images.end(); ) {
+		if (it->second == account_id) {
+			it = m_known_key_images.erase(it);
+		} else {
+			++it;
+		}
+	}
+	return true;
+}
+void Engine::add_known_key_images(uint64_t account_id, const vector<crypto::key_image> &key_images)
+{
+	for (const crypto::key_image &key_image : key_images) {
+		m_known_key_images[key_image] = account_id;
+	}
+}
+//
+bool Engine::_scan_shard(const BlockBatch &batch, size_t begin, size_t end, vector<AccountOutput> &owned_outputs, string &err_string) const
+{
+	vector<monero_output_scanner::PendingTxAmounts> pending_amounts;
+	for (size_t a = begin; a < end; a++) {
+		const crypto::secret_key &sec_viewKey = m_sec_viewKeys[a];
+		const crypto::public_key &pub_spendKey = m_pub_spendKeys[a];
+		for (size_t t = 0; t < batch.n_txs(); t++) {
+			uint32_t outputs_begin = batch.tx_outputs_begin[t];
+			uint32_t outputs_end = batch.tx_outputs_begin[t + 1];
+			if (outputs_begin == outputs_end) {
+				continue;
+			}
+			crypto::key_derivation derivation;
+			bool has_derivation = batch.tx_pub_keys[t] != crypto::null_pkey
+				&& crypto::generate_key_derivation(batch.tx_pub_keys[t], sec_viewKey, derivation);
+			bool has_additional = batch.tx_has_additional_pub_keys[t] != 0;
+			if (!has_derivation && !has_additional) {
+				continue;
+			}
+			monero_output_scanner::PendingTxAmounts pending{};
+			for (uint32_t o = outputs_begin; o < outputs_end; o++) {
+				size_t i = o - outputs_begin;
+				monero_output_scanner::OutputOwner owner;
+				if (!monero_output_scanner::find_output_owner(
+					sec_viewKey, pub_spendKey, nullptr,
+					batch.out_keys[o], i, batch.tx_pub_keys[t],
+					has_derivation ? &derivation : nullptr,
+					has_additional ? &batch.additional_pub_keys[o] : nullptr,
+					owner
+				)) {
+					continue;
+				}
+				AccountOutput owned{};
+				owned.account_id = m_account_ids[a];
+				monero_output_scanner::OwnedOutput &output = owned.output;
+				output.height = batch.tx_heights[t];
+				output.tx_hash = batch.tx_hashes[t];
+				output.tx_pub_key = owner.tx_pub_key;
+				output.out_index = i;
+				output.out_pub_key = batch.out_keys[o];
+				output.subaddress_index = owner.subaddress_index;
+				output.amount = batch.out_amounts[o];
+				output.mask = rct::identity();
+				output.is_coinbase = batch.tx_is_coinbase[t] != 0;
+				output.unlock_time = batch.tx_unlock_times[t];
+				if (batch.tx_rct_types[t] != rct::RCTTypeNull) {
+					if (pending.owned_output_indices.empty()) { // the tx's first owned output for this account
+						pending.to_decode.rv.type = batch.tx_rct_types[t];
+						pending.to_decode.rv.ecdhInfo.reserve(outputs_end - outputs_begin);
+						pending.to_decode.rv.outPk.reserve(outputs_end - outputs_begin);
+						for (uint32_t p = outputs_begin; p < outputs_end; p++) { // decode_amounts indexes the tx's own outputs
+							pending.to_decode.rv.ecdhInfo.push_back(batch.out_ecdh_info[p]);
+							rct::ctkey outPk{};
+							outPk.mask = batch.out_commitments[p];
+							pending.to_decode.rv.outPk.push_back(outPk);
+						}
+					}
+					pending.owned_output_indices.push_back(owned_outputs.size());
+					pending.to_decode.out_indices.push_back(i);
+					pending.to_decode.out_derivations.push_back(owner.derivation);
+				}
+				memwipe(&owner.derivation, sizeof(owner.derivation));
+				owned_outputs.push_back(std::move(owned));
+			}
+			memwipe(&derivation, sizeof(derivation));
+			if (!pending.owned_output_indices.empty()) {
+				pending_amounts.push_back(std::move(pending));
+			}
+		}
+	}
+	return monero_output_scanner::decode_owned_amounts(owned_outputs, pending_amounts, [] (AccountOutput &owned) -> monero_output_scanner::OwnedOutput & { return owned.output; }, err_string);
+}
+bool Engine::scan(const BlockBatch &batch, ScanBatchRetVals &retVals) const
+{
+	retVals = {};
+	auto started = std::chrono::steady_clock::now();
+	size_t n_accounts = m_account_ids.size();
+	size_t n_shards = std::min(m_n_shards, std::max<size_t>(1, n_accounts));
+	size_t shard_size = (n_accounts + n_shards - 1) / n_shards;
+	vector<vector<AccountOutput>> shard_outputs(n_shards);
+	vector<boost::optional<string>> shard_errors(n_shards);
+	tools::threadpool &tpool = tools::threadpool::getInstance();
+	tools::threadpool::waiter waiter;
+	for (size_t s = 0; s < n_shards; s++) {
+		size_t begin = std::min(n_accounts, s * shard_size);
+		size_t end = std::min(n_accounts, begin + shard_size);
+		if (begin == end) {
+			continue;
+		}
+		tpool.submit(&waiter, [this, &batch, &shard_outputs, &shard_errors, s, begin, end] () {
+			try {
+				string err_string;
+				if (!_scan_shard(batch, begin, end, shard_outputs[s], err_string)) {
+					shard_errors[s] = err_string;
+				}
+			} catch (const std::exception &e) { // the pool can't propagate exceptions; report it against this shard
+				shard_errors[s] = string(e.what());
+			}
+		});
+	}
+	// Spends don't depend on the account keys, so they're matched here while the shards run
+	for (size_t i = 0; i < batch.input_key_images.size(); i++) {
+		auto found = m_known_key_images.find(batch.input_key_images[i]);
+		if (found != m_known_key_images.end()) {
+			uint32_t t = batch.input_txs[i];
+			retVals.spent_key_images.push_back(AccountSpend{
+				found->second,
+				monero_output_scanner::SpentKeyImage{ batch.tx_heights[t], batch.tx_hashes[t], batch.input_key_images[i] }
+			});
+		}
+	}
+	waiter.wait(&tpool);
+	for (size_t s = 0; s < n_shards; s++) {
+		if (shard_errors[s] != boost::none) {
+			retVals.did_error = true;
+			retVals.err_string = shard_errors[s];
+			retVals.owned_outputs.clear();
+			retVals.spent_key_images.clear();
+			return false;
+		}
+		std::move(shard_outputs[s].begin(), shard_outputs[s].end(), std::back_inserter(retVals.owned_outputs));
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+	retVals.throughput = Throughput{
+		batch.n_outputs(), n_accounts, seconds,
+		seconds > 0 ? (double)batch.n_outputs() * n_accounts / seconds : 0
+	};
+	return true;
+}
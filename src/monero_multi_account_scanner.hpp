@@ -0,0 +1,155 @@
+//
+//  monero_multi_account_scanner.hpp
+//  Copyright (c) 2014-2019, MyMonero.com
+//
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are
+//  permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright notice, this list of
+//	conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list
+//	of conditions and the following disclaimer in the documentation and/or other
+//	materials provided with the distribution.
+//
+//  3. Neither the name of the copyright holder nor the names of its contributors may be
+//	used to endorse or promote products derived from this software without specific
+//	prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+//  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+//  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+//  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+//  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//
+#ifndef monero_multi_account_scanner_hpp
+#define monero_multi_account_scanner_hpp
+//
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "crypto.h"
+#include "cryptonote_basic.h"
+#include "ringct/rctTypes.h"
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
+#include "monero_output_scanner.hpp"
+#include "monero_tx_view.hpp"
+//
+using namespace tools;
+#include "tools__ret_vals.hpp"
+//
+namespace monero_multi_account_scanner
+{
+	// Server-side scanning of one block stream against many view-only accounts (as a lightwallet
+	// backend does). Blocks are parsed once into a BlockBatch of contiguous per-tx and per-output
+	// arrays; Engine then splits its accounts into shards, one per worker on the shared
+	// threadpool, and each worker walks the whole batch for its shard. The per-account cost is a
+	// key derivation per tx and a derive_subaddress_public_key per output; input key images are
+	// matched once per batch against every account's known key images through a single map.
+	struct BlockBatch
+	{
+		uint64_t start_height = 0;
+		uint64_t end_height = 0; // exclusive
+		// per tx, miner txs included
+		std::vector<crypto::hash> tx_hashes;
+		std::vector<uint64_t> tx_heights;
+		std::vector<uint64_t> tx_unlock_times;
+		std::vector<uint8_t> tx_is_coinbase;
+		std::vector<uint8_t> tx_versions;
+		std::vector<uint8_t> tx_rct_types; // rct::RCTTypeNull for v1 txs
+		std::vector<crypto::public_key> tx_pub_keys; // null_pkey when extra has none
+		std::vector<uint32_t> tx_outputs_begin; // into the per output arrays; one extra entry at the end
+		std::vector<uint8_t> tx_has_additional_pub_keys; // then additional_pub_keys is filled for its outputs
+		// per output
+		std::vector<crypto::public_key> out_keys;
+		std::vector<crypto::public_key> additional_pub_keys;
+		std::vector<uint64_t> out_amounts; // 0 for rct outputs
+		std::vector<rct::ecdhTuple> out_ecdh_info; // empty tuples for non-rct outputs
+		std::vector<rct::key> out_commitments;
+		// per input
+		std::vector<crypto::key_image> input_key_images;
+		std::vector<uint32_t> input_txs; // index of the spending tx
+		//
+		size_t n_txs() const { return tx_hashes.size(); }
+		size_t n_outputs() const { return out_keys.size(); }
+	};
+	// Appends one tx, read through view; every BlockBatch is built with this, so batches from
+	// new__block_batch and monero_block_cache are the same. batch.tx_outputs_begin must already
+	// hold the first tx's begin.
+	void append_tx(
+		BlockBatch &batch,
+		const monero_tx_view::TxView &view,
+		const crypto::hash &tx_hash,
+		uint64_t height,
+		bool is_coinbase
+	);
+	bool new__block_batch( // txs are read through monero_tx_view, so their signatures aren't parsed or checked
+		const std::vector<cryptonote::block_complete_entry> &blocks, // consecutive, ascending; each block's tx_hashes must match its txs
+		BlockBatch &batch,
+		std::string &err_string
+	);
+	// buff_bin: a binary COMMAND_RPC_GET_BLOCKS_BY_HEIGHT response, as read by binary_utils::binary_blocks_to_json
+	bool new__block_batch_from_blocks_by_height_response(
+		const std::string &buff_bin,
+		BlockBatch &batch,
+		std::string &err_string
+	);
+	//
+	struct AccountOutput
+	{
+		uint64_t account_id;
+		monero_output_scanner::OwnedOutput output; // key_image is never set; subaddress_index is always {0, 0}
+	};
+	struct AccountSpend
+	{
+		uint64_t account_id;
+		monero_output_scanner::SpentKeyImage spend;
+	};
+	struct Throughput
+	{
+		uint64_t n_outputs;
+		uint64_t n_accounts;
+		double seconds;
+		double output_accounts_per_second; // n_outputs * n_accounts / seconds
+	};
+	struct ScanBatchRetVals: RetVals_base
+	{
+		std::vector<AccountOutput> owned_outputs; // grouped by account shard, in chain order within an account
+		std::vector<AccountSpend> spent_key_images; // in chain order
+		Throughput throughput;
+	};
+	//
+	// Accounts may be added and removed between scans, not during one.
+	class Engine
+	{
+	public:
+		Engine(size_t n_shards = 0); // 0: one per threadpool worker
+		~Engine();
+		//
+		void add_account(uint64_t account_id, const crypto::secret_key &sec_viewKey, const crypto::public_key &pub_spendKey); // replaces the keys if already added
+		bool remove_account(uint64_t account_id); // and its known key images
+		void add_known_key_images(uint64_t account_id, const std::vector<crypto::key_image> &key_images);
+		size_t n_accounts() const { return m_account_ids.size(); }
+		//
+		bool scan(const BlockBatch &batch, ScanBatchRetVals &retVals) const;
+	private:
+		bool _scan_shard(const BlockBatch &batch, size_t begin, size_t end, std::vector<AccountOutput> &owned_outputs, std::string &err_string) const;
+		//
+		size_t m_n_shards;
+		// accounts, struct-of-arrays so a shard's keys are contiguous
+		std::vector<uint64_t> m_account_ids;
+		std::vector<crypto::secret_key> m_sec_viewKeys;
+		std::vector<crypto::public_key> m_pub_spendKeys;
+		std::unordered_map<uint64_t, size_t> m_account_indices;
+		std::unordered_map<crypto::key_image, uint64_t> m_known_key_images; // -> account_id
+	};
+}
+//
+#endif /* monero_multi_account_scanner_hpp */
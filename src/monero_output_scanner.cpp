@@ -0,0 +1,389 @@
+//
+//  monero_key_image_store.cpp
+//  Copyright (c) 2014-2019, MyMonero.com
+//
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are
+//  permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright notice, this list of
+//	conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list
+//	of conditions and the following disclaimer in the documentation and/or other
+//	materials provided with the distribution.
+//
+//  3. Neither the name of the copyright holder nor the names of its contributors may be
+//	used to endorse or promote products derived from this software without specific
+//	prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+//  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+//  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+//  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+//  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//
+#include "monero_output_scanner.hpp"
+#include "monero_rct_utils.hpp"
+#include "monero_key_image_store.hpp"
+//
+#include <algorithm>
+#include <unordered_set>
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+#include "storages/portable_storage_template_helper.h"
+#include "ringct/rctOps.h"
+#include "common/threadpool.h"
+#include "device/device.hpp"
+#include "memwipe.h"
+#include "misc_log_ex.h"
+//
+using namespace std;
+using namespace crypto;
+using namespace cryptonote;
+using namespace monero_output_scanner;
+//
+namespace
+{
+	struct RangeResult
+	{
+		boost::optional<string> err_string;
+		uint64_t start_height = 0;
+		uint64_t end_height = 0; // exclusive
+		vector<OwnedOutput> owned_outputs;
+		vector<SpentKeyImage> input_key_images; // every input in the range; filtered once all ranges are in
+	};
+	//
+	bool _is_owned(
+		const crypto::public_key &pub_spendKey,
+		const monero_subaddress_table::SubaddressTable *subaddresses,
+		const crypto::public_key &out_key,
+		const crypto::key_derivation &derivation,
+		size_t out_index,
+		subaddress_index &index
+	) {
+		crypto::public_key spend_key;
+		if (!crypto::derive_subaddress_public_key(out_key, derivation, out_index, spend_key)) {
+			return false;
+		}
+		if (subaddresses != nullptr) {
+			return subaddresses->lookup(spend_key, index); // one probe, however many subaddresses
+		}
+		index = subaddress_index{ 0, 0 };
+		return spend_key == pub_spendKey;
+	}
+	void _scan_tx(
+		const ScanAccount &account,
+		const transaction &tx,
+		const crypto::hash &tx_hash,
+		uint64_t height,
+		bool is_coinbase,
+		RangeResult &result,
+		vector<PendingTxAmounts> &pending_amounts
+	) {
+		for (const txin_v &in : tx.vin) {
+			if (in.type() == typeid(txin_to_key)) {
+				result.input_key_images.push_back(SpentKeyImage{ height, tx_hash, boost::get<txin_to_key>(in).k_image });
+			}
+		}
+		crypto::public_key tx_pub_key = get_tx_pub_key_from_extra(tx);
+		vector<crypto::public_key> additional_tx_pub_keys = get_additional_tx_pub_keys_from_extra(tx);
+		bool has_additional = additional_tx_pub_keys.size() == tx.vout.size();
+		crypto::key_derivation derivation;
+		bool has_derivation = tx_pub_key != crypto::null_pkey
+			&& crypto::generate_key_derivation(tx_pub_key, account.sec_viewKey, derivation);
+		if (!has_derivation && !has_additional) {
+			return;
+		}
+		PendingTxAmounts pending{};
+		for (size_t i = 0; i < tx.vout.size(); i++) {
+			if (tx.vout[i].target.type() != typeid(txout_to_key)) {
+				continue;
+			}
+			const crypto::public_key &out_key = boost::get<txout_to_key>(tx.vout[i].target).key;
+			OutputOwner owner;
+			if (!find_output_owner(
+				account.sec_viewKey, account.pub_spendKey, account.subaddresses.get(),
+				out_key, i, tx_pub_key,
+				has_derivation ? &derivation : nullptr,
+				has_additional ? &additional_tx_pub_keys[i] : nullptr,
+				owner
+			)) {
+				continue;
+			}
+			OwnedOutput output{};
+			output.height = height;
+			output.tx_hash = tx_hash;
+			output.tx_pub_key = owner.tx_pub_key;
+			output.out_index = i;
+			output.out_pub_key = out_key;
+			output.subaddress_index = owner.subaddress_index;
+			output.amount = tx.vout[i].amount;
+			output.mask = rct::identity();
+			output.is_coinbase = is_coinbase;
+			output.unlock_time = tx.unlock_time;
+			if (tx.version >= 2 && tx.rct_signatures.type != rct::RCTTypeNull) {
+				if (pending.owned_output_indices.empty()) { // the tx's first owned output
+					pending.to_decode.rv.type = tx.rct_signatures.type;
+					pending.to_decode.rv.ecdhInfo = tx.rct_signatures.ecdhInfo;
+					pending.to_decode.rv.outPk = tx.rct_signatures.outPk;
+				}
+				pending.owned_output_indices.push_back(result.owned_outputs.size());
+				pending.to_decode.out_indices.push_back(i);
+				pending.to_decode.out_derivations.push_back(owner.derivation);
+			}
+			memwipe(&owner.derivation, sizeof(owner.derivation));
+			result.owned_outputs.push_back(std::move(output));
+		}
+		memwipe(&derivation, sizeof(derivation));
+		if (!pending.owned_output_indices.empty()) {
+			pending_amounts.push_back(std::move(pending));
+		}
+	}
+	void _compute_key_images(const ScanAccount &account, RangeResult &result)
+	{
+		for (OwnedOutput &output : result.owned_outputs) {
+			if (!output.subaddress_index.is_zero()) { // the key image store's derivation is main address only
+				account_keys keys;
+				keys.m_account_address.m_spend_public_key = account.pub_spendKey;
+				keys.m_spend_secret_key = *account.sec_spendKey;
+				keys.m_view_secret_key = account.sec_viewKey;
+				crypto::key_derivation derivation;
+				keypair in_ephemeral;
+				crypto::key_image key_image;
+				bool r = crypto::generate_key_derivation(output.tx_pub_key, account.sec_viewKey, derivation)
+					&& generate_key_image_helper_precomp(keys, output.out_pub_key, derivation, output.out_index, output.subaddress_index, in_ephemeral, key_image, hw::get_device("default"));
+				memwipe(&derivation, sizeof(derivation));
+				memwipe(&in_ephemeral.sec, sizeof(in_ephemeral.sec));
+				memwipe(&keys.m_spend_secret_key, sizeof(keys.m_spend_secret_key));
+				memwipe(&keys.m_view_secret_key, sizeof(keys.m_view_secret_key));
+				if (!r) {
+					result.err_string = string("Unable to generate subaddress key image");
+					return;
+				}
+				output.key_image = key_image;
+				continue;
+			}
+			monero_key_image_utils::KeyImageRetVals key_image_retVals;
+			if (!monero_key_image_store::new__key_image(
+				account.pub_spendKey, *account.sec_spendKey, account.sec_viewKey,
+				output.tx_pub_key, output.out_index,
+				key_image_retVals
+			)) {
+				result.err_string = key_image_retVals.err_string;
+				return;
+			}
+			output.key_image = key_image_retVals.calculated_key_image;
+		}
+	}
+	void _scan_range(
+		const vector<block_complete_entry> &blocks,
+		size_t begin, size_t end,
+		const ScanAccount &account,
+		RangeResult &result
+	) {
+		vector<PendingTxAmounts> pending_amounts;
+		for (size_t b = begin; b < end; b++) {
+			block block;
+			if (!parse_and_validate_block_from_blob(blocks[b].block, block)
+				|| block.miner_tx.vin.size() != 1 || block.miner_tx.vin[0].type() != typeid(txin_gen)) {
+				result.err_string = "Failed to parse block blob at index " + std::to_string(b);
+				return;
+			}
+			uint64_t height = boost::get<txin_gen>(block.miner_tx.vin[0]).height;
+			if (b == begin) {
+				result.start_height = height;
+			}
+			result.end_height = height + 1;
+			_scan_tx(account, block.miner_tx, get_transaction_hash(block.miner_tx), height, true, result, pending_amounts);
+			bool has_tx_hashes = block.tx_hashes.size() == blocks[b].txs.size();
+			for (size_t t = 0; t < blocks[b].txs.size(); t++) {
+				transaction tx;
+				if (!parse_and_validate_tx_from_blob(blocks[b].txs[t], tx)) {
+					result.err_string = "Failed to parse tx blob at index " + std::to_string(t) + " of block index " + std::to_string(b);
+					return;
+				}
+				_scan_tx(account, tx, has_tx_hashes ? block.tx_hashes[t] : get_transaction_hash(tx), height, false, result, pending_amounts);
+			}
+		}
+		string err_string;
+		if (!decode_owned_amounts(result.owned_outputs, pending_amounts, [] (OwnedOutput &output) -> OwnedOutput & { return output; }, err_string)) {
+			result.err_string = err_string;
+			return;
+		}
+		if (account.sec_spendKey != boost::none) {
+			_compute_key_images(account, result);
+		}
+	}
+	void _scan_ranges(
+		const vector<block_complete_entry> &blocks,
+		const ScanAccount &account,
+		vector<RangeResult> &results
+	) {
+		tools::threadpool &tpool = tools::threadpool::getInstance();
+		size_t n_ranges = std::min(blocks.size(), std::max<size_t>(1, tpool.get_max_concurrency()));
+		size_t range_size = (blocks.size() + n_ranges - 1) / n_ranges;
+		n_ranges = (blocks.size() + range_size - 1) / range_size;
+		results.clear();
+		results.resize(n_ranges);
+		tools::threadpool::waiter waiter;
+		for (size_t r = 0; r < n_ranges; r++) {
+			size_t begin = r * range_size;
+			size_t end = std::min(blocks.size(), begin + range_size);
+			tpool.submit(&waiter, [&blocks, &account, &results, r, begin, end] () {
+				try {
+					_scan_range(blocks, begin, end, account, results[r]);
+				} catch (const std::exception &e) { // the pool can't propagate exceptions; report it against this range
+					results[r].err_string = string(e.what());
+				}
+			});
+		}
+		waiter.wait(&tpool);
+	}
+}
+//
+bool monero_output_scanner::scan_blocks(
+	const vector<block_complete_entry> &blocks,
+	const ScanAccount &account,
+	ScanRetVals &retVals
+) {
+	retVals = {};
+	if (blocks.empty()) {
+		return true;
+	}
+	vector<RangeResult> results;
+	while (true) {
+		_scan_ranges(blocks, account, results);
+		for (const RangeResult &result : results) {
+			if (result.err_string != boost::none) {
+				retVals.did_error = true;
+				retVals.err_string = result.err_string;
+				return false;
+			}
+		}
+		if (account.subaddresses == nullptr) {
+			break;
+		}
+		// Like wallet2: a subaddress in use may push the lookahead window over subaddresses which
+		// were already missed in these blocks, so they're scanned again until the table settles
+		bool did_expand = false;
+		for (const RangeResult &result : results) {
+			for (const OwnedOutput &output : result.owned_outputs) {
+				did_expand = account.subaddresses->expand_for(output.subaddress_index) || did_expand;
+			}
+		}
+		if (!did_expand) {
+			break;
+		}
+	}
+	// Spends can only follow the outputs they spend, so every key image found in this scan
+	// can be watched for across the whole scan
+	unordered_set<crypto::key_image> watched_key_images(account.known_key_images.begin(), account.known_key_images.end());
+	for (RangeResult &result : results) {
+		for (OwnedOutput &output : result.owned_outputs) {
+			if (output.key_image != boost::none) {
+				watched_key_images.insert(*output.key_image);
+			}
+			retVals.owned_outputs.push_back(std::move(output));
+		}
+	}
+	for (const RangeResult &result : results) {
+		for (const SpentKeyImage &input : result.input_key_images) {
+			if (watched_key_images.find(input.key_image) != watched_key_images.end()) {
+				retVals.spent_key_images.push_back(input);
+			}
+		}
+	}
+	retVals.start_height = results.front().start_height;
+	retVals.end_height = results.back().end_height;
+	//
+	return true;
+}
+bool monero_output_scanner::scan_blocks_by_height_response(
+	const string &buff_bin,
+	const ScanAccount &account,
+	ScanRetVals &retVals
+) {
+	COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::response resp_struct;
+	if (!epee::serialization::load_t_from_binary(resp_struct, buff_bin)) {
+		retVals = {};
+		retVals.did_error = true;
+		retVals.err_string = string("Failed to load blocks by height response");
+		return false;
+	}
+	return scan_blocks(resp_struct.blocks, account, retVals);
+}
+//
+bool monero_output_scanner::find_output_owner(
+	const crypto::secret_key &sec_viewKey,
+	const crypto::public_key &pub_spendKey,
+	const monero_subaddress_table::SubaddressTable *subaddresses,
+	const crypto::public_key &out_key,
+	size_t out_index,
+	const crypto::public_key &tx_pub_key,
+	const crypto::key_derivation *derivation,
+	const crypto::public_key *additional_pub_key,
+	OutputOwner &owner
+) {
+	if (derivation != nullptr && _is_owned(pub_spendKey, subaddresses, out_key, *derivation, out_index, owner.subaddress_index)) {
+		owner.tx_pub_key = tx_pub_key;
+		owner.derivation = *derivation;
+		return true;
+	}
+	if (additional_pub_key != nullptr // only derived when the main key doesn't match
+		&& crypto::generate_key_derivation(*additional_pub_key, sec_viewKey, owner.derivation)) {
+		if (_is_owned(pub_spendKey, subaddresses, out_key, owner.derivation, out_index, owner.subaddress_index)) {
+			owner.tx_pub_key = *additional_pub_key;
+			return true;
+		}
+		memwipe(&owner.derivation, sizeof(owner.derivation));
+	}
+	return false;
+}
+bool monero_output_scanner::decode_pending_amounts(
+	vector<PendingTxAmounts> &pending_amounts,
+	const std::function<OwnedOutput &(size_t)> &output_at,
+	vector<bool> &keep,
+	string &err_string
+) {
+	vector<monero_rct_utils::TxAmountsToDecode> to_decode;
+	to_decode.reserve(pending_amounts.size());
+	for (PendingTxAmounts &pending : pending_amounts) {
+		to_decode.push_back(std::move(pending.to_decode));
+	}
+	monero_rct_utils::DecodeAmountsRetVals decode_retVals;
+	bool r = monero_rct_utils::decode_amounts(to_decode, crypto::null_skey, decode_retVals); // every derivation is given, so this can't fail
+	for (monero_rct_utils::TxAmountsToDecode &tx : to_decode) {
+		if (tx.derivation != boost::none) {
+			memwipe(&*tx.derivation, sizeof(*tx.derivation));
+		}
+		if (!tx.out_derivations.empty()) {
+			memwipe(tx.out_derivations.data(), tx.out_derivations.size() * sizeof(crypto::key_derivation));
+		}
+	}
+	if (!r || decode_retVals.decoded.size() != pending_amounts.size()) {
+		err_string = decode_retVals.err_string != boost::none ? *decode_retVals.err_string : string("Unable to decode amounts");
+		return false;
+	}
+	for (size_t p = 0; p < pending_amounts.size(); p++) {
+		const vector<size_t> &owned_output_indices = pending_amounts[p].owned_output_indices;
+		for (size_t k = 0; k < owned_output_indices.size(); k++) {
+			const monero_rct_utils::DecodedAmount &decoded = decode_retVals.decoded[p][k];
+			OwnedOutput &output = output_at(owned_output_indices[k]);
+			if (decoded.did_error) { // its key is ours but its commitment doesn't open; unspendable, so not reported
+				LOG_PRINT_L0("monero_output_scanner: undecodable amount in tx " << output.tx_hash << " output " << output.out_index);
+				keep[owned_output_indices[k]] = false;
+				continue;
+			}
+			output.amount = decoded.amount;
+			output.mask = decoded.mask;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,175 @@
+//
+//  monero_output_scanner.hpp
+//  Copyright (c) 2014-2019, MyMonero.com
+//
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are
+//  permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright notice, this list of
+//	conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list
+//	of conditions and the following disclaimer in the documentation and/or other
+//	materials provided with the distribution.
+//
+//  3. Neither the name of the copyright holder nor the names of its contributors may be
+//	used to endorse or promote products derived from this software without specific
+//	prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+//  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+//  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+//  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+//  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//
+#ifndef monero_output_scanner_hpp
+#define monero_output_scanner_hpp
+//
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/optional.hpp>
+#include "crypto.h"
+#include "cryptonote_basic.h"
+#include "ringct/rctTypes.h"
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
+#include "monero_subaddress_table.hpp"
+#include "monero_rct_utils.hpp"
+//
+using namespace tools;
+#include "tools__ret_vals.hpp"
+//
+namespace monero_output_scanner
+{
+	// Native view-key scanning of raw blocks, so refreshing doesn't need every block as JSON and a
+	// bridge call per output. Block ranges are parsed and scanned in parallel on the shared
+	// threadpool; each tx's pub key and additional pub keys come from extra, every output key is
+	// checked against the account's spend pub key with derive_subaddress_public_key, and rct
+	// amounts of the owned outputs are decoded with monero_rct_utils. Only owned outputs and
+	// spends of known key images are returned.
+	struct ScanAccount
+	{
+		crypto::secret_key sec_viewKey;
+		crypto::public_key pub_spendKey;
+		// When given, key images of found outputs are computed (through monero_key_image_store) so
+		// their spends are reported as well, including spends within the same scan
+		boost::optional<crypto::secret_key> sec_spendKey;
+		std::vector<crypto::key_image> known_key_images; // of outputs found by earlier scans
+		// When set, outputs to any subaddress in the table are owned; it's expanded past every
+		// subaddress found in use, and the blocks rescanned if that added keys
+		std::shared_ptr<monero_subaddress_table::SubaddressTable> subaddresses;
+	};
+	struct OwnedOutput
+	{
+		uint64_t height;
+		crypto::hash tx_hash;
+		crypto::public_key tx_pub_key; // the main or additional tx pub key the output was derived with
+		uint64_t out_index; // within the tx
+		crypto::public_key out_pub_key;
+		cryptonote::subaddress_index subaddress_index; // {0, 0} without a subaddress table
+		uint64_t amount;
+		rct::key mask; // identity for non-rct outputs
+		bool is_coinbase;
+		uint64_t unlock_time;
+		boost::optional<crypto::key_image> key_image; // when a sec_spendKey was given
+	};
+	struct SpentKeyImage
+	{
+		uint64_t height;
+		crypto::hash tx_hash;
+		crypto::key_image key_image;
+	};
+	struct ScanRetVals: RetVals_base
+	{
+		uint64_t start_height = 0;
+		uint64_t end_height = 0; // exclusive; equal to start_height when there were no blocks
+		std::vector<OwnedOutput> owned_outputs; // in chain order
+		std::vector<SpentKeyImage> spent_key_images; // in chain order
+	};
+	//
+	bool scan_blocks(
+		const std::vector<cryptonote::block_complete_entry> &blocks, // consecutive, ascending
+		const ScanAccount &account,
+		ScanRetVals &retVals
+	);
+	// buff_bin: a binary COMMAND_RPC_GET_BLOCKS_BY_HEIGHT response, as read by binary_utils::binary_blocks_to_json
+	bool scan_blocks_by_height_response(
+		const std::string &buff_bin,
+		const ScanAccount &account,
+		ScanRetVals &retVals
+	);
+	//
+	// Per output steps, shared with monero_multi_account_scanner
+	struct OutputOwner // what an owned output was derived with
+	{
+		crypto::public_key tx_pub_key; // the main or additional tx pub key
+		crypto::key_derivation derivation; // for its amount; the caller wipes it
+		cryptonote::subaddress_index subaddress_index;
+	};
+	// Whether the output with key out_key at out_index of its tx is the account's: checked with
+	// derivation (tx_pub_key's), then only if that doesn't match, with one derived from
+	// additional_pub_key. Either may be nullptr when the tx has none. Without a subaddress table
+	// (nullptr), only pub_spendKey is owned.
+	bool find_output_owner(
+		const crypto::secret_key &sec_viewKey,
+		const crypto::public_key &pub_spendKey,
+		const monero_subaddress_table::SubaddressTable *subaddresses,
+		const crypto::public_key &out_key,
+		size_t out_index,
+		const crypto::public_key &tx_pub_key,
+		const crypto::key_derivation *derivation,
+		const crypto::public_key *additional_pub_key,
+		OutputOwner &owner
+	);
+	struct PendingTxAmounts // a tx's owned rct outputs, until their amounts are decoded
+	{
+		std::vector<size_t> owned_output_indices; // into the caller's owned outputs; one per to_decode.out_indices
+		monero_rct_utils::TxAmountsToDecode to_decode; // the tx's rct data, copied once, with each owned output's index and out_derivations
+	};
+	// Decodes every pending amount in one monero_rct_utils::decode_amounts call into output_at(its
+	// owned output index); keep is cleared for the outputs whose commitments don't open, which are
+	// ours but unspendable.
+	bool decode_pending_amounts(
+		std::vector<PendingTxAmounts> &pending_amounts,
+		const std::function<OwnedOutput &(size_t)> &output_at,
+		std::vector<bool> &keep, // one per owned output
+		std::string &err_string
+	);
+	// decode_pending_amounts, then the undecodable outputs are dropped from owned_outputs
+	template<typename T, typename OutputOf>
+	bool decode_owned_amounts(
+		std::vector<T> &owned_outputs,
+		std::vector<PendingTxAmounts> &pending_amounts,
+		OutputOf output_of, // OwnedOutput &(T &)
+		std::string &err_string
+	) {
+		if (pending_amounts.empty()) {
+			return true;
+		}
+		std::vector<bool> keep(owned_outputs.size(), true);
+		if (!decode_pending_amounts(pending_amounts, [&owned_outputs, &output_of] (size_t i) -> OwnedOutput & { return output_of(owned_outputs[i]); }, keep, err_string)) {
+			return false;
+		}
+		size_t kept = 0;
+		for (size_t i = 0; i < owned_outputs.size(); i++) {
+			if (keep[i]) {
+				if (kept != i) {
+					owned_outputs[kept] = std::move(owned_outputs[i]);
+				}
+				kept++;
+			}
+		}
+		owned_outputs.resize(kept);
+		return true;
+	}
+}
+//
+#endif /* monero_output_scanner_hpp */
@@ -0,0 +1,147 @@
+//
+//  monero_key_image_store.cpp
+//  Copyright (c) 2014-2019, MyMonero.com
+//
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are
+//  permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright notice, this list of
+//	conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list
+//	of conditions and the following disclaimer in the documentation and/or other
+//	materials provided with the distribution.
+//
+//  3. Neither the name of the copyright holder nor the names of its contributors may be
+//	used to endorse or promote products derived from this software without specific
+//	prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+//  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+//  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+//  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+//  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//
+#include "monero_rct_utils.hpp"
+#include "monero_key_derivation_cache.hpp"
+//
+#include <sstream>
+#include "ringct/rctOps.h"
+#include "ringct/multiexp.h"
+#include "memwipe.h"
+#include "misc_log_ex.h"
+//
+using namespace std;
+using namespace crypto;
+using namespace monero_rct_utils;
+//
+namespace
+{
+	struct DecodedCommitment
+	{
+		size_t tx_index;
+		size_t out_index; // into the tx's out_indices
+		rct::key C;
+	};
+	bool _commitment_opens(const rct::key &C, const DecodedAmount &decoded)
+	{ // same check as rct::decodeRct
+		rct::key Ctmp;
+		rct::addKeys2(Ctmp, decoded.mask, rct::d2h(decoded.amount), rct::H);
+		return rct::equalKeys(C, Ctmp);
+	}
+	bool _commitments_open(const vector<DecodedCommitment> &commitments, const DecodeAmountsRetVals &retVals)
+	{
+		vector<rct::MultiexpData> data;
+		data.reserve(commitments.size() + 2);
+		rct::key sum_masks = rct::zero();
+		rct::key sum_amounts = rct::zero();
+		for (const DecodedCommitment &commitment : commitments) {
+			const DecodedAmount &decoded = retVals.decoded[commitment.tx_index][commitment.out_index];
+			rct::key weight = rct::skGen();
+			sc_muladd(sum_masks.bytes, weight.bytes, decoded.mask.bytes, sum_masks.bytes);
+			sc_muladd(sum_amounts.bytes, weight.bytes, rct::d2h(decoded.amount).bytes, sum_amounts.bytes);
+			data.emplace_back(weight, commitment.C);
+		}
+		rct::key neg;
+		sc_sub(neg.bytes, rct::zero().bytes, sum_masks.bytes);
+		data.emplace_back(neg, rct::G);
+		sc_sub(neg.bytes, rct::zero().bytes, sum_amounts.bytes);
+		data.emplace_back(neg, rct::H);
+		//
+		return rct::equalKeys(rct::straus(data), rct::identity());
+	}
+}
+//
+bool monero_rct_utils::decode_amounts(
+	const vector<TxAmountsToDecode> &txs,
+	const crypto::secret_key &sec_viewKey,
+	DecodeAmountsRetVals &retVals
+) {
+	retVals = {};
+	retVals.decoded.resize(txs.size());
+	vector<DecodedCommitment> commitments;
+	for (size_t t = 0; t < txs.size(); t++) {
+		const TxAmountsToDecode &tx = txs[t];
+		vector<DecodedAmount> &decoded = retVals.decoded[t];
+		decoded.resize(tx.out_indices.size(), DecodedAmount{ true, 0, rct::zero() });
+		if (tx.rv.type == rct::RCTTypeNull) {
+			continue; // nothing to decode; every output stays in error
+		}
+		bool has_out_derivations = !tx.out_derivations.empty();
+		crypto::key_derivation derivation;
+		if (has_out_derivations) {
+			if (tx.out_derivations.size() != tx.out_indices.size()) {
+				continue; // malformed; every output stays in error
+			}
+		} else if (tx.derivation != boost::none) {
+			derivation = *tx.derivation;
+		} else if (!monero_key_derivation_cache::generate_key_derivation(tx.tx_pub_key, sec_viewKey, derivation)) {
+			retVals.did_error = true;
+			std::ostringstream ss{};
+			ss << "failed to generate_key_derivation(" << tx.tx_pub_key << ", <view key>)";
+			retVals.err_string = ss.str();
+			retVals.decoded.clear();
+			//
+			return false;
+		}
+		bool is_v2 = tx.rv.type == rct::RCTTypeBulletproof2;
+		for (size_t o = 0; o < tx.out_indices.size(); o++) {
+			uint64_t i = tx.out_indices[o];
+			if (i >= tx.rv.ecdhInfo.size() || i >= tx.rv.outPk.size()) {
+				continue;
+			}
+			rct::key sk;
+			crypto::derivation_to_scalar(has_out_derivations ? tx.out_derivations[o] : derivation, i, (crypto::ec_scalar &)sk);
+			rct::ecdhTuple ecdh_info = tx.rv.ecdhInfo[i];
+			rct::ecdhDecode(ecdh_info, sk, is_v2);
+			memwipe(&sk, sizeof(sk));
+			decoded[o] = DecodedAmount{ false, rct::h2d(ecdh_info.amount), ecdh_info.mask };
+			commitments.push_back(DecodedCommitment{ t, o, tx.rv.outPk[i].mask });
+		}
+		memwipe(&derivation, sizeof(derivation));
+	}
+	bool all_open = false;
+	if (commitments.size() > 1) {
+		try {
+			all_open = _commitments_open(commitments, retVals);
+		} catch (const std::exception &e) { // e.g. a commitment which isn't a point
+			LOG_PRINT_L0("monero_rct_utils: batched commitment check: " << e.what());
+		}
+	}
+	if (!all_open) {
+		for (const DecodedCommitment &commitment : commitments) {
+			DecodedAmount &decoded = retVals.decoded[commitment.tx_index][commitment.out_index];
+			if (!_commitment_opens(commitment.C, decoded)) {
+				decoded = DecodedAmount{ true, 0, rct::zero() };
+			}
+		}
+	}
+	return true;
+}
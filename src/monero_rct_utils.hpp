@@ -0,0 +1,76 @@
+//
+//  monero_rct_utils.hpp
+//  Copyright (c) 2014-2019, MyMonero.com
+//
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are
+//  permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright notice, this list of
+//	conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list
+//	of conditions and the following disclaimer in the documentation and/or other
+//	materials provided with the distribution.
+//
+//  3. Neither the name of the copyright holder nor the names of its contributors may be
+//	used to endorse or promote products derived from this software without specific
+//	prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+//  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+//  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+//  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+//  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//
+#ifndef monero_rct_utils_hpp
+#define monero_rct_utils_hpp
+//
+#include <vector>
+#include <boost/optional.hpp>
+#include "crypto.h"
+#include "ringct/rctTypes.h"
+//
+using namespace tools;
+#include "tools__ret_vals.hpp"
+//
+namespace monero_rct_utils
+{
+	// Batch counterpart of rct::decodeRct/decodeRctSimple for refreshing received outputs: each
+	// tx's rct data is handed over once for all of its outputs, derivations come from
+	// monero_key_derivation_cache when only the tx pub key is given, and the decoded
+	// commitments are checked together with one multiexponentiation (a random linear combination
+	// of sum(w*C) == sum(w*mask)*G + sum(w*amount)*H). A batch which fails that check is
+	// re-checked output by output only to find the culprits.
+	struct TxAmountsToDecode
+	{
+		rct::rctSig rv; // only type, ecdhInfo and outPk are read
+		boost::optional<crypto::key_derivation> derivation; // when none, generated from tx_pub_key and the view key
+		crypto::public_key tx_pub_key;
+		std::vector<uint64_t> out_indices;
+		std::vector<crypto::key_derivation> out_derivations; // optl: one per out_index, e.g. some from additional tx pub keys; overrides derivation
+	};
+	struct DecodedAmount
+	{
+		bool did_error; // no ecdhInfo for the index, or the commitment didn't open to the decoded amount
+		rct::xmr_amount amount;
+		rct::key mask;
+	};
+	struct DecodeAmountsRetVals: RetVals_base
+	{
+		std::vector<std::vector<DecodedAmount>> decoded; // per tx, per out_index
+	};
+	bool decode_amounts(
+		const std::vector<TxAmountsToDecode> &txs,
+		const crypto::secret_key &sec_viewKey, // only used for txs without a derivation
+		DecodeAmountsRetVals &retVals
+	);
+}
+//
+#endif /* monero_rct_utils_hpp */
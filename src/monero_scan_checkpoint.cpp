@@ -0,0 +1,423 @@
+//
+//  monero_key_image_store.cpp
+//  Copyright (c) 2014-2019, MyMonero.com
+//
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are
+//  permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright notice, this list of
+//	conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list
+//	of conditions and the following disclaimer in the documentation and/or other
+//	materials provided with the distribution.
+//
+//  3. Neither the name of the copyright holder nor the names of its contributors may be
+//	used to endorse or promote products derived from this software without specific
+//	prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+//  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+//  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+//  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+//  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//
+#include "monero_scan_checkpoint.hpp"
+//
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "memwipe.h"
+#include "monero_scan_serialization.hpp"
+//
+using namespace std;
+using namespace crypto;
+using namespace monero_output_scanner;
+using namespace monero_scan_checkpoint;
+using namespace monero_scan_serialization;
+//
+namespace
+{
+	// File layout: a header of magic followed by an account check value, then records of a
+	// little endian uint32 payload size, a type byte, the payload and a checksum.
+	const uint8_t file_magic[8] = { 'M', 'M', 'S', 'C', 'P', 0, 0, 1 }; // last byte is the version
+	const size_t header_size = 32;
+	const size_t record_overhead = 4 + 1 + 8;
+	const uint64_t min_compaction_size = 64 * 1024;
+	enum RecordType: uint8_t
+	{
+		snapshot_record = 'S',
+		delta_record = 'D',
+		rewind_record = 'R'
+	};
+	//
+	const size_t output_size = owned_output_with_key_image_size + 8;
+	void _write_outputs(Writer &w, const vector<Output> &outputs)
+	{
+		w.u64(outputs.size());
+		for (const Output &o : outputs) {
+			write_owned_output(w, o.output, true);
+			w.u64(o.global_index);
+		}
+	}
+	bool _read_outputs(Reader &r, vector<Output> &outputs)
+	{
+		uint64_t n;
+		if (!r.count(n, output_size)) {
+			return false;
+		}
+		outputs.resize(n);
+		for (Output &o : outputs) {
+			read_owned_output(r, o.output, true);
+			o.global_index = r.u64();
+		}
+		return r.ok;
+	}
+	//
+	void _checksum(const void *record, size_t size, uint8_t *out) // over size, type and payload
+	{
+		crypto::hash h;
+		crypto::cn_fast_hash(record, size, h);
+		memcpy(out, &h, 8);
+	}
+	string _record(uint8_t type, const string &payload)
+	{
+		Writer w;
+		w.u32((uint32_t)payload.size());
+		w.u8(type);
+		w.buf.append(payload);
+		uint8_t checksum[8];
+		_checksum(w.buf.data(), w.buf.size(), checksum);
+		w.buf.append(reinterpret_cast<const char *>(checksum), sizeof(checksum));
+		return w.buf;
+	}
+	string _snapshot_payload(const State &state)
+	{
+		Writer w;
+		w.u64(state.start_height);
+		w.u64(state.height);
+		write_pods(w, state.recent_block_hashes.begin(), state.recent_block_hashes.end());
+		_write_outputs(w, state.outputs);
+		write_spent_key_images(w, state.spent_key_images);
+		return w.buf;
+	}
+	//
+	// State changes, shared by appending and replaying
+	void _extend(State &state, uint64_t end_height, const vector<crypto::hash> &trailing_block_hashes, const vector<Output> &outputs, const vector<SpentKeyImage> &spends)
+	{
+		if (trailing_block_hashes.size() < end_height - state.height) { // the kept hashes no longer connect
+			state.recent_block_hashes.clear();
+		}
+		state.recent_block_hashes.insert(state.recent_block_hashes.end(), trailing_block_hashes.begin(), trailing_block_hashes.end());
+		while (state.recent_block_hashes.size() > max_reorg_depth) {
+			state.recent_block_hashes.pop_front();
+		}
+		state.height = end_height;
+		state.outputs.insert(state.outputs.end(), outputs.begin(), outputs.end());
+		state.spent_key_images.insert(state.spent_key_images.end(), spends.begin(), spends.end());
+	}
+	bool _can_rewind(const State &state, uint64_t height)
+	{
+		return height == state.start_height
+			|| (height <= state.height && height > state.height - state.recent_block_hashes.size());
+	}
+	void _rewind(State &state, uint64_t height)
+	{
+		state.recent_block_hashes.resize(state.recent_block_hashes.size() - std::min<uint64_t>(state.height - height, state.recent_block_hashes.size()));
+		state.height = height;
+		state.outputs.erase(std::find_if(state.outputs.begin(), state.outputs.end(), [height] (const Output &o) { return o.output.height >= height; }), state.outputs.end());
+		state.spent_key_images.erase(std::find_if(state.spent_key_images.begin(), state.spent_key_images.end(), [height] (const SpentKeyImage &s) { return s.height >= height; }), state.spent_key_images.end());
+	}
+	bool _replay(State &state, uint8_t type, Reader &r)
+	{
+		if (type == snapshot_record) {
+			State snapshot;
+			snapshot.start_height = r.u64();
+			snapshot.height = r.u64();
+			vector<crypto::hash> hashes;
+			if (!read_pods(r, hashes) || !_read_outputs(r, snapshot.outputs) || !read_spent_key_images(r, snapshot.spent_key_images) || !r.done()) {
+				return false;
+			}
+			snapshot.recent_block_hashes.assign(hashes.begin(), hashes.end());
+			state = std::move(snapshot);
+			return true;
+		}
+		if (type == delta_record) {
+			uint64_t start_height = r.u64();
+			uint64_t end_height = r.u64();
+			vector<crypto::hash> hashes;
+			vector<Output> outputs;
+			vector<SpentKeyImage> spends;
+			if (!read_pods(r, hashes) || !_read_outputs(r, outputs) || !read_spent_key_images(r, spends) || !r.done() || end_height <= start_height) {
+				return false;
+			}
+			if (state.height == state.start_height) {
+				state.start_height = state.height = start_height;
+			}
+			if (start_height != state.height) {
+				return false;
+			}
+			_extend(state, end_height, hashes, outputs, spends);
+			return true;
+		}
+		if (type == rewind_record) {
+			uint64_t height = r.u64();
+			if (!r.done() || !_can_rewind(state, height)) {
+				return false;
+			}
+			_rewind(state, height);
+			return true;
+		}
+		return false;
+	}
+	//
+	void _account_header(const crypto::secret_key &sec_viewKey, const crypto::public_key &pub_spendKey, uint8_t *header)
+	{
+		static const char prefix[] = "mymonero scan checkpoint";
+		unsigned char buf[sizeof(prefix) + sizeof(crypto::secret_key) + sizeof(crypto::public_key)];
+		memcpy(buf, prefix, sizeof(prefix));
+		memcpy(buf + sizeof(prefix), &sec_viewKey, sizeof(crypto::secret_key));
+		memcpy(buf + sizeof(prefix) + sizeof(crypto::secret_key), &pub_spendKey, sizeof(crypto::public_key));
+		crypto::hash check;
+		crypto::cn_fast_hash(buf, sizeof(buf), check);
+		memwipe(buf, sizeof(buf));
+		memcpy(header, file_magic, sizeof(file_magic));
+		memcpy(header + sizeof(file_magic), &check, header_size - sizeof(file_magic));
+	}
+	bool _write_all(int fd, const string &data, uint64_t offset)
+	{
+		size_t written = 0;
+		while (written < data.size()) {
+			ssize_t n = pwrite(fd, data.data() + written, data.size() - written, offset + written);
+			if (n <= 0) {
+				return false;
+			}
+			written += n;
+		}
+		return true;
+	}
+	bool _fsync_directory_of(const string &path)
+	{
+		size_t slash = path.find_last_of('/');
+		string directory = slash == string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+		int fd = ::open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) {
+			return false;
+		}
+		bool r = fsync(fd) == 0;
+		::close(fd);
+		return r;
+	}
+}
+//
+CheckpointFile::~CheckpointFile()
+{
+	if (m_fd >= 0) {
+		::close(m_fd); // also releases the flock
+	}
+}
+vector<crypto::key_image> CheckpointFile::known_key_images() const
+{
+	vector<crypto::key_image> key_images;
+	for (const Output &o : m_state.outputs) {
+		if (o.output.key_image != boost::none) {
+			key_images.push_back(*o.output.key_image);
+		}
+	}
+	return key_images;
+}
+//
+bool CheckpointFile::_append_record(uint8_t type, const string &payload, string &err_string)
+{
+	string record = _record(type, payload);
+	if (!_write_all(m_fd, record, m_end_offset) || fdatasync(m_fd) != 0) {
+		ftruncate(m_fd, m_end_offset); // best effort; the next open drops it anyway
+		err_string = "Failed to write scan checkpoint";
+		return false;
+	}
+	m_end_offset += record.size();
+	m_deltas_size += record.size();
+	return true;
+}
+bool CheckpointFile::append(const Delta &delta, string &err_string)
+{
+	bool is_first = m_state.height == m_state.start_height;
+	if (delta.block_hashes.empty()) {
+		err_string = "Scan checkpoint delta has no blocks";
+		return false;
+	}
+	if (!is_first && (delta.start_height != m_state.height || m_state.recent_block_hashes.empty() || delta.prev_block_hash != m_state.recent_block_hashes.back())) {
+		err_string = "Scan checkpoint delta doesn't extend the checkpoint";
+		return false;
+	}
+	uint64_t end_height = delta.start_height + delta.block_hashes.size();
+	size_t n_kept = std::min(delta.block_hashes.size(), max_reorg_depth);
+	vector<crypto::hash> trailing_block_hashes(delta.block_hashes.end() - n_kept, delta.block_hashes.end());
+	//
+	Writer w;
+	w.u64(delta.start_height);
+	w.u64(end_height);
+	write_pods(w, trailing_block_hashes.begin(), trailing_block_hashes.end());
+	_write_outputs(w, delta.outputs);
+	write_spent_key_images(w, delta.spent_key_images);
+	if (!_append_record(delta_record, w.buf, err_string)) {
+		return false;
+	}
+	if (is_first) {
+		m_state.start_height = m_state.height = delta.start_height;
+	}
+	_extend(m_state, end_height, trailing_block_hashes, delta.outputs, delta.spent_key_images);
+	if (m_deltas_size > std::max(m_snapshot_size, min_compaction_size)) {
+		string compact_err_string;
+		compact(compact_err_string); // the delta is durable either way; compaction is retried on the next append
+	}
+	return true;
+}
+uint64_t CheckpointFile::fork_height(uint64_t start_height, const vector<crypto::hash> &chain_block_hashes) const
+{
+	uint64_t kept_start_height = m_state.height - m_state.recent_block_hashes.size();
+	uint64_t overlap_end_height = std::min(m_state.height, start_height + chain_block_hashes.size());
+	for (uint64_t height = std::max(start_height, kept_start_height); height < overlap_end_height; height++) {
+		if (m_state.recent_block_hashes[height - kept_start_height] != chain_block_hashes[height - start_height]) {
+			return height;
+		}
+	}
+	return overlap_end_height;
+}
+bool CheckpointFile::rewind(uint64_t height, string &err_string)
+{
+	if (height == m_state.height) {
+		return true;
+	}
+	if (!_can_rewind(m_state, height)) {
+		err_string = "Reorg is deeper than the scan checkpoint keeps; rescan instead";
+		return false;
+	}
+	Writer w;
+	w.u64(height);
+	if (!_append_record(rewind_record, w.buf, err_string)) {
+		return false;
+	}
+	_rewind(m_state, height);
+	return true;
+}
+bool CheckpointFile::compact(string &err_string)
+{
+	string temporary_path = m_path + ".tmp";
+	int fd = ::open(temporary_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd < 0) {
+		err_string = "Failed to create " + temporary_path;
+		return false;
+	}
+	string record = _record(snapshot_record, _snapshot_payload(m_state));
+	bool r = flock(fd, LOCK_EX | LOCK_NB) == 0 // held before it's visible under m_path
+		&& _write_all(fd, string(reinterpret_cast<const char *>(m_header), header_size), 0)
+		&& _write_all(fd, record, header_size)
+		&& fsync(fd) == 0
+		&& rename(temporary_path.c_str(), m_path.c_str()) == 0;
+	if (!r) {
+		::close(fd);
+		unlink(temporary_path.c_str());
+		err_string = "Failed to compact scan checkpoint";
+		return false;
+	}
+	_fsync_directory_of(m_path);
+	::close(m_fd);
+	m_fd = fd;
+	m_end_offset = header_size + record.size();
+	m_snapshot_size = record.size();
+	m_deltas_size = 0;
+	return true;
+}
+//
+bool monero_scan_checkpoint::new__checkpoint_file(
+	const string &path,
+	const crypto::secret_key &sec_viewKey,
+	const crypto::public_key &pub_spendKey,
+	std::unique_ptr<CheckpointFile> &file,
+	string &err_string
+) {
+	std::unique_ptr<CheckpointFile> opened(new CheckpointFile);
+	opened->m_path = path;
+	_account_header(sec_viewKey, pub_spendKey, opened->m_header);
+	opened->m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (opened->m_fd < 0) {
+		err_string = "Failed to open scan checkpoint " + path;
+		return false;
+	}
+	if (flock(opened->m_fd, LOCK_EX | LOCK_NB) != 0) {
+		err_string = "Scan checkpoint is in use by another process";
+		return false;
+	}
+	struct stat st;
+	if (fstat(opened->m_fd, &st) != 0) {
+		err_string = "Failed to open scan checkpoint " + path;
+		return false;
+	}
+	uint64_t file_size = (uint64_t)st.st_size;
+	if (file_size < header_size) { // new, or the header write was torn
+		if (ftruncate(opened->m_fd, 0) != 0
+			|| !_write_all(opened->m_fd, string(reinterpret_cast<const char *>(opened->m_header), header_size), 0)
+			|| fsync(opened->m_fd) != 0) {
+			err_string = "Failed to create scan checkpoint " + path;
+			return false;
+		}
+		file_size = header_size;
+	}
+	void *mapped = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, opened->m_fd, 0);
+	if (mapped == MAP_FAILED) {
+		err_string = "Failed to map scan checkpoint " + path;
+		return false;
+	}
+	const uint8_t *bytes = static_cast<const uint8_t *>(mapped);
+	if (memcmp(bytes, opened->m_header, header_size) != 0) {
+		munmap(mapped, file_size);
+		err_string = "Scan checkpoint belongs to another account or version";
+		return false;
+	}
+	uint64_t offset = header_size;
+	while (file_size - offset >= record_overhead) {
+		Reader header(bytes + offset, 5);
+		uint32_t payload_size = header.u32();
+		uint8_t type = header.u8();
+		uint64_t record_size = record_overhead + payload_size;
+		if (file_size - offset < record_size) {
+			break;
+		}
+		uint8_t checksum[8];
+		_checksum(bytes + offset, record_size - 8, checksum);
+		if (memcmp(checksum, bytes + offset + record_size - 8, 8) != 0) {
+			break; // everything from a torn append onwards is dropped
+		}
+		Reader r(bytes + offset + 5, payload_size);
+		if (!_replay(opened->m_state, type, r)) {
+			break;
+		}
+		if (type == snapshot_record) {
+			opened->m_snapshot_size = record_size;
+			opened->m_deltas_size = 0;
+		} else {
+			opened->m_deltas_size += record_size;
+		}
+		offset += record_size;
+	}
+	munmap(mapped, file_size);
+	opened->m_end_offset = offset;
+	if (file_size != offset && ftruncate(opened->m_fd, offset) != 0) { // cut the torn tail so appends follow the last good record
+		err_string = "Failed to repair scan checkpoint " + path;
+		return false;
+	}
+	file = std::move(opened);
+	return true;
+}
@@ -0,0 +1,126 @@
+//
+//  monero_scan_checkpoint.hpp
+//  Copyright (c) 2014-2019, MyMonero.com
+//
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are
+//  permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright notice, this list of
+//	conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list
+//	of conditions and the following disclaimer in the documentation and/or other
+//	materials provided with the distribution.
+//
+//  3. Neither the name of the copyright holder nor the names of its contributors may be
+//	used to endorse or promote products derived from this software without specific
+//	prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+//  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+//  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+//  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+//  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//
+#ifndef monero_scan_checkpoint_hpp
+#define monero_scan_checkpoint_hpp
+//
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include "crypto.h"
+#include "monero_output_scanner.hpp"
+//
+namespace monero_scan_checkpoint
+{
+	// Persisted scan state, so a restarted scanner resumes where it stopped instead of at the
+	// restore height. A checkpoint file starts with a header (magic and an account check value)
+	// followed by checksummed records: a snapshot of the whole state, then the deltas appended by
+	// each scan and the rewinds done for reorgs. Every append is fsync'd and a torn record is
+	// dropped (and cut off) on the next open, so each delta lands entirely or not at all. Once the
+	// deltas outweigh the snapshot the file is compacted into a new snapshot, written to a
+	// temporary file and renamed over the old one. Loading maps the file and replays its records.
+	//
+	// The hashes of the last max_reorg_depth scanned blocks are kept, so that a reorg only rewinds
+	// to its fork point. The file isn't encrypted; it's as sensitive as the outputs it lists.
+	static const uint64_t unknown_global_index = UINT64_MAX;
+	static const size_t max_reorg_depth = 720; // blocks
+	//
+	struct Output
+	{
+		monero_output_scanner::OwnedOutput output;
+		uint64_t global_index; // or unknown_global_index
+	};
+	struct State
+	{
+		uint64_t start_height = 0; // of the first scan
+		uint64_t height = 0; // next height to scan; equal to start_height before any scan
+		std::deque<crypto::hash> recent_block_hashes; // of [height - size, height); back() is the tip
+		std::vector<Output> outputs; // in chain order
+		std::vector<monero_output_scanner::SpentKeyImage> spent_key_images; // in chain order
+	};
+	struct Delta // one scan's worth
+	{
+		uint64_t start_height; // must be the state's height, unless nothing was scanned yet
+		crypto::hash prev_block_hash; // prev_id of the block at start_height; checked against the tip
+		std::vector<crypto::hash> block_hashes; // of [start_height, end_height), at least one
+		std::vector<Output> outputs;
+		std::vector<monero_output_scanner::SpentKeyImage> spent_key_images;
+	};
+	//
+	class CheckpointFile
+	{
+	public:
+		~CheckpointFile();
+		//
+		const State &state() const { return m_state; }
+		std::vector<crypto::key_image> known_key_images() const; // of outputs with a key image; for ScanAccount
+		//
+		// Fails, changing nothing, when the delta doesn't extend the tip; find the fork then
+		bool append(const Delta &delta, std::string &err_string);
+		// chain_block_hashes are the chain's hashes from start_height on. Returns the first height
+		// whose kept hash differs from the chain's, or the end of the overlap when none does.
+		uint64_t fork_height(uint64_t start_height, const std::vector<crypto::hash> &chain_block_hashes) const;
+		// Drops everything at and above height; fails when that's deeper than the kept hashes
+		// (other than all the way back to start_height), in which case a rescan is needed
+		bool rewind(uint64_t height, std::string &err_string);
+		bool compact(std::string &err_string); // also done by append once the deltas outweigh the snapshot
+	private:
+		friend bool new__checkpoint_file(
+			const std::string &path,
+			const crypto::secret_key &sec_viewKey,
+			const crypto::public_key &pub_spendKey,
+			std::unique_ptr<CheckpointFile> &file,
+			std::string &err_string
+		);
+		CheckpointFile() {}
+		bool _append_record(uint8_t type, const std::string &payload, std::string &err_string);
+		//
+		std::string m_path;
+		int m_fd = -1;
+		uint8_t m_header[32];
+		uint64_t m_end_offset = 0;
+		uint64_t m_snapshot_size = 0;
+		uint64_t m_deltas_size = 0; // bytes of records after the snapshot
+		State m_state;
+	};
+	// Opens (and locks) the account's checkpoint file at path, creating an empty one if needed.
+	// Fails when another process has it open or it belongs to another account.
+	bool new__checkpoint_file(
+		const std::string &path,
+		const crypto::secret_key &sec_viewKey,
+		const crypto::public_key &pub_spendKey,
+		std::unique_ptr<CheckpointFile> &file,
+		std::string &err_string
+	);
+}
+//
+#endif /* monero_scan_checkpoint_hpp */
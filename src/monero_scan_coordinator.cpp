@@ -0,0 +1,687 @@
+//
+//  monero_key_image_store.cpp
+//  Copyright (c) 2014-2019, MyMonero.com
+//
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are
+//  permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright notice, this list of
+//	conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list
+//	of conditions and the following disclaimer in the documentation and/or other
+//	materials provided with the distribution.
+//
+//  3. Neither the name of the copyright holder nor the names of its contributors may be
+//	used to endorse or promote products derived from this software without specific
+//	prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+//  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+//  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+//  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+//  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//
+#include "monero_scan_coordinator.hpp"
+#include "monero_key_image_store.hpp"
+#include "monero_scan_serialization.hpp"
+//
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <limits>
+#include <unordered_set>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <dirent.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "memwipe.h"
+#include "misc_log_ex.h"
+//
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // e.g. macOS, where SO_NOSIGPIPE is set on each socket instead
+#endif
+//
+using namespace std;
+using namespace crypto;
+using namespace cryptonote;
+using namespace monero_output_scanner;
+using namespace monero_scan_coordinator;
+using namespace monero_scan_serialization;
+//
+namespace
+{
+	// Wire format: messages are a little endian uint32 length, then a type byte and its payload,
+	// laid out with monero_scan_serialization.
+	enum MessageType: uint8_t
+	{
+		scan_chunk = 1, // chunk_id, start, end, sec_viewKey, pub_spendKey, known key images
+		match_spends = 2, // chunk_id, start, end, watched key images
+		chunk_result = 3 // chunk_id, ok, then an error string or a ChunkResult
+	};
+	const uint32_t max_message_size = 256 * 1024 * 1024;
+	typedef std::chrono::steady_clock Clock;
+	//
+	void _write_result(Writer &w, const ChunkResult &result)
+	{
+		w.u64(result.start_height);
+		w.u64(result.end_height);
+		w.u64(result.checkpoint.height);
+		w.pod(result.checkpoint.block_hash);
+		w.u64(result.owned_outputs.size());
+		for (const OwnedOutput &output : result.owned_outputs) {
+			write_owned_output(w, output, false); // key images are never computed by workers
+		}
+		write_spent_key_images(w, result.spent_key_images);
+	}
+	bool _read_result(Reader &r, ChunkResult &result)
+	{
+		result.start_height = r.u64();
+		result.end_height = r.u64();
+		result.checkpoint.height = r.u64();
+		r.pod(result.checkpoint.block_hash);
+		uint64_t n;
+		if (!r.count(n, owned_output_size)) {
+			return false;
+		}
+		result.owned_outputs.resize(n);
+		for (OwnedOutput &output : result.owned_outputs) {
+			read_owned_output(r, output, false);
+		}
+		return read_spent_key_images(r, result.spent_key_images);
+	}
+	//
+	// Socket I/O
+	void _configure_socket(int fd)
+	{
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#ifdef SO_NOSIGPIPE
+		setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+	}
+	bool _write_all(int fd, const char *data, size_t size)
+	{
+		while (size > 0) {
+			ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+			if (n < 0 && errno == EINTR) {
+				continue;
+			}
+			if (n <= 0) {
+				return false;
+			}
+			data += n;
+			size -= n;
+		}
+		return true;
+	}
+	bool _read_all(int fd, char *data, size_t size, Clock::time_point deadline) // fails once deadline passes, unless it's max
+	{
+		while (size > 0) {
+			if (deadline != Clock::time_point::max()) { // so a peer that sends part of a message and stalls can't block this
+				int64_t remaining_ms = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+				if (remaining_ms <= 0) {
+					return false;
+				}
+				pollfd readable{ fd, POLLIN, 0 };
+				int r = poll(&readable, 1, (int)std::min<int64_t>(remaining_ms, std::numeric_limits<int>::max()));
+				if (r < 0 && errno == EINTR) {
+					continue;
+				}
+				if (r <= 0) {
+					return false;
+				}
+			}
+			ssize_t n = recv(fd, data, size, 0);
+			if (n < 0 && errno == EINTR) {
+				continue;
+			}
+			if (n <= 0) {
+				return false;
+			}
+			data += n;
+			size -= n;
+		}
+		return true;
+	}
+	bool _send_message(int fd, MessageType type, const string &payload)
+	{
+		Writer header;
+		header.u32((uint32_t)payload.size() + 1);
+		header.u8(type);
+		return _write_all(fd, header.buf.data(), header.buf.size())
+			&& _write_all(fd, payload.data(), payload.size());
+	}
+	bool _receive_message(int fd, uint8_t &type, string &payload, Clock::time_point deadline = Clock::time_point::max())
+	{
+		string header(5, '\0');
+		if (!_read_all(fd, &header[0], header.size(), deadline)) {
+			return false;
+		}
+		Reader r(header);
+		uint32_t size = r.u32();
+		type = r.u8();
+		if (size == 0 || size > max_message_size) {
+			return false;
+		}
+		payload.assign(size - 1, '\0');
+		return size == 1 || _read_all(fd, &payload[0], payload.size(), deadline);
+	}
+	int _connect(const Endpoint &endpoint)
+	{
+		addrinfo hints{};
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		addrinfo *addrs = nullptr;
+		if (getaddrinfo(endpoint.host.c_str(), std::to_string(endpoint.port).c_str(), &hints, &addrs) != 0) {
+			return -1;
+		}
+		int fd = -1;
+		for (addrinfo *addr = addrs; addr != nullptr && fd < 0; addr = addr->ai_next) {
+			fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+			if (fd >= 0 && connect(fd, addr->ai_addr, addr->ai_addrlen) != 0) {
+				close(fd);
+				fd = -1;
+			}
+		}
+		freeaddrinfo(addrs);
+		if (fd >= 0) {
+			_configure_socket(fd);
+		}
+		return fd;
+	}
+	//
+	// Worker side
+	bool _blocks(const BlockSource &source, uint64_t start_height, uint64_t end_height, vector<block_complete_entry> &blocks, string &err_string)
+	{
+		if (!source(start_height, end_height, blocks, err_string)) {
+			return false;
+		}
+		if (blocks.size() != end_height - start_height) {
+			err_string = "Block source returned the wrong number of blocks";
+			return false;
+		}
+		return true;
+	}
+	bool _checkpoint(const block_complete_entry &last, uint64_t end_height, Checkpoint &checkpoint, string &err_string)
+	{
+		block block;
+		if (!parse_and_validate_block_from_blob(last.block, block)) {
+			err_string = "Failed to parse block blob";
+			return false;
+		}
+		checkpoint = Checkpoint{ end_height, get_block_hash(block) };
+		return true;
+	}
+	bool _scan_chunk(const BlockSource &source, uint64_t start_height, uint64_t end_height, const ScanAccount &account, ChunkResult &result, string &err_string)
+	{
+		vector<block_complete_entry> blocks;
+		if (!_blocks(source, start_height, end_height, blocks, err_string)) {
+			return false;
+		}
+		ScanRetVals scan_retVals;
+		if (!scan_blocks(blocks, account, scan_retVals)) {
+			err_string = *scan_retVals.err_string;
+			return false;
+		}
+		if (scan_retVals.start_height != start_height || scan_retVals.end_height != end_height) {
+			err_string = "Block source returned blocks of other heights";
+			return false;
+		}
+		result.start_height = start_height;
+		result.end_height = end_height;
+		result.owned_outputs = std::move(scan_retVals.owned_outputs);
+		result.spent_key_images = std::move(scan_retVals.spent_key_images);
+		return _checkpoint(blocks.back(), end_height, result.checkpoint, err_string);
+	}
+	bool _match_spends(const BlockSource &source, uint64_t start_height, uint64_t end_height, const unordered_set<crypto::key_image> &watched, ChunkResult &result, string &err_string)
+	{
+		vector<block_complete_entry> blocks;
+		if (!_blocks(source, start_height, end_height, blocks, err_string)) {
+			return false;
+		}
+		result.start_height = start_height;
+		result.end_height = end_height;
+		for (size_t b = 0; b < blocks.size(); b++) {
+			block block;
+			if (!parse_and_validate_block_from_blob(blocks[b].block, block)) {
+				err_string = "Failed to parse block blob at index " + std::to_string(b);
+				return false;
+			}
+			bool has_tx_hashes = block.tx_hashes.size() == blocks[b].txs.size();
+			for (size_t t = 0; t < blocks[b].txs.size(); t++) {
+				transaction tx;
+				if (!parse_and_validate_tx_base_from_blob(blocks[b].txs[t], tx)) { // only the inputs are needed
+					err_string = "Failed to parse tx blob at index " + std::to_string(t) + " of block index " + std::to_string(b);
+					return false;
+				}
+				for (const txin_v &in : tx.vin) {
+					if (in.type() == typeid(txin_to_key) && watched.find(boost::get<txin_to_key>(in).k_image) != watched.end()) {
+						result.spent_key_images.push_back(SpentKeyImage{
+							start_height + b,
+							has_tx_hashes ? block.tx_hashes[t] : get_transaction_hash(tx),
+							boost::get<txin_to_key>(in).k_image
+						});
+					}
+				}
+			}
+		}
+		return _checkpoint(blocks.back(), end_height, result.checkpoint, err_string);
+	}
+	void _serve_connection(int fd, const BlockSource &source)
+	{
+		uint8_t type;
+		string payload;
+		while (_receive_message(fd, type, payload)) {
+			Reader r(payload);
+			uint32_t chunk_id = r.u32();
+			uint64_t start_height = r.u64();
+			uint64_t end_height = r.u64();
+			bool ok = r.ok && start_height < end_height;
+			string err_string = "Malformed request";
+			ChunkResult result{};
+			if (ok && type == scan_chunk) {
+				ScanAccount account{};
+				r.pod(account.sec_viewKey);
+				r.pod(account.pub_spendKey);
+				ok = read_pods(r, account.known_key_images) && r.done()
+					&& _scan_chunk(source, start_height, end_height, account, result, err_string);
+				memwipe(&account.sec_viewKey, sizeof(account.sec_viewKey));
+			} else if (ok && type == match_spends) {
+				vector<crypto::key_image> watched;
+				ok = read_pods(r, watched) && r.done()
+					&& _match_spends(source, start_height, end_height, unordered_set<crypto::key_image>(watched.begin(), watched.end()), result, err_string);
+			} else {
+				ok = false;
+			}
+			memwipe(&payload[0], payload.size());
+			Writer w;
+			w.u32(chunk_id);
+			w.u8(ok);
+			if (ok) {
+				_write_result(w, result);
+			} else {
+				w.str(err_string);
+			}
+			if (!_send_message(fd, chunk_result, w.buf)) {
+				return;
+			}
+		}
+	}
+	//
+	// Coordinator side
+	struct Chunk
+	{
+		uint64_t start_height;
+		uint64_t end_height;
+	};
+	bool _run_round(
+		const vector<Endpoint> &workers,
+		MessageType type,
+		const vector<size_t> &chunk_indices,
+		const std::function<string(size_t)> &payload_for, // by chunk index; starts with chunk_id, start, end
+		uint64_t chunk_timeout_ms,
+		vector<ChunkResult> &results,
+		string &err_string
+	) {
+		if (chunk_indices.empty()) {
+			return true;
+		}
+		struct Connection
+		{
+			int fd;
+			bool is_busy;
+			size_t chunk;
+			Clock::time_point deadline; // while busy
+		};
+		vector<Connection> connections;
+		for (const Endpoint &endpoint : workers) {
+			int fd = _connect(endpoint);
+			if (fd < 0) {
+				LOG_PRINT_L0("monero_scan_coordinator: unable to connect to " << endpoint.host << ":" << endpoint.port);
+				continue;
+			}
+			connections.push_back(Connection{ fd, false, 0, Clock::time_point() });
+		}
+		auto close_all = [&connections] () {
+			for (Connection &connection : connections) {
+				if (connection.fd >= 0) {
+					close(connection.fd);
+					connection.fd = -1;
+				}
+			}
+		};
+		std::deque<size_t> queue(chunk_indices.begin(), chunk_indices.end());
+		size_t remaining = chunk_indices.size();
+		while (remaining > 0) {
+			size_t n_live = 0;
+			for (Connection &connection : connections) {
+				if (connection.fd >= 0 && !connection.is_busy && !queue.empty()) {
+					size_t chunk = queue.front();
+					if (_send_message(connection.fd, type, payload_for(chunk))) {
+						connection.is_busy = true;
+						connection.chunk = chunk;
+						connection.deadline = Clock::now() + std::chrono::milliseconds(chunk_timeout_ms);
+						queue.pop_front();
+					} else {
+						close(connection.fd);
+						connection.fd = -1;
+					}
+				}
+				n_live += connection.fd >= 0;
+			}
+			if (n_live == 0) {
+				err_string = "No scan workers left to scan with";
+				return false;
+			}
+			vector<pollfd> pollfds;
+			vector<size_t> polled;
+			Clock::time_point now = Clock::now();
+			Clock::time_point next_deadline = Clock::time_point::max();
+			bool did_time_out = false;
+			for (size_t i = 0; i < connections.size(); i++) {
+				Connection &connection = connections[i];
+				if (connection.fd < 0 || !connection.is_busy) {
+					continue;
+				}
+				if (connection.deadline <= now) { // stuck or far too slow; its reply could no longer be told apart, so drop it
+					LOG_PRINT_L0("monero_scan_coordinator: chunk " << connection.chunk << " timed out; requeueing it");
+					close(connection.fd);
+					connection.fd = -1;
+					connection.is_busy = false;
+					queue.push_front(connection.chunk);
+					did_time_out = true;
+					continue;
+				}
+				next_deadline = std::min(next_deadline, connection.deadline);
+				pollfds.push_back(pollfd{ connection.fd, POLLIN, 0 });
+				polled.push_back(i);
+			}
+			if (did_time_out) { // hand those chunks out again first
+				continue;
+			}
+			int timeout_ms = (int)std::min<int64_t>(
+				std::chrono::duration_cast<std::chrono::milliseconds>(next_deadline - now).count() + 1, // round up, so the deadline has passed on wakeup
+				std::numeric_limits<int>::max()
+			);
+			if (poll(pollfds.data(), pollfds.size(), timeout_ms) < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				err_string = "poll failed";
+				close_all();
+				return false;
+			}
+			for (size_t p = 0; p < pollfds.size(); p++) {
+				if (pollfds[p].revents == 0) {
+					continue;
+				}
+				Connection &connection = connections[polled[p]];
+				uint8_t reply_type;
+				string payload;
+				ChunkResult result{};
+				bool received = _receive_message(connection.fd, reply_type, payload, connection.deadline) && reply_type == chunk_result;
+				Reader r(payload);
+				bool is_this_chunk = received && r.u32() == connection.chunk;
+				bool ok = is_this_chunk && r.u8() != 0;
+				if (is_this_chunk && !ok) { // the worker couldn't do it, e.g. its block source failed
+					err_string = "Scan worker failed chunk " + std::to_string(connection.chunk) + ": " + r.str();
+					close_all();
+					return false;
+				}
+				connection.is_busy = false;
+				if (!ok || !_read_result(r, result) || !r.done()) { // dropped, garbled or stalled mid-message; someone else gets the chunk
+					LOG_PRINT_L0("monero_scan_coordinator: lost a worker; requeueing chunk " << connection.chunk);
+					close(connection.fd);
+					connection.fd = -1;
+					queue.push_front(connection.chunk);
+					continue;
+				}
+				results[connection.chunk] = std::move(result);
+				remaining--;
+			}
+		}
+		close_all();
+		return true;
+	}
+	size_t _n_threads() // 0 where that can't be told
+	{
+#ifdef __linux__
+		DIR *dir = opendir("/proc/self/task");
+		if (dir == nullptr) {
+			return 0;
+		}
+		size_t n = 0;
+		for (dirent *entry = readdir(dir); entry != nullptr; entry = readdir(dir)) {
+			n += entry->d_name[0] != '.';
+		}
+		closedir(dir);
+		return n;
+#else
+		return 0;
+#endif
+	}
+	void _chunk_header(Writer &w, size_t chunk, const Chunk &range)
+	{
+		w.u32((uint32_t)chunk);
+		w.u64(range.start_height);
+		w.u64(range.end_height);
+	}
+}
+//
+bool monero_scan_coordinator::scan_range(
+	const vector<Endpoint> &workers,
+	uint64_t start_height, uint64_t end_height,
+	const ScanAccount &account,
+	ScanRangeRetVals &retVals,
+	uint64_t chunk_size,
+	uint64_t chunk_timeout_ms
+) {
+	retVals = {};
+	string err_string;
+	if (account.subaddresses != nullptr) {
+		err_string = "Subaddress tables aren't supported by distributed scans";
+	} else if (start_height > end_height || chunk_size == 0 || chunk_timeout_ms == 0) {
+		err_string = "Invalid scan range";
+	}
+	if (!err_string.empty()) {
+		retVals.did_error = true;
+		retVals.err_string = err_string;
+		return false;
+	}
+	vector<Chunk> chunks;
+	for (uint64_t height = start_height; height < end_height; height += std::min(chunk_size, end_height - height)) {
+		chunks.push_back(Chunk{ height, height + std::min(chunk_size, end_height - height) });
+	}
+	vector<size_t> all_chunks(chunks.size());
+	for (size_t c = 0; c < chunks.size(); c++) {
+		all_chunks[c] = c;
+	}
+	// Round one: owned outputs, and spends of the key images the account already knows
+	vector<ChunkResult> results(chunks.size());
+	bool r = _run_round(workers, scan_chunk, all_chunks, [&chunks, &account] (size_t c) {
+		Writer w;
+		_chunk_header(w, c, chunks[c]);
+		w.pod(account.sec_viewKey);
+		w.pod(account.pub_spendKey);
+		write_pods(w, account.known_key_images.begin(), account.known_key_images.end());
+		return w.buf;
+	}, chunk_timeout_ms, results, err_string);
+	if (!r) {
+		retVals.did_error = true;
+		retVals.err_string = err_string;
+		return false;
+	}
+	// Round two, only with a spend key: spends of the outputs just found, in their own chunk and after
+	vector<vector<SpentKeyImage>> found_spends(chunks.size());
+	if (account.sec_spendKey != boost::none) {
+		unordered_set<crypto::key_image> known(account.known_key_images.begin(), account.known_key_images.end());
+		vector<vector<crypto::key_image>> watched(chunks.size()); // cumulative, per chunk
+		vector<crypto::key_image> cumulative;
+		for (size_t c = 0; c < chunks.size(); c++) {
+			for (OwnedOutput &output : results[c].owned_outputs) {
+				monero_key_image_utils::KeyImageRetVals key_image_retVals;
+				if (!monero_key_image_store::new__key_image(
+					account.pub_spendKey, *account.sec_spendKey, account.sec_viewKey,
+					output.tx_pub_key, output.out_index,
+					key_image_retVals
+				)) {
+					retVals.did_error = true;
+					retVals.err_string = key_image_retVals.err_string;
+					return false;
+				}
+				output.key_image = key_image_retVals.calculated_key_image;
+				if (known.find(*output.key_image) == known.end()) { // known ones were matched in round one
+					cumulative.push_back(*output.key_image);
+				}
+			}
+			watched[c] = cumulative;
+		}
+		vector<size_t> spend_chunks;
+		for (size_t c = 0; c < chunks.size(); c++) {
+			if (!watched[c].empty()) {
+				spend_chunks.push_back(c);
+			}
+		}
+		vector<ChunkResult> spend_results(chunks.size());
+		r = _run_round(workers, match_spends, spend_chunks, [&chunks, &watched] (size_t c) {
+			Writer w;
+			_chunk_header(w, c, chunks[c]);
+			write_pods(w, watched[c].begin(), watched[c].end());
+			return w.buf;
+		}, chunk_timeout_ms, spend_results, err_string);
+		if (!r) {
+			retVals.did_error = true;
+			retVals.err_string = err_string;
+			return false;
+		}
+		for (size_t c : spend_chunks) {
+			found_spends[c] = std::move(spend_results[c].spent_key_images);
+		}
+	}
+	// Deterministic merge: chunk order, and within a chunk round one's spends before round two's at the same height
+	for (size_t c = 0; c < chunks.size(); c++) {
+		ChunkResult &result = results[c];
+		std::move(result.owned_outputs.begin(), result.owned_outputs.end(), std::back_inserter(retVals.owned_outputs));
+		std::merge(
+			result.spent_key_images.begin(), result.spent_key_images.end(),
+			found_spends[c].begin(), found_spends[c].end(),
+			std::back_inserter(retVals.spent_key_images),
+			[] (const SpentKeyImage &a, const SpentKeyImage &b) { return a.height < b.height; }
+		);
+		retVals.checkpoints.push_back(result.checkpoint);
+	}
+	return true;
+}
+//
+bool monero_scan_coordinator::listen(const string &host, uint16_t port, int &listen_fd, uint16_t &bound_port, string &err_string)
+{
+	addrinfo hints{};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	addrinfo *addrs = nullptr;
+	if (getaddrinfo(host.empty() ? nullptr : host.c_str(), std::to_string(port).c_str(), &hints, &addrs) != 0) {
+		err_string = "Unable to resolve listen address";
+		return false;
+	}
+	listen_fd = -1;
+	for (addrinfo *addr = addrs; addr != nullptr && listen_fd < 0; addr = addr->ai_next) {
+		listen_fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+		if (listen_fd < 0) {
+			continue;
+		}
+		int one = 1;
+		setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if (::bind(listen_fd, addr->ai_addr, addr->ai_addrlen) != 0 || ::listen(listen_fd, 16) != 0) {
+			close(listen_fd);
+			listen_fd = -1;
+		}
+	}
+	freeaddrinfo(addrs);
+	if (listen_fd < 0) {
+		err_string = "Unable to listen on " + host + ":" + std::to_string(port);
+		return false;
+	}
+	sockaddr_storage bound{};
+	socklen_t bound_size = sizeof(bound);
+	getsockname(listen_fd, reinterpret_cast<sockaddr *>(&bound), &bound_size);
+	bound_port = ntohs(bound.ss_family == AF_INET6
+		? reinterpret_cast<sockaddr_in6 *>(&bound)->sin6_port
+		: reinterpret_cast<sockaddr_in *>(&bound)->sin_port);
+	return true;
+}
+void monero_scan_coordinator::serve(int listen_fd, const BlockSource &source)
+{
+	while (true) {
+		int fd = accept(listen_fd, nullptr, nullptr);
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED) {
+				continue;
+			}
+			return;
+		}
+		_configure_socket(fd);
+		_serve_connection(fd, source);
+		close(fd);
+	}
+}
+//
+bool monero_scan_coordinator::spawn_local_workers(
+	size_t n,
+	const BlockSource &source,
+	vector<Endpoint> &endpoints,
+	vector<int> &pids,
+	string &err_string
+) {
+	if (_n_threads() > 1) { // a child would only have the forking thread, and any lock another thread held stays held
+		err_string = "Local scan workers must be spawned before any other threads are started";
+		return false;
+	}
+	for (size_t i = 0; i < n; i++) {
+		int listen_fd;
+		uint16_t port;
+		if (!monero_scan_coordinator::listen("127.0.0.1", 0, listen_fd, port, err_string)) { // before forking, so the port is known here
+			return false;
+		}
+		pid_t pid = fork();
+		if (pid < 0) {
+			close(listen_fd);
+			err_string = "Unable to fork a scan worker";
+			return false;
+		}
+		if (pid == 0) { // single threaded still, so the shared threadpool starts afresh in here
+			serve(listen_fd, source);
+			_exit(0);
+		}
+		close(listen_fd);
+		endpoints.push_back(Endpoint{ "127.0.0.1", port });
+		pids.push_back(pid);
+	}
+	return true;
+}
+void monero_scan_coordinator::stop_local_workers(const vector<int> &pids)
+{
+	for (int pid : pids) {
+		kill(pid, SIGTERM);
+	}
+	for (int pid : pids) {
+		waitpid(pid, nullptr, 0);
+	}
+}
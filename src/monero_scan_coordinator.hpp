@@ -0,0 +1,112 @@
+//
+//  monero_scan_coordinator.hpp
+//  Copyright (c) 2014-2019, MyMonero.com
+//
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are
+//  permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright notice, this list of
+//	conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list
+//	of conditions and the following disclaimer in the documentation and/or other
+//	materials provided with the distribution.
+//
+//  3. Neither the name of the copyright holder nor the names of its contributors may be
+//	used to endorse or promote products derived from this software without specific
+//	prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+//  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+//  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+//  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+//  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//
+#ifndef monero_scan_coordinator_hpp
+#define monero_scan_coordinator_hpp
+//
+#include <functional>
+#include <string>
+#include <vector>
+#include "crypto.h"
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
+#include "monero_output_scanner.hpp"
+//
+using namespace tools;
+#include "tools__ret_vals.hpp"
+//
+namespace monero_scan_coordinator
+{
+	// Splits a height range into chunks and farms them out to worker processes over TCP, local or
+	// on peer hosts. A worker gets its blocks from a BlockSource (a daemon, a cache, ...), runs
+	// monero_output_scanner over them and answers with a ChunkResult; the coordinator hands out
+	// chunks as workers become free, moves a chunk to another worker if its worker drops or
+	// doesn't answer within the chunk timeout, and merges the results in height order, so the outcome doesn't depend on scheduling.
+	//
+	// Workers only ever see the view secret key. When the account has a spend secret key the
+	// coordinator computes the found outputs' key images itself and, in a second round, asks for
+	// their spends from the chunk each output was found in onwards. The protocol isn't
+	// encrypted - use it on a trusted network or through a tunnel. Subaddress tables aren't
+	// supported.
+	typedef std::function<bool(
+		uint64_t start_height, uint64_t end_height, // [start, end)
+		std::vector<cryptonote::block_complete_entry> &blocks,
+		std::string &err_string
+	)> BlockSource;
+	//
+	struct Endpoint
+	{
+		std::string host;
+		uint16_t port;
+	};
+	struct Checkpoint
+	{
+		uint64_t height; // scanned up to here, exclusive
+		crypto::hash block_hash; // of the block at height - 1
+	};
+	struct ChunkResult // what a worker sends back; mergeable
+	{
+		uint64_t start_height;
+		uint64_t end_height;
+		Checkpoint checkpoint;
+		std::vector<monero_output_scanner::OwnedOutput> owned_outputs;
+		std::vector<monero_output_scanner::SpentKeyImage> spent_key_images;
+	};
+	struct ScanRangeRetVals: RetVals_base
+	{
+		std::vector<monero_output_scanner::OwnedOutput> owned_outputs; // in chain order
+		std::vector<monero_output_scanner::SpentKeyImage> spent_key_images; // in chain order
+		std::vector<Checkpoint> checkpoints; // one per chunk, ascending
+	};
+	static const uint64_t default_chunk_size = 1000; // blocks
+	static const uint64_t default_chunk_timeout_ms = 10 * 60 * 1000; // per chunk, from when it's sent
+	//
+	// Coordinator
+	bool scan_range(
+		const std::vector<Endpoint> &workers,
+		uint64_t start_height, uint64_t end_height, // [start, end)
+		const monero_output_scanner::ScanAccount &account,
+		ScanRangeRetVals &retVals,
+		uint64_t chunk_size = default_chunk_size,
+		uint64_t chunk_timeout_ms = default_chunk_timeout_ms
+	);
+	//
+	// Worker
+	bool listen(const std::string &host, uint16_t port, int &listen_fd, uint16_t &bound_port, std::string &err_string); // port 0 picks a free one
+	void serve(int listen_fd, const BlockSource &source); // serves one connection at a time until accept fails
+	//
+	// Local multi-process stand-in: forks n workers listening on 127.0.0.1. Call it before the
+	// process starts any threads (including the shared threadpool's); it fails otherwise, where
+	// that can be told (Linux).
+	bool spawn_local_workers(size_t n, const BlockSource &source, std::vector<Endpoint> &endpoints, std::vector<int> &pids, std::string &err_string);
+	void stop_local_workers(const std::vector<int> &pids);
+}
+//
+#endif /* monero_scan_coordinator_hpp */
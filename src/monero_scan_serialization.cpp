@@ -0,0 +1,101 @@
+//
+//  monero_key_image_store.cpp
+//  Copyright (c) 2014-2019, MyMonero.com
+//
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are
+//  permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright notice, this list of
+//	conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list
+//	of conditions and the following disclaimer in the documentation and/or other
+//	materials provided with the distribution.
+//
+//  3. Neither the name of the copyright holder nor the names of its contributors may be
+//	used to endorse or promote products derived from this software without specific
+//	prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+//  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+//  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+//  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+//  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//
+#include "monero_scan_serialization.hpp"
+//
+using namespace std;
+using namespace monero_output_scanner;
+using namespace monero_scan_serialization;
+//
+void monero_scan_serialization::write_owned_output(Writer &w, const OwnedOutput &output, bool with_key_image)
+{
+	bool has_key_image = with_key_image && output.key_image != boost::none;
+	w.u64(output.height);
+	w.pod(output.tx_hash);
+	w.pod(output.tx_pub_key);
+	w.u64(output.out_index);
+	w.pod(output.out_pub_key);
+	w.u32(output.subaddress_index.major);
+	w.u32(output.subaddress_index.minor);
+	w.u64(output.amount);
+	w.pod(output.mask);
+	w.u8((output.is_coinbase ? 1 : 0) | (has_key_image ? 2 : 0));
+	w.u64(output.unlock_time);
+	if (with_key_image) {
+		w.pod(has_key_image ? *output.key_image : crypto::key_image{});
+	}
+}
+void monero_scan_serialization::read_owned_output(Reader &r, OwnedOutput &output, bool with_key_image)
+{
+	output.height = r.u64();
+	r.pod(output.tx_hash);
+	r.pod(output.tx_pub_key);
+	output.out_index = r.u64();
+	r.pod(output.out_pub_key);
+	output.subaddress_index.major = r.u32();
+	output.subaddress_index.minor = r.u32();
+	output.amount = r.u64();
+	r.pod(output.mask);
+	uint8_t flags = r.u8();
+	output.is_coinbase = (flags & 1) != 0;
+	output.unlock_time = r.u64();
+	output.key_image = boost::none;
+	if (with_key_image) {
+		crypto::key_image key_image;
+		r.pod(key_image);
+		if (flags & 2) {
+			output.key_image = key_image;
+		}
+	}
+}
+void monero_scan_serialization::write_spent_key_images(Writer &w, const vector<SpentKeyImage> &spends)
+{
+	w.u64(spends.size());
+	for (const SpentKeyImage &spend : spends) {
+		w.u64(spend.height);
+		w.pod(spend.tx_hash);
+		w.pod(spend.key_image);
+	}
+}
+bool monero_scan_serialization::read_spent_key_images(Reader &r, vector<SpentKeyImage> &spends)
+{
+	uint64_t n;
+	if (!r.count(n, spent_key_image_size)) {
+		return false;
+	}
+	spends.resize(n);
+	for (SpentKeyImage &spend : spends) {
+		spend.height = r.u64();
+		r.pod(spend.tx_hash);
+		r.pod(spend.key_image);
+	}
+	return r.ok;
+}
@@ -0,0 +1,108 @@
+//
+//  monero_scan_serialization.hpp
+//  Copyright (c) 2014-2019, MyMonero.com
+//
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are
+//  permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright notice, this list of
+//	conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list
+//	of conditions and the following disclaimer in the documentation and/or other
+//	materials provided with the distribution.
+//
+//  3. Neither the name of the copyright holder nor the names of its contributors may be
+//	used to endorse or promote products derived from this software without specific
+//	prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+//  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+//  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+//  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+//  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//
+#ifndef monero_scan_serialization_hpp
+#define monero_scan_serialization_hpp
+//
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "crypto.h"
+#include "monero_output_scanner.hpp"
+//
+namespace monero_scan_serialization
+{
+	// The byte layout monero_scan_coordinator's messages and monero_scan_checkpoint's records
+	// share: integers are little endian and keys are their raw bytes. A Reader stops at the first
+	// short read and leaves ok false, so callers check ok (or done) once at the end.
+	struct Writer
+	{
+		std::string buf;
+		void u8(uint8_t v) { buf.push_back((char)v); }
+		void u32(uint32_t v) { for (size_t i = 0; i < 4; i++) { u8((v >> (8 * i)) & 0xff); } }
+		void u64(uint64_t v) { for (size_t i = 0; i < 8; i++) { u8((v >> (8 * i)) & 0xff); } }
+		template<typename T> void pod(const T &v) { buf.append(reinterpret_cast<const char *>(&v), sizeof(T)); }
+		void str(const std::string &v) { u32((uint32_t)v.size()); buf.append(v); }
+	};
+	struct Reader
+	{
+		const uint8_t *p;
+		const uint8_t *end;
+		bool ok = true;
+		//
+		Reader(const uint8_t *p, size_t size) : p(p), end(p + size) {}
+		Reader(const std::string &buf) : Reader(reinterpret_cast<const uint8_t *>(buf.data()), buf.size()) {}
+		bool has(size_t n) { ok = ok && (size_t)(end - p) >= n; return ok; }
+		uint8_t u8() { return has(1) ? *p++ : 0; }
+		uint32_t u32() { uint32_t v = 0; for (size_t i = 0; i < 4; i++) { v |= (uint32_t)u8() << (8 * i); } return v; }
+		uint64_t u64() { uint64_t v = 0; for (size_t i = 0; i < 8; i++) { v |= (uint64_t)u8() << (8 * i); } return v; }
+		template<typename T> void pod(T &v) { if (has(sizeof(T))) { memcpy(&v, p, sizeof(T)); p += sizeof(T); } }
+		std::string str() { uint32_t n = u32(); if (!has(n)) { return std::string(); } std::string v(reinterpret_cast<const char *>(p), n); p += n; return v; }
+		bool count(uint64_t &n, size_t min_element_size) { n = u64(); return has(0) && n <= (size_t)(end - p) / min_element_size; } // so a corrupt count can't allocate
+		bool done() const { return ok && p == end; }
+	};
+	//
+	// A count, then each element's raw bytes
+	template<typename Iterator>
+	void write_pods(Writer &w, Iterator begin, Iterator end)
+	{
+		w.u64(std::distance(begin, end));
+		for (Iterator it = begin; it != end; ++it) {
+			w.pod(*it);
+		}
+	}
+	template<typename T>
+	bool read_pods(Reader &r, std::vector<T> &values)
+	{
+		uint64_t n;
+		if (!r.count(n, sizeof(T))) {
+			return false;
+		}
+		values.resize(n);
+		for (T &value : values) {
+			r.pod(value);
+		}
+		return r.ok;
+	}
+	//
+	// An OwnedOutput's fields in declaration order, its flags byte holding is_coinbase. With
+	// with_key_image, the flags byte also says whether there's a key image and its bytes follow
+	// unlock_time; without, key_image isn't written and is left as none when read.
+	static const size_t owned_output_size = 8 + 32 + 32 + 8 + 32 + 4 + 4 + 8 + 32 + 1 + 8;
+	static const size_t owned_output_with_key_image_size = owned_output_size + 32;
+	static const size_t spent_key_image_size = 8 + 32 + 32;
+	void write_owned_output(Writer &w, const monero_output_scanner::OwnedOutput &output, bool with_key_image);
+	void read_owned_output(Reader &r, monero_output_scanner::OwnedOutput &output, bool with_key_image);
+	void write_spent_key_images(Writer &w, const std::vector<monero_output_scanner::SpentKeyImage> &spends);
+	bool read_spent_key_images(Reader &r, std::vector<monero_output_scanner::SpentKeyImage> &spends);
+}
+#endif /* monero_scan_serialization_hpp */
@@ -40,6 +40,7 @@
 #include "monero_transfer_utils.hpp"
 #include "monero_fork_rules.hpp"
 #include "monero_key_image_utils.hpp"
+#include "monero_key_image_store.hpp"
 #include "monero_address_utils.hpp"
 //
 using namespace crypto;
@@ -205,11 +206,11 @@ LightwalletAPI_Res_GetUnspentOuts monero_send_routine::new__parsed_res__get_unsp
 		}
 		bool isOutputSpent = false; // let's see…
 		{
-			BOOST_FOREACH(const boost::property_tree::ptree::value_type &spend_key_image_string, output_desc.second.get_child("spend_key_images"))
-			{
-//				cout << "spend_key_image_string: " << spend_key_image_string.second.data() << endl;
+			const boost::property_tree::ptree &spend_key_images = output_desc.second.get_child("spend_key_images");
+			string calculated_key_image_string;
+			if (!spend_key_images.empty()) { // the key image is the same for every candidate, so derive (or look up) it once
 				KeyImageRetVals retVals;
-				bool r = new__key_image(
+				bool r = monero_key_image_store::new__key_image(
 					pub_spendKey, sec_spendKey, sec_viewKey, tx_pub_key,
 					output__index,
 					retVals
@@ -221,8 +222,12 @@ LightwalletAPI_Res_GetUnspentOuts monero_send_routine::new__parsed_res__get_unsp
 						none, none, none
 					};
 				}
-				auto calculated_key_image_string = epee::string_tools::pod_to_hex(retVals.calculated_key_image);
+				calculated_key_image_string = epee::string_tools::pod_to_hex(retVals.calculated_key_image);
 //				cout << "calculated_key_image_string: " << calculated_key_image_string << endl;
+			}
+			BOOST_FOREACH(const boost::property_tree::ptree::value_type &spend_key_image_string, spend_key_images)
+			{
+//				cout << "spend_key_image_string: " << spend_key_image_string.second.data() << endl;
 				auto areEqual = calculated_key_image_string == spend_key_image_string.second.data();
 				if (areEqual) {
 					isOutputSpent = true; // output was spent… exclude
@@ -288,8 +293,13 @@ LightwalletAPI_Res_GetRandomOuts monero_send_routine::new__parsed_res__get_rando
 		}
 		mix_outs.push_back(std::move(amountAndOuts));
 	}
+	vector<RingMembers> ring_members;
+	CreateTransactionErrorCode code = new__ring_members(mix_outs, ring_members);
+	if (code != noError) {
+		return {err_msg_from_err_code__create_transaction(code), none};
+	}
 	return {
-		none, mix_outs
+		none, std::move(ring_members)
 	};
 }
 //
@@ -332,7 +342,7 @@ void _reenterable_construct_and_send_tx(
 ) {
 	args.status_update_fn(calculatingFee);
 	//
-	auto use_fork_rules = monero_fork_rules::make_use_fork_rules_fn(args.fork_version);
+	ForkRules fork_rules(args.fork_version); // resolved once for both steps
 	//
 	Send_Step1_RetVals step1_retVals;
 	monero_transfer_utils::send_step1__prepare_params_for_get_decoys(
@@ -342,7 +352,7 @@ void _reenterable_construct_and_send_tx(
 		args.sending_amount,
 		args.is_sweeping,
 		args.simple_priority,
-		use_fork_rules,
+		fork_rules,
 		args.unspent_outs,
 		args.fee_per_b,
 		args.fee_quantization_mask,
@@ -361,7 +371,7 @@ void _reenterable_construct_and_send_tx(
 		args,
 		step1_retVals,
 		constructionAttempt,
-		use_fork_rules
+		fork_rules
 	] (
 		const property_tree::ptree &res
 	) -> void {
@@ -389,7 +399,7 @@ void _reenterable_construct_and_send_tx(
 			args.fee_per_b,
 			args.fee_quantization_mask,
 			*(parsed_res.mix_outs),
-			std::move(use_fork_rules),
+			fork_rules,
 			args.unlock_time,
 			args.nettype
 		);
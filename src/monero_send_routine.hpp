@@ -208,7 +208,7 @@ namespace monero_send_routine
 	{
 		optional<string> err_msg;
 		// OR
-		optional<vector<RandomAmountOutputs>> mix_outs;
+		optional<vector<RingMembers>> mix_outs;
 	};
 	LightwalletAPI_Res_GetUnspentOuts new__parsed_res__get_unspent_outs(
 		const property_tree::ptree &res,
@@ -0,0 +1,204 @@
+//
+//  monero_key_image_store.cpp
+//  Copyright (c) 2014-2019, MyMonero.com
+//
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are
+//  permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright notice, this list of
+//	conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list
+//	of conditions and the following disclaimer in the documentation and/or other
+//	materials provided with the distribution.
+//
+//  3. Neither the name of the copyright holder nor the names of its contributors may be
+//	used to endorse or promote products derived from this software without specific
+//	prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+//  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+//  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+//  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+//  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//
+#include "monero_subaddress_table.hpp"
+//
+#include <cstring>
+#include "device/device.hpp"
+#include "common/threadpool.h"
+#include "memwipe.h"
+//
+using namespace std;
+using namespace crypto;
+using namespace cryptonote;
+using namespace monero_subaddress_table;
+//
+namespace
+{
+	const uint32_t keys_per_task = 256;
+	//
+	size_t _hash(const crypto::public_key &key)
+	{ // points are uniformly distributed already
+		size_t h;
+		memcpy(&h, &key, sizeof(h));
+		return h;
+	}
+}
+//
+SubaddressTable::SubaddressTable(
+	const crypto::secret_key &sec_viewKey,
+	const crypto::public_key &pub_spendKey,
+	uint32_t major_lookahead,
+	uint32_t minor_lookahead
+) :
+	m_major_lookahead(std::min(max_major_lookahead, std::max<uint32_t>(1, major_lookahead))),
+	m_minor_lookahead(std::min(max_minor_lookahead, std::max<uint32_t>(1, minor_lookahead)))
+{
+	m_keys.m_view_secret_key = sec_viewKey;
+	m_keys.m_account_address.m_spend_public_key = pub_spendKey;
+	expand_to(m_major_lookahead, m_minor_lookahead);
+}
+SubaddressTable::~SubaddressTable()
+{
+	memwipe(&m_keys.m_view_secret_key, sizeof(m_keys.m_view_secret_key));
+}
+//
+bool SubaddressTable::lookup(const crypto::public_key &spend_public_key, subaddress_index &index) const
+{
+	if (m_slots.empty()) {
+		return false;
+	}
+	size_t mask = m_slots.size() - 1;
+	for (size_t i = _hash(spend_public_key) & mask; m_slots[i].is_occupied; i = (i + 1) & mask) {
+		if (m_slots[i].spend_public_key == spend_public_key) {
+			index = m_slots[i].index;
+			return true;
+		}
+	}
+	return false;
+}
+bool SubaddressTable::expand_for(const subaddress_index &used)
+{
+	size_t size_before = m_size;
+	uint64_t n_majors = std::max<uint64_t>(m_n_minors.size(), (uint64_t)used.major + m_major_lookahead);
+	n_majors = std::min<uint64_t>(n_majors, UINT32_MAX);
+	std::vector<std::pair<uint32_t, std::pair<uint32_t, uint32_t>>> ranges;
+	for (uint64_t major = m_n_minors.size(); major < n_majors; major++) {
+		ranges.push_back(std::make_pair((uint32_t)major, std::make_pair(0u, m_minor_lookahead)));
+	}
+	uint32_t used_minors = (uint32_t)std::min<uint64_t>((uint64_t)used.minor + m_minor_lookahead, UINT32_MAX);
+	if (used.major < m_n_minors.size() && m_n_minors[used.major] < used_minors) {
+		ranges.push_back(std::make_pair(used.major, std::make_pair(m_n_minors[used.major], used_minors)));
+	}
+	_generate(ranges);
+	return m_size != size_before;
+}
+void SubaddressTable::expand_to(uint32_t n_majors, uint32_t n_minors)
+{
+	std::vector<std::pair<uint32_t, std::pair<uint32_t, uint32_t>>> ranges;
+	for (uint32_t major = 0; major < std::max<uint32_t>(n_majors, (uint32_t)m_n_minors.size()); major++) {
+		uint32_t begin = major < m_n_minors.size() ? m_n_minors[major] : 0;
+		if (begin < n_minors) {
+			ranges.push_back(std::make_pair(major, std::make_pair(begin, n_minors)));
+		}
+	}
+	_generate(ranges);
+}
+//
+bool SubaddressTable::_generate(const std::vector<std::pair<uint32_t, std::pair<uint32_t, uint32_t>>> &ranges)
+{
+	if (m_did_error) {
+		return false;
+	}
+	// Split into tasks of at most keys_per_task keys; each task fills its own vector
+	struct Task
+	{
+		uint32_t major;
+		uint32_t begin;
+		uint32_t end;
+		std::vector<crypto::public_key> spend_public_keys;
+		bool did_error;
+	};
+	std::vector<Task> tasks;
+	size_t n_keys = 0;
+	for (const auto &range : ranges) {
+		for (uint32_t begin = range.second.first; begin < range.second.second; ) {
+			uint32_t end = begin + std::min(keys_per_task, range.second.second - begin);
+			tasks.push_back(Task{ range.first, begin, end, {}, false });
+			n_keys += end - begin;
+			begin = end;
+		}
+	}
+	if (tasks.empty()) {
+		return true;
+	}
+	hw::device &hwdev = hw::get_device("default");
+	tools::threadpool &tpool = tools::threadpool::getInstance();
+	tools::threadpool::waiter waiter;
+	for (Task &task : tasks) {
+		tpool.submit(&waiter, [this, &hwdev, &task] () {
+			try {
+				task.spend_public_keys = hwdev.get_subaddress_spend_public_keys(m_keys, task.major, task.begin, task.end);
+			} catch (const std::exception &) { // the pool can't propagate exceptions; throws on a spend public key that isn't a point
+				task.did_error = true;
+			}
+		});
+	}
+	waiter.wait(&tpool);
+	for (const Task &task : tasks) {
+		if (task.did_error || task.spend_public_keys.size() != task.end - task.begin) {
+			m_did_error = true;
+			return false;
+		}
+	}
+	//
+	_reserve(m_size + n_keys);
+	for (const Task &task : tasks) {
+		if (task.major >= m_n_minors.size()) {
+			m_n_minors.resize(task.major + 1, 0);
+		}
+		for (uint32_t minor = task.begin; minor < task.end; minor++) {
+			_insert(task.spend_public_keys[minor - task.begin], subaddress_index{ task.major, minor });
+		}
+		m_n_minors[task.major] = std::max(m_n_minors[task.major], task.end);
+	}
+	return true;
+}
+void SubaddressTable::_insert(const crypto::public_key &spend_public_key, const subaddress_index &index)
+{ // must have room
+	size_t mask = m_slots.size() - 1;
+	size_t i = _hash(spend_public_key) & mask;
+	for (; m_slots[i].is_occupied; i = (i + 1) & mask) {
+		if (m_slots[i].spend_public_key == spend_public_key) {
+			return;
+		}
+	}
+	m_slots[i] = Slot{ spend_public_key, index, true };
+	m_size++;
+}
+void SubaddressTable::_reserve(size_t n)
+{
+	size_t capacity = m_slots.empty() ? 16 : m_slots.size();
+	while (capacity < 2 * n) {
+		capacity *= 2;
+	}
+	if (capacity == m_slots.size()) {
+		return;
+	}
+	std::vector<Slot> old_slots(capacity, Slot{ crypto::null_pkey, subaddress_index{ 0, 0 }, false });
+	old_slots.swap(m_slots);
+	m_size = 0;
+	for (const Slot &slot : old_slots) {
+		if (slot.is_occupied) {
+			_insert(slot.spend_public_key, slot.index);
+		}
+	}
+}
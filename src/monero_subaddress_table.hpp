@@ -0,0 +1,96 @@
+//
+//  monero_subaddress_table.hpp
+//  Copyright (c) 2014-2019, MyMonero.com
+//
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are
+//  permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright notice, this list of
+//	conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list
+//	of conditions and the following disclaimer in the documentation and/or other
+//	materials provided with the distribution.
+//
+//  3. Neither the name of the copyright holder nor the names of its contributors may be
+//	used to endorse or promote products derived from this software without specific
+//	prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+//  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+//  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+//  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+//  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//
+#ifndef monero_subaddress_table_hpp
+#define monero_subaddress_table_hpp
+//
+#include <vector>
+#include "crypto.h"
+#include "cryptonote_basic.h"
+#include "cryptonote_basic/subaddress_index.h"
+//
+namespace monero_subaddress_table
+{
+	// Spend public keys of an account's subaddresses, so an output is matched against all of them
+	// with one derive_subaddress_public_key and one probe instead of one comparison per
+	// subaddress. Keys are generated (in parallel, on the shared threadpool) for
+	// [0, n majors) x [0, n minors of that major), kept in an open-addressing table with linear
+	// probing, and grown like wallet2's lookahead: once index (major, minor) is seen in use,
+	// expand_for makes sure major + major_lookahead majors and minor + minor_lookahead minors of
+	// that major exist.
+	//
+	// lookup is safe from any number of threads; expanding isn't safe concurrently with lookups.
+	class SubaddressTable
+	{
+	public:
+		static const uint32_t default_major_lookahead = 50;
+		static const uint32_t default_minor_lookahead = 200;
+		static const uint32_t max_major_lookahead = 500; // lookaheads are clamped to these; 10x wallet2's defaults
+		static const uint32_t max_minor_lookahead = 2000;
+		//
+		SubaddressTable(
+			const crypto::secret_key &sec_viewKey,
+			const crypto::public_key &pub_spendKey,
+			uint32_t major_lookahead = default_major_lookahead,
+			uint32_t minor_lookahead = default_minor_lookahead
+		); // generates the initial lookahead window
+		~SubaddressTable();
+		SubaddressTable(const SubaddressTable &) = delete;
+		SubaddressTable &operator=(const SubaddressTable &) = delete;
+		//
+		bool lookup(const crypto::public_key &spend_public_key, cryptonote::subaddress_index &index) const;
+		bool expand_for(const cryptonote::subaddress_index &used); // true if any keys were added
+		void expand_to(uint32_t n_majors, uint32_t n_minors); // every major gets at least n_minors
+		size_t size() const { return m_size; }
+		bool did_error() const { return m_did_error; } // keys couldn't be generated, e.g. pub_spendKey isn't a valid point; the table stays empty
+		const crypto::public_key &pub_spendKey() const { return m_keys.m_account_address.m_spend_public_key; }
+	private:
+		struct Slot
+		{
+			crypto::public_key spend_public_key;
+			cryptonote::subaddress_index index;
+			bool is_occupied;
+		};
+		bool _generate(const std::vector<std::pair<uint32_t, std::pair<uint32_t, uint32_t>>> &ranges); // (major, [begin, end) minors); false and nothing added on failure
+		void _insert(const crypto::public_key &spend_public_key, const cryptonote::subaddress_index &index);
+		void _reserve(size_t n);
+		//
+		cryptonote::account_keys m_keys; // view secret and spend public only
+		uint32_t m_major_lookahead;
+		uint32_t m_minor_lookahead;
+		std::vector<uint32_t> m_n_minors; // generated minors, per major
+		std::vector<Slot> m_slots; // size is a power of two, kept at most half full
+		size_t m_size = 0;
+		bool m_did_error = false;
+	};
+}
+//
+#endif /* monero_subaddress_table_hpp */
@@ -36,6 +36,12 @@
 #include "string_tools.h"
 #include "monero_paymentID_utils.hpp"
 #include "monero_key_image_utils.hpp"
+#include "monero_key_derivation_cache.hpp"
+#include "monero_keypair_pool.hpp"
+#include "monero_tx_verification.hpp"
+#include "serialization/binary_utils.h"
+#include "common/threadpool.h"
+#include <unordered_set>
 //
 using namespace std;
 using namespace crypto;
@@ -157,7 +163,7 @@ bool _rct_hex_to_decrypted_mask(
 	}
 	auto make_key_derivation = [&]() {
 		crypto::key_derivation derivation;
-		bool r = generate_key_derivation(tx_pub_key, view_secret_key, derivation);
+		bool r = monero_key_derivation_cache::generate_key_derivation(tx_pub_key, view_secret_key, derivation);
 		THROW_WALLET_EXCEPTION_IF(!r, error::wallet_internal_error, "Failed to generate key derivation");
 		crypto::secret_key scalar;
 		crypto::derivation_to_scalar(derivation, internal_output_index, scalar);
@@ -193,6 +199,161 @@ bool _verify_sec_key(const crypto::secret_key &secret_key, const crypto::public_
 	bool r = crypto::secret_key_to_public_key(secret_key, calculated_pub);
 	return r && public_key == calculated_pub;
 }
+crypto::hash _tx_hash_from_blob(const cryptonote::transaction &tx, const cryptonote::blobdata &blob)
+{ // Same result as get_transaction_hash(tx) but hashing slices of the already serialized blob instead of re-serializing each part
+	if (tx.version == 1) {
+		return crypto::cn_fast_hash(blob.data(), blob.size());
+	}
+	const rct::rctSig &rv = tx.rct_signatures;
+	if (rv.type != rct::RCTTypeBulletproof && rv.type != rct::RCTTypeBulletproof2) {
+		return cryptonote::get_transaction_hash(tx); // only bulletproof types are constructed here
+	}
+	for (const auto &in : tx.vin) {
+		if (in.type() != typeid(txin_to_key)) {
+			return cryptonote::get_transaction_hash(tx); // nor other input types, but a decoded signed tx may have them
+		}
+	}
+	for (const auto &out : tx.vout) {
+		if (out.target.type() != typeid(txout_to_key)) {
+			return cryptonote::get_transaction_hash(tx);
+		}
+	}
+	size_t prefix_size = varint_size(tx.version) + varint_size(tx.unlock_time);
+	prefix_size += varint_size(tx.vin.size());
+	for (const auto &in : tx.vin) {
+		const txin_to_key &in_to_key = boost::get<txin_to_key>(in);
+		prefix_size += 1/*variant tag*/ + varint_size(in_to_key.amount) + varint_size(in_to_key.key_offsets.size());
+		for (uint64_t offset : in_to_key.key_offsets) {
+			prefix_size += varint_size(offset);
+		}
+		prefix_size += sizeof(crypto::key_image);
+	}
+	prefix_size += varint_size(tx.vout.size());
+	for (const auto &out : tx.vout) {
+		prefix_size += varint_size(out.amount) + 1/*variant tag*/ + sizeof(crypto::public_key);
+	}
+	prefix_size += varint_size(tx.extra.size()) + tx.extra.size();
+	//
+	size_t n_outputs = tx.vout.size();
+	size_t base_size = 1/*type*/ + varint_size(rv.txnFee)
+		+ n_outputs * (rv.type == rct::RCTTypeBulletproof2 ? 8 : 2 * sizeof(rct::key))/*ecdhInfo*/
+		+ n_outputs * sizeof(rct::key)/*outPk*/; // bulletproof types keep their pseudoOuts in the prunable part
+	if (prefix_size + base_size > blob.size()) {
+		return cryptonote::get_transaction_hash(tx);
+	}
+	//
+	crypto::hash hashes[3];
+	crypto::cn_fast_hash(blob.data(), prefix_size, hashes[0]);
+	crypto::cn_fast_hash(blob.data() + prefix_size, base_size, hashes[1]);
+	crypto::cn_fast_hash(blob.data() + prefix_size + base_size, blob.size() - prefix_size - base_size, hashes[2]);
+	return crypto::cn_fast_hash(hashes, sizeof(hashes));
+}
+cryptonote::account_keys _account_keys_from_strings(
+	const string &from_address_string,
+	const string &sec_viewKey_string,
+	const string &sec_spendKey_string,
+	network_type nettype
+) {
+	cryptonote::address_parse_info from_addr_info;
+	THROW_WALLET_EXCEPTION_IF(!cryptonote::get_account_address_from_str(from_addr_info, nettype, from_address_string), error::wallet_internal_error, "Couldn't parse from-address");
+	cryptonote::account_keys account_keys;
+	{
+		account_keys.m_account_address = from_addr_info.address;
+		//
+		crypto::secret_key sec_viewKey;
+		THROW_WALLET_EXCEPTION_IF(!string_tools::hex_to_pod(sec_viewKey_string, sec_viewKey), error::wallet_internal_error, "Couldn't parse view key");
+		account_keys.m_view_secret_key = sec_viewKey;
+		//
+		crypto::secret_key sec_spendKey;
+		THROW_WALLET_EXCEPTION_IF(!string_tools::hex_to_pod(sec_spendKey_string, sec_spendKey), error::wallet_internal_error, "Couldn't parse spend key");
+		account_keys.m_spend_secret_key = sec_spendKey;
+	}
+	return account_keys;
+}
+CreateTransactionErrorCode _to_addr_and_extra(
+	const string &to_address_string,
+	const optional<string>& payment_id_string,
+	network_type nettype,
+	cryptonote::address_parse_info &to_addr_info,
+	std::vector<uint8_t> &extra
+) {
+	THROW_WALLET_EXCEPTION_IF(
+		to_address_string.find(".") != std::string::npos, // assumed to be an OA address asXMR addresses do not have periods and OA addrs must
+		error::wallet_internal_error,
+		"Integrators must resolve OA addresses before calling Send"
+	); // This would be an app code fault
+	if (!cryptonote::get_account_address_from_str(to_addr_info, nettype, to_address_string)) {
+		return couldntDecodeToAddress;
+	}
+	//
+	CreateTransactionErrorCode tx_extra__code = _add_pid_to_tx_extra(payment_id_string, extra);
+	if (tx_extra__code != noError) {
+		return tx_extra__code;
+	}
+	bool payment_id_seen = payment_id_string != none; // logically this is true since payment_id_string has passed validation (or we'd have errored)
+	if (to_addr_info.is_subaddress && payment_id_seen) {
+		return cantUsePIDWithSubAddress; // Never use a subaddress with a payment ID
+	}
+	if (to_addr_info.has_payment_id) {
+		if (payment_id_seen) {
+			return nonZeroPIDWithIntAddress; // can't use int addr at same time as supplying manual pid
+		}
+		if (to_addr_info.is_subaddress) {
+			THROW_WALLET_EXCEPTION_IF(false, error::wallet_internal_error, "Unexpected is_subaddress && has_payment_id"); // should never happen
+			return invalidDestinationAddress;
+		}
+		std::string extra_nonce;
+		cryptonote::set_encrypted_payment_id_to_tx_extra_nonce(extra_nonce, to_addr_info.payment_id);
+		bool r = cryptonote::add_extra_nonce_to_tx_extra(extra, extra_nonce);
+		if (!r) {
+			return couldntAddPIDNonceToTXExtra;
+		}
+		payment_id_seen = true;
+	}
+	return noError;
+}
+bool _fee_suffices_for_weight( // or sets tx_must_be_reconstructed and fee_actually_needed
+	Send_Step2_RetVals &retVals,
+	uint64_t tx_weight,
+	uint64_t fee_amount,
+	uint32_t simple_priority,
+	uint64_t fee_per_b,
+	uint64_t fee_quantization_mask,
+	const ForkRules &fork_rules
+) {
+	uint64_t fee_actually_needed = calculate_fee_from_weight(
+		get_base_fee(fee_per_b)/*i.e. fee_per_b*/,
+		tx_weight,
+		get_fee_multiplier(simple_priority, default_priority(), get_fee_algorithm(fork_rules), fork_rules),
+		fee_quantization_mask
+	);
+	if (fee_actually_needed > fee_amount) {
+//		cout << "Need to reconstruct tx with fee of at least " << fee_actually_needed << "." << endl;
+		retVals.tx_must_be_reconstructed = true;
+		retVals.fee_actually_needed = fee_actually_needed;
+		return false;
+	}
+	return true;
+}
+void _step2_retVals_from_constructed( // checks the fee the constructed tx actually needs
+	Send_Step2_RetVals &retVals,
+	Convenience_TransactionConstruction_RetVals &create_tx__retVals,
+	uint64_t fee_amount,
+	uint32_t simple_priority,
+	uint64_t fee_per_b,
+	uint64_t fee_quantization_mask,
+	const ForkRules &fork_rules
+) {
+	THROW_WALLET_EXCEPTION_IF(create_tx__retVals.signed_serialized_tx_string == boost::none, error::wallet_internal_error, "Not expecting no signed_serialized_tx_string given no error");
+	//
+	if (!_fee_suffices_for_weight(retVals, *create_tx__retVals.tx_weight, fee_amount, simple_priority, fee_per_b, fee_quantization_mask, fork_rules)) {
+		return;
+	}
+	retVals.signed_serialized_tx_string = std::move(*(create_tx__retVals.signed_serialized_tx_string));
+	retVals.tx_hash_string = std::move(*(create_tx__retVals.tx_hash_string));
+	retVals.tx_key_string = std::move(*(create_tx__retVals.tx_key_string));
+	retVals.tx_pub_key_string = std::move(*(create_tx__retVals.tx_pub_key_string));
+}
 } // unnamed namespace
 //
 namespace
@@ -222,6 +383,64 @@ namespace
 	}
 }
 //
+// Decoy parsing
+CreateTransactionErrorCode monero_transfer_utils::new__ring_members(
+	const RandomAmountOutputs &random_amount_outputs,
+	RingMembers &ring_members
+) {
+	ring_members = {};
+	ring_members.amount = random_amount_outputs.amount;
+	const vector<RandomAmountOutput> &outputs = random_amount_outputs.outputs;
+	//
+	// Sort a permutation by global index rather than the outputs themselves so the strings aren't copied
+	vector<size_t> order(outputs.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&outputs] (size_t a, size_t b) {
+		return outputs[a].global_index < outputs[b].global_index;
+	});
+	ring_members.global_indices.reserve(order.size());
+	ring_members.public_keys.reserve(order.size());
+	ring_members.commits.reserve(order.size());
+	ring_members.has_commit.reserve(order.size());
+	ring_members.has_public_key.reserve(order.size());
+	for (size_t i : order) {
+		const RandomAmountOutput &output = outputs[i];
+		if (!ring_members.global_indices.empty() && ring_members.global_indices.back() == output.global_index) {
+			LOG_PRINT_L2("got duplicate mixin, skipping");
+			continue;
+		}
+		crypto::public_key public_key = AUTO_VAL_INIT(public_key);
+		bool has_public_key = string_tools::hex_to_pod(output.public_key, public_key);
+		rct::key commit = rct::identity();
+		bool has_commit = output.rct != none && (*output.rct).empty() == false;
+		if (has_commit) {
+			_rct_hex_to_rct_commit(*output.rct, commit);
+		}
+		ring_members.global_indices.push_back(output.global_index);
+		ring_members.public_keys.push_back(rct::pk2rct(public_key));
+		ring_members.commits.push_back(commit);
+		ring_members.has_commit.push_back(has_commit ? 1 : 0);
+		ring_members.has_public_key.push_back(has_public_key ? 1 : 0);
+	}
+	return noError;
+}
+CreateTransactionErrorCode monero_transfer_utils::new__ring_members(
+	const vector<RandomAmountOutputs> &mix_outs,
+	vector<RingMembers> &ring_members
+) {
+	ring_members.clear();
+	ring_members.resize(mix_outs.size());
+	for (size_t i = 0; i < mix_outs.size(); i++) {
+		CreateTransactionErrorCode code = new__ring_members(mix_outs[i], ring_members[i]);
+		if (code != noError) {
+			return code;
+		}
+	}
+	return noError;
+}
+//
 //
 //
 // Decomposed Send procedure
@@ -232,7 +451,7 @@ void monero_transfer_utils::send_step1__prepare_params_for_get_decoys(
 	uint64_t sending_amount,
 	bool is_sweeping,
 	uint32_t simple_priority,
-	use_fork_rules_fn_type use_fork_rules_fn,
+	const ForkRules &fork_rules,
 	//
 	const vector<SpendableOutput> &unspent_outs,
 	uint64_t fee_per_b, // per v8
@@ -269,12 +488,12 @@ void monero_transfer_utils::send_step1__prepare_params_for_get_decoys(
 		retVals.errCode = tx_extra__code;
 		return;
 	}
-	const uint64_t base_fee = get_base_fee(fee_per_b); // in other words, fee_per_b
-	const uint64_t fee_multiplier = get_fee_multiplier(simple_priority, default_priority(), get_fee_algorithm(use_fork_rules_fn), use_fork_rules_fn);
+	// resolved once; the fee estimates below are then table lookups
+	const FeeParams fee_params = new__fee_params(fee_per_b, simple_priority, fee_quantization_mask, fake_outs_count, extra.size(), bulletproof, fork_rules);
 	//
 	uint64_t attempt_at_min_fee;
 	if (passedIn_attemptAt_fee == none) {
-		attempt_at_min_fee = estimate_fee(true/*use_per_byte_fee*/, true/*use_rct*/, 2/*est num inputs*/, fake_outs_count, 2, extra.size(), bulletproof, base_fee, fee_multiplier, fee_quantization_mask);
+		attempt_at_min_fee = fee_params.estimated_fee(2/*est num inputs*/, 2);
 		// opted to do this instead of `const uint64_t min_fee = (fee_multiplier * base_fee * estimate_tx_size(use_rct, 1, fake_outs_count, 2, extra.size(), bulletproof));`
 		// TODO: estimate with 1 input or 2?
 	} else {
@@ -321,11 +540,7 @@ void monero_transfer_utils::send_step1__prepare_params_for_get_decoys(
 	// Note: using_outs and using_outs_amount may still get modified below (so retVals.spendable_balance gets updated)
 	//
 //	if (/*using_outs.size() > 1*/ && use_rct) { // FIXME? see original core js
-	uint64_t needed_fee = estimate_fee(
-		true/*use_per_byte_fee*/, use_rct,
-		retVals.using_outs.size(), fake_outs_count, /*tx.dsts.size()*/1+1, extra.size(),
-		bulletproof, base_fee, fee_multiplier, fee_quantization_mask
-	);
+	uint64_t needed_fee = fee_params.estimated_fee(retVals.using_outs.size(), /*tx.dsts.size()*/1+1);
 	// if newNeededFee < neededFee, use neededFee instead (should only happen on the 2nd or later times through (due to estimated fee being too low))
 	if (needed_fee < attempt_at_min_fee) {
 		needed_fee = attempt_at_min_fee;
@@ -359,11 +574,7 @@ void monero_transfer_utils::send_step1__prepare_params_for_get_decoys(
 			retVals.spendable_balance = using_outs_amount; // must store for needMoreMoneyThanFound return
 			//
 			// Recalculate fee, total incl fees
-			needed_fee = estimate_fee(
-				true/*use_per_byte_fee*/, use_rct,
-				retVals.using_outs.size(), fake_outs_count, /*tx.dsts.size()*/1+1, extra.size(),
-				bulletproof, base_fee, fee_multiplier, fee_quantization_mask
-			);
+			needed_fee = fee_params.estimated_fee(retVals.using_outs.size(), /*tx.dsts.size()*/1+1);
 			total_incl_fees = sending_amount + needed_fee; // because fee changed
 		}
 		retVals.required_balance = total_incl_fees; // update required_balance b/c total_incl_fees changed
@@ -387,7 +598,7 @@ void monero_transfer_utils::send_step1__prepare_params_for_get_decoys(
 	retVals.change_amount = change_amount;
 	//
 //	uint64_t tx_estimated_weight = estimate_tx_weight(true/*use_rct*/, retVals.using_outs.size(), fake_outs_count, 1+1, extra.size(), true/*bulletproof*/);
-//	if (tx_estimated_weight >= TX_WEIGHT_TARGET(get_upper_transaction_weight_limit(0, use_fork_rules_fn))) {
+//	if (tx_estimated_weight >= TX_WEIGHT_TARGET(get_upper_transaction_weight_limit(0, fork_rules))) {
 //		// TODO?
 //	}
 }
@@ -406,49 +617,223 @@ void monero_transfer_utils::send_step2__try_create_transaction(
 	const vector<SpendableOutput> &using_outs,
 	uint64_t fee_per_b, // per v8
 	uint64_t fee_quantization_mask,
-	vector<RandomAmountOutputs> &mix_outs, // cannot be const due to convenience__create_transaction's mutability requirement
-	use_fork_rules_fn_type use_fork_rules_fn,
+	const vector<RingMembers> &mix_outs,
+	const ForkRules &fork_rules,
 	uint64_t unlock_time, // or 0
-	cryptonote::network_type nettype
+	cryptonote::network_type nettype,
+	bool self_verify
 ) {
 	retVals = {};
 	//
-	Convenience_TransactionConstruction_RetVals create_tx__retVals;
-	monero_transfer_utils::convenience__create_transaction(
-		create_tx__retVals,
-		from_address_string,
-		sec_viewKey_string, sec_spendKey_string,
+	PrepareTransaction_RetVals prepare_retVals;
+	convenience__prepare_transaction(
+		prepare_retVals,
+		from_address_string, sec_viewKey_string,
 		to_address_string, payment_id_string,
 		final_total_wo_fee, change_amount, fee_amount,
 		using_outs, mix_outs,
-		use_fork_rules_fn,
-		unlock_time,
-		nettype // TODO: move to after from_address_string
+		fork_rules,
+		unlock_time, nettype
 	);
-	if (create_tx__retVals.errCode != noError) {
-		retVals.errCode = create_tx__retVals.errCode;
+	if (prepare_retVals.errCode != noError) {
+		retVals.errCode = prepare_retVals.errCode;
 		return;
 	}
-	THROW_WALLET_EXCEPTION_IF(create_tx__retVals.signed_serialized_tx_string == boost::none, error::wallet_internal_error, "Not expecting no signed_serialized_tx_string given no error");
-	//
-	size_t blob_size = *create_tx__retVals.txBlob_byteLength;
-	uint64_t fee_actually_needed = calculate_fee(
-		true/*use_per_byte_fee*/,
-		*create_tx__retVals.tx, blob_size,
-		get_base_fee(fee_per_b)/*i.e. fee_per_b*/,
-		get_fee_multiplier(simple_priority, default_priority(), get_fee_algorithm(use_fork_rules_fn), use_fork_rules_fn),
-		fee_quantization_mask
+	// the weight is exact, so a too-low fee is known before signing
+	if (!_fee_suffices_for_weight(retVals, exact_tx_weight(*prepare_retVals.unsigned_tx), fee_amount, simple_priority, fee_per_b, fee_quantization_mask, fork_rules)) {
+		return;
+	}
+	TransactionConstruction_RetVals sign_retVals;
+	convenience__sign_transaction(
+		sign_retVals,
+		*prepare_retVals.unsigned_tx,
+		from_address_string, sec_viewKey_string, sec_spendKey_string,
+		fork_rules, nettype
 	);
-	if (fee_actually_needed > fee_amount) {
-//		cout << "Need to reconstruct tx with fee of at least " << fee_actually_needed << "." << endl;
-		retVals.tx_must_be_reconstructed = true;
-		retVals.fee_actually_needed = fee_actually_needed;
+	if (sign_retVals.errCode != noError) {
+		retVals.errCode = sign_retVals.errCode;
 		return;
 	}
-	retVals.signed_serialized_tx_string = std::move(*(create_tx__retVals.signed_serialized_tx_string));
-	retVals.tx_hash_string = std::move(*(create_tx__retVals.tx_hash_string));
-	retVals.tx_key_string = std::move(*(create_tx__retVals.tx_key_string));
-	retVals.tx_pub_key_string = std::move(*(create_tx__retVals.tx_pub_key_string));
+	Convenience_TransactionConstruction_RetVals create_tx__retVals;
+	finalize_transaction(create_tx__retVals, sign_retVals);
+	_step2_retVals_from_constructed(
+		retVals, create_tx__retVals,
+		fee_amount, simple_priority, fee_per_b, fee_quantization_mask,
+		fork_rules
+	);
+	if (self_verify && retVals.errCode == noError && !retVals.tx_must_be_reconstructed) {
+		vector<bool> passed;
+		monero_tx_verification::verify({ &(*sign_retVals.tx) }, passed);
+		if (!passed[0]) {
+			retVals = {};
+			retVals.errCode = transactionFailedSelfVerification;
+		}
+	}
+}
+//
+void monero_transfer_utils::create_transactions_batch__prepare_params_for_get_decoys(
+	BatchSend_Step1_RetVals &retVals,
+	//
+	const vector<BatchSendSpec> &specs,
+	uint32_t simple_priority,
+	const ForkRules &fork_rules,
+	//
+	const vector<SpendableOutput> &unspent_outs,
+	uint64_t fee_per_b, // per v8
+	uint64_t fee_quantization_mask
+) {
+	retVals = {};
+	retVals.per_spec.resize(specs.size());
+	//
+	vector<SpendableOutput> remaining_outs = unspent_outs;
+	for (size_t i = 0; i < specs.size(); i++) {
+		const BatchSendSpec &spec = specs[i];
+		Send_Step1_RetVals &step1_retVals = retVals.per_spec[i];
+		send_step1__prepare_params_for_get_decoys(
+			step1_retVals,
+			spec.payment_id_string,
+			spec.sending_amount,
+			spec.is_sweeping,
+			simple_priority,
+			fork_rules,
+			remaining_outs,
+			fee_per_b,
+			fee_quantization_mask,
+			spec.passedIn_attemptAt_fee
+		);
+		if (step1_retVals.errCode != noError) {
+			continue; // this spec's outputs stay available to the following specs
+		}
+		// Remove what this spec is spending so the next spec's selection is disjoint from it
+		std::unordered_set<string> used_public_keys;
+		for (const SpendableOutput &out : step1_retVals.using_outs) {
+			used_public_keys.insert(out.public_key);
+			retVals.using_outs_for_decoys.push_back(out);
+		}
+		remaining_outs.erase(
+			std::remove_if(remaining_outs.begin(), remaining_outs.end(), [&used_public_keys] (const SpendableOutput &out) {
+				return used_public_keys.count(out.public_key) != 0;
+			}),
+			remaining_outs.end()
+		);
+	}
+}
+void monero_transfer_utils::create_transactions_batch(
+	vector<Send_Step2_RetVals> &retVals,
+	//
+	const string &from_address_string,
+	const string &sec_viewKey_string,
+	const string &sec_spendKey_string,
+	const vector<BatchSendSpec> &specs,
+	const BatchSend_Step1_RetVals &step1_retVals,
+	uint32_t simple_priority,
+	uint64_t fee_per_b, // per v8
+	uint64_t fee_quantization_mask,
+	const vector<RingMembers> &mix_outs,
+	const ForkRules &fork_rules,
+	uint64_t unlock_time, // or 0
+	cryptonote::network_type nettype,
+	bool self_verify
+) {
+	THROW_WALLET_EXCEPTION_IF(step1_retVals.per_spec.size() != specs.size(), error::wallet_internal_error, "Expected one step1 result per spec");
+	retVals.clear();
+	retVals.resize(specs.size());
+	bool mix_outs_match = mix_outs.size() == step1_retVals.using_outs_for_decoys.size();
+	//
+	// Keys are parsed once for the whole batch
+	cryptonote::account_keys account_keys = _account_keys_from_strings(from_address_string, sec_viewKey_string, sec_spendKey_string, nettype);
+	std::unordered_map<crypto::public_key, cryptonote::subaddress_index> subaddresses;
+	subaddresses[account_keys.m_account_address.m_spend_public_key] = {0,0};
+	//
+	vector<TransactionConstruction_RetVals> sign_retVals(specs.size()); // txs are kept until verified
+	//
+	tools::threadpool &tpool = tools::threadpool::getInstance();
+	tools::threadpool::waiter waiter;
+	size_t mix_outs_offset = 0;
+	for (size_t i = 0; i < specs.size(); i++) {
+		const Send_Step1_RetVals &spec_step1 = step1_retVals.per_spec[i];
+		if (spec_step1.errCode != noError) {
+			retVals[i].errCode = spec_step1.errCode; // pass-through
+			continue;
+		}
+		size_t n_outs = spec_step1.using_outs.size();
+		if (!mix_outs_match) {
+			retVals[i].errCode = wrongNumberOfMixOutsProvided;
+			continue;
+		}
+		tpool.submit(&waiter, [&, i, mix_outs_offset, n_outs] () {
+			const BatchSendSpec &spec = specs[i];
+			const Send_Step1_RetVals &spec_step1 = step1_retVals.per_spec[i];
+			Send_Step2_RetVals &spec_retVals = retVals[i];
+			try {
+				cryptonote::address_parse_info to_addr_info;
+				std::vector<uint8_t> extra;
+				CreateTransactionErrorCode to_addr__code = _to_addr_and_extra(spec.to_address_string, spec.payment_id_string, nettype, to_addr_info, extra);
+				if (to_addr__code != noError) {
+					spec_retVals.errCode = to_addr__code;
+					return;
+				}
+				vector<RingMembers> spec_mix_outs(mix_outs.begin() + mix_outs_offset, mix_outs.begin() + mix_outs_offset + n_outs);
+				PrepareTransaction_RetVals prepare_retVals;
+				prepare_transaction(
+					prepare_retVals,
+					account_keys.m_account_address, account_keys.m_view_secret_key,
+					to_addr_info,
+					spec_step1.final_total_wo_fee, spec_step1.change_amount, spec_step1.using_fee,
+					spec_step1.using_outs, spec_mix_outs,
+					extra,
+					fork_rules,
+					unlock_time, nettype
+				);
+				if (prepare_retVals.errCode != noError) {
+					spec_retVals.errCode = prepare_retVals.errCode;
+					return;
+				}
+				if (!_fee_suffices_for_weight(spec_retVals, exact_tx_weight(*prepare_retVals.unsigned_tx), spec_step1.using_fee, simple_priority, fee_per_b, fee_quantization_mask, fork_rules)) {
+					return; // skip signing
+				}
+				TransactionConstruction_RetVals &spec_sign_retVals = sign_retVals[i];
+				sign_transaction(spec_sign_retVals, *prepare_retVals.unsigned_tx, account_keys, subaddresses, fork_rules);
+				if (spec_sign_retVals.errCode != noError) {
+					spec_retVals.errCode = spec_sign_retVals.errCode;
+					return;
+				}
+				Convenience_TransactionConstruction_RetVals create_tx__retVals;
+				finalize_transaction(create_tx__retVals, spec_sign_retVals);
+				_step2_retVals_from_constructed(
+					spec_retVals, create_tx__retVals,
+					spec_step1.using_fee, simple_priority, fee_per_b, fee_quantization_mask,
+					fork_rules
+				);
+			} catch (const std::exception &e) { // the pool can't propagate exceptions; report it against this spec
+				LOG_PRINT_L0("create_transactions_batch: spec " << i << ": " << e.what());
+				spec_retVals = {};
+				spec_retVals.errCode = transactionNotConstructed;
+			}
+		});
+		mix_outs_offset += n_outs;
+	}
+	waiter.wait(&tpool);
+	if (!self_verify) {
+		return;
+	}
+	vector<size_t> verifying_idxs;
+	vector<const cryptonote::transaction *> verifying_txs;
+	for (size_t i = 0; i < specs.size(); i++) {
+		if (retVals[i].errCode == noError && !retVals[i].tx_must_be_reconstructed && sign_retVals[i].tx != boost::none) {
+			verifying_idxs.push_back(i);
+			verifying_txs.push_back(&(*sign_retVals[i].tx));
+		}
+	}
+	vector<bool> passed;
+	monero_tx_verification::verify(verifying_txs, passed);
+	for (size_t j = 0; j < verifying_idxs.size(); j++) {
+		if (!passed[j]) {
+			Send_Step2_RetVals &spec_retVals = retVals[verifying_idxs[j]];
+			spec_retVals = {};
+			spec_retVals.errCode = transactionFailedSelfVerification;
+		}
+	}
 }
 //
 //
@@ -464,12 +849,52 @@ void monero_transfer_utils::create_transaction(
 	uint64_t change_amount,
 	uint64_t fee_amount,
 	const vector<SpendableOutput> &outputs,
-	vector<RandomAmountOutputs> &mix_outs, 
+	const vector<RingMembers> &mix_outs,
 	const std::vector<uint8_t> &extra,
-	use_fork_rules_fn_type use_fork_rules_fn,
+	const ForkRules &fork_rules,
 	uint64_t unlock_time, // or 0
 	bool rct,
 	cryptonote::network_type nettype
+) {
+	retVals.errCode = noError;
+	//
+	PrepareTransaction_RetVals prepare_retVals;
+	prepare_transaction(
+		prepare_retVals,
+		sender_account_keys.m_account_address, sender_account_keys.m_view_secret_key,
+		to_addr,
+		sending_amount, change_amount, fee_amount,
+		outputs, mix_outs,
+		extra,
+		fork_rules,
+		unlock_time, nettype
+	);
+	if (prepare_retVals.errCode != noError) {
+		retVals.errCode = prepare_retVals.errCode; // pass-through
+		return;
+	}
+	sign_transaction(
+		retVals,
+		*prepare_retVals.unsigned_tx,
+		sender_account_keys, subaddresses,
+		fork_rules
+	);
+}
+//
+void monero_transfer_utils::prepare_transaction(
+	PrepareTransaction_RetVals &retVals,
+	const account_public_address &sender_address,
+	const secret_key &sender_view_secret_key,
+	const address_parse_info &to_addr,
+	uint64_t sending_amount,
+	uint64_t change_amount,
+	uint64_t fee_amount,
+	const vector<SpendableOutput> &outputs,
+	const vector<RingMembers> &mix_outs,
+	const std::vector<uint8_t> &extra,
+	const ForkRules &fork_rules,
+	uint64_t unlock_time, // or 0
+	cryptonote::network_type nettype
 ) {
 	retVals.errCode = noError;
 	//
@@ -478,24 +903,19 @@ void monero_transfer_utils::create_transaction(
 	uint32_t fake_outputs_count = fixed_mixinsize();
 	bool bulletproof = true;
 	rct::RangeProofType range_proof_type = bulletproof ? rct::RangeProofPaddedBulletproof : rct::RangeProofBorromean;
-	int bp_version = bulletproof ? (use_fork_rules_fn(HF_VERSION_SMALLER_BP, -10) ? 2 : 1) : 0;
-	const rct::RCTConfig rct_config {
-		range_proof_type,
-		bp_version,
-	};
+	int bp_version = bulletproof ? (fork_rules.use_smaller_bp ? 2 : 1) : 0;
 	//
 	if (mix_outs.size() != outputs.size() && fake_outputs_count != 0) {
 		retVals.errCode = wrongNumberOfMixOutsProvided;
 		return;
 	}
 	for (size_t i = 0; i < mix_outs.size(); i++) {
-		if (mix_outs[i].outputs.size() < fake_outputs_count) {
+		if (mix_outs[i].size() < fake_outputs_count) {
 			retVals.errCode = notEnoughOutputsForMixing;
 			return;
 		}
 	}
-	if (!sender_account_keys.get_device().verify_keys(sender_account_keys.m_spend_secret_key, sender_account_keys.m_account_address.m_spend_public_key)
-		|| !sender_account_keys.get_device().verify_keys(sender_account_keys.m_view_secret_key, sender_account_keys.m_account_address.m_view_public_key)) {
+	if (!_verify_sec_key(sender_view_secret_key, sender_address.m_view_public_key)) {
 		retVals.errCode = invalidSecretKeys;
 		return;
 	}
@@ -519,48 +939,6 @@ void monero_transfer_utils::create_transaction(
 		src.rct = outputs[out_index].rct != none && (*(outputs[out_index].rct)).empty() == false;
 		//
 		typedef cryptonote::tx_source_entry::output_entry tx_output_entry;
-		if (mix_outs.size() != 0) {
-			// Sort fake outputs by global index
-			std::sort(mix_outs[out_index].outputs.begin(), mix_outs[out_index].outputs.end(), [] (
-				RandomAmountOutput const& a,
-				RandomAmountOutput const& b
-			) {
-				return a.global_index < b.global_index;
-			});
-			for (
-				size_t j = 0;
-				src.outputs.size() < fake_outputs_count && j < mix_outs[out_index].outputs.size();
-				j++
-			) {
-				auto mix_out__output = mix_outs[out_index].outputs[j];
-				if (mix_out__output.global_index == outputs[out_index].global_index) {
-					LOG_PRINT_L2("got mixin the same as output, skipping");
-					continue;
-				}
-				auto oe = tx_output_entry{};
-				oe.first = mix_out__output.global_index;
-				//
-				crypto::public_key public_key = AUTO_VAL_INIT(public_key);
-				if(!string_tools::hex_to_pod(mix_out__output.public_key, public_key)) {
-					retVals.errCode = givenAnInvalidPubKey;
-					return;
-				}
-				oe.second.dest = rct::pk2rct(public_key);
-				//
-				if (mix_out__output.rct != boost::none && (*(mix_out__output.rct)).empty() == false) {
-					rct::key commit;
-					_rct_hex_to_rct_commit(*mix_out__output.rct, commit);
-					oe.second.mask = commit;
-				} else {
-					if (outputs[out_index].rct != boost::none && (*(outputs[out_index].rct)).empty() == false) {
-						retVals.errCode = mixRCTOutsMissingCommit;
-						return;
-					}
-					oe.second.mask = rct::zeroCommit(src.amount); //create identity-masked commitment for non-rct mix input
-				}
-				src.outputs.push_back(oe);
-			}
-		}
 		auto real_oe = tx_output_entry{};
 		real_oe.first = outputs[out_index].global_index;
 		//
@@ -585,15 +963,50 @@ void monero_transfer_utils::create_transaction(
 			real_oe.second.mask = rct::zeroCommit(src.amount/*aka outputs[out_index].amount*/); //create identity-masked commitment for non-rct input
 		}
 		//
-		// Add real_oe to outputs
-		uint64_t real_output_index = src.outputs.size();
-		for (size_t j = 0; j < src.outputs.size(); j++) {
-			if (real_oe.first < src.outputs[j].first) {
-				real_output_index = j;
-				break;
+		// Take the first fake_outputs_count decoys (already sorted by global index), skipping the real
+		// output if the server returned it, and place real_oe in order as the ring is assembled
+		uint64_t real_output_index = 0;
+		bool placed_real_oe = false;
+		src.outputs.reserve(fake_outputs_count + 1);
+		if (mix_outs.size() != 0) {
+			const RingMembers &ring = mix_outs[out_index];
+			size_t real_pos = ring.lower_bound(real_oe.first);
+			bool ring_has_real = real_pos < ring.size() && ring.global_indices[real_pos] == real_oe.first;
+			size_t n_decoys = 0;
+			for (size_t j = 0; n_decoys < fake_outputs_count && j < ring.size(); j++) {
+				if (ring_has_real && j == real_pos) {
+					LOG_PRINT_L2("got mixin the same as output, skipping");
+					continue;
+				}
+				if (!placed_real_oe && j >= real_pos) {
+					real_output_index = src.outputs.size();
+					src.outputs.push_back(real_oe);
+					placed_real_oe = true;
+				}
+				if (!ring.has_public_key[j]) {
+					retVals.errCode = givenAnInvalidPubKey;
+					return;
+				}
+				auto oe = tx_output_entry{};
+				oe.first = ring.global_indices[j];
+				oe.second.dest = ring.public_keys[j];
+				if (ring.has_commit[j]) {
+					oe.second.mask = ring.commits[j];
+				} else {
+					if (outputs[out_index].rct != boost::none && (*(outputs[out_index].rct)).empty() == false) {
+						retVals.errCode = mixRCTOutsMissingCommit;
+						return;
+					}
+					oe.second.mask = rct::zeroCommit(src.amount); //create identity-masked commitment for non-rct mix input
+				}
+				src.outputs.push_back(oe);
+				n_decoys++;
 			}
 		}
-		src.outputs.insert(src.outputs.begin() + real_output_index, real_oe);
+		if (!placed_real_oe) {
+			real_output_index = src.outputs.size();
+			src.outputs.push_back(real_oe);
+		}
 		//
 		crypto::public_key tx_pub_key = AUTO_VAL_INIT(tx_pub_key);
 		if(!string_tools::validate_hex(64, outputs[out_index].tx_pub_key)) {
@@ -614,7 +1027,7 @@ void monero_transfer_utils::create_transaction(
 			rct::key decrypted_mask;
 			bool r = _rct_hex_to_decrypted_mask(
 				*(outputs[out_index].rct),
-				sender_account_keys.m_view_secret_key,
+				sender_view_secret_key,
 				tx_pub_key,
 				internal_output_index,
 				decrypted_mask
@@ -657,14 +1070,13 @@ void monero_transfer_utils::create_transaction(
 			// letting the destination be able to work out which of the inputs is the
 			// real one in our rings
 			LOG_PRINT_L2("generating dummy address for 0 change");
-			cryptonote::account_base dummy;
-			dummy.generate();
-			change_dst.addr = dummy.get_keys().m_account_address;
+			change_dst.addr.m_spend_public_key = monero_keypair_pool::new_keypair().pub;
+			change_dst.addr.m_view_public_key = monero_keypair_pool::new_keypair().pub;
 			LOG_PRINT_L2("generated dummy address for 0 change");
 			splitted_dsts.push_back(change_dst);
 		}
 	} else {
-		change_dst.addr = sender_account_keys.m_account_address;
+		change_dst.addr = sender_address;
 		splitted_dsts.push_back(change_dst);
 	}
 	//
@@ -679,33 +1091,81 @@ void monero_transfer_utils::create_transaction(
 		return;
 	}
 	//
-	cryptonote::transaction tx;
-	crypto::secret_key tx_key;
+	UnsignedTransaction unsigned_tx;
+	unsigned_tx.version = 1;
+	unsigned_tx.sources = std::move(sources);
+	unsigned_tx.splitted_dsts = std::move(splitted_dsts);
+	unsigned_tx.change_addr = change_dst.addr;
+	unsigned_tx.extra = extra;
+	unsigned_tx.unlock_time = unlock_time;
+	unsigned_tx.range_proof_type = range_proof_type;
+	unsigned_tx.bp_version = bp_version;
+	retVals.unsigned_tx = std::move(unsigned_tx);
+}
+//
+void monero_transfer_utils::sign_transaction(
+	TransactionConstruction_RetVals &retVals,
+	const UnsignedTransaction &unsigned_tx,
+	const account_keys& sender_account_keys,
+	const std::unordered_map<crypto::public_key, cryptonote::subaddress_index> &subaddresses,
+	const ForkRules &fork_rules
+) {
+	retVals.errCode = noError;
+	//
+	if (!sender_account_keys.get_device().verify_keys(sender_account_keys.m_spend_secret_key, sender_account_keys.m_account_address.m_spend_public_key)
+		|| !sender_account_keys.get_device().verify_keys(sender_account_keys.m_view_secret_key, sender_account_keys.m_account_address.m_view_public_key)) {
+		retVals.errCode = invalidSecretKeys;
+		return;
+	}
+	// the weight is exact before signing, so an oversized tx is never signed nor serialized
+	if (get_upper_transaction_weight_limit(0, fork_rules) <= exact_tx_weight(unsigned_tx)) {
+		// TODO: return error::tx_too_big, upper_transaction_weight_limit
+		retVals.errCode = transactionTooBig;
+		return;
+	}
+	const rct::RCTConfig rct_config {
+		static_cast<rct::RangeProofType>(unsigned_tx.range_proof_type),
+		static_cast<int>(unsigned_tx.bp_version),
+	};
+	bool bulletproof = rct_config.range_proof_type != rct::RangeProofBorromean;
+	// construct_tx_with_tx_key takes these by non-const ref
+	std::vector<tx_source_entry> sources = unsigned_tx.sources;
+	std::vector<tx_destination_entry> splitted_dsts = unsigned_tx.splitted_dsts;
+	//
+	// Same as construct_tx_and_get_tx_key but drawing the tx keys from the pool
+	crypto::secret_key tx_key = monero_keypair_pool::new_keypair().sec;
 	std::vector<crypto::secret_key> additional_tx_keys;
-	bool r = cryptonote::construct_tx_and_get_tx_key(
+	size_t num_stdaddresses = 0;
+	size_t num_subaddresses = 0;
+	cryptonote::account_public_address single_dest_subaddress;
+	cryptonote::classify_addresses(splitted_dsts, unsigned_tx.change_addr, num_stdaddresses, num_subaddresses, single_dest_subaddress);
+	if (num_subaddresses > 0 && (num_stdaddresses > 0 || num_subaddresses > 1)) { // need additional tx keys
+		additional_tx_keys.reserve(splitted_dsts.size());
+		for (size_t i = 0; i < splitted_dsts.size(); i++) {
+			additional_tx_keys.push_back(monero_keypair_pool::new_keypair().sec);
+		}
+	}
+	retVals.tx.emplace(); // constructed in place; transaction has no move constructor
+	cryptonote::transaction &tx = *retVals.tx;
+	bool r = cryptonote::construct_tx_with_tx_key(
 		sender_account_keys, subaddresses,
-		sources, splitted_dsts, change_dst.addr, extra,
-		tx, unlock_time, tx_key, additional_tx_keys,
+		sources, splitted_dsts, unsigned_tx.change_addr, unsigned_tx.extra,
+		tx, unsigned_tx.unlock_time, tx_key, additional_tx_keys,
 		true, rct_config,
 		/*m_multisig ? &msout : */NULL
 	);
 	LOG_PRINT_L2("constructed tx, r="<<r);
 	if (!r) {
 		// TODO: return error::tx_not_constructed, sources, dsts, unlock_time, nettype
+		retVals.tx = none;
 		retVals.errCode = transactionNotConstructed;
 		return;
 	}
-	if (get_upper_transaction_weight_limit(0, use_fork_rules_fn) <= get_transaction_weight(tx)) {
-		// TODO: return error::tx_too_big, tx, upper_transaction_weight_limit
-		retVals.errCode = transactionTooBig;
-		return;
-	}
 	bool use_bulletproofs = !tx.rct_signatures.p.bulletproofs.empty();
 	THROW_WALLET_EXCEPTION_IF(use_bulletproofs != bulletproof, error::wallet_internal_error, "Expected tx use_bulletproofs to equal bulletproof flag");
 	//
-	retVals.tx = tx;
 	retVals.tx_key = tx_key;
-	retVals.additional_tx_keys = additional_tx_keys;
+	retVals.additional_tx_keys = std::move(additional_tx_keys);
 }
 //
 void monero_transfer_utils::convenience__create_transaction(
@@ -719,115 +1179,238 @@ void monero_transfer_utils::convenience__create_transaction(
 	uint64_t change_amount,
 	uint64_t fee_amount,
 	const vector<SpendableOutput> &outputs,
-	vector<RandomAmountOutputs> &mix_outs,
-	use_fork_rules_fn_type use_fork_rules_fn,
+	const vector<RingMembers> &mix_outs,
+	const ForkRules &fork_rules,
 	uint64_t unlock_time,
 	network_type nettype
 ) {
 	retVals.errCode = noError;
 	//
-	cryptonote::address_parse_info from_addr_info;
-	THROW_WALLET_EXCEPTION_IF(!cryptonote::get_account_address_from_str(from_addr_info, nettype, from_address_string), error::wallet_internal_error, "Couldn't parse from-address");
-	cryptonote::account_keys account_keys;
-	{
-		account_keys.m_account_address = from_addr_info.address;
-		//
-		crypto::secret_key sec_viewKey;
-		THROW_WALLET_EXCEPTION_IF(!string_tools::hex_to_pod(sec_viewKey_string, sec_viewKey), error::wallet_internal_error, "Couldn't parse view key");
-		account_keys.m_view_secret_key = sec_viewKey;
-		//
-		crypto::secret_key sec_spendKey;
-		THROW_WALLET_EXCEPTION_IF(!string_tools::hex_to_pod(sec_spendKey_string, sec_spendKey), error::wallet_internal_error, "Couldn't parse spend key");
-		account_keys.m_spend_secret_key = sec_spendKey;
+	PrepareTransaction_RetVals prepare_retVals;
+	convenience__prepare_transaction(
+		prepare_retVals,
+		from_address_string, sec_viewKey_string,
+		to_address_string, payment_id_string,
+		sending_amount, change_amount, fee_amount,
+		outputs, mix_outs,
+		fork_rules,
+		unlock_time, nettype
+	);
+	if (prepare_retVals.errCode != noError) {
+		retVals.errCode = prepare_retVals.errCode; // pass-through
+		return; // already set the error
 	}
-	THROW_WALLET_EXCEPTION_IF(
-		to_address_string.find(".") != std::string::npos, // assumed to be an OA address asXMR addresses do not have periods and OA addrs must
-		error::wallet_internal_error,
-		"Integrators must resolve OA addresses before calling Send"
-	); // This would be an app code fault
-	cryptonote::address_parse_info to_addr_info; // just in case…
-	if (!cryptonote::get_account_address_from_str(to_addr_info, nettype, to_address_string)) {
-		retVals.errCode = couldntDecodeToAddress;
-		return;
+	TransactionConstruction_RetVals actualCall_retVals;
+	convenience__sign_transaction(
+		actualCall_retVals,
+		*prepare_retVals.unsigned_tx,
+		from_address_string,
+		sec_viewKey_string, sec_spendKey_string,
+		fork_rules,
+		nettype
+	);
+	if (actualCall_retVals.errCode != noError) {
+		retVals.errCode = actualCall_retVals.errCode; // pass-through
+		return; // already set the error
 	}
+	finalize_transaction(retVals, actualCall_retVals);
+}
+//
+void monero_transfer_utils::convenience__prepare_transaction(
+	PrepareTransaction_RetVals &retVals,
+	const string &from_address_string,
+	const string &sec_viewKey_string,
+	const string &to_address_string,
+	const optional<string>& payment_id_string,
+	uint64_t sending_amount,
+	uint64_t change_amount,
+	uint64_t fee_amount,
+	const vector<SpendableOutput> &outputs,
+	const vector<RingMembers> &mix_outs,
+	const ForkRules &fork_rules,
+	uint64_t unlock_time,
+	network_type nettype
+) {
+	retVals.errCode = noError;
 	//
+	cryptonote::address_parse_info from_addr_info;
+	THROW_WALLET_EXCEPTION_IF(!cryptonote::get_account_address_from_str(from_addr_info, nettype, from_address_string), error::wallet_internal_error, "Couldn't parse from-address");
+	crypto::secret_key sec_viewKey;
+	THROW_WALLET_EXCEPTION_IF(!string_tools::hex_to_pod(sec_viewKey_string, sec_viewKey), error::wallet_internal_error, "Couldn't parse view key");
+	cryptonote::address_parse_info to_addr_info;
 	std::vector<uint8_t> extra;
-	CreateTransactionErrorCode tx_extra__code = _add_pid_to_tx_extra(payment_id_string, extra);
-	if (tx_extra__code != noError) {
-		retVals.errCode = tx_extra__code;
-		return;
-	}
-	bool payment_id_seen = payment_id_string != none; // logically this is true since payment_id_string has passed validation (or we'd have errored)
-	if (to_addr_info.is_subaddress && payment_id_seen) {
-		retVals.errCode = cantUsePIDWithSubAddress; // Never use a subaddress with a payment ID
+	CreateTransactionErrorCode to_addr__code = _to_addr_and_extra(to_address_string, payment_id_string, nettype, to_addr_info, extra);
+	if (to_addr__code != noError) {
+		retVals.errCode = to_addr__code;
 		return;
 	}
-	if (to_addr_info.has_payment_id) {
-		if (payment_id_seen) {
-			retVals.errCode = nonZeroPIDWithIntAddress; // can't use int addr at same time as supplying manual pid
-			return;
-		}
-		if (to_addr_info.is_subaddress) {
-			THROW_WALLET_EXCEPTION_IF(false, error::wallet_internal_error, "Unexpected is_subaddress && has_payment_id"); // should never happen
-			return;
-		}
-		std::string extra_nonce;
-		cryptonote::set_encrypted_payment_id_to_tx_extra_nonce(extra_nonce, to_addr_info.payment_id);
-		bool r = cryptonote::add_extra_nonce_to_tx_extra(extra, extra_nonce);
-		if (!r) {
-			retVals.errCode = couldntAddPIDNonceToTXExtra;
-			return;
-		}
-		payment_id_seen = true;
-	}
-	//
-	uint32_t subaddr_account_idx = 0;
-	std::unordered_map<crypto::public_key, cryptonote::subaddress_index> subaddresses;
-	subaddresses[account_keys.m_account_address.m_spend_public_key] = {0,0};
 	//
-	TransactionConstruction_RetVals actualCall_retVals;
-	create_transaction(
-		actualCall_retVals,
-		account_keys, subaddr_account_idx, subaddresses,
+	prepare_transaction(
+		retVals,
+		from_addr_info.address, sec_viewKey,
 		to_addr_info,
 		sending_amount, change_amount, fee_amount,
 		outputs, mix_outs,
 		extra, // TODO: move to after address
-		use_fork_rules_fn,
-		unlock_time, true/*rct*/, nettype
+		fork_rules,
+		unlock_time, nettype
 	);
-	if (actualCall_retVals.errCode != noError) {
-		retVals.errCode = actualCall_retVals.errCode; // pass-through
-		return; // already set the error
+}
+//
+void monero_transfer_utils::convenience__sign_transaction(
+	TransactionConstruction_RetVals &retVals,
+	const UnsignedTransaction &unsigned_tx,
+	const string &from_address_string,
+	const string &sec_viewKey_string,
+	const string &sec_spendKey_string,
+	const ForkRules &fork_rules,
+	network_type nettype
+) {
+	cryptonote::account_keys account_keys = _account_keys_from_strings(from_address_string, sec_viewKey_string, sec_spendKey_string, nettype);
+	std::unordered_map<crypto::public_key, cryptonote::subaddress_index> subaddresses;
+	subaddresses[account_keys.m_account_address.m_spend_public_key] = {0,0};
+	//
+	sign_transaction(
+		retVals,
+		unsigned_tx,
+		account_keys, subaddresses,
+		fork_rules
+	);
+}
+//
+void monero_transfer_utils::finalize_transaction(
+	Convenience_TransactionConstruction_RetVals &retVals,
+	const TransactionConstruction_RetVals &signed_tx
+) {
+	retVals.errCode = noError;
+	//
+	if (signed_tx.tx == none || signed_tx.tx_key == none) { // a decoded signed tx isn't necessarily well formed
+		retVals.errCode = couldntDecodeStagedTransaction;
+		return;
+	}
+	const cryptonote::transaction &tx = *signed_tx.tx;
+	//
+	// Serialize exactly once; everything else is derived from this blob
+	cryptonote::blobdata txBlob;
+	if (!cryptonote::tx_to_blob(tx, txBlob) || txBlob.empty()) {
+		retVals.errCode = couldntDecodeStagedTransaction;
+		return;
 	}
-	auto txBlob = t_serializable_object_to_blob(*actualCall_retVals.tx);
 	size_t txBlob_byteLength = txBlob.size();
-	//	cout << "txBlob: " << txBlob << endl;
-//	cout << "txBlob_byteLength: " << txBlob_byteLength << endl;
-	THROW_WALLET_EXCEPTION_IF(txBlob_byteLength <= 0, error::wallet_internal_error, "Expected tx blob byte length > 0");
 	//
 	// tx hash
-	retVals.tx_hash_string = epee::string_tools::pod_to_hex(cryptonote::get_transaction_hash(*actualCall_retVals.tx));
+	retVals.tx_hash_string = epee::string_tools::pod_to_hex(_tx_hash_from_blob(tx, txBlob));
 	// signed serialized tx
-	retVals.signed_serialized_tx_string = epee::string_tools::buff_to_hex_nodelimer(cryptonote::tx_to_blob(*actualCall_retVals.tx));
+	retVals.signed_serialized_tx_string = epee::string_tools::buff_to_hex_nodelimer(txBlob);
 	// (concatenated) tx key
 	{
 		ostringstream oss;
-		oss << epee::string_tools::pod_to_hex(*actualCall_retVals.tx_key);
-		for (size_t i = 0; i < (*actualCall_retVals.additional_tx_keys).size(); ++i) {
-			oss << epee::string_tools::pod_to_hex((*actualCall_retVals.additional_tx_keys)[i]);
+		oss << epee::string_tools::pod_to_hex(*signed_tx.tx_key);
+		if (signed_tx.additional_tx_keys != none) {
+			for (size_t i = 0; i < (*signed_tx.additional_tx_keys).size(); ++i) {
+				oss << epee::string_tools::pod_to_hex((*signed_tx.additional_tx_keys)[i]);
+			}
 		}
 		retVals.tx_key_string = oss.str();
 	}
 	{
 		ostringstream oss;
-		oss << epee::string_tools::pod_to_hex(get_tx_pub_key_from_extra(*actualCall_retVals.tx));
+		oss << epee::string_tools::pod_to_hex(get_tx_pub_key_from_extra(tx));
 		retVals.tx_pub_key_string = oss.str();
 	}
-	retVals.tx = *actualCall_retVals.tx; // for calculating block weight; FIXME: std::move?
-	//
-//	cout << "out 0: " << string_tools::pod_to_hex(boost::get<txout_to_key>((*(actualCall_retVals.tx)).vout[0].target).key) << endl;
-//	cout << "out 1: " << string_tools::pod_to_hex(boost::get<txout_to_key>((*(actualCall_retVals.tx)).vout[1].target).key) << endl;
-	//	
+	retVals.tx_weight = cryptonote::get_transaction_weight(tx, txBlob_byteLength); // for calculating the fee actually needed
 	retVals.txBlob_byteLength = txBlob_byteLength;
 }
+//
+uint64_t monero_transfer_utils::exact_tx_weight(const UnsignedTransaction &unsigned_tx)
+{
+	std::vector<std::vector<uint64_t>> ring_global_indices;
+	ring_global_indices.reserve(unsigned_tx.sources.size());
+	uint64_t amount_in = 0;
+	for (const tx_source_entry &src : unsigned_tx.sources) {
+		std::vector<uint64_t> ring;
+		ring.reserve(src.outputs.size());
+		for (const auto &oe : src.outputs) {
+			ring.push_back(oe.first);
+		}
+		ring_global_indices.push_back(std::move(ring));
+		amount_in += src.amount;
+	}
+	uint64_t amount_out = 0;
+	for (const tx_destination_entry &dst : unsigned_tx.splitted_dsts) {
+		amount_out += dst.amount;
+	}
+	THROW_WALLET_EXCEPTION_IF(amount_out > amount_in, error::wallet_internal_error, "Expected inputs to cover outputs");
+	//
+	// construct_tx replaces any tx pub key in extra with its own, and appends additional tx pub keys when needed
+	std::vector<uint8_t> extra = unsigned_tx.extra;
+	remove_field_from_tx_extra(extra, typeid(tx_extra_pub_key));
+	size_t extra_size = extra.size() + 1/*tag*/ + sizeof(crypto::public_key);
+	size_t num_stdaddresses = 0;
+	size_t num_subaddresses = 0;
+	cryptonote::account_public_address single_dest_subaddress;
+	cryptonote::classify_addresses(unsigned_tx.splitted_dsts, unsigned_tx.change_addr, num_stdaddresses, num_subaddresses, single_dest_subaddress);
+	if (num_subaddresses > 0 && (num_stdaddresses > 0 || num_subaddresses > 1)) {
+		size_t n_keys = unsigned_tx.splitted_dsts.size();
+		extra_size += 1/*tag*/ + varint_size(n_keys) + n_keys * sizeof(crypto::public_key);
+	}
+	rct::RCTType rct_type = unsigned_tx.range_proof_type == rct::RangeProofBorromean
+		? rct::RCTTypeSimple
+		: (unsigned_tx.bp_version == 0 || unsigned_tx.bp_version >= 2 ? rct::RCTTypeBulletproof2 : rct::RCTTypeBulletproof);
+	return monero_fee_utils::exact_tx_weight(
+		ring_global_indices,
+		unsigned_tx.splitted_dsts.size(),
+		extra_size,
+		amount_in - amount_out,
+		unsigned_tx.unlock_time,
+		rct_type
+	);
+}
+//
+string monero_transfer_utils::encode_unsigned_transaction(const UnsignedTransaction &unsigned_tx)
+{
+	return t_serializable_object_to_blob(unsigned_tx);
+}
+bool monero_transfer_utils::decode_unsigned_transaction(const string &blob, UnsignedTransaction &unsigned_tx)
+{
+	std::istringstream iss(blob);
+	binary_archive<false> ar(iss);
+	return ::serialization::serialize(ar, unsigned_tx)
+		&& ar.remaining_bytes() == 0; // trailing bytes mean it isn't one of our blobs
+}
+string monero_transfer_utils::encode_signed_transaction(const TransactionConstruction_RetVals &signed_tx)
+{
+	THROW_WALLET_EXCEPTION_IF(signed_tx.tx == none || signed_tx.tx_key == none, error::wallet_internal_error, "Expected a signed tx");
+	std::ostringstream oss;
+	binary_archive<true> ar(oss);
+	// serialization takes non-const refs even when saving
+	cryptonote::transaction &tx = const_cast<cryptonote::transaction &>(*signed_tx.tx);
+	crypto::secret_key tx_key = *signed_tx.tx_key;
+	std::vector<crypto::secret_key> additional_tx_keys = signed_tx.additional_tx_keys ? *signed_tx.additional_tx_keys : std::vector<crypto::secret_key>{};
+	bool r = ::serialization::serialize(ar, tx)
+		&& ::serialization::serialize(ar, tx_key)
+		&& ::serialization::serialize(ar, additional_tx_keys);
+	THROW_WALLET_EXCEPTION_IF(!r, error::wallet_internal_error, "Couldn't encode signed tx");
+	return oss.str();
+}
+bool monero_transfer_utils::decode_signed_transaction(const string &blob, TransactionConstruction_RetVals &signed_tx)
+{
+	signed_tx.errCode = noError;
+	signed_tx.tx.emplace();
+	crypto::secret_key tx_key;
+	std::vector<crypto::secret_key> additional_tx_keys;
+	std::istringstream iss(blob);
+	binary_archive<false> ar(iss);
+	bool r = ::serialization::serialize(ar, *signed_tx.tx)
+		&& ::serialization::serialize(ar, tx_key)
+		&& ::serialization::serialize(ar, additional_tx_keys)
+		&& ar.remaining_bytes() == 0;
+	if (!r) {
+		signed_tx.tx = none;
+		signed_tx.errCode = couldntDecodeStagedTransaction;
+		return false;
+	}
+	signed_tx.tx_key = tx_key;
+	signed_tx.additional_tx_keys = std::move(additional_tx_keys);
+	return true;
+}
@@ -32,6 +32,7 @@
 #ifndef monero_transfer_utils_hpp
 #define monero_transfer_utils_hpp
 //
+#include <algorithm>
 #include <boost/optional.hpp>
 //
 #include "string_tools.h"
@@ -107,6 +108,8 @@ namespace monero_transfer_utils
 		invalidPID						= 19,
 		enteredAmountTooLow				= 20,
 		cantGetDecryptedMaskFromRCTHex	= 21,
+		couldntDecodeStagedTransaction	= 22,
+		transactionFailedSelfVerification	= 23,
 		needMoreMoneyThanFound			= 90
 	};
 	static inline string err_msg_from_err_code__create_transaction(CreateTransactionErrorCode code)
@@ -158,9 +161,40 @@ namespace monero_transfer_utils
 				return "The amount you've entered is too low";
 			case cantGetDecryptedMaskFromRCTHex:
 				return "Can't get decrypted mask from 'rct' hex";
+			case couldntDecodeStagedTransaction:
+				return "Couldn't decode staged transaction";
+			case transactionFailedSelfVerification:
+				return "Constructed transaction failed verification";
 		}
 	}
 	//
+	// Ring member candidates (decoys) for one input, as parallel arrays sorted by global index
+	// with duplicates removed. Built once when the RandomOuts response is parsed so that
+	// create_transaction can place the real output by binary search without copying decoys.
+	struct RingMembers
+	{
+		uint64_t amount;
+		vector<uint64_t> global_indices;
+		vector<rct::key> public_keys;
+		vector<rct::key> commits;
+		vector<uint8_t> has_commit; // 0 if the server sent no rct commit for this decoy (non-rct)
+		vector<uint8_t> has_public_key; // 0 if the server's key didn't parse; only an error once the decoy is picked
+		//
+		size_t size() const { return global_indices.size(); }
+		size_t lower_bound(uint64_t global_index) const
+		{ // index of the first member whose global index is not less than global_index
+			return std::lower_bound(global_indices.begin(), global_indices.end(), global_index) - global_indices.begin();
+		}
+	};
+	CreateTransactionErrorCode new__ring_members(
+		const RandomAmountOutputs &random_amount_outputs,
+		RingMembers &ring_members
+	);
+	CreateTransactionErrorCode new__ring_members(
+		const vector<RandomAmountOutputs> &mix_outs,
+		vector<RingMembers> &ring_members
+	);
+	//
 	// See monero_send_routine for actual app-lvl interface used by lightwallets 
 	//
 	//
@@ -193,7 +227,7 @@ namespace monero_transfer_utils
 		uint64_t sending_amount,
 		bool is_sweeping,
 		uint32_t simple_priority,
-		use_fork_rules_fn_type use_fork_rules_fn,
+		const ForkRules &fork_rules,
 		//
 		const vector<SpendableOutput> &unspent_outs,
 		uint64_t fee_per_b, // per v8
@@ -231,10 +265,61 @@ namespace monero_transfer_utils
 		const vector<SpendableOutput> &using_outs,
 		uint64_t fee_per_b, // per v8
 		uint64_t fee_quantization_mask,
-		vector<RandomAmountOutputs> &mix_outs, // it gets sorted
-		use_fork_rules_fn_type use_fork_rules_fn,
+		const vector<RingMembers> &mix_outs,
+		const ForkRules &fork_rules,
+		uint64_t unlock_time, // or 0
+		cryptonote::network_type nettype,
+		bool self_verify = false // verify the tx with monero_tx_verification before returning it; a failure gets transactionFailedSelfVerification
+	);
+	//
+	// Batch variant of the Send_Step* functions, for sending many independent payments from one wallet:
+	//	1. call create_transactions_batch__prepare_params_for_get_decoys with all send specs; outputs are
+	//		selected disjointly, in spec order, so no two txs spend the same output
+	//	2. make a single RandomOuts request for all of using_outs_for_decoys (in that order)
+	//	3. call create_transactions_batch with the combined mix_outs; txs are constructed in parallel
+	// Each spec succeeds, fails, or needs reconstruction independently; re-enter step 1 for the specs that
+	// need it by passing their fee_actually_needed as passedIn_attemptAt_fee.
+	//
+	struct BatchSendSpec
+	{
+		string to_address_string;
+		optional<string> payment_id_string;
+		uint64_t sending_amount;
+		bool is_sweeping;
+		optional<uint64_t> passedIn_attemptAt_fee;
+	};
+	struct BatchSend_Step1_RetVals
+	{
+		vector<Send_Step1_RetVals> per_spec; // check each errCode
+		vector<SpendableOutput> using_outs_for_decoys; // concatenation of the successful specs' using_outs
+	};
+	void create_transactions_batch__prepare_params_for_get_decoys(
+		BatchSend_Step1_RetVals &retVals,
+		//
+		const vector<BatchSendSpec> &specs,
+		uint32_t simple_priority,
+		const ForkRules &fork_rules,
+		//
+		const vector<SpendableOutput> &unspent_outs,
+		uint64_t fee_per_b, // per v8
+		uint64_t fee_quantization_mask
+	);
+	void create_transactions_batch(
+		vector<Send_Step2_RetVals> &retVals, // one per spec; specs which failed step1 are passed through with its errCode
+		//
+		const string &from_address_string,
+		const string &sec_viewKey_string,
+		const string &sec_spendKey_string,
+		const vector<BatchSendSpec> &specs,
+		const BatchSend_Step1_RetVals &step1_retVals,
+		uint32_t simple_priority,
+		uint64_t fee_per_b, // per v8
+		uint64_t fee_quantization_mask,
+		const vector<RingMembers> &mix_outs, // for using_outs_for_decoys, in order
+		const ForkRules &fork_rules,
 		uint64_t unlock_time, // or 0
-		cryptonote::network_type nettype
+		cryptonote::network_type nettype,
+		bool self_verify // verify the batch's txs with monero_tx_verification before returning them; failures get transactionFailedSelfVerification
 	);
 	//
 	//
@@ -248,7 +333,7 @@ namespace monero_transfer_utils
 		optional<string> tx_hash_string;
 		optional<string> tx_key_string; // this includes additional_tx_keys
 		optional<string> tx_pub_key_string; // from get_tx_pub_key_from_extra()
-		optional<transaction> tx; // for block weight
+		optional<uint64_t> tx_weight; // for the fee check; the tx itself is not copied out
 		optional<size_t> txBlob_byteLength;
 	};
 	void convenience__create_transaction(
@@ -262,8 +347,8 @@ namespace monero_transfer_utils
 		uint64_t change_amount,
 		uint64_t fee_amount,
 		const vector<SpendableOutput> &outputs,
-		vector<RandomAmountOutputs> &mix_outs, // get sorted
-		use_fork_rules_fn_type use_fork_rules_fn,
+		const vector<RingMembers> &mix_outs,
+		const ForkRules &fork_rules,
 		uint64_t unlock_time							= 0, // or 0
 		network_type nettype 							= MAINNET
 	);
@@ -271,7 +356,7 @@ namespace monero_transfer_utils
 	{
 		CreateTransactionErrorCode errCode;
 		//
-		optional<transaction> tx;
+		optional<transaction> tx; // emplaced by create_transaction and read in place by callers; avoid copying
 		optional<secret_key> tx_key;
 		optional<vector<secret_key>> additional_tx_keys;
 	};
@@ -285,13 +370,111 @@ namespace monero_transfer_utils
 		uint64_t change_amount,
 		uint64_t fee_amount,
 		const vector<SpendableOutput> &outputs,
-		vector<RandomAmountOutputs> &mix_outs,
+		const vector<RingMembers> &mix_outs,
 		const std::vector<uint8_t> &extra, // this is not declared const b/c it may have the output tx pub key appended to it
-		use_fork_rules_fn_type use_fork_rules_fn,
+		const ForkRules &fork_rules,
 		uint64_t unlock_time							= 0, // or 0
 		bool rct 										= true,
 		network_type nettype							= MAINNET
 	);
+	//
+	//
+	// Staged construction - create_transaction split so that each stage can run in a different process:
+	//	1. prepare_transaction assembles rings and decrypts masks; needs only the address and view key
+	//	2. sign_transaction constructs and signs the tx; needs the spend key
+	//	3. finalize_transaction serializes the signed tx and derives its hash and key strings
+	// Stages hand off via the encode_*/decode_* binary encodings.
+	//
+	struct UnsignedTransaction
+	{
+		uint32_t version; // of this encoding
+		vector<tx_source_entry> sources;
+		vector<tx_destination_entry> splitted_dsts;
+		account_public_address change_addr;
+		vector<uint8_t> extra;
+		uint64_t unlock_time;
+		uint8_t range_proof_type; // rct::RangeProofType
+		uint32_t bp_version;
+		//
+		BEGIN_SERIALIZE_OBJECT()
+			VARINT_FIELD(version)
+			if (version != 1) {
+				return false;
+			}
+			FIELD(sources)
+			FIELD(splitted_dsts)
+			FIELD(change_addr)
+			FIELD(extra)
+			VARINT_FIELD(unlock_time)
+			FIELD(range_proof_type)
+			VARINT_FIELD(bp_version)
+		END_SERIALIZE()
+	};
+	struct PrepareTransaction_RetVals
+	{
+		CreateTransactionErrorCode errCode;
+		//
+		optional<UnsignedTransaction> unsigned_tx;
+	};
+	void prepare_transaction(
+		PrepareTransaction_RetVals &retVals,
+		const account_public_address &sender_address,
+		const secret_key &sender_view_secret_key,
+		const address_parse_info &to_addr, // this _must_ include correct .is_subaddr
+		uint64_t sending_amount,
+		uint64_t change_amount,
+		uint64_t fee_amount,
+		const vector<SpendableOutput> &outputs,
+		const vector<RingMembers> &mix_outs,
+		const std::vector<uint8_t> &extra,
+		const ForkRules &fork_rules,
+		uint64_t unlock_time							= 0, // or 0
+		network_type nettype							= MAINNET
+	);
+	void convenience__prepare_transaction( // parses addresses and keys and builds tx extra, like convenience__create_transaction
+		PrepareTransaction_RetVals &retVals,
+		const string &from_address_string,
+		const string &sec_viewKey_string,
+		const string &to_address_string,
+		const optional<string>& payment_id_string,
+		uint64_t sending_amount,
+		uint64_t change_amount,
+		uint64_t fee_amount,
+		const vector<SpendableOutput> &outputs,
+		const vector<RingMembers> &mix_outs,
+		const ForkRules &fork_rules,
+		uint64_t unlock_time							= 0, // or 0
+		network_type nettype 							= MAINNET
+	);
+	void sign_transaction(
+		TransactionConstruction_RetVals &retVals,
+		const UnsignedTransaction &unsigned_tx,
+		const account_keys& sender_account_keys,
+		const std::unordered_map<crypto::public_key, cryptonote::subaddress_index> &subaddresses,
+		const ForkRules &fork_rules
+	);
+	void convenience__sign_transaction( // signs for the primary address, like convenience__create_transaction
+		TransactionConstruction_RetVals &retVals,
+		const UnsignedTransaction &unsigned_tx,
+		const string &from_address_string,
+		const string &sec_viewKey_string,
+		const string &sec_spendKey_string,
+		const ForkRules &fork_rules,
+		network_type nettype 							= MAINNET
+	);
+	void finalize_transaction(
+		Convenience_TransactionConstruction_RetVals &retVals,
+		const TransactionConstruction_RetVals &signed_tx // as returned by sign_transaction or decode_signed_transaction
+	);
+	//
+	string encode_unsigned_transaction(const UnsignedTransaction &unsigned_tx);
+	bool decode_unsigned_transaction(const string &blob, UnsignedTransaction &unsigned_tx);
+	string encode_signed_transaction(const TransactionConstruction_RetVals &signed_tx);
+	bool decode_signed_transaction(const string &blob, TransactionConstruction_RetVals &signed_tx);
+	//
+	// Weight the tx will have once signed, computed exactly from its prepared structure so that a
+	// too-low fee can be caught before paying for signing
+	uint64_t exact_tx_weight(const UnsignedTransaction &unsigned_tx);
 }
 
 #endif /* monero_transfer_utils_hpp */
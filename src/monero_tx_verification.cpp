@@ -0,0 +1,153 @@
+//
+//  monero_tx_verification.cpp
+//  Copyright (c) 2014-2019, MyMonero.com
+//
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are
+//  permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright notice, this list of
+//	conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list
+//	of conditions and the following disclaimer in the documentation and/or other
+//	materials provided with the distribution.
+//
+//  3. Neither the name of the copyright holder nor the names of its contributors may be
+//	used to endorse or promote products derived from this software without specific
+//	prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+//  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+//  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+//  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+//  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//
+#include "monero_tx_verification.hpp"
+//
+#include "ringct/rctSigs.h"
+#include "common/threadpool.h"
+#include "misc_log_ex.h"
+//
+using namespace std;
+using namespace cryptonote;
+using namespace monero_tx_verification;
+//
+namespace
+{
+	bool _is_verifiable(const transaction &tx)
+	{
+		switch (tx.rct_signatures.type) {
+			case rct::RCTTypeSimple:
+			case rct::RCTTypeBulletproof:
+			case rct::RCTTypeBulletproof2:
+				return true;
+			default: // this lib only constructs simple rct txs
+				return false;
+		}
+	}
+	bool _semantics_verified(const vector<const rct::rctSig *> &rvs)
+	{
+		try {
+			return rct::verRctSemanticsSimple(rvs);
+		} catch (const std::exception &e) {
+			LOG_PRINT_L0("monero_tx_verification: semantics: " << e.what());
+			return false;
+		}
+	}
+}
+//
+void monero_tx_verification::verify(
+	const vector<const transaction *> &txs,
+	vector<bool> &passed
+) {
+	passed.assign(txs.size(), false);
+	vector<size_t> verifiable_idxs;
+	vector<const rct::rctSig *> rvs;
+	for (size_t i = 0; i < txs.size(); i++) {
+		if (txs[i] != nullptr && _is_verifiable(*txs[i])) {
+			verifiable_idxs.push_back(i);
+			rvs.push_back(&txs[i]->rct_signatures);
+		}
+	}
+	if (rvs.empty()) {
+		return;
+	}
+	// 1. semantics, with one batched bulletproof verification for all txs
+	vector<bool> semantics_ok(rvs.size(), true);
+	if (!_semantics_verified(rvs)) {
+		for (size_t j = 0; j < rvs.size(); j++) {
+			semantics_ok[j] = _semantics_verified({ rvs[j] });
+		}
+	}
+	// 2. ring signatures
+	tools::threadpool &tpool = tools::threadpool::getInstance();
+	tools::threadpool::waiter waiter;
+	vector<char> signatures_ok(rvs.size(), 0); // not vector<bool>: written from several threads
+	for (size_t j = 0; j < rvs.size(); j++) {
+		if (!semantics_ok[j]) {
+			continue;
+		}
+		tpool.submit(&waiter, [&rvs, &signatures_ok, j] () {
+			try {
+				signatures_ok[j] = rct::verRctNonSemanticsSimple(*rvs[j]) ? 1 : 0;
+			} catch (const std::exception &e) {
+				LOG_PRINT_L0("monero_tx_verification: signatures: " << e.what());
+			}
+		});
+	}
+	waiter.wait(&tpool);
+	for (size_t j = 0; j < rvs.size(); j++) {
+		passed[verifiable_idxs[j]] = semantics_ok[j] && signatures_ok[j] != 0;
+	}
+}
+//
+Queue::Queue(size_t max_batch_size)
+	: m_max_batch_size(max_batch_size > 0 ? max_batch_size : 1)
+{
+}
+void Queue::push(const string &session_id, const transaction &tx)
+{
+	boost::lock_guard<boost::mutex> lock(m_mutex);
+	m_pending_session_ids.push_back(session_id);
+	m_pending_txs.push_back(tx); // copied: message and mixRing must come along
+	if (m_pending_txs.size() >= m_max_batch_size) {
+		_verify_pending();
+	}
+}
+vector<string> Queue::flush()
+{
+	boost::lock_guard<boost::mutex> lock(m_mutex);
+	_verify_pending();
+	vector<string> failed;
+	failed.swap(m_failed_session_ids);
+	return failed;
+}
+size_t Queue::pending()
+{
+	boost::lock_guard<boost::mutex> lock(m_mutex);
+	return m_pending_txs.size();
+}
+void Queue::_verify_pending()
+{
+	vector<const transaction *> txs;
+	txs.reserve(m_pending_txs.size());
+	for (const transaction &tx : m_pending_txs) {
+		txs.push_back(&tx);
+	}
+	vector<bool> passed;
+	verify(txs, passed);
+	for (size_t i = 0; i < passed.size(); i++) {
+		if (!passed[i]) {
+			m_failed_session_ids.push_back(m_pending_session_ids[i]);
+		}
+	}
+	m_pending_session_ids.clear();
+	m_pending_txs.clear();
+}
@@ -0,0 +1,79 @@
+//
+//  monero_tx_verification.hpp
+//  Copyright (c) 2014-2019, MyMonero.com
+//
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are
+//  permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright notice, this list of
+//	conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list
+//	of conditions and the following disclaimer in the documentation and/or other
+//	materials provided with the distribution.
+//
+//  3. Neither the name of the copyright holder nor the names of its contributors may be
+//	used to endorse or promote products derived from this software without specific
+//	prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+//  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+//  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+//  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+//  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//
+#ifndef monero_tx_verification_hpp
+#define monero_tx_verification_hpp
+//
+#include <string>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+//
+#include "cryptonote_basic.h"
+//
+namespace monero_tx_verification
+{
+	// Local self-verification of constructed (still in-memory) RingCT txs before they're submitted.
+	// Semantics - including every bulletproof - are checked for the whole batch in one call so the
+	// range proof multiexponentiation is amortized across txs; a batch which fails is re-checked
+	// tx by tx only to find the culprits. Ring signatures can't be batched and are checked in
+	// parallel on the shared threadpool.
+	//
+	// Txs must come straight out of construction: rct_signatures.message and mixRing aren't
+	// serialized, so a tx parsed back from its blob can't be verified here.
+	void verify(
+		const std::vector<const cryptonote::transaction *> &txs,
+		std::vector<bool> &passed // out: one per tx
+	);
+	//
+	// Collects constructed txs from any number of send sessions and verifies them in batches of
+	// up to max_batch_size; failures are reported by the session_id they were pushed with.
+	class Queue
+	{
+	public:
+		static const size_t default_max_batch_size = 16;
+		//
+		Queue(size_t max_batch_size = default_max_batch_size);
+		//
+		void push(const std::string &session_id, const cryptonote::transaction &tx); // may verify a full batch on the calling thread
+		std::vector<std::string> flush(); // verifies anything pending; returns and forgets the failed session_ids so far
+		size_t pending();
+	private:
+		void _verify_pending(); // call with m_mutex held
+		//
+		boost::mutex m_mutex;
+		size_t m_max_batch_size;
+		std::vector<std::string> m_pending_session_ids;
+		std::vector<cryptonote::transaction> m_pending_txs;
+		std::vector<std::string> m_failed_session_ids;
+	};
+}
+//
+#endif /* monero_tx_verification_hpp */
@@ -0,0 +1,212 @@
+//
+//  monero_key_image_store.cpp
+//  Copyright (c) 2014-2019, MyMonero.com
+//
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are
+//  permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright notice, this list of
+//	conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list
+//	of conditions and the following disclaimer in the documentation and/or other
+//	materials provided with the distribution.
+//
+//  3. Neither the name of the copyright holder nor the names of its contributors may be
+//	used to endorse or promote products derived from this software without specific
+//	prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+//  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+//  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+//  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+//  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//
+#include "monero_tx_view.hpp"
+//
+#include <cstring>
+#include "cryptonote_basic/cryptonote_format_utils.h"
+//
+using namespace std;
+using namespace monero_tx_view;
+//
+namespace
+{
+	// Tags and sizes of the binary serialization; see cryptonote_basic.h and rctTypes.h
+	const uint8_t txin_gen_tag = 0xff;
+	const uint8_t txin_to_key_tag = 0x02;
+	const uint8_t txout_to_key_tag = 0x02;
+	const size_t ecdh_info_size = 2 * sizeof(rct::key);
+	const size_t compact_ecdh_info_size = 8; // RCTTypeBulletproof2 keeps only the amount
+	static_assert(sizeof(rct::ecdhTuple) == ecdh_info_size, "ecdhTuple must be its serialized mask and amount");
+	//
+	struct Cursor
+	{
+		const uint8_t *data;
+		size_t size;
+		size_t pos = 0;
+		bool ok = true;
+		//
+		bool skip(size_t n)
+		{
+			ok = ok && size - pos >= n;
+			if (ok) {
+				pos += n;
+			}
+			return ok;
+		}
+		uint8_t byte()
+		{
+			size_t at = pos;
+			return skip(1) ? data[at] : 0;
+		}
+		uint64_t varint()
+		{
+			uint64_t v = 0;
+			for (unsigned shift = 0; ok; shift += 7) {
+				uint8_t b = byte();
+				if (!ok || shift > 63 || (shift == 63 && b > 1)) {
+					ok = false;
+					break;
+				}
+				v |= (uint64_t)(b & 0x7f) << shift;
+				if ((b & 0x80) == 0) {
+					break;
+				}
+			}
+			return v;
+		}
+		bool count(uint64_t &n, size_t min_element_size) // guards reserve() against garbage counts
+		{
+			n = varint();
+			ok = ok && n <= (size - pos) / min_element_size;
+			return ok;
+		}
+	};
+	template<typename T>
+	T _pod_at(const uint8_t *data, size_t offset)
+	{
+		T v;
+		memcpy(&v, data + offset, sizeof(T));
+		return v;
+	}
+}
+//
+bool TxView::parse(const string &blob)
+{
+	*this = TxView();
+	m_data = reinterpret_cast<const uint8_t *>(blob.data());
+	m_size = blob.size();
+	Cursor c{ m_data, m_size };
+	m_version = c.varint();
+	m_unlock_time = c.varint();
+	if (!c.ok || m_version == 0 || m_version > 2) {
+		return false;
+	}
+	uint64_t n;
+	if (!c.count(n, 2)) {
+		return false;
+	}
+	for (uint64_t i = 0; i < n && c.ok; i++) {
+		uint8_t tag = c.byte();
+		if (tag == txin_gen_tag && n == 1) {
+			m_is_coinbase = true;
+			m_coinbase_height = c.varint();
+		} else if (tag == txin_to_key_tag) {
+			c.varint(); // amount
+			uint64_t n_offsets;
+			if (!c.count(n_offsets, 1)) {
+				return false;
+			}
+			for (uint64_t o = 0; o < n_offsets && c.ok; o++) {
+				c.varint();
+			}
+			m_key_image_offsets.push_back(c.pos);
+			c.skip(sizeof(crypto::key_image));
+		} else {
+			return false;
+		}
+	}
+	if (!c.count(n, 1 + 1 + sizeof(crypto::public_key))) {
+		return false;
+	}
+	m_output_amounts.reserve(n);
+	m_output_key_offsets.reserve(n);
+	for (uint64_t i = 0; i < n && c.ok; i++) {
+		m_output_amounts.push_back(c.varint());
+		if (c.byte() != txout_to_key_tag) {
+			return false;
+		}
+		m_output_key_offsets.push_back(c.pos);
+		c.skip(sizeof(crypto::public_key));
+	}
+	m_extra_size = c.varint();
+	m_extra_offset = c.pos;
+	if (!c.ok || !c.skip(m_extra_size)) {
+		return false;
+	}
+	if (m_version == 1) { // the signatures follow; everything needed is in the prefix
+		m_rct_type = rct::RCTTypeNull;
+		m_base_end = c.pos;
+		return true;
+	}
+	m_rct_type = c.byte();
+	if (m_rct_type != rct::RCTTypeNull) {
+		if (m_rct_type != rct::RCTTypeFull && m_rct_type != rct::RCTTypeSimple && m_rct_type != rct::RCTTypeBulletproof && m_rct_type != rct::RCTTypeBulletproof2) {
+			return false;
+		}
+		m_rct_fee = c.varint();
+		if (m_rct_type == rct::RCTTypeSimple) { // pseudo outs moved to the prunable part with bulletproofs
+			c.skip(n_inputs() * sizeof(rct::key));
+		}
+		m_ecdh_offset = c.pos;
+		c.skip(n_outputs() * (m_rct_type == rct::RCTTypeBulletproof2 ? compact_ecdh_info_size : ecdh_info_size));
+		m_out_pk_offset = c.pos;
+		c.skip(n_outputs() * sizeof(rct::key));
+	}
+	m_base_end = c.pos;
+	return c.ok;
+}
+//
+crypto::key_image TxView::key_image(size_t i) const
+{
+	return _pod_at<crypto::key_image>(m_data, m_key_image_offsets[i]);
+}
+crypto::public_key TxView::output_key(size_t i) const
+{
+	return _pod_at<crypto::public_key>(m_data, m_output_key_offsets[i]);
+}
+vector<uint8_t> TxView::extra() const
+{
+	return vector<uint8_t>(m_data + m_extra_offset, m_data + m_extra_offset + m_extra_size);
+}
+bool TxView::tx_pub_key(crypto::public_key &pub_key) const
+{
+	pub_key = cryptonote::get_tx_pub_key_from_extra(extra());
+	return pub_key != crypto::null_pkey;
+}
+vector<crypto::public_key> TxView::additional_tx_pub_keys() const
+{
+	return cryptonote::get_additional_tx_pub_keys_from_extra(extra());
+}
+rct::ecdhTuple TxView::ecdh_info(size_t i) const
+{
+	rct::ecdhTuple info{};
+	if (m_rct_type == rct::RCTTypeBulletproof2) {
+		memcpy(info.amount.bytes, m_data + m_ecdh_offset + i * compact_ecdh_info_size, compact_ecdh_info_size);
+	} else {
+		info = _pod_at<rct::ecdhTuple>(m_data, m_ecdh_offset + i * ecdh_info_size);
+	}
+	return info;
+}
+rct::key TxView::out_pk(size_t i) const
+{
+	return _pod_at<rct::key>(m_data, m_out_pk_offset + i * sizeof(rct::key));
+}
@@ -0,0 +1,95 @@
+//
+//  monero_tx_view.hpp
+//  Copyright (c) 2014-2019, MyMonero.com
+//
+//  All rights reserved.
+//
+//  Redistribution and use in source and binary forms, with or without modification, are
+//  permitted provided that the following conditions are met:
+//
+//  1. Redistributions of source code must retain the above copyright notice, this list of
+//	conditions and the following disclaimer.
+//
+//  2. Redistributions in binary form must reproduce the above copyright notice, this list
+//	of conditions and the following disclaimer in the documentation and/or other
+//	materials provided with the distribution.
+//
+//  3. Neither the name of the copyright holder nor the names of its contributors may be
+//	used to endorse or promote products derived from this software without specific
+//	prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+//  EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+//  MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+//  THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+//  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+//  STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+//  THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//
+#ifndef monero_tx_view_hpp
+#define monero_tx_view_hpp
+//
+#include <string>
+#include <vector>
+#include "crypto.h"
+#include "ringct/rctTypes.h"
+//
+namespace monero_tx_view
+{
+	// A transaction blob indexed by a single walk over its prefix and rct base, for callers which
+	// only need the fields scanning touches. Nothing is decoded until it's asked for, and the
+	// signatures and prunable rct data (bulletproofs, MLSAGs, pseudo outs after bulletproofs) are
+	// never read at all - so, unlike parse_and_validate_tx_from_blob, nothing is validated beyond
+	// the blob being well formed up to the end of the rct base.
+	class TxView
+	{
+	public:
+		// blob must outlive the view. False for malformed blobs and input or output types other
+		// than gen, to_key and to_key outputs.
+		bool parse(const std::string &blob);
+		//
+		uint64_t version() const { return m_version; }
+		uint64_t unlock_time() const { return m_unlock_time; }
+		bool is_coinbase() const { return m_is_coinbase; }
+		uint64_t coinbase_height() const { return m_coinbase_height; } // the gen input's height
+		//
+		size_t n_inputs() const { return m_key_image_offsets.size(); } // to_key inputs only
+		crypto::key_image key_image(size_t i) const;
+		//
+		size_t n_outputs() const { return m_output_key_offsets.size(); }
+		uint64_t output_amount(size_t i) const { return m_output_amounts[i]; } // 0 for rct outputs
+		crypto::public_key output_key(size_t i) const;
+		//
+		std::vector<uint8_t> extra() const;
+		bool tx_pub_key(crypto::public_key &pub_key) const; // false when extra has none
+		std::vector<crypto::public_key> additional_tx_pub_keys() const;
+		//
+		uint8_t rct_type() const { return m_rct_type; } // rct::RCTTypeNull for v1 txs
+		uint64_t rct_fee() const { return m_rct_fee; }
+		rct::ecdhTuple ecdh_info(size_t i) const; // as deserialized: only the amount for RCTTypeBulletproof2
+		rct::key out_pk(size_t i) const; // the output's amount commitment
+		size_t prunable_size() const { return m_size - m_base_end; } // skipped, never walked
+	private:
+		const uint8_t *m_data = nullptr;
+		size_t m_size = 0;
+		uint64_t m_version = 0;
+		uint64_t m_unlock_time = 0;
+		bool m_is_coinbase = false;
+		uint64_t m_coinbase_height = 0;
+		std::vector<size_t> m_key_image_offsets;
+		std::vector<uint64_t> m_output_amounts;
+		std::vector<size_t> m_output_key_offsets;
+		size_t m_extra_offset = 0;
+		size_t m_extra_size = 0;
+		uint8_t m_rct_type = 0;
+		uint64_t m_rct_fee = 0;
+		size_t m_ecdh_offset = 0;
+		size_t m_out_pk_offset = 0;
+		size_t m_base_end = 0;
+	};
+}
+//
+#endif /* monero_tx_view_hpp */
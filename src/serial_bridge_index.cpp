@@ -42,7 +42,12 @@
 #include "monero_paymentID_utils.hpp"
 #include "monero_wallet_utils.hpp"
 #include "monero_key_image_utils.hpp"
+#include "monero_key_image_store.hpp"
+#include "monero_key_derivation_cache.hpp"
+#include "monero_rct_utils.hpp"
+#include "monero_output_scanner.hpp"
 #include "monero_binary_utils.hpp"
+#include "monero_buffer_registry.hpp"
 #include "wallet_errors.h"
 #include "string_tools.h"
 #include "ringct/rctSigs.h"
@@ -59,6 +64,192 @@ using namespace binary_utils;
 using namespace serial_bridge;
 using namespace serial_bridge_utils;
 //
+// Shared argument parsing and return value construction
+namespace
+{
+	vector<SpendableOutput> _spendable_outputs_from_ptree(boost::property_tree::ptree &outputs_ptree)
+	{
+		vector<SpendableOutput> using_outs;
+		BOOST_FOREACH(boost::property_tree::ptree::value_type &output_desc, outputs_ptree)
+		{
+			assert(output_desc.first.empty()); // array elements have no names
+			SpendableOutput out{};
+			out.amount = stoull(output_desc.second.get<string>("amount"));
+			out.public_key = output_desc.second.get<string>("public_key");
+			out.rct = output_desc.second.get_optional<string>("rct");
+			if (out.rct != none && (*out.rct).empty() == true) {
+				out.rct = none; // send to 'none' if empty str for safety
+			}
+			out.global_index = stoull(output_desc.second.get<string>("global_index"));
+			out.index = stoull(output_desc.second.get<string>("index"));
+			out.tx_pub_key = output_desc.second.get<string>("tx_pub_key");
+			//
+			using_outs.push_back(std::move(out));
+		}
+		return using_outs;
+	}
+	CreateTransactionErrorCode _ring_members_from_json(boost::property_tree::ptree &json_root, vector<RingMembers> &ring_members)
+	{
+		vector<RandomAmountOutputs> mix_outs;
+		BOOST_FOREACH(boost::property_tree::ptree::value_type &mix_out_desc, json_root.get_child("mix_outs"))
+		{
+			assert(mix_out_desc.first.empty()); // array elements have no names
+			auto amountAndOuts = RandomAmountOutputs{};
+			amountAndOuts.amount = stoull(mix_out_desc.second.get<string>("amount"));
+			BOOST_FOREACH(boost::property_tree::ptree::value_type &mix_out_output_desc, mix_out_desc.second.get_child("outputs"))
+			{
+				assert(mix_out_output_desc.first.empty()); // array elements have no names
+				auto amountOutput = RandomAmountOutput{};
+				amountOutput.global_index = stoull(mix_out_output_desc.second.get<string>("global_index")); // this is, I believe, presently supplied as a string by the API, probably to avoid overflow
+				amountOutput.public_key = mix_out_output_desc.second.get<string>("public_key");
+				amountOutput.rct = mix_out_output_desc.second.get_optional<string>("rct");
+				amountAndOuts.outputs.push_back(std::move(amountOutput));
+			}
+			mix_outs.push_back(std::move(amountAndOuts));
+		}
+		return new__ring_members(mix_outs, ring_members);
+	}
+	vector<BatchSendSpec> _batch_send_specs_from_json(boost::property_tree::ptree &json_root)
+	{
+		vector<BatchSendSpec> specs;
+		BOOST_FOREACH(boost::property_tree::ptree::value_type &spec_desc, json_root.get_child("specs"))
+		{
+			assert(spec_desc.first.empty()); // array elements have no names
+			BatchSendSpec spec{};
+			spec.to_address_string = spec_desc.second.get<string>("to_address_string");
+			spec.payment_id_string = spec_desc.second.get_optional<string>("payment_id_string");
+			spec.sending_amount = stoull(spec_desc.second.get<string>("sending_amount"));
+			spec.is_sweeping = spec_desc.second.get<bool>("is_sweeping");
+			optional<string> optl__passedIn_attemptAt_fee_string = spec_desc.second.get_optional<string>("passedIn_attemptAt_fee");
+			if (optl__passedIn_attemptAt_fee_string != none) {
+				spec.passedIn_attemptAt_fee = stoull(*optl__passedIn_attemptAt_fee_string);
+			}
+			specs.push_back(std::move(spec));
+		}
+		return specs;
+	}
+	uint8_t _fork_version_from_json(boost::property_tree::ptree &json_root)
+	{
+		uint8_t fork_version = 0; // if missing
+		optional<string> optl__fork_version_string = json_root.get_optional<string>("fork_version");
+		if (optl__fork_version_string != none) {
+			fork_version = stoul(*optl__fork_version_string);
+		}
+		return fork_version;
+	}
+	boost::property_tree::ptree _using_outs_ptree(const vector<SpendableOutput> &using_outs)
+	{
+		boost::property_tree::ptree using_outs_ptree;
+		BOOST_FOREACH(const SpendableOutput &out, using_outs)
+		{ // PROBABLY don't need to shuttle these back (could send only public_key) but consumers might like the feature of being able to send this JSON structure directly back to step2 without reconstructing it for themselves
+			auto out_ptree_pair = std::make_pair("", boost::property_tree::ptree{});
+			auto& out_ptree = out_ptree_pair.second;
+			out_ptree.put("amount", RetVals_Transforms::str_from(out.amount));
+			out_ptree.put("public_key", out.public_key);
+			if (out.rct != none && (*out.rct).empty() == false) {
+				out_ptree.put("rct", *out.rct); 
+			}
+			out_ptree.put("global_index", RetVals_Transforms::str_from(out.global_index));
+			out_ptree.put("index", RetVals_Transforms::str_from(out.index));
+			out_ptree.put("tx_pub_key", out.tx_pub_key);
+			using_outs_ptree.push_back(out_ptree_pair);
+		}
+		return using_outs_ptree;
+	}
+	boost::property_tree::ptree _step1_ret_root(const Send_Step1_RetVals &retVals)
+	{
+		boost::property_tree::ptree root;
+		if (retVals.errCode != noError) {
+			root.put(ret_json_key__any__err_code(), retVals.errCode);
+			root.put(ret_json_key__any__err_msg(), err_msg_from_err_code__create_transaction(retVals.errCode));
+			//
+			// The following will be set if errCode==needMoreMoneyThanFound - and i'm depending on them being 0 otherwise
+			root.put(ret_json_key__send__spendable_balance(), RetVals_Transforms::str_from(retVals.spendable_balance));
+			root.put(ret_json_key__send__required_balance(), RetVals_Transforms::str_from(retVals.required_balance));
+		} else {
+			root.put(ret_json_key__send__mixin(), RetVals_Transforms::str_from(retVals.mixin));
+			root.put(ret_json_key__send__using_fee(), RetVals_Transforms::str_from(retVals.using_fee));
+			root.put(ret_json_key__send__final_total_wo_fee(), RetVals_Transforms::str_from(retVals.final_total_wo_fee));
+			root.put(ret_json_key__send__change_amount(), RetVals_Transforms::str_from(retVals.change_amount));
+			root.add_child(ret_json_key__send__using_outs(), _using_outs_ptree(retVals.using_outs));
+		}
+		return root;
+	}
+	boost::property_tree::ptree _step2_ret_root(const Send_Step2_RetVals &retVals)
+	{
+		boost::property_tree::ptree root;
+		if (retVals.errCode != noError) {
+			root.put(ret_json_key__any__err_code(), retVals.errCode);
+			root.put(ret_json_key__any__err_msg(), err_msg_from_err_code__create_transaction(retVals.errCode));
+		} else {
+			if (retVals.tx_must_be_reconstructed) {
+				root.put(ret_json_key__send__tx_must_be_reconstructed(), true);
+				root.put(ret_json_key__send__fee_actually_needed(), RetVals_Transforms::str_from(retVals.fee_actually_needed)); // must be passed back
+			} else {
+				root.put(ret_json_key__send__tx_must_be_reconstructed(), false); // so consumers have it available
+				root.put(ret_json_key__send__serialized_signed_tx(), *(retVals.signed_serialized_tx_string));
+				root.put(ret_json_key__send__tx_hash(), *(retVals.tx_hash_string));
+				root.put(ret_json_key__send__tx_key(), *(retVals.tx_key_string));
+				root.put(ret_json_key__send__tx_pub_key(), *(retVals.tx_pub_key_string));
+			}
+		}
+		return root;
+	}
+	optional<string> _rv_for_decoding_from_json(boost::property_tree::ptree &rv_desc, rct::rctSig &rv)
+	{ // just type, ecdhInfo and outPk[].mask - what amount decoding reads; it doesn't implement other parts of rv, such as .pseudoOuts
+		unsigned int rv_type_int = stoul(rv_desc.get<string>("type"));
+		if (rv_type_int != rct::RCTTypeNull && rv_type_int != rct::RCTTypeFull && rv_type_int != rct::RCTTypeSimple
+			&& rv_type_int != rct::RCTTypeBulletproof && rv_type_int != rct::RCTTypeBulletproof2) {
+			return string("Invalid 'rv.type'");
+		}
+		rv.type = (uint8_t)rv_type_int;
+		BOOST_FOREACH(boost::property_tree::ptree::value_type &ecdh_info_desc, rv_desc.get_child("ecdhInfo"))
+		{
+			assert(ecdh_info_desc.first.empty()); // array elements have no names
+			auto ecdh_info = rct::ecdhTuple{};
+			if (rv.type == rct::RCTTypeBulletproof2) {
+				if (!epee::string_tools::hex_to_pod(ecdh_info_desc.second.get<string>("amount"), (crypto::hash8&)ecdh_info.amount)) {
+					return string("Invalid rv.ecdhInfo[].amount");
+				}
+			} else {
+				if (!epee::string_tools::hex_to_pod(ecdh_info_desc.second.get<string>("mask"), ecdh_info.mask)) {
+					return string("Invalid rv.ecdhInfo[].mask");
+				}
+				if (!epee::string_tools::hex_to_pod(ecdh_info_desc.second.get<string>("amount"), ecdh_info.amount)) {
+					return string("Invalid rv.ecdhInfo[].amount");
+				}
+			}
+			rv.ecdhInfo.push_back(ecdh_info);
+		}
+		BOOST_FOREACH(boost::property_tree::ptree::value_type &outPk_desc, rv_desc.get_child("outPk"))
+		{
+			assert(outPk_desc.first.empty()); // array elements have no names
+			auto outPk = rct::ctkey{};
+			if (!epee::string_tools::hex_to_pod(outPk_desc.second.get<string>("mask"), outPk.mask)) {
+				return string("Invalid rv.outPk[].mask");
+			}
+			rv.outPk.push_back(outPk);
+		}
+		return none;
+	}
+	std::shared_ptr<const string> _binary_from_json(const boost::property_tree::ptree &json_root)
+	{ // a registered buffer by "handle", read in place; or, as before handles, a copy of "length" bytes at "ptr", as epee's binary loader takes a std::string. Null for unknown handles
+		optional<string> optl__handle_string = json_root.get_optional<string>("handle");
+		if (optl__handle_string != none) {
+			return monero_buffer_registry::acquire(stoull(*optl__handle_string));
+		}
+		const char *ptr = reinterpret_cast<const char *>(static_cast<uintptr_t>(stoull(json_root.get<string>("ptr"))));
+		return std::make_shared<const string>(ptr, stoull(json_root.get<string>("length")));
+	}
+	string _err_ret_json_from_code(CreateTransactionErrorCode code)
+	{
+		boost::property_tree::ptree root;
+		root.put(ret_json_key__any__err_code(), code);
+		root.put(ret_json_key__any__err_msg(), err_msg_from_err_code__create_transaction(code));
+		return ret_json_from_root(root);
+	}
+}
+//
 //
 // Bridge Function Implementations
 //
@@ -321,7 +512,7 @@ string serial_bridge::estimated_tx_network_fee(const string &args_string)
 	uint64_t fee = monero_fee_utils::estimated_tx_network_fee(
 		stoull(json_root.get<string>("fee_per_b")),
 		stoul(json_root.get<string>("priority")),
-		monero_fork_rules::make_use_fork_rules_fn(fork_version)
+		monero_fork_rules::ForkRules(fork_version)
 	);
 	std::ostringstream o;
 	o << fee;
@@ -349,8 +540,8 @@ string serial_bridge::estimate_fee(const string &args_string)
 	uint64_t fee_quantization_mask = stoull(json_root.get<string>("fee_quantization_mask"));
 	uint32_t priority = stoul(json_root.get<string>("priority"));
 	uint8_t fork_version = stoul(json_root.get<string>("fork_version"));
-	use_fork_rules_fn_type use_fork_rules_fn = monero_fork_rules::make_use_fork_rules_fn(fork_version);
-	uint64_t fee_multiplier = monero_fee_utils::get_fee_multiplier(priority, monero_fee_utils::default_priority(), monero_fee_utils::get_fee_algorithm(use_fork_rules_fn), use_fork_rules_fn);
+	ForkRules fork_rules(fork_version);
+	uint64_t fee_multiplier = monero_fee_utils::get_fee_multiplier(priority, monero_fee_utils::default_priority(), monero_fee_utils::get_fee_algorithm(fork_rules), fork_rules);
 	//
 	uint64_t fee = monero_fee_utils::estimate_fee(use_per_byte_fee, use_rct, n_inputs, mixin, n_outputs, extra_size, bulletproof, base_fee, fee_multiplier, fee_quantization_mask);
 	//
@@ -361,6 +552,66 @@ string serial_bridge::estimate_fee(const string &args_string)
 	//
 	return ret_json_from_root(root);
 }
+string serial_bridge::fee_matrix(const string &args_string)
+{
+	boost::property_tree::ptree json_root;
+	if (!parsed_json_root(args_string, json_root)) {
+		return error_ret_json_from_message("Invalid JSON");
+	}
+	//
+	uint64_t min_inputs = stoull(json_root.get<string>("min_inputs", "1"));
+	uint64_t max_inputs = stoull(json_root.get<string>("max_inputs", "16"));
+	uint64_t min_outputs = stoull(json_root.get<string>("min_outputs", "2"));
+	uint64_t max_outputs = stoull(json_root.get<string>("max_outputs", "2"));
+	size_t extra_size = stoul(json_root.get<string>("extra_size", "0"));
+	monero_fee_utils::FeeMatrixRetVals retVals;
+	if (!monero_fee_utils::new__fee_matrix(
+		stoull(json_root.get<string>("fee_per_b")),
+		stoull(json_root.get<string>("fee_mask")),
+		min_inputs, max_inputs,
+		min_outputs, max_outputs,
+		extra_size,
+		monero_fork_rules::ForkRules(_fork_version_from_json(json_root)),
+		retVals
+	)) {
+		return error_ret_json_from_message(*retVals.err_string);
+	}
+	const monero_fee_utils::FeeMatrix &matrix = retVals.matrix;
+	//
+	boost::property_tree::ptree root;
+	{
+		boost::property_tree::ptree priorities_ptree;
+		for (uint32_t priority : matrix.priorities) {
+			priorities_ptree.push_back(std::make_pair("", boost::property_tree::ptree(RetVals_Transforms::str_from(priority))));
+		}
+		root.add_child(ret_json_key__fee_matrix__priorities(), priorities_ptree);
+	}
+	{
+		boost::property_tree::ptree n_inputs_ptree;
+		n_inputs_ptree.push_back(std::make_pair("", boost::property_tree::ptree(RetVals_Transforms::str_from((uint32_t)matrix.min_inputs))));
+		n_inputs_ptree.push_back(std::make_pair("", boost::property_tree::ptree(RetVals_Transforms::str_from((uint32_t)matrix.max_inputs))));
+		root.add_child(ret_json_key__fee_matrix__n_inputs(), n_inputs_ptree);
+		boost::property_tree::ptree n_outputs_ptree;
+		n_outputs_ptree.push_back(std::make_pair("", boost::property_tree::ptree(RetVals_Transforms::str_from((uint32_t)matrix.min_outputs))));
+		n_outputs_ptree.push_back(std::make_pair("", boost::property_tree::ptree(RetVals_Transforms::str_from((uint32_t)matrix.max_outputs))));
+		root.add_child(ret_json_key__fee_matrix__n_outputs(), n_outputs_ptree);
+	}
+	boost::property_tree::ptree fees_ptree;
+	for (size_t p = 0; p < matrix.priorities.size(); p++) {
+		boost::property_tree::ptree by_n_inputs_ptree;
+		for (int n_inputs = matrix.min_inputs; n_inputs <= matrix.max_inputs; n_inputs++) {
+			boost::property_tree::ptree by_n_outputs_ptree;
+			for (int n_outputs = matrix.min_outputs; n_outputs <= matrix.max_outputs; n_outputs++) {
+				by_n_outputs_ptree.push_back(std::make_pair("", boost::property_tree::ptree(RetVals_Transforms::str_from(matrix.fee(p, n_inputs, n_outputs)))));
+			}
+			by_n_inputs_ptree.push_back(std::make_pair("", by_n_outputs_ptree));
+		}
+		fees_ptree.push_back(std::make_pair("", by_n_inputs_ptree));
+	}
+	root.add_child(ret_json_key__fee_matrix__fees(), fees_ptree);
+	//
+	return ret_json_from_root(root);
+}
 string serial_bridge::estimate_tx_weight(const string &args_string)
 {
 	boost::property_tree::ptree json_root;
@@ -430,7 +681,7 @@ string serial_bridge::generate_key_image(const string &args_string)
 		THROW_WALLET_EXCEPTION_IF(!r, error::wallet_internal_error, "Invalid tx pub key");
 	}
 	monero_key_image_utils::KeyImageRetVals retVals;
-	bool r = monero_key_image_utils::new__key_image(
+	bool r = monero_key_image_store::new__key_image( // reads and fills the key image store when one is open
 		pub_spendKey, sec_spendKey, sec_viewKey, tx_pub_key,
 		stoull(json_root.get<string>("out_index")),
 		retVals
@@ -443,6 +694,80 @@ string serial_bridge::generate_key_image(const string &args_string)
 	//
 	return ret_json_from_root(root);
 }
+string serial_bridge::generate_key_images(const string &args_string)
+{
+	boost::property_tree::ptree json_root;
+	if (!parsed_json_root(args_string, json_root)) {
+		// it will already have thrown an exception
+		return error_ret_json_from_message("Invalid JSON");
+	}
+	crypto::secret_key sec_viewKey{};
+	crypto::secret_key sec_spendKey{};
+	crypto::public_key pub_spendKey{};
+	{
+		bool r = false;
+		r = epee::string_tools::hex_to_pod(std::string(json_root.get<string>("sec_viewKey_string")), sec_viewKey);
+		THROW_WALLET_EXCEPTION_IF(!r, error::wallet_internal_error, "Invalid secret view key");
+		r = epee::string_tools::hex_to_pod(std::string(json_root.get<string>("sec_spendKey_string")), sec_spendKey);
+		THROW_WALLET_EXCEPTION_IF(!r, error::wallet_internal_error, "Invalid secret spend key");
+		r = epee::string_tools::hex_to_pod(std::string(json_root.get<string>("pub_spendKey_string")), pub_spendKey);
+		THROW_WALLET_EXCEPTION_IF(!r, error::wallet_internal_error, "Invalid public spend key");
+	}
+	vector<monero_key_image_utils::KeyImageOutput> outputs;
+	BOOST_FOREACH(boost::property_tree::ptree::value_type &output_desc, json_root.get_child("outputs"))
+	{
+		assert(output_desc.first.empty()); // array elements have no names
+		monero_key_image_utils::KeyImageOutput output;
+		if (!epee::string_tools::hex_to_pod(output_desc.second.get<string>("tx_pub_key"), output.tx_public_key)) {
+			return error_ret_json_from_message("Invalid tx pub key");
+		}
+		output.out_index = stoull(output_desc.second.get<string>("out_index"));
+		outputs.push_back(output);
+	}
+	optional<bool> verify = json_root.get_optional<bool>("verify"); // optl; defaults to true
+	monero_key_image_utils::KeyImagesRetVals retVals;
+	bool r = monero_key_image_store::new__key_images(
+		pub_spendKey, sec_spendKey, sec_viewKey,
+		outputs,
+		verify == none || *verify,
+		retVals
+	);
+	if (!r) {
+		return error_ret_json_from_message("Unable to generate key images");
+	}
+	boost::property_tree::ptree root;
+	boost::property_tree::ptree key_images_ptree;
+	for (const crypto::key_image &key_image : retVals.calculated_key_images) {
+		key_images_ptree.push_back(std::make_pair("", boost::property_tree::ptree(epee::string_tools::pod_to_hex(key_image))));
+	}
+	root.add_child(ret_json_key__key_images(), key_images_ptree);
+	//
+	return ret_json_from_root(root);
+}
+string serial_bridge::open_key_image_store(const string &args_string)
+{
+	boost::property_tree::ptree json_root;
+	if (!parsed_json_root(args_string, json_root)) {
+		// it will already have thrown an exception
+		return error_ret_json_from_message("Invalid JSON");
+	}
+	string err_string;
+	if (!monero_key_image_store::open(json_root.get<string>("directory"), err_string)) {
+		return error_ret_json_from_message(err_string);
+	}
+	boost::property_tree::ptree root;
+	root.put(ret_json_key__generic_retVal(), true);
+	//
+	return ret_json_from_root(root);
+}
+string serial_bridge::close_key_image_store(const string &args_string)
+{
+	monero_key_image_store::close();
+	boost::property_tree::ptree root;
+	root.put(ret_json_key__generic_retVal(), true);
+	//
+	return ret_json_from_root(root);
+}
 //
 string serial_bridge::send_step1__prepare_params_for_get_decoys(const string &args_string)
 { // TODO: possibly allow this fn to take tx sec key as an arg, although, random bit gen is now handled well by emscripten
@@ -487,46 +812,14 @@ string serial_bridge::send_step1__prepare_params_for_get_decoys(const string &ar
 		stoull(json_root.get<string>("sending_amount")),
 		json_root.get<bool>("is_sweeping"),
 		stoul(json_root.get<string>("priority")),
-		monero_fork_rules::make_use_fork_rules_fn(fork_version),
+		monero_fork_rules::ForkRules(fork_version),
 		unspent_outs,
 		stoull(json_root.get<string>("fee_per_b")), // per v8
 		stoull(json_root.get<string>("fee_mask")),
 		//
 		optl__passedIn_attemptAt_fee // use this for passing step2 "must-reconstruct" return values back in, i.e. re-entry; when nil, defaults to attempt at network min
 	);
-	boost::property_tree::ptree root;
-	if (retVals.errCode != noError) {
-		root.put(ret_json_key__any__err_code(), retVals.errCode);
-		root.put(ret_json_key__any__err_msg(), err_msg_from_err_code__create_transaction(retVals.errCode));
-		//
-		// The following will be set if errCode==needMoreMoneyThanFound - and i'm depending on them being 0 otherwise
-		root.put(ret_json_key__send__spendable_balance(), RetVals_Transforms::str_from(retVals.spendable_balance));
-		root.put(ret_json_key__send__required_balance(), RetVals_Transforms::str_from(retVals.required_balance));
-	} else {
-		root.put(ret_json_key__send__mixin(), RetVals_Transforms::str_from(retVals.mixin));
-		root.put(ret_json_key__send__using_fee(), RetVals_Transforms::str_from(retVals.using_fee));
-		root.put(ret_json_key__send__final_total_wo_fee(), RetVals_Transforms::str_from(retVals.final_total_wo_fee));
-		root.put(ret_json_key__send__change_amount(), RetVals_Transforms::str_from(retVals.change_amount));
-		{
-			boost::property_tree::ptree using_outs_ptree;
-			BOOST_FOREACH(SpendableOutput &out, retVals.using_outs)
-			{ // PROBABLY don't need to shuttle these back (could send only public_key) but consumers might like the feature of being able to send this JSON structure directly back to step2 without reconstructing it for themselves
-				auto out_ptree_pair = std::make_pair("", boost::property_tree::ptree{});
- 				auto& out_ptree = out_ptree_pair.second;
-				out_ptree.put("amount", RetVals_Transforms::str_from(out.amount));
-				out_ptree.put("public_key", out.public_key);
-				if (out.rct != none && (*out.rct).empty() == false) {
-					out_ptree.put("rct", *out.rct); 
-				}
-				out_ptree.put("global_index", RetVals_Transforms::str_from(out.global_index));
-				out_ptree.put("index", RetVals_Transforms::str_from(out.index));
-				out_ptree.put("tx_pub_key", out.tx_pub_key);
-				using_outs_ptree.push_back(out_ptree_pair);
-			}
-			root.add_child(ret_json_key__send__using_outs(), using_outs_ptree);
-		}
-	}
-	return ret_json_from_root(root);
+	return ret_json_from_root(_step1_ret_root(retVals));
 }
 string serial_bridge::send_step2__try_create_transaction(const string &args_string)
 {
@@ -536,82 +829,226 @@ string serial_bridge::send_step2__try_create_transaction(const string &args_stri
 		return error_ret_json_from_message("Invalid JSON");
 	}
 	//
-	vector<SpendableOutput> using_outs;
-	BOOST_FOREACH(boost::property_tree::ptree::value_type &output_desc, json_root.get_child("using_outs"))
-	{
-		assert(output_desc.first.empty()); // array elements have no names
-		SpendableOutput out{};
-		out.amount = stoull(output_desc.second.get<string>("amount"));
-		out.public_key = output_desc.second.get<string>("public_key");
-		out.rct = output_desc.second.get_optional<string>("rct");
-		if (out.rct != none && (*out.rct).empty() == true) {
-			out.rct = none; // send to 'none' if empty str for safety
-		}
-		out.global_index = stoull(output_desc.second.get<string>("global_index"));
-		out.index = stoull(output_desc.second.get<string>("index"));
-		out.tx_pub_key = output_desc.second.get<string>("tx_pub_key");
+	vector<SpendableOutput> using_outs = _spendable_outputs_from_ptree(json_root.get_child("using_outs"));
+	vector<RingMembers> ring_members;
+	CreateTransactionErrorCode ring_members_code = _ring_members_from_json(json_root, ring_members);
+	if (ring_members_code != noError) {
+		return _err_ret_json_from_code(ring_members_code);
+	}
+	uint8_t fork_version = _fork_version_from_json(json_root);
+	optional<bool> self_verify = json_root.get_optional<bool>("self_verify"); // optl
+	Send_Step2_RetVals retVals;
+	monero_transfer_utils::send_step2__try_create_transaction(
+		retVals,
 		//
-		using_outs.push_back(std::move(out));
+		json_root.get<string>("from_address_string"),
+		json_root.get<string>("sec_viewKey_string"),
+		json_root.get<string>("sec_spendKey_string"),
+		json_root.get<string>("to_address_string"),
+		json_root.get_optional<string>("payment_id_string"),
+		stoull(json_root.get<string>("final_total_wo_fee")),
+		stoull(json_root.get<string>("change_amount")),
+		stoull(json_root.get<string>("fee_amount")),
+		stoul(json_root.get<string>("priority")),
+		using_outs,
+		stoull(json_root.get<string>("fee_per_b")),
+		stoull(json_root.get<string>("fee_mask")),
+		ring_members,
+		monero_fork_rules::ForkRules(fork_version),
+		stoull(json_root.get<string>("unlock_time")),
+		nettype_from_string(json_root.get<string>("nettype_string")),
+		self_verify != none && *self_verify
+	);
+	return ret_json_from_root(_step2_ret_root(retVals));
+}
+//
+string serial_bridge::create_transactions_batch__prepare_params_for_get_decoys(const string &args_string)
+{
+	boost::property_tree::ptree json_root;
+	if (!parsed_json_root(args_string, json_root)) {
+		// it will already have thrown an exception
+		return error_ret_json_from_message("Invalid JSON");
 	}
-	vector<RandomAmountOutputs> mix_outs;
-	BOOST_FOREACH(boost::property_tree::ptree::value_type &mix_out_desc, json_root.get_child("mix_outs"))
+	vector<BatchSendSpec> specs = _batch_send_specs_from_json(json_root);
+	vector<SpendableOutput> unspent_outs = _spendable_outputs_from_ptree(json_root.get_child("unspent_outs"));
+	BatchSend_Step1_RetVals retVals;
+	monero_transfer_utils::create_transactions_batch__prepare_params_for_get_decoys(
+		retVals,
+		specs,
+		stoul(json_root.get<string>("priority")),
+		monero_fork_rules::ForkRules(_fork_version_from_json(json_root)),
+		unspent_outs,
+		stoull(json_root.get<string>("fee_per_b")), // per v8
+		stoull(json_root.get<string>("fee_mask"))
+	);
+	boost::property_tree::ptree root;
 	{
-		assert(mix_out_desc.first.empty()); // array elements have no names
-		auto amountAndOuts = RandomAmountOutputs{};
-		amountAndOuts.amount = stoull(mix_out_desc.second.get<string>("amount"));
-		BOOST_FOREACH(boost::property_tree::ptree::value_type &mix_out_output_desc, mix_out_desc.second.get_child("outputs"))
-		{
-			assert(mix_out_output_desc.first.empty()); // array elements have no names
-			auto amountOutput = RandomAmountOutput{};
-			amountOutput.global_index = stoull(mix_out_output_desc.second.get<string>("global_index")); // this is, I believe, presently supplied as a string by the API, probably to avoid overflow
-			amountOutput.public_key = mix_out_output_desc.second.get<string>("public_key");
-			amountOutput.rct = mix_out_output_desc.second.get_optional<string>("rct");
-			amountAndOuts.outputs.push_back(std::move(amountOutput));
+		boost::property_tree::ptree per_spec_ptree;
+		for (const Send_Step1_RetVals &spec_retVals : retVals.per_spec) {
+			per_spec_ptree.push_back(std::make_pair("", _step1_ret_root(spec_retVals)));
 		}
-		mix_outs.push_back(std::move(amountAndOuts));
+		root.add_child(ret_json_key__send__per_spec(), per_spec_ptree);
 	}
-	uint8_t fork_version = 0; // if missing
-	optional<string> optl__fork_version_string = json_root.get_optional<string>("fork_version");
-	if (optl__fork_version_string != none) {
-		fork_version = stoul(*optl__fork_version_string);
+	// request decoys for these, in this order, with one RandomOuts call
+	root.add_child(ret_json_key__send__using_outs(), _using_outs_ptree(retVals.using_outs_for_decoys));
+	return ret_json_from_root(root);
+}
+string serial_bridge::create_transactions_batch(const string &args_string)
+{
+	boost::property_tree::ptree json_root;
+	if (!parsed_json_root(args_string, json_root)) {
+		// it will already have thrown an exception
+		return error_ret_json_from_message("Invalid JSON");
 	}
-	Send_Step2_RetVals retVals;
-	monero_transfer_utils::send_step2__try_create_transaction(
+	vector<BatchSendSpec> specs = _batch_send_specs_from_json(json_root);
+	BatchSend_Step1_RetVals step1_retVals;
+	BOOST_FOREACH(boost::property_tree::ptree::value_type &spec_desc, json_root.get_child("per_spec"))
+	{ // as returned by create_transactions_batch__prepare_params_for_get_decoys
+		assert(spec_desc.first.empty()); // array elements have no names
+		Send_Step1_RetVals spec_step1{};
+		optional<uint32_t> err_code = spec_desc.second.get_optional<uint32_t>(ret_json_key__any__err_code());
+		spec_step1.errCode = err_code != none ? (CreateTransactionErrorCode)*err_code : noError;
+		if (spec_step1.errCode == noError) {
+			spec_step1.mixin = stoul(spec_desc.second.get<string>(ret_json_key__send__mixin()));
+			spec_step1.using_fee = stoull(spec_desc.second.get<string>(ret_json_key__send__using_fee()));
+			spec_step1.final_total_wo_fee = stoull(spec_desc.second.get<string>(ret_json_key__send__final_total_wo_fee()));
+			spec_step1.change_amount = stoull(spec_desc.second.get<string>(ret_json_key__send__change_amount()));
+			spec_step1.using_outs = _spendable_outputs_from_ptree(spec_desc.second.get_child(ret_json_key__send__using_outs()));
+			step1_retVals.using_outs_for_decoys.insert(step1_retVals.using_outs_for_decoys.end(), spec_step1.using_outs.begin(), spec_step1.using_outs.end());
+		}
+		step1_retVals.per_spec.push_back(std::move(spec_step1));
+	}
+	if (step1_retVals.per_spec.size() != specs.size()) {
+		return error_ret_json_from_message("Expected one 'per_spec' entry per spec");
+	}
+	vector<RingMembers> ring_members;
+	CreateTransactionErrorCode ring_members_code = _ring_members_from_json(json_root, ring_members);
+	if (ring_members_code != noError) {
+		return _err_ret_json_from_code(ring_members_code);
+	}
+	optional<bool> self_verify = json_root.get_optional<bool>("self_verify"); // optl
+	vector<Send_Step2_RetVals> retVals;
+	monero_transfer_utils::create_transactions_batch(
 		retVals,
 		//
 		json_root.get<string>("from_address_string"),
 		json_root.get<string>("sec_viewKey_string"),
 		json_root.get<string>("sec_spendKey_string"),
+		specs,
+		step1_retVals,
+		stoul(json_root.get<string>("priority")),
+		stoull(json_root.get<string>("fee_per_b")),
+		stoull(json_root.get<string>("fee_mask")),
+		ring_members,
+		monero_fork_rules::ForkRules(_fork_version_from_json(json_root)),
+		stoull(json_root.get<string>("unlock_time")),
+		nettype_from_string(json_root.get<string>("nettype_string")),
+		self_verify != none && *self_verify
+	);
+	boost::property_tree::ptree root;
+	boost::property_tree::ptree per_spec_ptree;
+	for (const Send_Step2_RetVals &spec_retVals : retVals) {
+		per_spec_ptree.push_back(std::make_pair("", _step2_ret_root(spec_retVals)));
+	}
+	root.add_child(ret_json_key__send__per_spec(), per_spec_ptree);
+	//
+	return ret_json_from_root(root);
+}
+//
+string serial_bridge::prepare_transaction(const string &args_string)
+{
+	boost::property_tree::ptree json_root;
+	if (!parsed_json_root(args_string, json_root)) {
+		// it will already have thrown an exception
+		return error_ret_json_from_message("Invalid JSON");
+	}
+	vector<SpendableOutput> using_outs = _spendable_outputs_from_ptree(json_root.get_child("using_outs"));
+	vector<RingMembers> ring_members;
+	CreateTransactionErrorCode ring_members_code = _ring_members_from_json(json_root, ring_members);
+	if (ring_members_code != noError) {
+		return _err_ret_json_from_code(ring_members_code);
+	}
+	PrepareTransaction_RetVals retVals;
+	monero_transfer_utils::convenience__prepare_transaction(
+		retVals,
+		json_root.get<string>("from_address_string"),
+		json_root.get<string>("sec_viewKey_string"),
 		json_root.get<string>("to_address_string"),
 		json_root.get_optional<string>("payment_id_string"),
 		stoull(json_root.get<string>("final_total_wo_fee")),
 		stoull(json_root.get<string>("change_amount")),
 		stoull(json_root.get<string>("fee_amount")),
-		stoul(json_root.get<string>("priority")),
 		using_outs,
-		stoull(json_root.get<string>("fee_per_b")),
-		stoull(json_root.get<string>("fee_mask")),
-		mix_outs,
-		monero_fork_rules::make_use_fork_rules_fn(fork_version),
+		ring_members,
+		monero_fork_rules::ForkRules(_fork_version_from_json(json_root)),
 		stoull(json_root.get<string>("unlock_time")),
 		nettype_from_string(json_root.get<string>("nettype_string"))
 	);
+	if (retVals.errCode != noError) {
+		return _err_ret_json_from_code(retVals.errCode);
+	}
 	boost::property_tree::ptree root;
+	root.put(ret_json_key__send__unsigned_tx(), epee::string_tools::buff_to_hex_nodelimer(encode_unsigned_transaction(*retVals.unsigned_tx)));
+	//
+	return ret_json_from_root(root);
+}
+string serial_bridge::sign_transaction(const string &args_string)
+{
+	boost::property_tree::ptree json_root;
+	if (!parsed_json_root(args_string, json_root)) {
+		// it will already have thrown an exception
+		return error_ret_json_from_message("Invalid JSON");
+	}
+	std::string unsigned_tx_blob;
+	UnsignedTransaction unsigned_tx;
+	if (!epee::string_tools::parse_hexstr_to_binbuff(json_root.get<string>("unsigned_tx"), unsigned_tx_blob)
+		|| !decode_unsigned_transaction(unsigned_tx_blob, unsigned_tx)) {
+		return _err_ret_json_from_code(couldntDecodeStagedTransaction);
+	}
+	TransactionConstruction_RetVals retVals;
+	monero_transfer_utils::convenience__sign_transaction(
+		retVals,
+		unsigned_tx,
+		json_root.get<string>("from_address_string"),
+		json_root.get<string>("sec_viewKey_string"),
+		json_root.get<string>("sec_spendKey_string"),
+		monero_fork_rules::ForkRules(_fork_version_from_json(json_root)),
+		nettype_from_string(json_root.get<string>("nettype_string"))
+	);
 	if (retVals.errCode != noError) {
-		root.put(ret_json_key__any__err_code(), retVals.errCode);
-		root.put(ret_json_key__any__err_msg(), err_msg_from_err_code__create_transaction(retVals.errCode));
-	} else {
-		if (retVals.tx_must_be_reconstructed) {
-			root.put(ret_json_key__send__tx_must_be_reconstructed(), true);
-			root.put(ret_json_key__send__fee_actually_needed(), RetVals_Transforms::str_from(retVals.fee_actually_needed)); // must be passed back
-		} else {
-			root.put(ret_json_key__send__tx_must_be_reconstructed(), false); // so consumers have it available
-			root.put(ret_json_key__send__serialized_signed_tx(), *(retVals.signed_serialized_tx_string));
-			root.put(ret_json_key__send__tx_hash(), *(retVals.tx_hash_string));
-			root.put(ret_json_key__send__tx_key(), *(retVals.tx_key_string));
-			root.put(ret_json_key__send__tx_pub_key(), *(retVals.tx_pub_key_string));
-		}
+		return _err_ret_json_from_code(retVals.errCode);
 	}
+	boost::property_tree::ptree root;
+	root.put(ret_json_key__send__signed_tx(), epee::string_tools::buff_to_hex_nodelimer(encode_signed_transaction(retVals)));
+	//
+	return ret_json_from_root(root);
+}
+string serial_bridge::finalize_transaction(const string &args_string)
+{
+	boost::property_tree::ptree json_root;
+	if (!parsed_json_root(args_string, json_root)) {
+		// it will already have thrown an exception
+		return error_ret_json_from_message("Invalid JSON");
+	}
+	std::string signed_tx_blob;
+	TransactionConstruction_RetVals signed_tx;
+	if (!epee::string_tools::parse_hexstr_to_binbuff(json_root.get<string>("signed_tx"), signed_tx_blob)
+		|| !decode_signed_transaction(signed_tx_blob, signed_tx)) {
+		return _err_ret_json_from_code(couldntDecodeStagedTransaction);
+	}
+	Convenience_TransactionConstruction_RetVals retVals;
+	monero_transfer_utils::finalize_transaction(retVals, signed_tx);
+	if (retVals.errCode != noError) {
+		return _err_ret_json_from_code(retVals.errCode);
+	}
+	//
+	boost::property_tree::ptree root;
+	root.put(ret_json_key__send__serialized_signed_tx(), *(retVals.signed_serialized_tx_string));
+	root.put(ret_json_key__send__tx_hash(), *(retVals.tx_hash_string));
+	root.put(ret_json_key__send__tx_key(), *(retVals.tx_key_string));
+	root.put(ret_json_key__send__tx_pub_key(), *(retVals.tx_pub_key_string));
+	root.put(ret_json_key__send__tx_weight(), RetVals_Transforms::str_from(*(retVals.tx_weight)));
+	//
 	return ret_json_from_root(root);
 }
 //
@@ -627,45 +1064,10 @@ string serial_bridge::decodeRct(const string &args_string)
 		return error_ret_json_from_message("Invalid 'sk'");
 	}
 	unsigned int i = stoul(json_root.get<string>("i"));
-	// NOTE: this rv structure parsing could be factored but it presently does not implement a number of sub-components of rv, such as .pseudoOuts
-	auto rv_desc = json_root.get_child("rv");
 	rct::rctSig rv = AUTO_VAL_INIT(rv);
-	unsigned int rv_type_int = stoul(rv_desc.get<string>("type"));
-	// got to be a better way to do this
-	if (rv_type_int == rct::RCTTypeNull) {
-		rv.type = rct::RCTTypeNull;
-	} else if (rv_type_int == rct::RCTTypeSimple) {
-		rv.type = rct::RCTTypeSimple;
-	} else if (rv_type_int == rct::RCTTypeFull) {
-		rv.type = rct::RCTTypeFull;
-	} else if (rv_type_int == rct::RCTTypeBulletproof) {
-		rv.type = rct::RCTTypeBulletproof;
-	} else if (rv_type_int == rct::RCTTypeBulletproof2) {
-		rv.type = rct::RCTTypeBulletproof2;
-	} else {
-		return error_ret_json_from_message("Invalid 'rv.type'");
-	}
-	BOOST_FOREACH(boost::property_tree::ptree::value_type &ecdh_info_desc, rv_desc.get_child("ecdhInfo"))
-	{
-		assert(ecdh_info_desc.first.empty()); // array elements have no names
-		auto ecdh_info = rct::ecdhTuple{};
-		if (!epee::string_tools::hex_to_pod(ecdh_info_desc.second.get<string>("mask"), ecdh_info.mask)) {
-			return error_ret_json_from_message("Invalid rv.ecdhInfo[].mask");
-		}
-		if (!epee::string_tools::hex_to_pod(ecdh_info_desc.second.get<string>("amount"), ecdh_info.amount)) {
-			return error_ret_json_from_message("Invalid rv.ecdhInfo[].amount");
-		}
-		rv.ecdhInfo.push_back(ecdh_info); // rct keys aren't movable
-	}
-	BOOST_FOREACH(boost::property_tree::ptree::value_type &outPk_desc, rv_desc.get_child("outPk"))
-	{
-		assert(outPk_desc.first.empty()); // array elements have no names
-		auto outPk = rct::ctkey{};
-		if (!epee::string_tools::hex_to_pod(outPk_desc.second.get<string>("mask"), outPk.mask)) {
-			return error_ret_json_from_message("Invalid rv.outPk[].mask");
-		}
-		// FIXME: does dest need to be placed on the key?
-		rv.outPk.push_back(outPk); // rct keys aren't movable
+	optional<string> err_msg = _rv_for_decoding_from_json(json_root.get_child("rv"), rv);
+	if (err_msg != none) {
+		return error_ret_json_from_message(*err_msg);
 	}
 	//
 	rct::key mask;
@@ -700,51 +1102,10 @@ string serial_bridge::decodeRctSimple(const string &args_string)
 		return error_ret_json_from_message("Invalid 'sk'");
 	}
 	unsigned int i = stoul(json_root.get<string>("i"));
-	// NOTE: this rv structure parsing could be factored but it presently does not implement a number of sub-components of rv, such as .pseudoOuts
-	auto rv_desc = json_root.get_child("rv");
 	rct::rctSig rv = AUTO_VAL_INIT(rv);
-	unsigned int rv_type_int = stoul(rv_desc.get<string>("type"));
-	// got to be a better way to do this
-	if (rv_type_int == rct::RCTTypeNull) {
-		rv.type = rct::RCTTypeNull;
-	} else if (rv_type_int == rct::RCTTypeSimple) {
-		rv.type = rct::RCTTypeSimple;
-	} else if (rv_type_int == rct::RCTTypeFull) {
-		rv.type = rct::RCTTypeFull;
-	} else if (rv_type_int == rct::RCTTypeBulletproof) {
-		rv.type = rct::RCTTypeBulletproof;
-	} else if (rv_type_int == rct::RCTTypeBulletproof2) {
-		rv.type = rct::RCTTypeBulletproof2;
-	} else {
-		return error_ret_json_from_message("Invalid 'rv.type'");
-	}
-	BOOST_FOREACH(boost::property_tree::ptree::value_type &ecdh_info_desc, rv_desc.get_child("ecdhInfo"))
-	{
-		assert(ecdh_info_desc.first.empty()); // array elements have no names
-		auto ecdh_info = rct::ecdhTuple{};
-		if (rv.type == rct::RCTTypeBulletproof2) {
-			if (!epee::string_tools::hex_to_pod(ecdh_info_desc.second.get<string>("amount"), (crypto::hash8&)ecdh_info.amount)) {
-				return error_ret_json_from_message("Invalid rv.ecdhInfo[].amount");
-			}
-		} else {
-			if (!epee::string_tools::hex_to_pod(ecdh_info_desc.second.get<string>("mask"), ecdh_info.mask)) {
-				return error_ret_json_from_message("Invalid rv.ecdhInfo[].mask");
-			}
-			if (!epee::string_tools::hex_to_pod(ecdh_info_desc.second.get<string>("amount"), ecdh_info.amount)) {
-				return error_ret_json_from_message("Invalid rv.ecdhInfo[].amount");
-			}
-		}
-		rv.ecdhInfo.push_back(ecdh_info);
-	}
-	BOOST_FOREACH(boost::property_tree::ptree::value_type &outPk_desc, rv_desc.get_child("outPk"))
-	{
-		assert(outPk_desc.first.empty()); // array elements have no names
-		auto outPk = rct::ctkey{};
-		if (!epee::string_tools::hex_to_pod(outPk_desc.second.get<string>("mask"), outPk.mask)) {
-			return error_ret_json_from_message("Invalid rv.outPk[].mask");
-		}
-		// FIXME: does dest need to be placed on the key?
-		rv.outPk.push_back(outPk);
+	optional<string> err_msg = _rv_for_decoding_from_json(json_root.get_child("rv"), rv);
+	if (err_msg != none) {
+		return error_ret_json_from_message(*err_msg);
 	}
 	//
 	rct::key mask;
@@ -766,6 +1127,73 @@ string serial_bridge::decodeRctSimple(const string &args_string)
 	//
 	return ret_json_from_root(root);	
 }
+string serial_bridge::decode_amounts(const string &args_string)
+{
+	boost::property_tree::ptree json_root;
+	if (!parsed_json_root(args_string, json_root)) {
+		// it will already have thrown an exception
+		return error_ret_json_from_message("Invalid JSON");
+	}
+	crypto::secret_key sec_viewKey = crypto::null_skey; // optl; needed for any tx given without a derivation
+	optional<string> optl__sec_viewKey_string = json_root.get_optional<string>("sec_viewKey_string");
+	if (optl__sec_viewKey_string != none && !epee::string_tools::hex_to_pod(*optl__sec_viewKey_string, sec_viewKey)) {
+		return error_ret_json_from_message("Invalid secret view key");
+	}
+	vector<monero_rct_utils::TxAmountsToDecode> txs;
+	BOOST_FOREACH(boost::property_tree::ptree::value_type &tx_desc, json_root.get_child("txs"))
+	{
+		assert(tx_desc.first.empty()); // array elements have no names
+		txs.emplace_back();
+		monero_rct_utils::TxAmountsToDecode &tx = txs.back();
+		tx.rv = AUTO_VAL_INIT(tx.rv);
+		optional<string> err_msg = _rv_for_decoding_from_json(tx_desc.second.get_child("rv"), tx.rv);
+		if (err_msg != none) {
+			return error_ret_json_from_message(*err_msg);
+		}
+		optional<string> optl__derivation_string = tx_desc.second.get_optional<string>("derivation");
+		if (optl__derivation_string != none) {
+			crypto::key_derivation derivation;
+			if (!epee::string_tools::hex_to_pod(*optl__derivation_string, derivation)) {
+				return error_ret_json_from_message("Invalid 'derivation'");
+			}
+			tx.derivation = derivation;
+		} else {
+			if (optl__sec_viewKey_string == none) {
+				return error_ret_json_from_message("Expected a 'derivation' or 'sec_viewKey_string'");
+			}
+			if (!epee::string_tools::hex_to_pod(tx_desc.second.get<string>("tx_pub_key"), tx.tx_pub_key)) {
+				return error_ret_json_from_message("Invalid tx pub key");
+			}
+		}
+		BOOST_FOREACH(boost::property_tree::ptree::value_type &index_desc, tx_desc.second.get_child("indices"))
+		{
+			tx.out_indices.push_back(stoull(index_desc.second.data()));
+		}
+	}
+	monero_rct_utils::DecodeAmountsRetVals retVals;
+	if (!monero_rct_utils::decode_amounts(txs, sec_viewKey, retVals)) {
+		return error_ret_json_from_message(*retVals.err_string);
+	}
+	boost::property_tree::ptree root;
+	boost::property_tree::ptree txs_ptree;
+	for (const vector<monero_rct_utils::DecodedAmount> &tx_decoded : retVals.decoded) {
+		boost::property_tree::ptree tx_ptree;
+		for (const monero_rct_utils::DecodedAmount &decoded : tx_decoded) {
+			boost::property_tree::ptree decoded_ptree;
+			if (decoded.did_error) {
+				decoded_ptree.put(ret_json_key__any__err_msg(), "Unable to decode amount");
+			} else {
+				decoded_ptree.put(ret_json_key__decodeRct_mask(), epee::string_tools::pod_to_hex(decoded.mask));
+				decoded_ptree.put(ret_json_key__decodeRct_amount(), RetVals_Transforms::str_from(decoded.amount));
+			}
+			tx_ptree.push_back(std::make_pair("", decoded_ptree));
+		}
+		txs_ptree.push_back(std::make_pair("", tx_ptree));
+	}
+	root.add_child(ret_json_key__decoded_amounts(), txs_ptree);
+	//
+	return ret_json_from_root(root);
+}
 string serial_bridge::generate_key_derivation(const string &args_string)
 {
 	boost::property_tree::ptree json_root;
@@ -782,7 +1210,7 @@ string serial_bridge::generate_key_derivation(const string &args_string)
 		return error_ret_json_from_message("Invalid 'sec'");
 	}
 	crypto::key_derivation derivation = AUTO_VAL_INIT(derivation);
-	if (!crypto::generate_key_derivation(pub_key, sec_key, derivation)) {
+	if (!monero_key_derivation_cache::generate_key_derivation(pub_key, sec_key, derivation)) {
 		return error_ret_json_from_message("Unable to generate key derivation");
 	}
 	boost::property_tree::ptree root;
@@ -888,19 +1316,72 @@ string serial_bridge::malloc_binary_from_json(const std::string &buff_json)
 {
 	// convert json to binary string
 	string buff_bin;
-	binary_utils::json_to_binary(buff_json, buff_bin);
+	try {
+		binary_utils::json_to_binary(buff_json, buff_bin);
+	} catch (std::exception const& e) {
+		return error_ret_json_from_message(e.what());
+	}
 
-	// copy binary string to heap and keep pointer
-	std::string* ptr = new std::string(buff_bin.c_str(), buff_bin.length());
+	// move binary string into a registered buffer; the caller frees it with free_buffer
+	size_t length = buff_bin.size();
+	monero_buffer_registry::Handle handle = monero_buffer_registry::adopt(std::move(buff_bin));
 
 	// create object with binary string memory address info
 	boost::property_tree::ptree root;
-	root.put("ptr", reinterpret_cast<intptr_t>(ptr->c_str()));
-	root.put("length", ptr->length());
+	root.put("handle", RetVals_Transforms::str_from(handle));
+	root.put("ptr", RetVals_Transforms::str_from((uint64_t)reinterpret_cast<uintptr_t>(monero_buffer_registry::data(handle))));
+	root.put("length", RetVals_Transforms::str_from((uint64_t)length));
 
 	// serlialize memory info to json str
 	return ret_json_from_root(root);
 }
+string serial_bridge::alloc_buffer(const std::string &args_string)
+{
+	boost::property_tree::ptree json_root;
+	if (!parsed_json_root(args_string, json_root)) {
+		// it will already have thrown an exception
+		return error_ret_json_from_message("Invalid JSON");
+	}
+	monero_buffer_registry::Handle handle = monero_buffer_registry::allocate(stoull(json_root.get<string>("length")));
+	boost::property_tree::ptree root;
+	root.put("handle", RetVals_Transforms::str_from(handle));
+	root.put("ptr", RetVals_Transforms::str_from((uint64_t)reinterpret_cast<uintptr_t>(monero_buffer_registry::data(handle))));
+	return ret_json_from_root(root);
+}
+string serial_bridge::fill_buffer(const std::string &args_string)
+{
+	boost::property_tree::ptree json_root;
+	if (!parsed_json_root(args_string, json_root)) {
+		// it will already have thrown an exception
+		return error_ret_json_from_message("Invalid JSON");
+	}
+	std::string data;
+	if (!epee::string_tools::parse_hexstr_to_binbuff(json_root.get<string>("hex"), data)) {
+		return error_ret_json_from_message("Invalid 'hex'");
+	}
+	optional<string> optl__offset_string = json_root.get_optional<string>("offset");
+	size_t offset = optl__offset_string != none ? stoull(*optl__offset_string) : 0;
+	if (!monero_buffer_registry::fill(stoull(json_root.get<string>("handle")), offset, data.data(), data.size())) {
+		return error_ret_json_from_message("Unknown buffer or out of bounds");
+	}
+	boost::property_tree::ptree root;
+	root.put(ret_json_key__generic_retVal(), true);
+	return ret_json_from_root(root);
+}
+string serial_bridge::free_buffer(const std::string &args_string)
+{
+	boost::property_tree::ptree json_root;
+	if (!parsed_json_root(args_string, json_root)) {
+		// it will already have thrown an exception
+		return error_ret_json_from_message("Invalid JSON");
+	}
+	if (!monero_buffer_registry::free(stoull(json_root.get<string>("handle")))) {
+		return error_ret_json_from_message("Unknown buffer");
+	}
+	boost::property_tree::ptree root;
+	root.put(ret_json_key__generic_retVal(), true);
+	return ret_json_from_root(root);
+}
 string serial_bridge::binary_to_json(const std::string &bin_mem_info_str)
 {
 	// parse memory address info to json
@@ -910,16 +1391,30 @@ string serial_bridge::binary_to_json(const std::string &bin_mem_info_str)
 		return error_ret_json_from_message("Invalid JSON");
 	}
 
-	// get ptr and length of binary data
-	char* ptr = (char*) root.get<int>("ptr");	// TODO: reinterpret_cast<intptr_t>?
-	int length = root.get<int>("length");
-
-	// read binary
-	std::string buff_bin(ptr, length);
+	// get binary data; read in place, including a caller's own "ptr" memory
+	std::shared_ptr<const string> buff_bin; // holds a registered buffer while it's read
+	const char *data;
+	size_t length;
+	optional<string> optl__handle_string = root.get_optional<string>("handle");
+	if (optl__handle_string != none) {
+		buff_bin = monero_buffer_registry::acquire(stoull(*optl__handle_string));
+		if (buff_bin == nullptr) {
+			return error_ret_json_from_message("Unknown buffer");
+		}
+		data = buff_bin->data();
+		length = buff_bin->size();
+	} else {
+		data = reinterpret_cast<const char *>(static_cast<uintptr_t>(stoull(root.get<string>("ptr"))));
+		length = stoull(root.get<string>("length"));
+	}
 
 	// convert binary to json and return
 	std::string buff_json;
-	binary_utils::binary_to_json(buff_bin, buff_json);
+	try {
+		binary_utils::binary_to_json(data, length, buff_json);
+	} catch (std::exception const& e) {
+		return error_ret_json_from_message(e.what());
+	}
 	return buff_json;
 }
 string serial_bridge::binary_blocks_to_json(const std::string &bin_mem_info_str)
@@ -931,15 +1426,128 @@ string serial_bridge::binary_blocks_to_json(const std::string &bin_mem_info_str)
 		return error_ret_json_from_message("Invalid JSON");
 	}
 
-	// get ptr and length of binary data
-	char* ptr = (char*) root.get<int>("ptr");	// TODO: reinterpret_cast<intptr_t>?
-	int length = root.get<int>("length");
-
-	// read binary
-	std::string buff_bin(ptr, length);
+	// get binary data
+	std::shared_ptr<const string> buff_bin = _binary_from_json(root);
+	if (buff_bin == nullptr) {
+		return error_ret_json_from_message("Unknown buffer");
+	}
 
 	// convert binary to json and return
 	std::string buff_json;
-	binary_utils::binary_blocks_to_json(buff_bin, buff_json);
+	binary_utils::binary_blocks_to_json(*buff_bin, buff_json);
+	return buff_json;
+}
+string serial_bridge::binary_blocks_to_compact(const std::string &bin_mem_info_str)
+{
+	// parse memory address info to json
+	boost::property_tree::ptree root;
+	if (!parsed_json_root(bin_mem_info_str, root)) {
+		// it will already have thrown an exception
+		return error_ret_json_from_message("Invalid JSON");
+	}
+
+	// get binary data
+	std::shared_ptr<const string> buff_bin = _binary_from_json(root);
+	if (buff_bin == nullptr) {
+		return error_ret_json_from_message("Unknown buffer");
+	}
+
+	// convert binary to compact json and return
+	std::string buff_json;
+	binary_utils::binary_blocks_to_compact(*buff_bin, buff_json);
 	return buff_json;
 }
+string serial_bridge::scan_binary_blocks(const std::string &args_string)
+{
+	boost::property_tree::ptree json_root;
+	if (!parsed_json_root(args_string, json_root)) {
+		// it will already have thrown an exception
+		return error_ret_json_from_message("Invalid JSON");
+	}
+	monero_output_scanner::ScanAccount account{};
+	{
+		bool r = false;
+		r = epee::string_tools::hex_to_pod(std::string(json_root.get<string>("sec_viewKey_string")), account.sec_viewKey);
+		THROW_WALLET_EXCEPTION_IF(!r, error::wallet_internal_error, "Invalid secret view key");
+		r = epee::string_tools::hex_to_pod(std::string(json_root.get<string>("pub_spendKey_string")), account.pub_spendKey);
+		THROW_WALLET_EXCEPTION_IF(!r, error::wallet_internal_error, "Invalid public spend key");
+		optional<string> optl__sec_spendKey_string = json_root.get_optional<string>("sec_spendKey_string");
+		if (optl__sec_spendKey_string != none) {
+			crypto::secret_key sec_spendKey;
+			r = epee::string_tools::hex_to_pod(*optl__sec_spendKey_string, sec_spendKey);
+			THROW_WALLET_EXCEPTION_IF(!r, error::wallet_internal_error, "Invalid secret spend key");
+			account.sec_spendKey = sec_spendKey;
+		}
+	}
+	optional<boost::property_tree::ptree &> optl__subaddress_lookahead = json_root.get_child_optional("subaddress_lookahead");
+	if (optl__subaddress_lookahead != none) { // optl; checks outputs against every subaddress in the window too
+		uint64_t major = stoull((*optl__subaddress_lookahead).get<string>("major"));
+		uint64_t minor = stoull((*optl__subaddress_lookahead).get<string>("minor"));
+		if (major > monero_subaddress_table::SubaddressTable::max_major_lookahead || minor > monero_subaddress_table::SubaddressTable::max_minor_lookahead) {
+			return error_ret_json_from_message("Subaddress lookahead too large");
+		}
+		account.subaddresses = std::make_shared<monero_subaddress_table::SubaddressTable>(
+			account.sec_viewKey, account.pub_spendKey,
+			(uint32_t)major, (uint32_t)minor
+		);
+		if (account.subaddresses->did_error()) {
+			return error_ret_json_from_message("Invalid public spend key");
+		}
+	}
+	optional<boost::property_tree::ptree &> optl__known_key_images = json_root.get_child_optional("known_key_images");
+	if (optl__known_key_images != none) {
+		BOOST_FOREACH(boost::property_tree::ptree::value_type &key_image_desc, *optl__known_key_images)
+		{
+			crypto::key_image key_image;
+			if (!epee::string_tools::hex_to_pod(key_image_desc.second.data(), key_image)) {
+				return error_ret_json_from_message("Invalid known key image");
+			}
+			account.known_key_images.push_back(key_image);
+		}
+	}
+
+	// get binary data
+	std::shared_ptr<const string> buff_bin = _binary_from_json(json_root);
+	if (buff_bin == nullptr) {
+		return error_ret_json_from_message("Unknown buffer");
+	}
+
+	monero_output_scanner::ScanRetVals retVals;
+	if (!monero_output_scanner::scan_blocks_by_height_response(*buff_bin, account, retVals)) {
+		return error_ret_json_from_message(*retVals.err_string);
+	}
+	boost::property_tree::ptree root;
+	root.put(ret_json_key__scan__start_height(), RetVals_Transforms::str_from(retVals.start_height));
+	root.put(ret_json_key__scan__end_height(), RetVals_Transforms::str_from(retVals.end_height));
+	boost::property_tree::ptree outputs_ptree;
+	for (const monero_output_scanner::OwnedOutput &output : retVals.owned_outputs) {
+		boost::property_tree::ptree output_ptree;
+		output_ptree.put("height", RetVals_Transforms::str_from(output.height));
+		output_ptree.put("tx_hash", epee::string_tools::pod_to_hex(output.tx_hash));
+		output_ptree.put("tx_pub_key", epee::string_tools::pod_to_hex(output.tx_pub_key));
+		output_ptree.put("index", RetVals_Transforms::str_from(output.out_index));
+		output_ptree.put("public_key", epee::string_tools::pod_to_hex(output.out_pub_key));
+		output_ptree.put("subaddress_major", RetVals_Transforms::str_from(output.subaddress_index.major));
+		output_ptree.put("subaddress_minor", RetVals_Transforms::str_from(output.subaddress_index.minor));
+		output_ptree.put("amount", RetVals_Transforms::str_from(output.amount));
+		output_ptree.put("mask", epee::string_tools::pod_to_hex(output.mask));
+		output_ptree.put("coinbase", output.is_coinbase);
+		output_ptree.put("unlock_time", RetVals_Transforms::str_from(output.unlock_time));
+		if (output.key_image != boost::none) {
+			output_ptree.put("key_image", epee::string_tools::pod_to_hex(*output.key_image));
+		}
+		outputs_ptree.push_back(std::make_pair("", output_ptree));
+	}
+	root.add_child(ret_json_key__scan__owned_outputs(), outputs_ptree);
+	boost::property_tree::ptree spent_ptree;
+	for (const monero_output_scanner::SpentKeyImage &spent : retVals.spent_key_images) {
+		boost::property_tree::ptree spent_entry_ptree;
+		spent_entry_ptree.put("height", RetVals_Transforms::str_from(spent.height));
+		spent_entry_ptree.put("tx_hash", epee::string_tools::pod_to_hex(spent.tx_hash));
+		spent_entry_ptree.put("key_image", epee::string_tools::pod_to_hex(spent.key_image));
+		spent_ptree.push_back(std::make_pair("", spent_entry_ptree));
+	}
+	root.add_child(ret_json_key__scan__spent_key_images(), spent_ptree);
+	//
+	return ret_json_from_root(root);
+}
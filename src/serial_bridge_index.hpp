@@ -47,6 +47,15 @@ namespace serial_bridge
 	string send_step1__prepare_params_for_get_decoys(const string &args_string);
 	string send_step2__try_create_transaction(const string &args_string);
 	//
+	// Batch of independent sends from one wallet - see monero_transfer_utils::create_transactions_batch
+	string create_transactions_batch__prepare_params_for_get_decoys(const string &args_string);
+	string create_transactions_batch(const string &args_string);
+	//
+	// Staged alternative to step2 - see monero_transfer_utils::prepare_transaction
+	string prepare_transaction(const string &args_string);
+	string sign_transaction(const string &args_string);
+	string finalize_transaction(const string &args_string);
+	//
 	string decode_address(const string &args_string);
 	string is_subaddress(const string &args_string);
 	string is_integrated_address(const string &args_string);
@@ -65,8 +74,12 @@ namespace serial_bridge
 	string estimate_fee(const string &args_string);
 	string estimate_tx_weight(const string &args_string);
 	string estimate_rct_tx_size(const string &args_string);
+	string fee_matrix(const string &args_string);
 	//
 	string generate_key_image(const string &args_string);
+	string generate_key_images(const string &args_string); // batch; outputs sharing a tx_pub_key share a derivation
+	string open_key_image_store(const string &args_string); // persists generated key images under "directory"; see monero_key_image_store
+	string close_key_image_store(const string &args_string);
 	//
 	string generate_key_derivation(const string &args_string);
 	string derive_public_key(const string &args_string);
@@ -74,11 +87,17 @@ namespace serial_bridge
 	string derivation_to_scalar(const string &args_string);
 	string decodeRct(const string &args_string);
 	string decodeRctSimple(const string &args_string);
+	string decode_amounts(const string &args_string); // batch of decodeRct(Simple) over many txs' outputs
 	string encrypt_payment_id(const string &args_string);
 	//
-	string malloc_binary_from_json(const string &args_string);
+	string malloc_binary_from_json(const string &args_string); // returns a buffer "handle" (and its "ptr" and "length"); free it with free_buffer
+	string alloc_buffer(const string &args_string); // see monero_buffer_registry
+	string fill_buffer(const string &args_string);
+	string free_buffer(const string &args_string);
 	string binary_to_json(const string &args_string);
 	string binary_blocks_to_json(const string &args_string);
+	string binary_blocks_to_compact(const string &args_string); // binary_blocks_to_json with only the fields scanning needs; see binary_utils
+	string scan_binary_blocks(const string &args_string); // binary_blocks_to_json memory info plus account keys; see monero_output_scanner
 }
 
 #endif /* serial_bridge_index_hpp */
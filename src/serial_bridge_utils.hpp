@@ -103,11 +103,21 @@ namespace serial_bridge_utils
 	static inline string ret_json_key__send__tx_hash() { return "tx_hash"; }
 	static inline string ret_json_key__send__tx_key() { return "tx_key"; }
 	static inline string ret_json_key__send__tx_pub_key() { return "tx_pub_key"; }
+	static inline string ret_json_key__send__tx_weight() { return "tx_weight"; }
+	static inline string ret_json_key__send__per_spec() { return "per_spec"; } // batch: one step1/step2-shaped result per send spec
+	static inline string ret_json_key__send__unsigned_tx() { return "unsigned_tx"; } // hex of encode_unsigned_transaction
+	static inline string ret_json_key__send__signed_tx() { return "signed_tx"; } // hex of encode_signed_transaction
 	//
 	static inline string ret_json_key__send__used_fee() { return "used_fee"; }
 	static inline string ret_json_key__send__total_sent() { return "total_sent"; }
 	static inline string ret_json_key__send__final_payment_id() { return "final_payment_id"; }
 	//
+	// - - fee_matrix
+	static inline string ret_json_key__fee_matrix__priorities() { return "priorities"; }
+	static inline string ret_json_key__fee_matrix__n_inputs() { return "n_inputs"; } // [min, max]
+	static inline string ret_json_key__fee_matrix__n_outputs() { return "n_outputs"; } // [min, max]
+	static inline string ret_json_key__fee_matrix__fees() { return "fees"; } // [priority index][n_inputs - min][n_outputs - min]
+	//
 	// - - decode_address, etc
 	static inline string ret_json_key__paymentID_string() { return "paymentID_string"; } // optional
 	static inline string ret_json_key__isSubaddress() { return "isSubaddress"; }
@@ -123,6 +133,13 @@ namespace serial_bridge_utils
 	static inline string ret_json_key__isInViewOnlyMode() { return "isInViewOnlyMode"; }
 	static inline string ret_json_key__decodeRct_mask() { return "mask"; }
 	static inline string ret_json_key__decodeRct_amount() { return "amount"; }
+	static inline string ret_json_key__decoded_amounts() { return "decoded"; } // decode_amounts; per tx, per index: { mask, amount } or { err_msg }
+	static inline string ret_json_key__key_images() { return "key_images"; } // generate_key_images; one per output, in order
+	// - - scan_binary_blocks
+	static inline string ret_json_key__scan__start_height() { return "start_height"; }
+	static inline string ret_json_key__scan__end_height() { return "end_height"; } // exclusive
+	static inline string ret_json_key__scan__owned_outputs() { return "owned_outputs"; }
+	static inline string ret_json_key__scan__spent_key_images() { return "spent_key_images"; }
 	// JSON keys - Args
 	// TODO: (is there a better way of doing this?) structs with auto parse & serialization?
 	//	static inline string args_json_key__
@@ -37,8 +37,10 @@
 #include <boost/test/unit_test.hpp> // last
 //
 // Includes & namespaces
+#include <algorithm>
 #include <iostream>
 #include <iterator>
+#include <set>
 #include <sstream>
 using namespace std;
 #include "string_tools.h"
@@ -55,6 +57,15 @@ using namespace serial_bridge_utils;
 // Shared code
 //
 // Test suites
+//
+// The distributed scan suite is registered first: its setup forks local scan workers, which has
+// to happen before any other test starts threads. Its cases are defined with the scanner tests.
+void setup__local_scan_workers();
+void teardown__local_scan_workers();
+void scanCoordinator__scan_range();
+BOOST_AUTO_TEST_SUITE(scanCoordinator, * boost::unit_test::fixture(&setup__local_scan_workers, &teardown__local_scan_workers))
+BOOST_AUTO_TEST_CASE(scan_range) { scanCoordinator__scan_range(); }
+BOOST_AUTO_TEST_SUITE_END()
  #include "../src/monero_address_utils.hpp"
 BOOST_AUTO_TEST_CASE(decodeAddress)
 {
@@ -92,6 +103,162 @@ BOOST_AUTO_TEST_CASE(paymentID)
 BOOST_AUTO_TEST_CASE(keyImage)
 {
 }
+#include "../src/monero_key_derivation_cache.hpp"
+BOOST_AUTO_TEST_CASE(keyDerivationCache)
+{
+	crypto::public_key tx_pub_key;
+	crypto::secret_key sec_viewKey;
+	BOOST_REQUIRE(string_tools::hex_to_pod("3ce9f1231ecebf100a8d0e9c165a2b88a766249cb03eac2c6dbe7587a1f0e9ae", tx_pub_key));
+	BOOST_REQUIRE(string_tools::hex_to_pod("7bea1907940afdd480eff7c4bcadb478a0fbb626df9e3ed74ae801e18f53e104", sec_viewKey));
+	crypto::key_derivation expected;
+	BOOST_REQUIRE(crypto::generate_key_derivation(tx_pub_key, sec_viewKey, expected));
+	//
+	monero_key_derivation_cache::clear();
+	monero_key_derivation_cache::set_capacity(1);
+	crypto::key_derivation derivation;
+	BOOST_REQUIRE(monero_key_derivation_cache::generate_key_derivation(tx_pub_key, sec_viewKey, derivation));
+	BOOST_REQUIRE(derivation == expected);
+	BOOST_REQUIRE(monero_key_derivation_cache::generate_key_derivation(tx_pub_key, sec_viewKey, derivation));
+	BOOST_REQUIRE(derivation == expected);
+	auto stats = monero_key_derivation_cache::stats();
+	BOOST_REQUIRE(stats.misses == 1 && stats.hits == 1 && stats.size == 1);
+	//
+	crypto::secret_key other_viewKey = sec_viewKey;
+	other_viewKey.data[0] ^= 1;
+	BOOST_REQUIRE(monero_key_derivation_cache::generate_key_derivation(tx_pub_key, other_viewKey, derivation));
+	BOOST_REQUIRE(!(derivation == expected));
+	stats = monero_key_derivation_cache::stats();
+	BOOST_REQUIRE(stats.misses == 2 && stats.evictions == 1 && stats.size == 1);
+	//
+	monero_key_derivation_cache::set_capacity(monero_key_derivation_cache::default_capacity);
+	monero_key_derivation_cache::clear();
+}
+#include "../src/monero_fee_utils.hpp"
+BOOST_AUTO_TEST_CASE(fee__exact_tx_weight)
+{ // against get_transaction_weight of hand-built txs of the same shape
+	const rct::RCTType rct_types[] = { rct::RCTTypeSimple, rct::RCTTypeBulletproof, rct::RCTTypeBulletproof2 };
+	const size_t ns_inputs[] = { 1, 2, 7 };
+	const size_t ns_outputs[] = { 1, 2, 3, 5, 16 };
+	const size_t extra_sizes[] = { 33, 44, 200 };
+	const uint64_t fees[] = { 0, 127, 4190000000, 18446744073709551615ull };
+	size_t n_checked = 0;
+	for (rct::RCTType rct_type : rct_types) {
+		for (size_t n_inputs : ns_inputs) {
+			for (size_t n_outputs : ns_outputs) {
+				for (size_t extra_size : extra_sizes) {
+					for (uint64_t fee : fees) {
+						if (rct_type == rct::RCTTypeSimple && n_outputs > 3) {
+							continue; // borromean rangeSigs are just big; keep the corpus quick
+						}
+						uint64_t unlock_time = fee % 3 == 0 ? 0 : 1500000 + fee % 1000;
+						std::vector<std::vector<uint64_t>> rings;
+						cryptonote::transaction tx;
+						tx.version = 2;
+						tx.unlock_time = unlock_time;
+						for (size_t i = 0; i < n_inputs; i++) {
+							std::vector<uint64_t> ring;
+							uint64_t global_index = 1 + i * 977;
+							for (size_t j = 0; j < 11; j++) {
+								ring.push_back(global_index);
+								global_index += (uint64_t)1 << (j * 3 + i); // spread offsets across varint lengths
+							}
+							cryptonote::txin_to_key in;
+							in.amount = 0;
+							in.key_offsets = cryptonote::absolute_output_offsets_to_relative(ring);
+							tx.vin.push_back(in);
+							rings.push_back(ring);
+						}
+						for (size_t o = 0; o < n_outputs; o++) {
+							cryptonote::tx_out out;
+							out.amount = 0;
+							out.target = cryptonote::txout_to_key(crypto::public_key{});
+							tx.vout.push_back(out);
+						}
+						tx.extra.resize(extra_size);
+						rct::rctSig &rv = tx.rct_signatures;
+						rv.type = rct_type;
+						rv.txnFee = fee;
+						rv.ecdhInfo.resize(n_outputs);
+						rv.outPk.resize(n_outputs);
+						if (rct_type == rct::RCTTypeSimple) {
+							rv.pseudoOuts.resize(n_inputs);
+							rv.p.rangeSigs.resize(n_outputs);
+						} else {
+							rv.p.pseudoOuts.resize(n_inputs);
+							size_t n_LR = 6;
+							while (((size_t)1 << (n_LR - 6)) < n_outputs) {
+								n_LR++;
+							}
+							rct::Bulletproof bp;
+							bp.L.resize(n_LR);
+							bp.R.resize(n_LR);
+							rv.p.bulletproofs.push_back(bp);
+						}
+						rv.p.MGs.resize(n_inputs);
+						for (rct::mgSig &mg : rv.p.MGs) {
+							mg.ss.assign(11, rct::keyV(2));
+						}
+						cryptonote::blobdata blob = cryptonote::tx_to_blob(tx);
+						BOOST_REQUIRE(blob.size() > 0);
+						BOOST_REQUIRE_EQUAL(monero_fee_utils::exact_rct_tx_size(rings, n_outputs, extra_size, fee, unlock_time, rct_type), blob.size());
+						BOOST_REQUIRE_EQUAL(monero_fee_utils::exact_tx_weight(rings, n_outputs, extra_size, fee, unlock_time, rct_type), cryptonote::get_transaction_weight(tx, blob.size()));
+						n_checked++;
+					}
+				}
+			}
+		}
+	}
+	cout << "fee__exact_tx_weight: checked " << n_checked << " shapes" << endl;
+}
+BOOST_AUTO_TEST_CASE(fee__weight_tables)
+{
+	for (int bulletproof = 0; bulletproof <= 1; bulletproof++) {
+		for (size_t n_inputs = 0; n_inputs <= monero_fee_utils::weight_table_max_inputs + 1; n_inputs++) {
+			for (size_t n_outputs = 0; n_outputs <= monero_fee_utils::weight_table_max_outputs; n_outputs++) {
+				for (size_t extra_size : { 0, 44, 1060 }) {
+					for (int mixin : { monero_fee_utils::weight_table_mixin, 15 }) { // 15: not tabled
+						BOOST_REQUIRE_EQUAL(
+							monero_fee_utils::tabled_tx_weight(true, n_inputs, mixin, n_outputs, extra_size, bulletproof != 0),
+							monero_fee_utils::estimate_tx_weight(true, n_inputs, mixin, n_outputs, extra_size, bulletproof != 0)
+						);
+					}
+				}
+			}
+		}
+	}
+	monero_fee_utils::FeeParams fee_params = monero_fee_utils::new__fee_params(24658, 2, 10000, monero_fee_utils::weight_table_mixin, 44, true, monero_fork_rules::make_use_fork_rules_fn(10));
+	uint64_t fee_multiplier = monero_fee_utils::get_fee_multiplier(2, monero_fee_utils::default_priority(), -1, monero_fork_rules::make_use_fork_rules_fn(10));
+	for (int n_inputs = 1; n_inputs <= 40; n_inputs++) {
+		BOOST_REQUIRE_EQUAL(
+			fee_params.estimated_fee(n_inputs, 2),
+			monero_fee_utils::estimate_fee(true, true, n_inputs, monero_fee_utils::weight_table_mixin, 2, 44, true, 24658, fee_multiplier, 10000)
+		);
+	}
+}
+#include "../src/monero_keypair_pool.hpp"
+#include <boost/thread/thread.hpp>
+BOOST_AUTO_TEST_CASE(keypairPool)
+{
+	// inline fallback while stopped
+	BOOST_REQUIRE(!monero_keypair_pool::is_running());
+	auto before = monero_keypair_pool::stats();
+	cryptonote::keypair k = monero_keypair_pool::new_keypair();
+	crypto::public_key pub;
+	BOOST_REQUIRE(crypto::secret_key_to_public_key(k.sec, pub) && pub == k.pub);
+	BOOST_REQUIRE(monero_keypair_pool::stats().inline_generated == before.inline_generated + 1);
+	//
+	monero_keypair_pool::start(8);
+	for (size_t i = 0; i < 1000 && monero_keypair_pool::stats().size < 8; i++) {
+		boost::this_thread::sleep_for(boost::chrono::milliseconds(5));
+	}
+	BOOST_REQUIRE(monero_keypair_pool::stats().size == 8);
+	cryptonote::keypair pooled = monero_keypair_pool::new_keypair();
+	BOOST_REQUIRE(crypto::secret_key_to_public_key(pooled.sec, pub) && pub == pooled.pub);
+	BOOST_REQUIRE(!(pooled.pub == k.pub));
+	BOOST_REQUIRE(monero_keypair_pool::stats().pooled == before.pooled + 1);
+	monero_keypair_pool::stop();
+	BOOST_REQUIRE(monero_keypair_pool::stats().size == 0);
+}
 //
 //
 #include "../src/monero_wallet_utils.hpp"
@@ -112,6 +279,60 @@ BOOST_AUTO_TEST_CASE(transfers__fee)
 	std::cout << "transfers__fee: est_fee with fee_per_b " << fee_per_b << ": " << est_fee << std::endl;
 	BOOST_REQUIRE(est_fee > 0);
 }
+BOOST_AUTO_TEST_CASE(forkRules)
+{
+	monero_fork_rules::ForkRules v10(10);
+	BOOST_REQUIRE(v10.fork_version == 10);
+	BOOST_REQUIRE(v10.use_per_byte_fee && v10.use_smaller_bp && v10.fee_algorithm == 3);
+	BOOST_REQUIRE(v10.upper_transaction_weight_limit == CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V5 / 2 - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE);
+	monero_fork_rules::ForkRules v8(8);
+	BOOST_REQUIRE(v8.use_per_byte_fee && !v8.use_smaller_bp);
+	//
+	// adapter: any use_fork_rules_fn_type, e.g. one which would query the daemon
+	size_t n_calls = 0;
+	monero_fork_rules::ForkRules v4(monero_fork_rules::use_fork_rules_fn_type([&n_calls] (uint8_t version, int64_t early_blocks)
+	{
+		n_calls++;
+		return version <= 4;
+	}));
+	BOOST_REQUIRE(v4.fork_version == 0);
+	BOOST_REQUIRE(!v4.use_per_byte_fee && v4.fee_algorithm == 1);
+	BOOST_REQUIRE(v4.upper_transaction_weight_limit == CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V2 - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE);
+	size_t n_calls_to_resolve = n_calls;
+	BOOST_REQUIRE(monero_fee_utils::get_fee_multiplier(2, monero_fee_utils::default_priority(), -1, v4) == 20);
+	BOOST_REQUIRE(monero_fee_utils::get_upper_transaction_weight_limit(0, v4) == v4.upper_transaction_weight_limit);
+	BOOST_REQUIRE(n_calls == n_calls_to_resolve); // nothing re-evaluated
+}
+BOOST_AUTO_TEST_CASE(transfers__ring_members)
+{
+	monero_transfer_utils::RandomAmountOutputs mix_out;
+	mix_out.amount = 0;
+	uint64_t global_indices[] = { 7570451, 6986524, 7459325, 6986524, 7282304 };
+	for (uint64_t global_index : global_indices) {
+		monero_transfer_utils::RandomAmountOutput output;
+		output.global_index = global_index;
+		output.public_key = "3ce9f1231ecebf100a8d0e9c165a2b88a766249cb03eac2c6dbe7587a1f0e9ae";
+		output.rct = string("c3b81a937c12c017b4c4eee0ab9acbd10d83f28c1586971b13791c7b475e469b");
+		mix_out.outputs.push_back(output);
+	}
+	monero_transfer_utils::RingMembers ring;
+	auto code = monero_transfer_utils::new__ring_members(mix_out, ring);
+	BOOST_REQUIRE(code == monero_transfer_utils::noError);
+	BOOST_REQUIRE(ring.size() == 4); // duplicate removed
+	for (size_t i = 1; i < ring.size(); i++) {
+		BOOST_REQUIRE(ring.global_indices[i - 1] < ring.global_indices[i]);
+	}
+	BOOST_REQUIRE(ring.has_commit[0] == 1);
+	BOOST_REQUIRE(ring.lower_bound(6986524) == 0);
+	BOOST_REQUIRE(ring.lower_bound(7300000) == 2);
+	BOOST_REQUIRE(ring.lower_bound(7570452) == 4);
+	//
+	mix_out.outputs[0].public_key = "not hex"; // global index 7570451, the last member
+	code = monero_transfer_utils::new__ring_members(mix_out, ring);
+	BOOST_REQUIRE(code == monero_transfer_utils::noError); // only an error if the decoy gets picked
+	BOOST_REQUIRE(ring.has_public_key[3] == 0);
+	BOOST_REQUIRE(ring.has_public_key[0] == 1);
+}
 //
 //
 // Serialization bridge
@@ -265,6 +486,7 @@ BOOST_AUTO_TEST_CASE(bridge__transfers__send__sweepDust)
 			root.put("unlock_time", "0");
 			root.put("priority", "1");
 			root.add_child("mix_outs", mix_outs);
+			root.put("self_verify", true); // optl
 			//
 			boost::property_tree::ptree ret_tree;
 			auto ret_string = serial_bridge::send_step2__try_create_transaction(args_string_from_root(root));
@@ -520,6 +742,493 @@ BOOST_AUTO_TEST_CASE(bridge__transfers__send__amount)
 		}
 	}
 }
+BOOST_AUTO_TEST_CASE(bridge__transfers__send__staged)
+{
+	using namespace serial_bridge;
+	using namespace monero_transfer_utils;
+	//
+	boost::property_tree::ptree unspent_outs;
+	boost::property_tree::ptree mix_outs;
+	{
+		boost::property_tree::ptree pt;
+		stringstream ss;
+		ss << DG_postsweep__unspent_outs_json;
+		boost::property_tree::json_parser::read_json(ss, pt);
+		unspent_outs = pt.get_child("unspent_outs");
+	}
+	{
+		boost::property_tree::ptree pt;
+		stringstream ss;
+		ss << DG_postsweep__rand_outs_json;
+		boost::property_tree::json_parser::read_json(ss, pt);
+		mix_outs = pt.get_child("mix_outs");
+	}
+	boost::property_tree::ptree step1_ret_tree;
+	{
+		boost::property_tree::ptree root;
+		root.put("is_sweeping", "false");
+		root.put("payment_id_string", "d2f602b240fbe624"); // optl
+		root.put("sending_amount", "200000000");
+		root.put("fee_per_b", "24658");
+		root.put("fee_mask", "10000");
+		root.put("fork_version", "10");
+		root.put("priority", "1");
+		root.add_child("unspent_outs", unspent_outs);
+		stringstream ret_stream;
+		ret_stream << serial_bridge::send_step1__prepare_params_for_get_decoys(args_string_from_root(root));
+		boost::property_tree::read_json(ret_stream, step1_ret_tree);
+		BOOST_REQUIRE(step1_ret_tree.get_optional<uint32_t>(ret_json_key__any__err_code()) == none);
+	}
+	//
+	// 1. prepare - no spend key
+	string unsigned_tx;
+	{
+		boost::property_tree::ptree root;
+		root.put("final_total_wo_fee", step1_ret_tree.get<string>(ret_json_key__send__final_total_wo_fee()));
+		root.put("change_amount", step1_ret_tree.get<string>(ret_json_key__send__change_amount()));
+		root.put("fee_amount", step1_ret_tree.get<string>(ret_json_key__send__using_fee()));
+		root.add_child("using_outs", step1_ret_tree.get_child(ret_json_key__send__using_outs()));
+		root.put("payment_id_string", "d2f602b240fbe624"); // optl
+		root.put("nettype_string", string_from_nettype(MAINNET));
+		root.put("to_address_string", "4APbcAKxZ2KPVPMnqa5cPtJK25tr7maE7LrJe67vzumiCtWwjDBvYnHZr18wFexJpih71Mxsjv8b7EpQftpB9NjPPXmZxHN");
+		root.put("from_address_string", "43zxvpcj5Xv9SEkNXbMCG7LPQStHMpFCQCmkmR4u5nzjWwq5Xkv5VmGgYEsHXg4ja2FGRD5wMWbBVMijDTqmmVqm93wHGkg");
+		root.put("sec_viewKey_string", "7bea1907940afdd480eff7c4bcadb478a0fbb626df9e3ed74ae801e18f53e104");
+		root.put("fork_version", "10");
+		root.put("unlock_time", "0");
+		root.add_child("mix_outs", mix_outs);
+		stringstream ret_stream;
+		ret_stream << serial_bridge::prepare_transaction(args_string_from_root(root));
+		boost::property_tree::ptree ret_tree;
+		boost::property_tree::read_json(ret_stream, ret_tree);
+		BOOST_REQUIRE(ret_tree.get_optional<uint32_t>(ret_json_key__any__err_code()) == none);
+		unsigned_tx = ret_tree.get<string>(ret_json_key__send__unsigned_tx());
+		BOOST_REQUIRE(unsigned_tx.size() > 0);
+	}
+	uint64_t expected_tx_weight;
+	{
+		cryptonote::blobdata unsigned_tx_blob;
+		BOOST_REQUIRE(epee::string_tools::parse_hexstr_to_binbuff(unsigned_tx, unsigned_tx_blob));
+		UnsignedTransaction decoded;
+		BOOST_REQUIRE(decode_unsigned_transaction(unsigned_tx_blob, decoded));
+		expected_tx_weight = exact_tx_weight(decoded);
+		UnsignedTransaction trailing;
+		BOOST_REQUIRE(!decode_unsigned_transaction(unsigned_tx_blob + string(1, '\0'), trailing)); // the whole blob must be consumed
+		monero_fork_rules::ForkRules at_limit(10);
+		at_limit.upper_transaction_weight_limit = expected_tx_weight; // the weight must be under the limit
+		TransactionConstruction_RetVals too_big;
+		convenience__sign_transaction(
+			too_big, decoded,
+			"43zxvpcj5Xv9SEkNXbMCG7LPQStHMpFCQCmkmR4u5nzjWwq5Xkv5VmGgYEsHXg4ja2FGRD5wMWbBVMijDTqmmVqm93wHGkg",
+			"7bea1907940afdd480eff7c4bcadb478a0fbb626df9e3ed74ae801e18f53e104",
+			"4e6d43cd03812b803c6f3206689f5fcc910005fc7e91d50d79b0776dbefcd803",
+			at_limit
+		);
+		BOOST_REQUIRE(too_big.errCode == transactionTooBig && too_big.tx == none); // rejected before signing
+	}
+	// 2. sign
+	string signed_tx;
+	{
+		boost::property_tree::ptree root;
+		root.put("unsigned_tx", unsigned_tx);
+		root.put("nettype_string", string_from_nettype(MAINNET));
+		root.put("from_address_string", "43zxvpcj5Xv9SEkNXbMCG7LPQStHMpFCQCmkmR4u5nzjWwq5Xkv5VmGgYEsHXg4ja2FGRD5wMWbBVMijDTqmmVqm93wHGkg");
+		root.put("sec_viewKey_string", "7bea1907940afdd480eff7c4bcadb478a0fbb626df9e3ed74ae801e18f53e104");
+		root.put("sec_spendKey_string", "4e6d43cd03812b803c6f3206689f5fcc910005fc7e91d50d79b0776dbefcd803");
+		root.put("fork_version", "10");
+		stringstream ret_stream;
+		ret_stream << serial_bridge::sign_transaction(args_string_from_root(root));
+		boost::property_tree::ptree ret_tree;
+		boost::property_tree::read_json(ret_stream, ret_tree);
+		BOOST_REQUIRE(ret_tree.get_optional<uint32_t>(ret_json_key__any__err_code()) == none);
+		signed_tx = ret_tree.get<string>(ret_json_key__send__signed_tx());
+		BOOST_REQUIRE(signed_tx.size() > 0);
+	}
+	// 3. finalize
+	{
+		boost::property_tree::ptree root;
+		root.put("signed_tx", signed_tx);
+		stringstream ret_stream;
+		ret_stream << serial_bridge::finalize_transaction(args_string_from_root(root));
+		boost::property_tree::ptree ret_tree;
+		boost::property_tree::read_json(ret_stream, ret_tree);
+		BOOST_REQUIRE(ret_tree.get_optional<uint32_t>(ret_json_key__any__err_code()) == none);
+		string serialized_signed_tx = ret_tree.get<string>(ret_json_key__send__serialized_signed_tx());
+		string tx_hash = ret_tree.get<string>(ret_json_key__send__tx_hash());
+		BOOST_REQUIRE(ret_tree.get<string>(ret_json_key__send__tx_key()).size() == 64);
+		BOOST_REQUIRE(stoull(ret_tree.get<string>(ret_json_key__send__tx_weight())) == expected_tx_weight);
+		//
+		// hash derived from blob slices must match a full recomputation
+		cryptonote::blobdata tx_blob;
+		BOOST_REQUIRE(epee::string_tools::parse_hexstr_to_binbuff(serialized_signed_tx, tx_blob));
+		cryptonote::transaction tx;
+		crypto::hash expected_tx_hash;
+		BOOST_REQUIRE(cryptonote::parse_and_validate_tx_from_blob(tx_blob, tx, expected_tx_hash));
+		BOOST_REQUIRE(tx_hash == epee::string_tools::pod_to_hex(expected_tx_hash));
+		cout << "bridge__transfers__send__staged: tx_hash: " << tx_hash << endl;
+	}
+	// corrupt handoff is reported, not thrown
+	{
+		boost::property_tree::ptree root;
+		root.put("signed_tx", "00");
+		stringstream ret_stream;
+		ret_stream << serial_bridge::finalize_transaction(args_string_from_root(root));
+		boost::property_tree::ptree ret_tree;
+		boost::property_tree::read_json(ret_stream, ret_tree);
+		BOOST_REQUIRE(ret_tree.get<uint32_t>(ret_json_key__any__err_code()) == monero_transfer_utils::couldntDecodeStagedTransaction);
+	}
+	// as is a decoded tx with parts never constructed here, or no tx at all
+	{
+		cryptonote::blobdata signed_tx_blob;
+		BOOST_REQUIRE(epee::string_tools::parse_hexstr_to_binbuff(signed_tx, signed_tx_blob));
+		TransactionConstruction_RetVals trailing;
+		BOOST_REQUIRE(!decode_signed_transaction(signed_tx_blob + string(1, '\0'), trailing));
+		BOOST_REQUIRE(trailing.errCode == couldntDecodeStagedTransaction);
+		TransactionConstruction_RetVals decoded;
+		BOOST_REQUIRE(decode_signed_transaction(signed_tx_blob, decoded));
+		decoded.tx->vout[0].target = cryptonote::txout_to_scripthash{};
+		decoded.tx->invalidate_hashes();
+		boost::property_tree::ptree root;
+		root.put("signed_tx", epee::string_tools::buff_to_hex_nodelimer(encode_signed_transaction(decoded)));
+		stringstream ret_stream;
+		ret_stream << serial_bridge::finalize_transaction(args_string_from_root(root));
+		boost::property_tree::ptree ret_tree;
+		boost::property_tree::read_json(ret_stream, ret_tree);
+		BOOST_REQUIRE(ret_tree.get_optional<uint32_t>(ret_json_key__any__err_code()) == none);
+		BOOST_REQUIRE(ret_tree.get<string>(ret_json_key__send__tx_hash()) == epee::string_tools::pod_to_hex(cryptonote::get_transaction_hash(*decoded.tx)));
+		//
+		TransactionConstruction_RetVals no_tx;
+		Convenience_TransactionConstruction_RetVals retVals;
+		monero_transfer_utils::finalize_transaction(retVals, no_tx);
+		BOOST_REQUIRE(retVals.errCode == couldntDecodeStagedTransaction);
+	}
+}
+//
+BOOST_AUTO_TEST_CASE(bridge__transfers__send__batch)
+{
+	using namespace serial_bridge;
+	using namespace monero_transfer_utils;
+	//
+	boost::property_tree::ptree unspent_outs;
+	boost::property_tree::ptree mix_outs;
+	{
+		boost::property_tree::ptree pt;
+		stringstream ss;
+		ss << DG_postsweep__unspent_outs_json;
+		boost::property_tree::json_parser::read_json(ss, pt);
+		unspent_outs = pt.get_child("unspent_outs");
+	}
+	{
+		boost::property_tree::ptree pt;
+		stringstream ss;
+		ss << DG_postsweep__rand_outs_json;
+		boost::property_tree::json_parser::read_json(ss, pt);
+		mix_outs = pt.get_child("mix_outs");
+	}
+	boost::property_tree::ptree specs;
+	{
+		boost::property_tree::ptree spec;
+		spec.put("to_address_string", "4APbcAKxZ2KPVPMnqa5cPtJK25tr7maE7LrJe67vzumiCtWwjDBvYnHZr18wFexJpih71Mxsjv8b7EpQftpB9NjPPXmZxHN");
+		spec.put("payment_id_string", "d2f602b240fbe624"); // optl
+		spec.put("sending_amount", "200000000");
+		spec.put("is_sweeping", "false");
+		specs.push_back(std::make_pair("", spec));
+	}
+	boost::property_tree::ptree step1_ret_tree;
+	{
+		boost::property_tree::ptree root;
+		root.add_child("specs", specs);
+		root.put("fee_per_b", "24658");
+		root.put("fee_mask", "10000");
+		root.put("fork_version", "10");
+		root.put("priority", "1");
+		root.add_child("unspent_outs", unspent_outs);
+		stringstream ret_stream;
+		ret_stream << serial_bridge::create_transactions_batch__prepare_params_for_get_decoys(args_string_from_root(root));
+		boost::property_tree::read_json(ret_stream, step1_ret_tree);
+		BOOST_REQUIRE(step1_ret_tree.get_child(ret_json_key__send__per_spec()).size() == 1);
+		BOOST_REQUIRE(step1_ret_tree.get_child(ret_json_key__send__per_spec()).front().second.get_optional<uint32_t>(ret_json_key__any__err_code()) == none);
+		BOOST_REQUIRE(step1_ret_tree.get_child(ret_json_key__send__using_outs()).size() == mix_outs.size());
+	}
+	{
+		boost::property_tree::ptree root;
+		root.add_child("specs", specs);
+		root.add_child("per_spec", step1_ret_tree.get_child(ret_json_key__send__per_spec()));
+		root.put("from_address_string", "43zxvpcj5Xv9SEkNXbMCG7LPQStHMpFCQCmkmR4u5nzjWwq5Xkv5VmGgYEsHXg4ja2FGRD5wMWbBVMijDTqmmVqm93wHGkg");
+		root.put("sec_viewKey_string", "7bea1907940afdd480eff7c4bcadb478a0fbb626df9e3ed74ae801e18f53e104");
+		root.put("sec_spendKey_string", "4e6d43cd03812b803c6f3206689f5fcc910005fc7e91d50d79b0776dbefcd803");
+		root.put("fee_per_b", "24658");
+		root.put("fee_mask", "10000");
+		root.put("fork_version", "10");
+		root.put("priority", "1");
+		root.put("unlock_time", "0");
+		root.put("nettype_string", string_from_nettype(MAINNET));
+		root.put("self_verify", true);
+		root.add_child("mix_outs", mix_outs);
+		stringstream ret_stream;
+		ret_stream << serial_bridge::create_transactions_batch(args_string_from_root(root));
+		boost::property_tree::ptree ret_tree;
+		boost::property_tree::read_json(ret_stream, ret_tree);
+		BOOST_REQUIRE(ret_tree.get_child(ret_json_key__send__per_spec()).size() == 1);
+		const boost::property_tree::ptree &spec_ret_tree = ret_tree.get_child(ret_json_key__send__per_spec()).front().second;
+		BOOST_REQUIRE(spec_ret_tree.get_optional<uint32_t>(ret_json_key__any__err_code()) == none);
+		BOOST_REQUIRE(spec_ret_tree.get_optional<bool>(ret_json_key__send__tx_must_be_reconstructed()) == false);
+		BOOST_REQUIRE(spec_ret_tree.get<string>(ret_json_key__send__tx_hash()).size() == 64);
+		cout << "bridge__transfers__send__batch: tx_hash: " << spec_ret_tree.get<string>(ret_json_key__send__tx_hash()) << endl;
+	}
+}
+//
+BOOST_AUTO_TEST_CASE(bridge__transfers__send__batch__multiple_specs)
+{
+	using namespace serial_bridge;
+	using namespace monero_transfer_utils;
+	//
+	boost::property_tree::ptree unspent_outs;
+	boost::property_tree::ptree all_mix_outs;
+	{
+		boost::property_tree::ptree pt;
+		stringstream ss;
+		ss << DG_presweep__unspent_outs_json;
+		boost::property_tree::json_parser::read_json(ss, pt);
+		unspent_outs = pt.get_child("unspent_outs");
+	}
+	{
+		boost::property_tree::ptree pt;
+		stringstream ss;
+		ss << DG_presweep__rand_outs_json;
+		boost::property_tree::json_parser::read_json(ss, pt);
+		all_mix_outs = pt.get_child("mix_outs");
+	}
+	// the middle spec can't be afforded; the others pass a fee which is surely enough, so neither is reconstructed
+	boost::property_tree::ptree specs;
+	for (const char *sending_amount : { "100000000", "100000000000000", "100000000" }) {
+		boost::property_tree::ptree spec;
+		spec.put("to_address_string", "4APbcAKxZ2KPVPMnqa5cPtJK25tr7maE7LrJe67vzumiCtWwjDBvYnHZr18wFexJpih71Mxsjv8b7EpQftpB9NjPPXmZxHN");
+		spec.put("sending_amount", sending_amount);
+		spec.put("is_sweeping", "false");
+		spec.put("passedIn_attemptAt_fee", "100000000");
+		specs.push_back(std::make_pair("", spec));
+	}
+	boost::property_tree::ptree step1_ret_tree;
+	{
+		boost::property_tree::ptree root;
+		root.add_child("specs", specs);
+		root.put("fee_per_b", "24658");
+		root.put("fee_mask", "10000");
+		root.put("fork_version", "10");
+		root.put("priority", "1");
+		root.add_child("unspent_outs", unspent_outs);
+		stringstream ret_stream;
+		ret_stream << serial_bridge::create_transactions_batch__prepare_params_for_get_decoys(args_string_from_root(root));
+		boost::property_tree::read_json(ret_stream, step1_ret_tree);
+	}
+	std::vector<boost::property_tree::ptree> step1_per_spec;
+	for (const boost::property_tree::ptree::value_type &spec_desc : step1_ret_tree.get_child(ret_json_key__send__per_spec())) {
+		step1_per_spec.push_back(spec_desc.second);
+	}
+	BOOST_REQUIRE(step1_per_spec.size() == 3);
+	BOOST_REQUIRE(step1_per_spec[1].get<uint32_t>(ret_json_key__any__err_code()) == needMoreMoneyThanFound);
+	// each spec spends its own outputs; the decoy request is for the first's, then the last's
+	std::vector<std::vector<string>> spec_public_keys(3);
+	std::vector<std::vector<uint64_t>> spec_global_indices(3);
+	for (size_t i : { 0, 2 }) {
+		BOOST_REQUIRE(step1_per_spec[i].get_optional<uint32_t>(ret_json_key__any__err_code()) == none);
+		for (const boost::property_tree::ptree::value_type &out_desc : step1_per_spec[i].get_child(ret_json_key__send__using_outs())) {
+			spec_public_keys[i].push_back(out_desc.second.get<string>("public_key"));
+			spec_global_indices[i].push_back(out_desc.second.get<uint64_t>("global_index"));
+		}
+		BOOST_REQUIRE(!spec_public_keys[i].empty());
+	}
+	for (const string &public_key : spec_public_keys[0]) {
+		BOOST_REQUIRE(std::find(spec_public_keys[2].begin(), spec_public_keys[2].end(), public_key) == spec_public_keys[2].end());
+	}
+	std::vector<string> decoy_request_public_keys;
+	for (const boost::property_tree::ptree::value_type &out_desc : step1_ret_tree.get_child(ret_json_key__send__using_outs())) {
+		decoy_request_public_keys.push_back(out_desc.second.get<string>("public_key"));
+	}
+	std::vector<string> expected_public_keys = spec_public_keys[0];
+	expected_public_keys.insert(expected_public_keys.end(), spec_public_keys[2].begin(), spec_public_keys[2].end());
+	BOOST_REQUIRE(decoy_request_public_keys == expected_public_keys);
+	// one set of decoys per requested output, in order
+	boost::property_tree::ptree mix_outs;
+	std::vector<std::set<uint64_t>> mix_out_global_indices;
+	for (const boost::property_tree::ptree::value_type &mix_out_desc : all_mix_outs) {
+		if (mix_outs.size() == decoy_request_public_keys.size()) {
+			break;
+		}
+		mix_outs.push_back(mix_out_desc);
+		mix_out_global_indices.emplace_back();
+		for (const boost::property_tree::ptree::value_type &output_desc : mix_out_desc.second.get_child("outputs")) {
+			mix_out_global_indices.back().insert(output_desc.second.get<uint64_t>("global_index"));
+		}
+	}
+	BOOST_REQUIRE(mix_outs.size() == decoy_request_public_keys.size());
+	//
+	boost::property_tree::ptree ret_tree;
+	{
+		boost::property_tree::ptree root;
+		root.add_child("specs", specs);
+		root.add_child("per_spec", step1_ret_tree.get_child(ret_json_key__send__per_spec()));
+		root.put("from_address_string", "43zxvpcj5Xv9SEkNXbMCG7LPQStHMpFCQCmkmR4u5nzjWwq5Xkv5VmGgYEsHXg4ja2FGRD5wMWbBVMijDTqmmVqm93wHGkg");
+		root.put("sec_viewKey_string", "7bea1907940afdd480eff7c4bcadb478a0fbb626df9e3ed74ae801e18f53e104");
+		root.put("sec_spendKey_string", "4e6d43cd03812b803c6f3206689f5fcc910005fc7e91d50d79b0776dbefcd803");
+		root.put("fee_per_b", "24658");
+		root.put("fee_mask", "10000");
+		root.put("fork_version", "10");
+		root.put("priority", "1");
+		root.put("unlock_time", "0");
+		root.put("nettype_string", string_from_nettype(MAINNET));
+		root.add_child("mix_outs", mix_outs);
+		stringstream ret_stream;
+		ret_stream << serial_bridge::create_transactions_batch(args_string_from_root(root));
+		boost::property_tree::read_json(ret_stream, ret_tree);
+	}
+	std::vector<boost::property_tree::ptree> per_spec;
+	for (const boost::property_tree::ptree::value_type &spec_desc : ret_tree.get_child(ret_json_key__send__per_spec())) {
+		per_spec.push_back(spec_desc.second);
+	}
+	BOOST_REQUIRE(per_spec.size() == 3);
+	// the middle spec's error is reported on it alone
+	BOOST_REQUIRE(per_spec[1].get<uint32_t>(ret_json_key__any__err_code()) == needMoreMoneyThanFound);
+	size_t mix_outs_offset = 0;
+	for (size_t i : { 0, 2 }) {
+		BOOST_REQUIRE(per_spec[i].get_optional<uint32_t>(ret_json_key__any__err_code()) == none);
+		BOOST_REQUIRE(per_spec[i].get<bool>(ret_json_key__send__tx_must_be_reconstructed()) == false);
+		string tx_blob;
+		BOOST_REQUIRE(epee::string_tools::parse_hexstr_to_binbuff(per_spec[i].get<string>(ret_json_key__send__serialized_signed_tx()), tx_blob));
+		cryptonote::transaction tx;
+		BOOST_REQUIRE(cryptonote::parse_and_validate_tx_from_blob(tx_blob, tx));
+		BOOST_REQUIRE(tx.vin.size() == spec_global_indices[i].size());
+		// each ring is its real output's and the decoys at that output's place in the request
+		for (const cryptonote::txin_v &in : tx.vin) {
+			std::vector<uint64_t> ring = cryptonote::relative_output_offsets_to_absolute(boost::get<cryptonote::txin_to_key>(in).key_offsets);
+			size_t o = 0;
+			while (o < spec_global_indices[i].size() && std::find(ring.begin(), ring.end(), spec_global_indices[i][o]) == ring.end()) {
+				o++;
+			}
+			BOOST_REQUIRE(o < spec_global_indices[i].size());
+			const std::set<uint64_t> &decoys = mix_out_global_indices[mix_outs_offset + o];
+			for (uint64_t global_index : ring) {
+				BOOST_REQUIRE(global_index == spec_global_indices[i][o] || decoys.count(global_index) != 0);
+			}
+		}
+		mix_outs_offset += spec_global_indices[i].size();
+	}
+}
+//
+#include "../src/monero_tx_verification.hpp"
+BOOST_AUTO_TEST_CASE(txVerification__queue)
+{
+	monero_tx_verification::Queue queue(2);
+	cryptonote::transaction not_rct; // nothing this lib would construct; must not pass
+	queue.push("session-a", not_rct);
+	BOOST_REQUIRE(queue.pending() == 1);
+	queue.push("session-b", not_rct); // fills the batch
+	BOOST_REQUIRE(queue.pending() == 0);
+	queue.push("session-c", not_rct);
+	vector<string> failed = queue.flush();
+	BOOST_REQUIRE(queue.pending() == 0);
+	BOOST_REQUIRE(failed.size() == 3);
+	BOOST_REQUIRE(failed[0] == "session-a" && failed[2] == "session-c");
+	BOOST_REQUIRE(queue.flush().empty()); // reported once
+	//
+	vector<bool> passed;
+	monero_tx_verification::verify({}, passed);
+	BOOST_REQUIRE(passed.empty());
+}
+//
+cryptonote::transaction new__DG_postsweep_signed_tx()
+{ // signed in memory, as self-verification needs
+	using namespace monero_transfer_utils;
+	//
+	boost::property_tree::ptree pt;
+	stringstream ss;
+	ss << DG_postsweep__unspent_outs_json;
+	boost::property_tree::json_parser::read_json(ss, pt);
+	vector<SpendableOutput> unspent_outs;
+	BOOST_FOREACH(boost::property_tree::ptree::value_type &output_desc, pt.get_child("unspent_outs"))
+	{
+		SpendableOutput out{};
+		out.amount = stoull(output_desc.second.get<string>("amount"));
+		out.public_key = output_desc.second.get<string>("public_key");
+		out.rct = output_desc.second.get_optional<string>("rct");
+		out.global_index = output_desc.second.get<uint64_t>("global_index");
+		out.index = output_desc.second.get<uint64_t>("index");
+		out.tx_pub_key = output_desc.second.get<string>("tx_pub_key");
+		unspent_outs.push_back(out);
+	}
+	vector<RandomAmountOutputs> mix_outs;
+	{
+		boost::property_tree::ptree pt;
+		stringstream ss;
+		ss << DG_postsweep__rand_outs_json;
+		boost::property_tree::json_parser::read_json(ss, pt);
+		BOOST_FOREACH(boost::property_tree::ptree::value_type &mix_out_desc, pt.get_child("mix_outs"))
+		{
+			RandomAmountOutputs amountAndOuts{};
+			amountAndOuts.amount = stoull(mix_out_desc.second.get<string>("amount"));
+			BOOST_FOREACH(boost::property_tree::ptree::value_type &mix_out_output_desc, mix_out_desc.second.get_child("outputs"))
+			{
+				RandomAmountOutput amountOutput{};
+				amountOutput.global_index = stoull(mix_out_output_desc.second.get<string>("global_index"));
+				amountOutput.public_key = mix_out_output_desc.second.get<string>("public_key");
+				amountOutput.rct = mix_out_output_desc.second.get_optional<string>("rct");
+				amountAndOuts.outputs.push_back(amountOutput);
+			}
+			mix_outs.push_back(amountAndOuts);
+		}
+	}
+	vector<RingMembers> ring_members;
+	BOOST_REQUIRE(new__ring_members(mix_outs, ring_members) == noError);
+	//
+	string from_address_string = "43zxvpcj5Xv9SEkNXbMCG7LPQStHMpFCQCmkmR4u5nzjWwq5Xkv5VmGgYEsHXg4ja2FGRD5wMWbBVMijDTqmmVqm93wHGkg";
+	string sec_viewKey_string = "7bea1907940afdd480eff7c4bcadb478a0fbb626df9e3ed74ae801e18f53e104";
+	monero_fork_rules::ForkRules fork_rules(10);
+	Send_Step1_RetVals step1_retVals;
+	send_step1__prepare_params_for_get_decoys(
+		step1_retVals,
+		none, 200000000, false/*is_sweeping*/, 1/*priority*/, fork_rules,
+		unspent_outs, 24658, 10000,
+		none
+	);
+	BOOST_REQUIRE(step1_retVals.errCode == noError);
+	PrepareTransaction_RetVals prepare_retVals;
+	convenience__prepare_transaction(
+		prepare_retVals,
+		from_address_string, sec_viewKey_string,
+		"4APbcAKxZ2KPVPMnqa5cPtJK25tr7maE7LrJe67vzumiCtWwjDBvYnHZr18wFexJpih71Mxsjv8b7EpQftpB9NjPPXmZxHN", none,
+		step1_retVals.final_total_wo_fee, step1_retVals.change_amount, step1_retVals.using_fee,
+		step1_retVals.using_outs, ring_members,
+		fork_rules
+	);
+	BOOST_REQUIRE(prepare_retVals.errCode == noError);
+	TransactionConstruction_RetVals sign_retVals;
+	convenience__sign_transaction(
+		sign_retVals,
+		*prepare_retVals.unsigned_tx,
+		from_address_string, sec_viewKey_string, "4e6d43cd03812b803c6f3206689f5fcc910005fc7e91d50d79b0776dbefcd803",
+		fork_rules
+	);
+	BOOST_REQUIRE(sign_retVals.errCode == noError);
+	//
+	return *sign_retVals.tx;
+}
+BOOST_AUTO_TEST_CASE(txVerification__tampered_rct_tx)
+{
+	cryptonote::transaction tx = new__DG_postsweep_signed_tx();
+	BOOST_REQUIRE(tx.rct_signatures.type == rct::RCTTypeBulletproof2);
+	vector<bool> passed;
+	monero_tx_verification::verify({ &tx }, passed);
+	BOOST_REQUIRE(passed.size() == 1 && passed[0]);
+	//
+	tx.rct_signatures.ecdhInfo[0].amount.bytes[0] ^= 0x01; // covered by the MLSAG message, so the signatures no longer verify
+	monero_tx_verification::verify({ &tx }, passed);
+	BOOST_REQUIRE(passed.size() == 1 && !passed[0]);
+	//
+	monero_tx_verification::Queue queue;
+	queue.push("session-tampered", tx);
+	vector<string> failed = queue.flush();
+	BOOST_REQUIRE(failed.size() == 1 && failed[0] == "session-tampered");
+}
 //
 BOOST_AUTO_TEST_CASE(bridged__decode_address)
 {
@@ -931,6 +1640,57 @@ BOOST_AUTO_TEST_CASE(bridged__estimate_fee)
 	BOOST_REQUIRE(fee == 330050000);
 	cout << "bridged__estimate_fee: " << fee << endl;
 }
+BOOST_AUTO_TEST_CASE(bridged__fee_matrix)
+{
+	using namespace serial_bridge;
+	//
+	boost::property_tree::ptree root;
+	root.put("fee_per_b", "24658");
+	root.put("fee_mask", "10000");
+	root.put("fork_version", "10");
+	root.put("min_inputs", "1");
+	root.put("max_inputs", "20");
+	root.put("min_outputs", "2");
+	root.put("max_outputs", "3");
+	//
+	auto ret_string = serial_bridge::fee_matrix(args_string_from_root(root));
+	stringstream ret_stream;
+	ret_stream << ret_string;
+	boost::property_tree::ptree ret_tree;
+	boost::property_tree::read_json(ret_stream, ret_tree);
+	BOOST_REQUIRE(ret_tree.get_optional<string>(ret_json_key__any__err_msg()) == none);
+	BOOST_REQUIRE(ret_tree.get_child(ret_json_key__fee_matrix__priorities()).size() == 4);
+	const boost::property_tree::ptree &fees = ret_tree.get_child(ret_json_key__fee_matrix__fees());
+	BOOST_REQUIRE(fees.size() == 4);
+	auto use_fork_rules_fn = monero_fork_rules::make_use_fork_rules_fn(10);
+	uint32_t priority = 1;
+	for (const auto &by_priority : fees) {
+		BOOST_REQUIRE(by_priority.second.size() == 20);
+		uint64_t fee_multiplier = monero_fee_utils::get_fee_multiplier(priority, monero_fee_utils::default_priority(), monero_fee_utils::get_fee_algorithm(use_fork_rules_fn), use_fork_rules_fn);
+		int n_inputs = 1;
+		for (const auto &by_n_inputs : by_priority.second) {
+			BOOST_REQUIRE(by_n_inputs.second.size() == 2);
+			int n_outputs = 2;
+			for (const auto &fee : by_n_inputs.second) { // same as calling estimate_fee for each cell
+				uint64_t expected = monero_fee_utils::estimate_fee(true, true, n_inputs, monero_fork_rules::fixed_mixinsize(), n_outputs, 0, true, 24658, fee_multiplier, 10000);
+				BOOST_REQUIRE_EQUAL(stoull(fee.second.get_value<string>()), expected);
+				n_outputs++;
+			}
+			n_inputs++;
+		}
+		priority++;
+	}
+	cout << "bridged__fee_matrix: priority 1, 1 input, 2 outputs: " << fees.front().second.front().second.front().second.get_value<string>() << endl;
+	//
+	// ranges past the weight tables are rejected rather than allocated, including ones that would wrap an int
+	root.put("max_inputs", "1000000000");
+	BOOST_REQUIRE(serial_bridge::fee_matrix(args_string_from_root(root)).find(ret_json_key__any__err_msg()) != string::npos);
+	root.put("max_inputs", "4294967297");
+	BOOST_REQUIRE(serial_bridge::fee_matrix(args_string_from_root(root)).find(ret_json_key__any__err_msg()) != string::npos);
+	root.put("max_inputs", "20");
+	root.put("max_outputs", "17");
+	BOOST_REQUIRE(serial_bridge::fee_matrix(args_string_from_root(root)).find(ret_json_key__any__err_msg()) != string::npos);
+}
 BOOST_AUTO_TEST_CASE(bridged__estimate_tx_weight)
 {
 	using namespace serial_bridge;
@@ -1012,6 +1772,145 @@ BOOST_AUTO_TEST_CASE(bridged__generate_key_image)
 	BOOST_REQUIRE(*key_image_string == "ae30ee23051dc0bdf10303fbd3b7d8035a958079eb66516b1740f2c9b02c804e");
 	cout << "bridged__generate_key_image: " << *key_image_string << endl;
 }
+BOOST_AUTO_TEST_CASE(bridged__generate_key_images)
+{
+	using namespace serial_bridge;
+	//
+	const string tx_pub_keys[] = {
+		"fc7f85bf64c6e4f6aa612dbc8ddb1bb77a9283656e9c2b9e777c9519798622b2",
+		"3eb884d3440d71326e27cc07a861b873e72abd339feb654660c36a008a0028b3" // any valid point will do
+	};
+	const std::pair<size_t, uint64_t> outputs[] = { {0, 0}, {1, 1}, {0, 1}, {0, 0} }; // interleaved, with a repeat
+	monero_key_derivation_cache::clear();
+	for (bool verify : { true, false }) {
+		boost::property_tree::ptree root;
+		root.put("sec_viewKey_string", "7bea1907940afdd480eff7c4bcadb478a0fbb626df9e3ed74ae801e18f53e104");
+		root.put("sec_spendKey_string", "4e6d43cd03812b803c6f3206689f5fcc910005fc7e91d50d79b0776dbefcd803");
+		root.put("pub_spendKey_string", "3eb884d3440d71326e27cc07a861b873e72abd339feb654660c36a008a0028b3");
+		root.put("verify", verify);
+		boost::property_tree::ptree outputs_ptree;
+		for (const auto &output : outputs) {
+			boost::property_tree::ptree output_ptree;
+			output_ptree.put("tx_pub_key", tx_pub_keys[output.first]);
+			output_ptree.put("out_index", output.second);
+			outputs_ptree.push_back(std::make_pair("", output_ptree));
+		}
+		root.add_child("outputs", outputs_ptree);
+		//
+		auto ret_string = serial_bridge::generate_key_images(args_string_from_root(root));
+		stringstream ret_stream;
+		ret_stream << ret_string;
+		boost::property_tree::ptree ret_tree;
+		boost::property_tree::read_json(ret_stream, ret_tree);
+		optional<string> err_string = ret_tree.get_optional<string>(ret_json_key__any__err_msg());
+		if (err_string != none) {
+			BOOST_REQUIRE_MESSAGE(false, *err_string);
+		}
+		vector<string> key_images;
+		for (const auto &key_image : ret_tree.get_child(ret_json_key__key_images())) {
+			key_images.push_back(key_image.second.get_value<string>());
+		}
+		BOOST_REQUIRE(key_images.size() == 4);
+		BOOST_REQUIRE(monero_key_derivation_cache::stats().misses == 2); // one per tx pub key; every later derivation is cached
+		BOOST_REQUIRE(key_images[0] == "ae30ee23051dc0bdf10303fbd3b7d8035a958079eb66516b1740f2c9b02c804e");
+		BOOST_REQUIRE(key_images[3] == key_images[0]);
+		for (size_t i = 0; i < 4; i++) { // same as one at a time
+			boost::property_tree::ptree single_root;
+			single_root.put("sec_viewKey_string", "7bea1907940afdd480eff7c4bcadb478a0fbb626df9e3ed74ae801e18f53e104");
+			single_root.put("sec_spendKey_string", "4e6d43cd03812b803c6f3206689f5fcc910005fc7e91d50d79b0776dbefcd803");
+			single_root.put("pub_spendKey_string", "3eb884d3440d71326e27cc07a861b873e72abd339feb654660c36a008a0028b3");
+			single_root.put("tx_pub_key", tx_pub_keys[outputs[i].first]);
+			single_root.put("out_index", outputs[i].second);
+			stringstream single_ret_stream;
+			single_ret_stream << serial_bridge::generate_key_image(args_string_from_root(single_root));
+			boost::property_tree::ptree single_ret_tree;
+			boost::property_tree::read_json(single_ret_stream, single_ret_tree);
+			BOOST_REQUIRE(single_ret_tree.get<string>(ret_json_key__generic_retVal()) == key_images[i]);
+		}
+	}
+}
+//
+#include "../src/monero_key_image_store.hpp"
+#include <cstdlib>
+#include <fstream>
+#include <dirent.h>
+#include <unistd.h>
+BOOST_AUTO_TEST_CASE(keyImageStore)
+{
+	crypto::secret_key sec_viewKey, sec_spendKey;
+	crypto::public_key pub_spendKey, tx_pub_key;
+	epee::string_tools::hex_to_pod("7bea1907940afdd480eff7c4bcadb478a0fbb626df9e3ed74ae801e18f53e104", sec_viewKey);
+	epee::string_tools::hex_to_pod("4e6d43cd03812b803c6f3206689f5fcc910005fc7e91d50d79b0776dbefcd803", sec_spendKey);
+	epee::string_tools::hex_to_pod("3eb884d3440d71326e27cc07a861b873e72abd339feb654660c36a008a0028b3", pub_spendKey);
+	epee::string_tools::hex_to_pod("fc7f85bf64c6e4f6aa612dbc8ddb1bb77a9283656e9c2b9e777c9519798622b2", tx_pub_key);
+	//
+	char dir_template[] = "/tmp/mymonero_kis_XXXXXX";
+	BOOST_REQUIRE(mkdtemp(dir_template) != nullptr);
+	string directory = dir_template;
+	string err_string;
+	BOOST_REQUIRE(!monero_key_image_store::open(directory + "/missing", err_string));
+	BOOST_REQUIRE(monero_key_image_store::open(directory, err_string));
+	//
+	monero_key_image_utils::KeyImageRetVals retVals;
+	BOOST_REQUIRE(monero_key_image_store::new__key_image(pub_spendKey, sec_spendKey, sec_viewKey, tx_pub_key, 0, retVals));
+	BOOST_REQUIRE(epee::string_tools::pod_to_hex(retVals.calculated_key_image) == "ae30ee23051dc0bdf10303fbd3b7d8035a958079eb66516b1740f2c9b02c804e");
+	std::vector<monero_key_image_utils::KeyImageOutput> outputs = { { tx_pub_key, 0 }, { tx_pub_key, 1 } };
+	monero_key_image_utils::KeyImagesRetVals batchRetVals;
+	BOOST_REQUIRE(monero_key_image_store::new__key_images(pub_spendKey, sec_spendKey, sec_viewKey, outputs, true, batchRetVals));
+	BOOST_REQUIRE(batchRetVals.calculated_key_images[0] == retVals.calculated_key_image);
+	crypto::key_image key_image_1 = batchRetVals.calculated_key_images[1];
+	auto stats = monero_key_image_store::stats();
+	BOOST_REQUIRE(stats.hits == 1 && stats.misses == 2 && stats.appended == 2);
+	BOOST_REQUIRE(stats.accounts == 1 && stats.size == 2);
+	monero_key_image_store::close();
+	//
+	// simulate a crash mid-append: the torn record is dropped on reopen and both stored ones survive
+	string file_path;
+	{
+		DIR *dir = opendir(directory.c_str());
+		BOOST_REQUIRE(dir != nullptr);
+		while (struct dirent *entry = readdir(dir)) {
+			if (entry->d_name[0] != '.') {
+				file_path = directory + "/" + entry->d_name; // the one account file
+			}
+		}
+		closedir(dir);
+		BOOST_REQUIRE(!file_path.empty());
+	}
+	{
+		std::ofstream f(file_path, std::ios::binary | std::ios::app);
+		f.write("torn", 4);
+	}
+	BOOST_REQUIRE(monero_key_image_store::open(directory, err_string));
+	outputs = { { tx_pub_key, 1 }, { tx_pub_key, 0 } };
+	BOOST_REQUIRE(monero_key_image_store::new__key_images(pub_spendKey, sec_spendKey, sec_viewKey, outputs, true, batchRetVals));
+	BOOST_REQUIRE(batchRetVals.calculated_key_images[0] == key_image_1);
+	BOOST_REQUIRE(batchRetVals.calculated_key_images[1] == retVals.calculated_key_image);
+	stats = monero_key_image_store::stats();
+	BOOST_REQUIRE(stats.hits == 2 && stats.misses == 0 && stats.size == 2);
+	//
+	// key images from a spend key that isn't the account's are returned unverified but never stored
+	monero_key_image_utils::KeyImageRetVals wrongRetVals;
+	BOOST_REQUIRE(monero_key_image_store::new__key_image(pub_spendKey, sec_viewKey, sec_viewKey, tx_pub_key, 2, wrongRetVals));
+	outputs = { { tx_pub_key, 2 } };
+	BOOST_REQUIRE(monero_key_image_store::new__key_images(pub_spendKey, sec_viewKey, sec_viewKey, outputs, false, batchRetVals));
+	BOOST_REQUIRE(batchRetVals.calculated_key_images[0] == wrongRetVals.calculated_key_image);
+	stats = monero_key_image_store::stats();
+	BOOST_REQUIRE(stats.appended == 0 && stats.size == 2);
+	BOOST_REQUIRE(monero_key_image_store::new__key_images(pub_spendKey, sec_spendKey, sec_viewKey, outputs, true, batchRetVals));
+	BOOST_REQUIRE(batchRetVals.calculated_key_images[0] != wrongRetVals.calculated_key_image);
+	stats = monero_key_image_store::stats();
+	BOOST_REQUIRE(stats.appended == 1 && stats.size == 3);
+	monero_key_image_store::close();
+	//
+	// without the store, key images are just computed
+	BOOST_REQUIRE(!monero_key_image_store::is_open());
+	BOOST_REQUIRE(monero_key_image_store::new__key_image(pub_spendKey, sec_spendKey, sec_viewKey, tx_pub_key, 1, retVals));
+	BOOST_REQUIRE(retVals.calculated_key_image == key_image_1);
+	//
+	remove(file_path.c_str());
+	rmdir(directory.c_str());
+}
 //
 BOOST_AUTO_TEST_CASE(bridged__address_and_keys_from_seed)
 {
@@ -1341,6 +2240,134 @@ BOOST_AUTO_TEST_CASE(bridged__decodeRctSimple)
 	cout << "bridged__decodeRctSimple: amount_string: " << amount_string << endl;
 	BOOST_REQUIRE(amount_string == "10000000000");
 }
+#include "../src/monero_rct_utils.hpp"
+#include "ringct/rctOps.h"
+BOOST_AUTO_TEST_CASE(rctUtils__decode_amounts)
+{
+	std::vector<monero_rct_utils::TxAmountsToDecode> txs(2);
+	std::vector<rct::xmr_amount> amounts = { 10000000000, 1, 123456789, 0 };
+	std::vector<crypto::key_derivation> derivations;
+	for (size_t t = 0; t < txs.size(); t++) {
+		monero_rct_utils::TxAmountsToDecode &tx = txs[t];
+		tx.rv.type = t == 0 ? rct::RCTTypeBulletproof2 : rct::RCTTypeBulletproof;
+		crypto::key_derivation derivation;
+		memcpy(&derivation, rct::skGen().bytes, sizeof(derivation)); // decoding only hashes it
+		tx.derivation = derivation;
+		derivations.push_back(derivation);
+		for (size_t i = 0; i < 2; i++) {
+			rct::key sk;
+			crypto::derivation_to_scalar(derivation, i, (crypto::ec_scalar &)sk);
+			rct::ecdhTuple ecdh_info{};
+			ecdh_info.mask = t == 0 ? rct::genCommitmentMask(sk) : rct::skGen();
+			ecdh_info.amount = rct::d2h(amounts[2 * t + i]);
+			rct::ctkey outPk{};
+			outPk.mask = rct::commit(amounts[2 * t + i], ecdh_info.mask);
+			rct::ecdhEncode(ecdh_info, sk, t == 0);
+			tx.rv.ecdhInfo.push_back(ecdh_info);
+			tx.rv.outPk.push_back(outPk);
+		}
+		tx.out_indices = { 1, 0, 2 }; // 2 is out of range
+	}
+	monero_rct_utils::DecodeAmountsRetVals retVals;
+	BOOST_REQUIRE(monero_rct_utils::decode_amounts(txs, crypto::null_skey, retVals));
+	BOOST_REQUIRE(retVals.decoded.size() == 2);
+	for (size_t t = 0; t < txs.size(); t++) {
+		BOOST_REQUIRE(retVals.decoded[t].size() == 3);
+		BOOST_REQUIRE(!retVals.decoded[t][0].did_error && retVals.decoded[t][0].amount == amounts[2 * t + 1]);
+		BOOST_REQUIRE(!retVals.decoded[t][1].did_error && retVals.decoded[t][1].amount == amounts[2 * t]);
+		BOOST_REQUIRE(retVals.decoded[t][2].did_error);
+		BOOST_REQUIRE(rct::equalKeys(rct::commit(retVals.decoded[t][0].amount, retVals.decoded[t][0].mask), txs[t].rv.outPk[1].mask));
+	}
+	// a commitment which doesn't open fails the batch; only its own output is reported
+	txs[1].rv.outPk[0].mask = rct::commit(amounts[2] + 1, rct::skGen());
+	BOOST_REQUIRE(monero_rct_utils::decode_amounts(txs, crypto::null_skey, retVals));
+	BOOST_REQUIRE(!retVals.decoded[0][0].did_error && !retVals.decoded[0][1].did_error);
+	BOOST_REQUIRE(!retVals.decoded[1][0].did_error);
+	BOOST_REQUIRE(retVals.decoded[1][1].did_error);
+	// per output derivations, as for a tx's outputs owned through its additional tx pub keys
+	txs[0].out_indices = { 1, 0 };
+	txs[0].out_derivations = { derivations[0], derivations[1] }; // the second isn't tx 0's
+	BOOST_REQUIRE(monero_rct_utils::decode_amounts(txs, crypto::null_skey, retVals));
+	BOOST_REQUIRE(retVals.decoded[0].size() == 2);
+	BOOST_REQUIRE(!retVals.decoded[0][0].did_error && retVals.decoded[0][0].amount == amounts[1]);
+	BOOST_REQUIRE(retVals.decoded[0][1].did_error);
+}
+BOOST_AUTO_TEST_CASE(bridged__decode_amounts)
+{
+	using namespace serial_bridge;
+	//
+	crypto::secret_key sec_viewKey = rct::rct2sk(rct::skGen());
+	crypto::public_key pub_viewKey;
+	BOOST_REQUIRE(crypto::secret_key_to_public_key(sec_viewKey, pub_viewKey));
+	std::vector<rct::xmr_amount> amounts = { 5000, 7000, 9000, 11000 };
+	boost::property_tree::ptree root;
+	root.put("sec_viewKey_string", epee::string_tools::pod_to_hex(sec_viewKey));
+	boost::property_tree::ptree txs_ptree;
+	for (size_t t = 0; t < 2; t++) { // bulletproof2, the first given by derivation and the second by tx pub key
+		crypto::secret_key tx_key = rct::rct2sk(rct::skGen());
+		crypto::public_key tx_pub_key;
+		BOOST_REQUIRE(crypto::secret_key_to_public_key(tx_key, tx_pub_key));
+		crypto::key_derivation derivation;
+		BOOST_REQUIRE(crypto::generate_key_derivation(pub_viewKey, tx_key, derivation));
+		boost::property_tree::ptree ecdhInfo;
+		boost::property_tree::ptree outPk;
+		for (size_t i = 0; i < 2; i++) {
+			rct::key sk;
+			crypto::derivation_to_scalar(derivation, i, (crypto::ec_scalar &)sk);
+			rct::ecdhTuple ecdh_info{};
+			ecdh_info.mask = rct::genCommitmentMask(sk);
+			ecdh_info.amount = rct::d2h(amounts[2 * t + i]);
+			bool is_bad_commitment = t == 1 && i == 1;
+			rct::key commitment = rct::commit(amounts[2 * t + i] + (is_bad_commitment ? 1 : 0), ecdh_info.mask);
+			rct::ecdhEncode(ecdh_info, sk, true);
+			boost::property_tree::ptree ecdh_info_ptree;
+			ecdh_info_ptree.put("amount", epee::string_tools::pod_to_hex((crypto::hash8 &)ecdh_info.amount));
+			ecdhInfo.push_back(std::make_pair("", ecdh_info_ptree));
+			boost::property_tree::ptree an_outPk;
+			an_outPk.put("mask", epee::string_tools::pod_to_hex(commitment));
+			outPk.push_back(std::make_pair("", an_outPk));
+		}
+		boost::property_tree::ptree rv;
+		rv.put("type", std::to_string(rct::RCTTypeBulletproof2));
+		rv.add_child("ecdhInfo", ecdhInfo);
+		rv.add_child("outPk", outPk);
+		boost::property_tree::ptree tx_ptree;
+		tx_ptree.add_child("rv", rv);
+		if (t == 0) {
+			tx_ptree.put("derivation", epee::string_tools::pod_to_hex(derivation));
+		} else {
+			tx_ptree.put("tx_pub_key", epee::string_tools::pod_to_hex(tx_pub_key));
+		}
+		boost::property_tree::ptree indices;
+		indices.push_back(std::make_pair("", boost::property_tree::ptree("1")));
+		indices.push_back(std::make_pair("", boost::property_tree::ptree("0")));
+		tx_ptree.add_child("indices", indices);
+		txs_ptree.push_back(std::make_pair("", tx_ptree));
+	}
+	root.add_child("txs", txs_ptree);
+	//
+	boost::property_tree::ptree ret_root;
+	BOOST_REQUIRE(parsed_json_root(decode_amounts(args_string_from_root(root)), ret_root));
+	BOOST_REQUIRE(ret_root.get_optional<string>(ret_json_key__any__err_msg()) == none);
+	std::vector<std::vector<boost::property_tree::ptree>> decoded;
+	for (const boost::property_tree::ptree::value_type &tx_desc : ret_root.get_child(ret_json_key__decoded_amounts())) {
+		decoded.emplace_back();
+		for (const boost::property_tree::ptree::value_type &decoded_desc : tx_desc.second) {
+			decoded.back().push_back(decoded_desc.second);
+		}
+	}
+	BOOST_REQUIRE(decoded.size() == 2 && decoded[0].size() == 2 && decoded[1].size() == 2);
+	BOOST_REQUIRE(decoded[0][0].get<string>(ret_json_key__decodeRct_amount()) == "7000");
+	BOOST_REQUIRE(decoded[0][1].get<string>(ret_json_key__decodeRct_amount()) == "5000");
+	// the commitment which doesn't open is reported on its own output only
+	BOOST_REQUIRE(decoded[1][0].get_optional<string>(ret_json_key__any__err_msg()) != none);
+	BOOST_REQUIRE(decoded[1][0].get_optional<string>(ret_json_key__decodeRct_amount()) == none);
+	BOOST_REQUIRE(decoded[1][1].get<string>(ret_json_key__decodeRct_amount()) == "9000");
+	// without a derivation or the view key there's nothing to decode with
+	root.erase("sec_viewKey_string");
+	BOOST_REQUIRE(parsed_json_root(decode_amounts(args_string_from_root(root)), ret_root));
+	BOOST_REQUIRE(ret_root.get_optional<string>(ret_json_key__any__err_msg()) != none);
+}
 // with bulletproof2
 BOOST_AUTO_TEST_CASE(bridged__decodeRctSimple_with_bulletproof2)
 {
@@ -1604,6 +2631,968 @@ BOOST_AUTO_TEST_CASE(bridge__transfers__send_stagenet_coinbase)
 	}
 }
 //
+#include "../src/monero_subaddress_table.hpp"
+#include "device/device.hpp"
+BOOST_AUTO_TEST_CASE(subaddressTable)
+{
+	cryptonote::account_keys keys;
+	epee::string_tools::hex_to_pod("7bea1907940afdd480eff7c4bcadb478a0fbb626df9e3ed74ae801e18f53e104", keys.m_view_secret_key);
+	epee::string_tools::hex_to_pod("3eb884d3440d71326e27cc07a861b873e72abd339feb654660c36a008a0028b3", keys.m_account_address.m_spend_public_key);
+	hw::device &hwdev = hw::get_device("default");
+	//
+	monero_subaddress_table::SubaddressTable table(keys.m_view_secret_key, keys.m_account_address.m_spend_public_key, 2, 5);
+	BOOST_REQUIRE(table.size() == 2 * 5);
+	cryptonote::subaddress_index index;
+	BOOST_REQUIRE(table.lookup(keys.m_account_address.m_spend_public_key, index) && index.is_zero());
+	BOOST_REQUIRE(table.lookup(hwdev.get_subaddress_spend_public_key(keys, { 1, 3 }), index));
+	BOOST_REQUIRE(index.major == 1 && index.minor == 3);
+	crypto::public_key beyond = hwdev.get_subaddress_spend_public_key(keys, { 1, 7 });
+	BOOST_REQUIRE(!table.lookup(beyond, index));
+	//
+	BOOST_REQUIRE(table.expand_for({ 1, 3 })); // majors [0, 3), and minors [0, 8) for major 1
+	BOOST_REQUIRE(table.size() == 5 + 8 + 5);
+	BOOST_REQUIRE(table.lookup(beyond, index) && index.major == 1 && index.minor == 7);
+	BOOST_REQUIRE(table.lookup(hwdev.get_subaddress_spend_public_key(keys, { 2, 4 }), index));
+	BOOST_REQUIRE(!table.expand_for({ 0, 0 }));
+	table.expand_to(3, 600); // crosses the table's growth and the per-task split
+	BOOST_REQUIRE(table.size() == 3 * 600);
+	BOOST_REQUIRE(table.lookup(hwdev.get_subaddress_spend_public_key(keys, { 2, 599 }), index) && index.minor == 599);
+	//
+	// a spend public key that isn't a point fails instead of throwing out of the pool
+	crypto::public_key not_a_point;
+	epee::string_tools::hex_to_pod("0200000000000000000000000000000000000000000000000000000000000000", not_a_point);
+	monero_subaddress_table::SubaddressTable bad_table(keys.m_view_secret_key, not_a_point, 2, 5);
+	BOOST_REQUIRE(bad_table.did_error() && bad_table.size() == 0);
+	BOOST_REQUIRE(!bad_table.lookup(not_a_point, index));
+	//
+	// the bridge rejects both, and lookaheads over the caps, before scanning
+	boost::property_tree::ptree root;
+	root.put("sec_viewKey_string", epee::string_tools::pod_to_hex(keys.m_view_secret_key));
+	root.put("pub_spendKey_string", epee::string_tools::pod_to_hex(keys.m_account_address.m_spend_public_key));
+	root.put("subaddress_lookahead.major", "4294967295");
+	root.put("subaddress_lookahead.minor", "5");
+	BOOST_REQUIRE(serial_bridge::scan_binary_blocks(args_string_from_root(root)).find("Subaddress lookahead too large") != string::npos);
+	root.put("subaddress_lookahead.major", "2");
+	root.put("pub_spendKey_string", epee::string_tools::pod_to_hex(not_a_point));
+	BOOST_REQUIRE(serial_bridge::scan_binary_blocks(args_string_from_root(root)).find("Invalid public spend key") != string::npos);
+}
+//
+#include "../src/monero_output_scanner.hpp"
+#include "cryptonote_core/cryptonote_tx_utils.h"
+//
+// Blocks for the scanning tests, from start_height up: each a coinbase to an address, plus txs
+struct TestChain
+{
+	uint64_t start_height;
+	std::vector<cryptonote::block> blocks;
+	std::vector<cryptonote::block_complete_entry> entries;
+	//
+	TestChain(uint64_t start_height) : start_height(start_height) {}
+	void add_block(const cryptonote::account_public_address &miner_address, const std::vector<cryptonote::transaction> &txs = {})
+	{
+		cryptonote::block block{};
+		BOOST_REQUIRE(cryptonote::construct_miner_tx(start_height + blocks.size(), 0, 0, 0, 0, miner_address, block.miner_tx, cryptonote::blobdata(), 999, 10));
+		cryptonote::block_complete_entry entry;
+		for (const cryptonote::transaction &tx : txs) {
+			block.tx_hashes.push_back(cryptonote::get_transaction_hash(tx));
+			entry.txs.push_back(cryptonote::tx_to_blob(tx));
+		}
+		entry.block = cryptonote::block_to_blob(block);
+		blocks.push_back(block);
+		entries.push_back(entry);
+	}
+};
+// A v1 tx spending key_image; its signature is never checked
+cryptonote::transaction v1_spend_tx(const crypto::key_image &key_image)
+{
+	cryptonote::transaction tx{};
+	tx.version = 1;
+	cryptonote::txin_to_key in{};
+	in.key_offsets.push_back(0);
+	in.k_image = key_image;
+	tx.vin.push_back(in);
+	tx.signatures.resize(1, std::vector<crypto::signature>(1));
+	return tx;
+}
+// A bulletproof2 tx paying each destination in order, with an additional tx pub key per output
+// when any is a subaddress, as construct_tx_with_tx_key does. Its amounts are encrypted and
+// committed to for real; its proofs and ring signature are zeroes, sized so the tx parses.
+cryptonote::transaction rct_tx_to(const std::vector<cryptonote::tx_destination_entry> &destinations)
+{
+	cryptonote::transaction tx{};
+	tx.version = 2;
+	cryptonote::txin_to_key in{};
+	in.key_offsets = { 7, 8 };
+	in.k_image = rct::rct2ki(rct::pkGen());
+	tx.vin.push_back(in);
+	crypto::secret_key tx_key = rct::rct2sk(rct::skGen());
+	crypto::public_key tx_pub_key;
+	BOOST_REQUIRE(crypto::secret_key_to_public_key(tx_key, tx_pub_key));
+	BOOST_REQUIRE(cryptonote::add_tx_pub_key_to_extra(tx, tx_pub_key));
+	bool has_subaddress = std::any_of(destinations.begin(), destinations.end(), [] (const cryptonote::tx_destination_entry &dst) { return dst.is_subaddress; });
+	std::vector<crypto::public_key> additional_tx_pub_keys;
+	tx.rct_signatures.type = rct::RCTTypeBulletproof2;
+	tx.rct_signatures.txnFee = 1000;
+	for (size_t i = 0; i < destinations.size(); i++) {
+		const cryptonote::tx_destination_entry &dst = destinations[i];
+		crypto::secret_key key = tx_key;
+		if (has_subaddress) {
+			crypto::secret_key additional_key = rct::rct2sk(rct::skGen());
+			additional_tx_pub_keys.push_back(dst.is_subaddress
+				? rct::rct2pk(rct::scalarmultKey(rct::pk2rct(dst.addr.m_spend_public_key), rct::sk2rct(additional_key)))
+				: rct::rct2pk(rct::scalarmultBase(rct::sk2rct(additional_key))));
+			if (dst.is_subaddress) {
+				key = additional_key;
+			}
+		}
+		crypto::key_derivation derivation;
+		BOOST_REQUIRE(crypto::generate_key_derivation(dst.addr.m_view_public_key, key, derivation));
+		crypto::public_key out_key;
+		BOOST_REQUIRE(crypto::derive_public_key(derivation, i, dst.addr.m_spend_public_key, out_key));
+		tx.vout.push_back(cryptonote::tx_out{ 0, cryptonote::txout_to_key(out_key) });
+		rct::key sk;
+		crypto::derivation_to_scalar(derivation, i, (crypto::ec_scalar &)sk);
+		rct::ecdhTuple ecdh_info{};
+		ecdh_info.mask = rct::genCommitmentMask(sk);
+		ecdh_info.amount = rct::d2h(dst.amount);
+		rct::ctkey out_pk{};
+		out_pk.mask = rct::commit(dst.amount, ecdh_info.mask);
+		rct::ecdhEncode(ecdh_info, sk, true);
+		tx.rct_signatures.ecdhInfo.push_back(ecdh_info);
+		tx.rct_signatures.outPk.push_back(out_pk);
+	}
+	if (has_subaddress) {
+		BOOST_REQUIRE(cryptonote::add_additional_tx_pub_keys_to_extra(tx.extra, additional_tx_pub_keys));
+	}
+	rct::Bulletproof proof{};
+	proof.L.resize(6 + 2); // for up to 4 outputs
+	proof.R.resize(proof.L.size());
+	tx.rct_signatures.p.bulletproofs.push_back(proof);
+	tx.rct_signatures.p.MGs.resize(1);
+	tx.rct_signatures.p.MGs[0].ss.resize(in.key_offsets.size(), rct::keyV(2));
+	tx.rct_signatures.p.pseudoOuts.resize(1);
+	return tx;
+}
+//
+BOOST_AUTO_TEST_CASE(outputScanner__scan_blocks)
+{
+	monero_output_scanner::ScanAccount account{};
+	crypto::secret_key sec_spendKey;
+	epee::string_tools::hex_to_pod("7bea1907940afdd480eff7c4bcadb478a0fbb626df9e3ed74ae801e18f53e104", account.sec_viewKey);
+	epee::string_tools::hex_to_pod("4e6d43cd03812b803c6f3206689f5fcc910005fc7e91d50d79b0776dbefcd803", sec_spendKey);
+	epee::string_tools::hex_to_pod("3eb884d3440d71326e27cc07a861b873e72abd339feb654660c36a008a0028b3", account.pub_spendKey);
+	account.subaddresses = std::make_shared<monero_subaddress_table::SubaddressTable>(account.sec_viewKey, account.pub_spendKey, 1, 4);
+	cryptonote::account_keys keys;
+	keys.m_account_address.m_spend_public_key = account.pub_spendKey;
+	keys.m_view_secret_key = account.sec_viewKey;
+	BOOST_REQUIRE(crypto::secret_key_to_public_key(account.sec_viewKey, keys.m_account_address.m_view_public_key));
+	const cryptonote::account_public_address &address = keys.m_account_address;
+	cryptonote::account_public_address subaddress = hw::get_device("default").get_subaddress(keys, { 0, 2 });
+	cryptonote::account_base other;
+	other.generate();
+	//
+	// a coinbase to the account at height 100, then a block at 101 with a tx spending its first
+	// output, then one at 102 with an rct tx paying the account, its subaddress 0/2, someone else,
+	// and the account again with a commitment which doesn't open
+	TestChain chain(100);
+	chain.add_block(address);
+	const cryptonote::transaction &coinbase_tx = chain.blocks[0].miner_tx;
+	monero_key_image_utils::KeyImageRetVals key_image_retVals;
+	BOOST_REQUIRE(monero_key_image_utils::new__key_image(
+		account.pub_spendKey, sec_spendKey, account.sec_viewKey,
+		cryptonote::get_tx_pub_key_from_extra(coinbase_tx), 0,
+		key_image_retVals
+	));
+	chain.add_block(other.get_keys().m_account_address, { v1_spend_tx(key_image_retVals.calculated_key_image) });
+	cryptonote::transaction rct_tx = rct_tx_to({
+		cryptonote::tx_destination_entry(5000, address, false),
+		cryptonote::tx_destination_entry(7000, subaddress, true),
+		cryptonote::tx_destination_entry(9000, other.get_keys().m_account_address, false),
+		cryptonote::tx_destination_entry(11000, address, false)
+	});
+	rct_tx.rct_signatures.outPk[3].mask = rct::commit(11000, rct::skGen());
+	chain.add_block(other.get_keys().m_account_address, { rct_tx });
+	const std::vector<cryptonote::block_complete_entry> &blocks = chain.entries;
+	//
+	monero_output_scanner::ScanRetVals retVals;
+	BOOST_REQUIRE(monero_output_scanner::scan_blocks(blocks, account, retVals));
+	BOOST_REQUIRE(retVals.start_height == 100 && retVals.end_height == 103);
+	size_t n_coinbase_outputs = coinbase_tx.vout.size();
+	BOOST_REQUIRE(retVals.owned_outputs.size() == n_coinbase_outputs + 2); // the undecodable output is dropped
+	for (size_t i = 0; i < n_coinbase_outputs; i++) {
+		const monero_output_scanner::OwnedOutput &output = retVals.owned_outputs[i];
+		BOOST_REQUIRE(output.height == 100 && output.is_coinbase && output.out_index == i);
+		BOOST_REQUIRE(output.amount == coinbase_tx.vout[i].amount);
+		BOOST_REQUIRE(rct::equalKeys(output.mask, rct::identity()));
+		BOOST_REQUIRE(output.key_image == boost::none);
+	}
+	std::vector<crypto::public_key> additional_tx_pub_keys = cryptonote::get_additional_tx_pub_keys_from_extra(rct_tx);
+	BOOST_REQUIRE(additional_tx_pub_keys.size() == rct_tx.vout.size());
+	for (size_t o = 0; o < 2; o++) { // amounts decoded in one batch, the second output via its additional tx pub key
+		const monero_output_scanner::OwnedOutput &output = retVals.owned_outputs[n_coinbase_outputs + o];
+		BOOST_REQUIRE(output.height == 102 && !output.is_coinbase && output.out_index == o);
+		BOOST_REQUIRE(output.tx_hash == chain.blocks[2].tx_hashes[0]);
+		BOOST_REQUIRE(output.amount == (o == 0 ? 5000 : 7000));
+		BOOST_REQUIRE(rct::equalKeys(rct::commit(output.amount, output.mask), rct_tx.rct_signatures.outPk[o].mask));
+		BOOST_REQUIRE(output.tx_pub_key == (o == 0 ? cryptonote::get_tx_pub_key_from_extra(rct_tx) : additional_tx_pub_keys[1]));
+		BOOST_REQUIRE(output.subaddress_index.major == 0 && output.subaddress_index.minor == (o == 0 ? 0 : 2));
+	}
+	BOOST_REQUIRE(retVals.spent_key_images.empty()); // no key images to watch for
+	//
+	account.sec_spendKey = sec_spendKey;
+	BOOST_REQUIRE(monero_output_scanner::scan_blocks(blocks, account, retVals));
+	BOOST_REQUIRE(retVals.owned_outputs[0].key_image != boost::none && *retVals.owned_outputs[0].key_image == key_image_retVals.calculated_key_image);
+	BOOST_REQUIRE(retVals.owned_outputs.back().key_image != boost::none); // the subaddress output's
+	BOOST_REQUIRE(retVals.spent_key_images.size() == 1);
+	BOOST_REQUIRE(retVals.spent_key_images[0].height == 101 && retVals.spent_key_images[0].tx_hash == chain.blocks[1].tx_hashes[0]);
+	//
+	account.sec_spendKey = boost::none;
+	account.known_key_images.push_back(key_image_retVals.calculated_key_image);
+	BOOST_REQUIRE(monero_output_scanner::scan_blocks(blocks, account, retVals));
+	BOOST_REQUIRE(retVals.spent_key_images.size() == 1);
+	//
+	monero_output_scanner::ScanAccount other_account{};
+	other_account.sec_viewKey = other.get_keys().m_view_secret_key;
+	other_account.pub_spendKey = other.get_keys().m_account_address.m_spend_public_key;
+	BOOST_REQUIRE(monero_output_scanner::scan_blocks(blocks, other_account, retVals));
+	BOOST_REQUIRE(retVals.owned_outputs.size() == chain.blocks[1].miner_tx.vout.size() + chain.blocks[2].miner_tx.vout.size() + 1);
+	BOOST_REQUIRE(retVals.owned_outputs[0].height == 101);
+	BOOST_REQUIRE(retVals.owned_outputs.back().amount == 9000 && retVals.owned_outputs.back().out_index == 2);
+}
+//
+#include "../src/monero_multi_account_scanner.hpp"
+#include <map>
+BOOST_AUTO_TEST_CASE(multiAccountScanner__engine)
+{
+	std::vector<cryptonote::account_base> accounts(5);
+	for (cryptonote::account_base &account : accounts) {
+		account.generate();
+	}
+	// each of the first three accounts gets a coinbase; a last block spends one of account 0's
+	// outputs, and pays account 3 in an rct tx along with an output whose commitment doesn't open
+	TestChain chain(200);
+	for (size_t i = 0; i < 3; i++) {
+		chain.add_block(accounts[i].get_keys().m_account_address);
+	}
+	crypto::key_image spent_key_image = rct::rct2ki(rct::pkGen());
+	cryptonote::transaction rct_tx = rct_tx_to({
+		cryptonote::tx_destination_entry(4242, accounts[3].get_keys().m_account_address, false),
+		cryptonote::tx_destination_entry(5000, accounts[3].get_keys().m_account_address, false)
+	});
+	rct_tx.rct_signatures.outPk[1].mask = rct::commit(5000, rct::skGen());
+	chain.add_block(accounts[4].get_keys().m_account_address, { v1_spend_tx(spent_key_image), rct_tx });
+	//
+	monero_multi_account_scanner::BlockBatch batch;
+	string err_string;
+	BOOST_REQUIRE(monero_multi_account_scanner::new__block_batch(chain.entries, batch, err_string));
+	BOOST_REQUIRE(batch.start_height == 200 && batch.end_height == 204);
+	BOOST_REQUIRE(batch.n_txs() == 6 && batch.input_key_images.size() == 2);
+	//
+	monero_multi_account_scanner::Engine engine(2);
+	for (uint64_t id = 0; id < 4; id++) { // account 4 isn't registered
+		engine.add_account(id, accounts[id].get_keys().m_view_secret_key, accounts[id].get_keys().m_account_address.m_spend_public_key);
+	}
+	engine.add_known_key_images(0, { spent_key_image });
+	monero_multi_account_scanner::ScanBatchRetVals retVals;
+	BOOST_REQUIRE(engine.scan(batch, retVals));
+	std::map<uint64_t, uint64_t> n_outputs_by_account;
+	for (const monero_multi_account_scanner::AccountOutput &owned : retVals.owned_outputs) {
+		BOOST_REQUIRE(owned.output.height == 200 + owned.account_id);
+		if (owned.account_id < 3) {
+			BOOST_REQUIRE(owned.output.amount == chain.blocks[owned.account_id].miner_tx.vout[owned.output.out_index].amount);
+		} else { // decoded, and the undecodable output dropped
+			BOOST_REQUIRE(owned.output.out_index == 0 && owned.output.amount == 4242);
+			BOOST_REQUIRE(rct::equalKeys(rct::commit(owned.output.amount, owned.output.mask), rct_tx.rct_signatures.outPk[0].mask));
+		}
+		n_outputs_by_account[owned.account_id]++;
+	}
+	BOOST_REQUIRE(n_outputs_by_account.size() == 4);
+	for (uint64_t id = 0; id < 3; id++) {
+		BOOST_REQUIRE(n_outputs_by_account[id] == chain.blocks[id].miner_tx.vout.size());
+	}
+	BOOST_REQUIRE(n_outputs_by_account[3] == 1);
+	BOOST_REQUIRE(retVals.spent_key_images.size() == 1);
+	BOOST_REQUIRE(retVals.spent_key_images[0].account_id == 0 && retVals.spent_key_images[0].spend.height == 203);
+	BOOST_REQUIRE(retVals.throughput.n_accounts == 4 && retVals.throughput.n_outputs == batch.n_outputs());
+	//
+	BOOST_REQUIRE(engine.remove_account(0));
+	BOOST_REQUIRE(!engine.remove_account(0));
+	BOOST_REQUIRE(engine.n_accounts() == 3);
+	BOOST_REQUIRE(engine.scan(batch, retVals));
+	BOOST_REQUIRE(retVals.spent_key_images.empty());
+	for (const monero_multi_account_scanner::AccountOutput &owned : retVals.owned_outputs) {
+		BOOST_REQUIRE(owned.account_id != 0);
+	}
+}
+//
+#include "../src/monero_scan_coordinator.hpp"
+#include "../src/monero_scan_serialization.hpp"
+#include <sys/socket.h>
+// Spawned by the scanCoordinator suite's setup, before the test has a chain; they read their
+// blocks from a file the test writes once it has built one.
+struct LocalScanWorkers
+{
+	string blocks_path;
+	std::vector<monero_scan_coordinator::Endpoint> endpoints;
+	std::vector<int> pids;
+	string err_string;
+	//
+	LocalScanWorkers()
+	{
+		char path_template[] = "/tmp/mymonero_scw_XXXXXX";
+		int fd = mkstemp(path_template);
+		if (fd < 0) {
+			err_string = "Unable to create the blocks file";
+			return;
+		}
+		close(fd);
+		blocks_path = path_template;
+		string path = blocks_path;
+		monero_scan_coordinator::BlockSource source = [path] (uint64_t start_height, uint64_t end_height, std::vector<cryptonote::block_complete_entry> &blocks, string &err_string)
+		{
+			std::ifstream file(path, std::ios::binary);
+			string buf((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+			monero_scan_serialization::Reader r(buf);
+			uint64_t first_height = r.u64();
+			uint64_t n_blocks = r.u64();
+			if (start_height < first_height || end_height > first_height + n_blocks) {
+				err_string = "Out of range";
+				return false;
+			}
+			for (uint64_t height = first_height; height < end_height; height++) {
+				cryptonote::block_complete_entry entry;
+				entry.block = r.str();
+				for (uint64_t n_txs = r.u64(); n_txs > 0 && r.ok; n_txs--) {
+					entry.txs.push_back(r.str());
+				}
+				if (height >= start_height) {
+					blocks.push_back(entry);
+				}
+			}
+			return r.ok;
+		};
+		monero_scan_coordinator::spawn_local_workers(2, source, endpoints, pids, err_string);
+	}
+	~LocalScanWorkers()
+	{
+		monero_scan_coordinator::stop_local_workers(pids);
+		if (!blocks_path.empty()) {
+			unlink(blocks_path.c_str());
+		}
+	}
+	void write_blocks(uint64_t start_height, const std::vector<cryptonote::block_complete_entry> &entries)
+	{
+		monero_scan_serialization::Writer w;
+		w.u64(start_height);
+		w.u64(entries.size());
+		for (const cryptonote::block_complete_entry &entry : entries) {
+			w.str(entry.block);
+			w.u64(entry.txs.size());
+			for (const cryptonote::blobdata &tx : entry.txs) {
+				w.str(tx);
+			}
+		}
+		std::ofstream file(blocks_path, std::ios::binary | std::ios::trunc);
+		file << w.buf;
+		BOOST_REQUIRE(file.good());
+	}
+};
+LocalScanWorkers *local_scan_workers = nullptr;
+void setup__local_scan_workers()
+{
+	local_scan_workers = new LocalScanWorkers();
+}
+void teardown__local_scan_workers()
+{
+	delete local_scan_workers;
+	local_scan_workers = nullptr;
+}
+//
+void scanCoordinator__scan_range()
+{
+	LocalScanWorkers &local_workers = *local_scan_workers;
+	BOOST_REQUIRE_MESSAGE(local_workers.err_string.empty(), local_workers.err_string);
+	string err_string;
+#ifdef __linux__
+	// and not once threads are running
+	boost::thread running([] { boost::this_thread::sleep_for(boost::chrono::milliseconds(100)); });
+	std::vector<monero_scan_coordinator::Endpoint> late_endpoints;
+	std::vector<int> late_pids;
+	BOOST_REQUIRE(!monero_scan_coordinator::spawn_local_workers(1, monero_scan_coordinator::BlockSource(), late_endpoints, late_pids, err_string));
+	BOOST_REQUIRE(late_pids.empty());
+	running.join();
+#endif
+	//
+	cryptonote::account_base account;
+	account.generate();
+	const cryptonote::account_keys &keys = account.get_keys();
+	// coinbases to the account at 300-302; 303 spends an output of 300's
+	TestChain test_chain(300);
+	for (size_t i = 0; i < 3; i++) {
+		test_chain.add_block(keys.m_account_address);
+	}
+	monero_key_image_utils::KeyImageRetVals key_image_retVals;
+	BOOST_REQUIRE(monero_key_image_store::new__key_image(
+		keys.m_account_address.m_spend_public_key, keys.m_spend_secret_key, keys.m_view_secret_key,
+		cryptonote::get_tx_pub_key_from_extra(test_chain.blocks[0].miner_tx), 0,
+		key_image_retVals
+	));
+	cryptonote::account_base other;
+	other.generate();
+	test_chain.add_block(other.get_keys().m_account_address, { v1_spend_tx(key_image_retVals.calculated_key_image) });
+	const std::vector<cryptonote::block_complete_entry> &chain = test_chain.entries;
+	const cryptonote::block &spend_block = test_chain.blocks[3];
+	local_workers.write_blocks(300, chain);
+	const std::vector<monero_scan_coordinator::Endpoint> &workers = local_workers.endpoints;
+	//
+	monero_output_scanner::ScanAccount scan_account{};
+	scan_account.sec_viewKey = keys.m_view_secret_key;
+	scan_account.pub_spendKey = keys.m_account_address.m_spend_public_key;
+	monero_output_scanner::ScanRetVals direct_retVals;
+	BOOST_REQUIRE(monero_output_scanner::scan_blocks(chain, scan_account, direct_retVals));
+	// view key only: the same outputs as a direct scan, and no spends
+	monero_scan_coordinator::ScanRangeRetVals retVals;
+	BOOST_REQUIRE(monero_scan_coordinator::scan_range(workers, 300, 304, scan_account, retVals, 2));
+	BOOST_REQUIRE(retVals.owned_outputs.size() == direct_retVals.owned_outputs.size());
+	for (size_t i = 0; i < retVals.owned_outputs.size(); i++) {
+		BOOST_REQUIRE(retVals.owned_outputs[i].height == direct_retVals.owned_outputs[i].height);
+		BOOST_REQUIRE(retVals.owned_outputs[i].out_pub_key == direct_retVals.owned_outputs[i].out_pub_key);
+		BOOST_REQUIRE(retVals.owned_outputs[i].amount == direct_retVals.owned_outputs[i].amount);
+	}
+	BOOST_REQUIRE(retVals.spent_key_images.empty());
+	BOOST_REQUIRE(retVals.checkpoints.size() == 2);
+	BOOST_REQUIRE(retVals.checkpoints[1].height == 304 && retVals.checkpoints[1].block_hash == cryptonote::get_block_hash(spend_block));
+	// with the spend key, the spend in a later chunk is found
+	scan_account.sec_spendKey = keys.m_spend_secret_key;
+	BOOST_REQUIRE(monero_scan_coordinator::scan_range(workers, 300, 304, scan_account, retVals, 2));
+	BOOST_REQUIRE(retVals.owned_outputs[0].key_image != boost::none);
+	BOOST_REQUIRE(*retVals.owned_outputs[0].key_image == key_image_retVals.calculated_key_image);
+	BOOST_REQUIRE(retVals.spent_key_images.size() == 1);
+	BOOST_REQUIRE(retVals.spent_key_images[0].height == 303 && retVals.spent_key_images[0].tx_hash == spend_block.tx_hashes[0]);
+	// a worker that accepts a chunk and never answers loses it to the others once it times out
+	int stuck_fd;
+	uint16_t stuck_port;
+	BOOST_REQUIRE(monero_scan_coordinator::listen("127.0.0.1", 0, stuck_fd, stuck_port, err_string)); // never accepted from; connects still complete
+	std::vector<monero_scan_coordinator::Endpoint> with_stuck = { { "127.0.0.1", stuck_port } };
+	with_stuck.insert(with_stuck.end(), workers.begin(), workers.end());
+	monero_scan_coordinator::ScanRangeRetVals requeued_retVals;
+	BOOST_REQUIRE(monero_scan_coordinator::scan_range(with_stuck, 300, 304, scan_account, requeued_retVals, 2, 200));
+	close(stuck_fd);
+	BOOST_REQUIRE(requeued_retVals.owned_outputs.size() == retVals.owned_outputs.size());
+	BOOST_REQUIRE(requeued_retVals.spent_key_images.size() == 1);
+	BOOST_REQUIRE(requeued_retVals.checkpoints.size() == 2);
+	// and so does one that sends part of a reply and stalls
+	int stalling_fd;
+	uint16_t stalling_port;
+	BOOST_REQUIRE(monero_scan_coordinator::listen("127.0.0.1", 0, stalling_fd, stalling_port, err_string));
+	boost::thread stalling([stalling_fd] {
+		for (int fd = accept(stalling_fd, nullptr, nullptr); fd >= 0; fd = accept(stalling_fd, nullptr, nullptr)) {
+			char buf[4096];
+			recv(fd, buf, sizeof(buf), 0); // some of the request
+			const char half_header[] = { 64, 0 }; // two of a message's four length bytes
+			send(fd, half_header, sizeof(half_header), 0);
+			while (recv(fd, buf, sizeof(buf), 0) > 0) { // until the coordinator gives up on it
+			}
+			close(fd);
+		}
+	});
+	std::vector<monero_scan_coordinator::Endpoint> with_stalling = { { "127.0.0.1", stalling_port } };
+	with_stalling.insert(with_stalling.end(), workers.begin(), workers.end());
+	bool did_scan = monero_scan_coordinator::scan_range(with_stalling, 300, 304, scan_account, requeued_retVals, 2, 200);
+	shutdown(stalling_fd, SHUT_RDWR); // ends its accept loop
+	stalling.join();
+	close(stalling_fd);
+	BOOST_REQUIRE(did_scan);
+	BOOST_REQUIRE(requeued_retVals.owned_outputs.size() == retVals.owned_outputs.size());
+	BOOST_REQUIRE(requeued_retVals.spent_key_images.size() == 1);
+	// a failing block source fails the scan
+	BOOST_REQUIRE(!monero_scan_coordinator::scan_range(workers, 300, 305, scan_account, retVals, 2));
+	BOOST_REQUIRE(retVals.did_error);
+}
+//
+#include "../src/monero_scan_checkpoint.hpp"
+BOOST_AUTO_TEST_CASE(scanCheckpoint)
+{
+	cryptonote::account_base account;
+	account.generate();
+	const cryptonote::account_keys &keys = account.get_keys();
+	char dir_template[] = "/tmp/mymonero_scp_XXXXXX";
+	BOOST_REQUIRE(mkdtemp(dir_template) != nullptr);
+	string path = string(dir_template) + "/account.scp";
+	string err_string;
+	//
+	std::vector<crypto::hash> chain(20); // hashes of heights 100-119
+	for (crypto::hash &hash : chain) {
+		hash = crypto::rand<crypto::hash>();
+	}
+	auto delta = [&chain] (uint64_t start_height, uint64_t end_height, uint64_t output_height) {
+		monero_scan_checkpoint::Delta delta{};
+		delta.start_height = start_height;
+		delta.prev_block_hash = start_height > 100 ? chain[start_height - 101] : crypto::null_hash;
+		delta.block_hashes.assign(chain.begin() + (start_height - 100), chain.begin() + (end_height - 100));
+		monero_scan_checkpoint::Output output{};
+		output.output.height = output_height;
+		output.output.out_pub_key = rct::rct2pk(rct::pkGen());
+		output.output.amount = 1000 + output_height;
+		output.output.key_image = rct::rct2ki(rct::pkGen());
+		output.global_index = 5000 + output_height;
+		delta.outputs.push_back(output);
+		return delta;
+	};
+	{
+		std::unique_ptr<monero_scan_checkpoint::CheckpointFile> file;
+		BOOST_REQUIRE(monero_scan_checkpoint::new__checkpoint_file(path, keys.m_view_secret_key, keys.m_account_address.m_spend_public_key, file, err_string));
+		BOOST_REQUIRE(file->append(delta(100, 110, 105), err_string));
+		monero_scan_checkpoint::Delta second = delta(110, 120, 115);
+		second.spent_key_images.push_back(monero_output_scanner::SpentKeyImage{ 117, crypto::null_hash, *file->state().outputs[0].output.key_image });
+		BOOST_REQUIRE(file->append(second, err_string));
+		BOOST_REQUIRE(!file->append(delta(110, 120, 115), err_string)); // doesn't extend the tip
+		// another process can't open it meanwhile
+		std::unique_ptr<monero_scan_checkpoint::CheckpointFile> other;
+		BOOST_REQUIRE(!monero_scan_checkpoint::new__checkpoint_file(path, keys.m_view_secret_key, keys.m_account_address.m_spend_public_key, other, err_string));
+	}
+	// resume, with a torn delta at the end which is dropped
+	{
+		std::ofstream torn(path, std::ios::binary | std::ios::app);
+		torn.write("\x40\x00\x00\x00" "D" "partial", 12);
+	}
+	std::unique_ptr<monero_scan_checkpoint::CheckpointFile> file;
+	BOOST_REQUIRE(monero_scan_checkpoint::new__checkpoint_file(path, keys.m_view_secret_key, keys.m_account_address.m_spend_public_key, file, err_string));
+	BOOST_REQUIRE(file->state().start_height == 100 && file->state().height == 120);
+	BOOST_REQUIRE(file->state().recent_block_hashes.back() == chain.back());
+	BOOST_REQUIRE(file->state().outputs.size() == 2 && file->state().outputs[1].global_index == 5115);
+	BOOST_REQUIRE(file->state().spent_key_images.size() == 1 && file->state().spent_key_images[0].height == 117);
+	BOOST_REQUIRE(file->known_key_images().size() == 2);
+	// a reorg at 116 only rewinds to there
+	std::vector<crypto::hash> reorged(chain.begin() + 10, chain.end());
+	reorged[6] = crypto::rand<crypto::hash>();
+	BOOST_REQUIRE(file->fork_height(110, reorged) == 116);
+	BOOST_REQUIRE(file->rewind(116, err_string));
+	BOOST_REQUIRE(file->state().height == 116 && file->state().outputs.size() == 2 && file->state().spent_key_images.empty());
+	BOOST_REQUIRE(file->compact(err_string));
+	file.reset();
+	BOOST_REQUIRE(monero_scan_checkpoint::new__checkpoint_file(path, keys.m_view_secret_key, keys.m_account_address.m_spend_public_key, file, err_string));
+	BOOST_REQUIRE(file->state().height == 116 && file->state().recent_block_hashes.back() == chain[15]);
+	BOOST_REQUIRE(file->state().outputs.size() == 2 && *file->state().outputs[0].output.key_image == *file->known_key_images().begin());
+	BOOST_REQUIRE(file->rewind(100, err_string)); // back to the start is always possible
+	BOOST_REQUIRE(file->state().outputs.empty());
+	file.reset();
+	// another account's keys don't open it
+	cryptonote::account_base other;
+	other.generate();
+	BOOST_REQUIRE(!monero_scan_checkpoint::new__checkpoint_file(path, other.get_keys().m_view_secret_key, other.get_keys().m_account_address.m_spend_public_key, file, err_string));
+	unlink(path.c_str());
+	rmdir(dir_template);
+}
+//
+#include "../src/monero_binary_utils.hpp"
+#include "storages/portable_storage_template_helper.h"
+BOOST_AUTO_TEST_CASE(binaryUtils__binary_blocks_to_json)
+{
+	cryptonote::account_base account;
+	account.generate();
+	cryptonote::COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::response resp{};
+	resp.status = "OK";
+	resp.untrusted = false;
+	cryptonote::block block{};
+	BOOST_REQUIRE(cryptonote::construct_miner_tx(10, 0, 0, 0, 0, account.get_keys().m_account_address, block.miner_tx, cryptonote::blobdata(), 999, 10));
+	cryptonote::transaction tx{};
+	tx.version = 1;
+	cryptonote::txin_to_key in{};
+	in.key_offsets.push_back(0);
+	in.k_image = rct::rct2ki(rct::pkGen());
+	tx.vin.push_back(in);
+	tx.signatures.resize(1, std::vector<crypto::signature>(1));
+	block.tx_hashes.push_back(cryptonote::get_transaction_hash(tx));
+	cryptonote::block_complete_entry entry;
+	entry.block = cryptonote::block_to_blob(block);
+	entry.txs.push_back(cryptonote::tx_to_blob(tx));
+	resp.blocks.push_back(entry);
+	string buff_bin;
+	BOOST_REQUIRE(epee::serialization::store_t_to_binary(resp, buff_bin));
+	//
+	string buff_json;
+	binary_utils::binary_blocks_to_json(buff_bin, buff_json);
+	boost::property_tree::ptree root;
+	std::istringstream ss(buff_json);
+	boost::property_tree::read_json(ss, root); // nested objects, not JSON-in-strings
+	BOOST_REQUIRE(root.get_child("blocks").size() == 1);
+	BOOST_REQUIRE(root.get_child("blocks").front().second.get<int>("miner_tx.version") == block.miner_tx.version);
+	BOOST_REQUIRE(root.get_child("blocks").front().second.get<string>("prev_id") == epee::string_tools::pod_to_hex(block.prev_id));
+	BOOST_REQUIRE(root.get_child("txs").size() == 1 && root.get_child("txs").front().second.size() == 1);
+	BOOST_REQUIRE(root.get_child("txs").front().second.front().second.get<int>("version") == 1);
+	BOOST_REQUIRE(root.get<string>("status") == "OK");
+	BOOST_REQUIRE(buff_json.find("\"untrusted\":false") != string::npos);
+	//
+	// many blocks and a block with more txs than one parse task takes come out in order
+	for (size_t i = 0; i < 40; i++) {
+		resp.blocks[0].txs.push_back(resp.blocks[0].txs[0]);
+	}
+	for (uint64_t height = 11; height < 50; height++) {
+		cryptonote::block next{};
+		BOOST_REQUIRE(cryptonote::construct_miner_tx(height, 0, 0, 0, 0, account.get_keys().m_account_address, next.miner_tx, cryptonote::blobdata(), 999, 10));
+		cryptonote::block_complete_entry next_entry;
+		next_entry.block = cryptonote::block_to_blob(next);
+		resp.blocks.push_back(next_entry);
+	}
+	BOOST_REQUIRE(epee::serialization::store_t_to_binary(resp, buff_bin));
+	binary_utils::binary_blocks_to_json(buff_bin, buff_json);
+	std::istringstream many_ss(buff_json);
+	boost::property_tree::read_json(many_ss, root);
+	BOOST_REQUIRE(root.get_child("blocks").size() == 40 && root.get_child("txs").size() == 40);
+	BOOST_REQUIRE(root.get_child("txs").front().second.size() == 41);
+	uint64_t expected_height = 10;
+	for (const auto &block_node : root.get_child("blocks")) {
+		BOOST_REQUIRE(block_node.second.get<uint64_t>("miner_tx.unlock_time") == expected_height++ + CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW);
+	}
+	// the reported failure is the first in block then tx order
+	resp.blocks[0].txs[20] = "garbage";
+	resp.blocks[3].block = "garbage";
+	BOOST_REQUIRE(epee::serialization::store_t_to_binary(resp, buff_bin));
+	try {
+		binary_utils::binary_blocks_to_json(buff_bin, buff_json);
+		BOOST_FAIL("expected a parse failure");
+	} catch (const std::runtime_error &e) {
+		BOOST_REQUIRE(string(e.what()) == "failed to parse tx blob at index 20");
+	}
+}
+//
+#include "../src/monero_tx_view.hpp"
+#include "serialization/binary_archive.h"
+BOOST_AUTO_TEST_CASE(txView__binary_blocks_to_compact)
+{
+	cryptonote::account_base account;
+	account.generate();
+	// a bulletproof2 tx, serialized up to the rct base, with stand-in prunable bytes
+	cryptonote::transaction tx{};
+	tx.version = 2;
+	tx.unlock_time = 77;
+	cryptonote::txin_to_key in{};
+	in.key_offsets = { 5, 6, 7 };
+	in.k_image = rct::rct2ki(rct::pkGen());
+	tx.vin.push_back(in);
+	for (size_t i = 0; i < 2; i++) {
+		tx.vout.push_back(cryptonote::tx_out{ 0, cryptonote::txout_to_key(rct::rct2pk(rct::pkGen())) });
+	}
+	crypto::public_key tx_pub_key = rct::rct2pk(rct::pkGen());
+	cryptonote::add_tx_pub_key_to_extra(tx, tx_pub_key);
+	tx.rct_signatures.type = rct::RCTTypeBulletproof2;
+	tx.rct_signatures.txnFee = 12345;
+	tx.rct_signatures.ecdhInfo.resize(2);
+	tx.rct_signatures.outPk.resize(2);
+	for (size_t i = 0; i < 2; i++) {
+		tx.rct_signatures.ecdhInfo[i].amount = rct::zero();
+		tx.rct_signatures.ecdhInfo[i].amount.bytes[0] = (unsigned char)(i + 1);
+		tx.rct_signatures.outPk[i].mask = rct::pkGen();
+	}
+	std::ostringstream oss;
+	binary_archive<true> ar(oss);
+	BOOST_REQUIRE(::serialization::serialize(ar, static_cast<cryptonote::transaction_prefix &>(tx)));
+	BOOST_REQUIRE(tx.rct_signatures.serialize_rctsig_base(ar, tx.vin.size(), tx.vout.size()));
+	string blob = oss.str() + string(100, '\x7f'); // never read
+	//
+	monero_tx_view::TxView view;
+	BOOST_REQUIRE(view.parse(blob));
+	BOOST_REQUIRE(view.version() == 2 && view.unlock_time() == 77 && !view.is_coinbase());
+	BOOST_REQUIRE(view.n_inputs() == 1 && view.key_image(0) == in.k_image);
+	BOOST_REQUIRE(view.n_outputs() == 2 && view.output_key(1) == boost::get<cryptonote::txout_to_key>(tx.vout[1].target).key);
+	crypto::public_key found_pub_key;
+	BOOST_REQUIRE(view.tx_pub_key(found_pub_key) && found_pub_key == tx_pub_key);
+	BOOST_REQUIRE(view.additional_tx_pub_keys().empty());
+	BOOST_REQUIRE(view.rct_type() == rct::RCTTypeBulletproof2 && view.rct_fee() == 12345);
+	BOOST_REQUIRE(view.ecdh_info(1).amount == tx.rct_signatures.ecdhInfo[1].amount);
+	BOOST_REQUIRE(view.out_pk(0) == tx.rct_signatures.outPk[0].mask);
+	BOOST_REQUIRE(view.prunable_size() == 100);
+	BOOST_REQUIRE(!view.parse(oss.str().substr(0, oss.str().size() - 1))); // cut into the rct base
+	//
+	cryptonote::block block{};
+	BOOST_REQUIRE(cryptonote::construct_miner_tx(42, 0, 0, 0, 0, account.get_keys().m_account_address, block.miner_tx, cryptonote::blobdata(), 999, 10));
+	block.tx_hashes.push_back(crypto::cn_fast_hash(blob.data(), blob.size()));
+	cryptonote::COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::response resp{};
+	resp.status = "OK";
+	cryptonote::block_complete_entry entry;
+	entry.block = cryptonote::block_to_blob(block);
+	entry.txs.push_back(blob);
+	resp.blocks.push_back(entry);
+	string buff_bin;
+	BOOST_REQUIRE(epee::serialization::store_t_to_binary(resp, buff_bin));
+	string buff_json;
+	binary_utils::binary_blocks_to_compact(buff_bin, buff_json);
+	boost::property_tree::ptree root;
+	std::istringstream ss(buff_json);
+	boost::property_tree::read_json(ss, root);
+	const boost::property_tree::ptree &block_node = root.get_child("blocks").front().second;
+	BOOST_REQUIRE(block_node.get<string>("hash") == epee::string_tools::pod_to_hex(cryptonote::get_block_hash(block)));
+	BOOST_REQUIRE(block_node.get<uint64_t>("height") == 42);
+	BOOST_REQUIRE(block_node.get_child("miner_tx.outputs").size() == block.miner_tx.vout.size());
+	const boost::property_tree::ptree &tx_node = block_node.get_child("txs").front().second;
+	BOOST_REQUIRE(tx_node.get<string>("hash") == epee::string_tools::pod_to_hex(block.tx_hashes[0]));
+	BOOST_REQUIRE(tx_node.get<string>("pub_key") == epee::string_tools::pod_to_hex(tx_pub_key));
+	BOOST_REQUIRE(tx_node.get_child("key_images").front().second.get_value<string>() == epee::string_tools::pod_to_hex(in.k_image));
+	BOOST_REQUIRE(tx_node.get_child("ecdh_info").back().second.get<string>("amount") == "0200000000000000");
+	BOOST_REQUIRE(tx_node.get_child("out_pk").size() == 2);
+	BOOST_REQUIRE(tx_node.get<int>("rct_type") == rct::RCTTypeBulletproof2);
+	//
+	// txs not matching the block's tx hashes fail rather than getting blob hashes, which v2 tx hashes aren't
+	resp.blocks[0].txs.push_back(blob);
+	BOOST_REQUIRE(epee::serialization::store_t_to_binary(resp, buff_bin));
+	try {
+		binary_utils::binary_blocks_to_compact(buff_bin, buff_json);
+		BOOST_FAIL("expected a parse failure");
+	} catch (const std::runtime_error &e) {
+		BOOST_REQUIRE(string(e.what()) == "failed to parse block blob at index 0");
+	}
+}
+//
+#include "../src/monero_buffer_registry.hpp"
+BOOST_AUTO_TEST_CASE(bufferRegistry)
+{
+	monero_buffer_registry::Stats before = monero_buffer_registry::stats();
+	// bridge round trip: binary by handle in, freed after
+	boost::property_tree::ptree root;
+	root.put("status", "OK");
+	root.put("count", "3");
+	string ret_string = serial_bridge::malloc_binary_from_json(args_string_from_root(root));
+	boost::property_tree::ptree ret_root;
+	BOOST_REQUIRE(serial_bridge_utils::parsed_json_root(ret_string, ret_root));
+	string handle_string = ret_root.get<string>("handle");
+	BOOST_REQUIRE(monero_buffer_registry::stats().live_buffers == before.live_buffers + 1);
+	boost::property_tree::ptree handle_root;
+	handle_root.put("handle", handle_string);
+	string json = serial_bridge::binary_to_json(args_string_from_root(handle_root));
+	BOOST_REQUIRE(json.find("\"status\"") != string::npos && json.find("OK") != string::npos);
+	// legacy ptr/length still work, with the full 64 bit address
+	boost::property_tree::ptree ptr_root;
+	ptr_root.put("ptr", ret_root.get<string>("ptr"));
+	ptr_root.put("length", ret_root.get<string>("length"));
+	BOOST_REQUIRE(serial_bridge::binary_to_json(args_string_from_root(ptr_root)) == json);
+	BOOST_REQUIRE(serial_bridge::free_buffer(args_string_from_root(handle_root)).find("err_msg") == string::npos);
+	BOOST_REQUIRE(serial_bridge::free_buffer(args_string_from_root(handle_root)).find("err_msg") != string::npos);
+	BOOST_REQUIRE(serial_bridge::binary_to_json(args_string_from_root(handle_root)).find("err_msg") != string::npos);
+	//
+	// an acquired buffer outlives its free
+	monero_buffer_registry::Handle handle = monero_buffer_registry::allocate(4);
+	BOOST_REQUIRE(monero_buffer_registry::fill(handle, 1, "abc", 3));
+	BOOST_REQUIRE(!monero_buffer_registry::fill(handle, 2, "abc", 3));
+	std::shared_ptr<const string> acquired = monero_buffer_registry::acquire(handle);
+	BOOST_REQUIRE(monero_buffer_registry::free(handle));
+	BOOST_REQUIRE(monero_buffer_registry::acquire(handle) == nullptr);
+	BOOST_REQUIRE(acquired->substr(1) == "abc");
+	acquired.reset();
+	//
+	// an adopted buffer is registered without a copy
+	string adopted(64, 'y');
+	const char *adopted_data = adopted.data();
+	monero_buffer_registry::Handle adopted_handle = monero_buffer_registry::adopt(std::move(adopted));
+	BOOST_REQUIRE(monero_buffer_registry::data(adopted_handle) == adopted_data);
+	BOOST_REQUIRE(monero_buffer_registry::acquire(adopted_handle)->size() == 64);
+	BOOST_REQUIRE(monero_buffer_registry::free(adopted_handle));
+	//
+	// leaks: steady allocate/fill/free cycles reuse pooled buffers and leave nothing live
+	string payload(256 * 1024, 'x');
+	const size_t n_cycles = 2000;
+	for (size_t i = 0; i < n_cycles; i++) {
+		monero_buffer_registry::Handle h = monero_buffer_registry::allocate(payload.size() - (i % 64));
+		BOOST_REQUIRE(monero_buffer_registry::fill(h, 0, payload.data(), payload.size() - (i % 64)));
+		BOOST_REQUIRE(monero_buffer_registry::acquire(h)->size() == payload.size() - (i % 64));
+		BOOST_REQUIRE(monero_buffer_registry::free(h));
+	}
+	monero_buffer_registry::Stats after = monero_buffer_registry::stats();
+	BOOST_REQUIRE(after.live_buffers == before.live_buffers && after.live_bytes == before.live_bytes);
+	BOOST_REQUIRE(after.reuses - before.reuses >= n_cycles - 1);
+	BOOST_REQUIRE(after.pooled_bytes <= monero_buffer_registry::max_pooled_bytes);
+}
+//
+#include "../src/monero_block_cache.hpp"
+BOOST_AUTO_TEST_CASE(blockCache)
+{
+	cryptonote::account_base account;
+	account.generate();
+	std::vector<cryptonote::block_complete_entry> chain(10); // heights 500-509; 505 has a spend
+	for (size_t i = 0; i < chain.size(); i++) {
+		cryptonote::block block{};
+		BOOST_REQUIRE(cryptonote::construct_miner_tx(500 + i, 0, 0, 0, 0, account.get_keys().m_account_address, block.miner_tx, cryptonote::blobdata(), 999, 10));
+		if (i == 5) {
+			cryptonote::transaction tx{};
+			tx.version = 1;
+			cryptonote::txin_to_key in{};
+			in.key_offsets.push_back(0);
+			in.k_image = rct::rct2ki(rct::pkGen());
+			tx.vin.push_back(in);
+			tx.signatures.resize(1, std::vector<crypto::signature>(1));
+			block.tx_hashes.push_back(cryptonote::get_transaction_hash(tx));
+			chain[i].txs.push_back(cryptonote::tx_to_blob(tx));
+		}
+		chain[i].block = cryptonote::block_to_blob(block);
+	}
+	char dir_template[] = "/tmp/mymonero_mbc_XXXXXX";
+	BOOST_REQUIRE(mkdtemp(dir_template) != nullptr);
+	string directory = dir_template;
+	string err_string;
+	std::unique_ptr<monero_block_cache::BlockCache> cache;
+	BOOST_REQUIRE(monero_block_cache::new__block_cache(directory, 1024 * 1024, cache, err_string));
+	BOOST_REQUIRE(cache->put(std::vector<cryptonote::block_complete_entry>(chain.begin(), chain.begin() + 5), err_string));
+	BOOST_REQUIRE(!cache->has(500, 510));
+	BOOST_REQUIRE(cache->put(std::vector<cryptonote::block_complete_entry>(chain.begin() + 5, chain.end()), err_string));
+	BOOST_REQUIRE(cache->has(500, 510) && !cache->has(499, 501));
+	//
+	// a range across both segments is the same batch parsing the blocks gives
+	monero_multi_account_scanner::BlockBatch cached, parsed;
+	BOOST_REQUIRE(cache->get_batch(502, 508, cached));
+	BOOST_REQUIRE(monero_multi_account_scanner::new__block_batch(std::vector<cryptonote::block_complete_entry>(chain.begin() + 2, chain.begin() + 8), parsed, err_string));
+	BOOST_REQUIRE(cached.start_height == parsed.start_height && cached.end_height == parsed.end_height);
+	BOOST_REQUIRE(cached.tx_hashes == parsed.tx_hashes && cached.tx_heights == parsed.tx_heights);
+	BOOST_REQUIRE(cached.tx_pub_keys == parsed.tx_pub_keys && cached.tx_outputs_begin == parsed.tx_outputs_begin);
+	BOOST_REQUIRE(cached.out_keys == parsed.out_keys && cached.out_amounts == parsed.out_amounts);
+	BOOST_REQUIRE(cached.input_key_images == parsed.input_key_images && cached.input_txs == parsed.input_txs);
+	BOOST_REQUIRE(cached.tx_versions == parsed.tx_versions && cached.tx_rct_types == parsed.tx_rct_types);
+	BOOST_REQUIRE(!cache->get_batch(505, 511, cached));
+	// txs not matching the block's tx hashes fail the put rather than getting blob hashes, which v2 tx hashes aren't
+	std::vector<cryptonote::block_complete_entry> mismatched(chain.begin() + 5, chain.begin() + 6);
+	mismatched[0].txs.push_back(mismatched[0].txs[0]);
+	BOOST_REQUIRE(!cache->put(mismatched, err_string) && err_string == "Failed to parse block blob at index 0");
+	BOOST_REQUIRE(!monero_multi_account_scanner::new__block_batch(mismatched, parsed, err_string) && err_string == "Failed to parse block blob at index 0");
+	// and the JSON converter gets what binary_blocks_to_compact gives
+	cryptonote::COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::response resp{};
+	resp.status = "OK";
+	resp.untrusted = false;
+	resp.blocks = chain;
+	string buff_bin, expected_json, cached_json;
+	BOOST_REQUIRE(epee::serialization::store_t_to_binary(resp, buff_bin));
+	binary_utils::binary_blocks_to_compact(buff_bin, expected_json);
+	BOOST_REQUIRE(cache->get_compact_json(500, 510, cached_json));
+	BOOST_REQUIRE(cached_json == expected_json);
+	monero_block_cache::Stats stats = cache->stats();
+	BOOST_REQUIRE(stats.segments == 2 && stats.hits == 2 && stats.misses == 1);
+	//
+	// reopened with room for one segment, the least recently written one goes
+	cache.reset();
+	BOOST_REQUIRE(monero_block_cache::new__block_cache(directory, stats.bytes - 1, cache, err_string));
+	BOOST_REQUIRE(cache->stats().segments == 1 && cache->stats().evictions == 1);
+	// a put overlapping cached ranges replaces them
+	BOOST_REQUIRE(cache->put_blocks_by_height_response(buff_bin, err_string));
+	BOOST_REQUIRE(cache->stats().segments == 1);
+	BOOST_REQUIRE(cache->put(std::vector<cryptonote::block_complete_entry>(chain.begin() + 3, chain.begin() + 6), err_string));
+	BOOST_REQUIRE(cache->has(503, 506) && !cache->has(506, 507));
+	// a corrupt segment is dropped on read
+	cache.reset();
+	DIR *dir = opendir(directory.c_str());
+	for (dirent *entry = readdir(dir); entry != nullptr; entry = readdir(dir)) {
+		if (string(entry->d_name).find(".mbc") != string::npos) {
+			std::fstream segment_file(directory + "/" + entry->d_name, std::ios::in | std::ios::out | std::ios::binary);
+			segment_file.seekp(100);
+			segment_file.put('\x55');
+		}
+	}
+	closedir(dir);
+	BOOST_REQUIRE(monero_block_cache::new__block_cache(directory, 1024 * 1024, cache, err_string));
+	BOOST_REQUIRE(cache->has(503, 506));
+	BOOST_REQUIRE(!cache->get_batch(503, 506, cached));
+	BOOST_REQUIRE(!cache->has(503, 506) && cache->stats().segments == 0);
+	cache.reset();
+	rmdir(dir_template);
+}
+//
+BOOST_AUTO_TEST_CASE(binaryUtils__streaming_json)
+{
+	epee::serialization::portable_storage ps;
+	BOOST_REQUIRE(ps.set_value("status", std::string("OK"), nullptr));
+	BOOST_REQUIRE(ps.set_value("bin", std::string("\x00\"\xff", 3), nullptr));
+	BOOST_REQUIRE(ps.set_value("height", (uint64_t)18446744073709551615ULL, nullptr));
+	BOOST_REQUIRE(ps.set_value("neg", (int32_t)-5, nullptr));
+	BOOST_REQUIRE(ps.set_value("small", (uint8_t)200, nullptr));
+	BOOST_REQUIRE(ps.set_value("ratio", 0.5, nullptr));
+	BOOST_REQUIRE(ps.set_value("flag", true, nullptr));
+	epee::serialization::portable_storage::hsection info = ps.open_section("info", nullptr, true);
+	BOOST_REQUIRE(ps.set_value("name", std::string("node"), info));
+	epee::serialization::portable_storage::harray ids = ps.insert_first_value("ids", (uint64_t)1, nullptr);
+	BOOST_REQUIRE(ps.insert_next_value(ids, (uint64_t)2));
+	BOOST_REQUIRE(ps.insert_next_value(ids, (uint64_t)3));
+	string buff_bin;
+	BOOST_REQUIRE(ps.store_to_binary(buff_bin));
+	//
+	string buff_json;
+	binary_utils::binary_to_json(buff_bin, buff_json);
+	BOOST_REQUIRE(buff_json.find("\"bin\":\"\\u0000\\\"\\u00ff\"") != string::npos);
+	boost::property_tree::ptree root;
+	std::istringstream ss(buff_json);
+	boost::property_tree::read_json(ss, root);
+	BOOST_REQUIRE(root.get<string>("status") == "OK");
+	BOOST_REQUIRE(root.get<uint64_t>("height") == 18446744073709551615ULL);
+	BOOST_REQUIRE(root.get<int>("neg") == -5);
+	BOOST_REQUIRE(root.get<int>("small") == 200);
+	BOOST_REQUIRE(root.get<double>("ratio") == 0.5);
+	BOOST_REQUIRE(root.get<bool>("flag"));
+	BOOST_REQUIRE(root.get<string>("info.name") == "node");
+	BOOST_REQUIRE(root.get_child("ids").size() == 3);
+	std::ostringstream os;
+	binary_utils::binary_to_json(buff_bin, os);
+	BOOST_REQUIRE(os.str() == buff_json);
+	//
+	// back to binary, which epee loads with the same values
+	string buff_bin2;
+	binary_utils::json_to_binary(buff_json, buff_bin2);
+	epee::serialization::portable_storage ps2;
+	BOOST_REQUIRE(ps2.load_from_binary(buff_bin2));
+	string bin;
+	BOOST_REQUIRE(ps2.get_value("bin", bin, nullptr));
+	BOOST_REQUIRE(bin == string("\x00\"\xff", 3));
+	int64_t neg = 0;
+	BOOST_REQUIRE(ps2.get_value("neg", neg, nullptr));
+	BOOST_REQUIRE(neg == -5);
+	string buff_json2;
+	binary_utils::binary_to_json(buff_bin2, buff_json2);
+	BOOST_REQUIRE(buff_json2 == buff_json);
+	//
+	// an RPC response survives the round trip
+	cryptonote::COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::response resp{};
+	resp.status = "OK";
+	resp.untrusted = true;
+	cryptonote::block_complete_entry entry;
+	entry.block = string("\x01\xff\x00\x80 block", 10);
+	entry.txs.push_back("tx one");
+	entry.txs.push_back(string("\x00\x01", 2));
+	resp.blocks.push_back(entry);
+	resp.blocks.push_back(cryptonote::block_complete_entry());
+	BOOST_REQUIRE(epee::serialization::store_t_to_binary(resp, buff_bin));
+	binary_utils::binary_to_json(buff_bin, buff_json);
+	binary_utils::json_to_binary(buff_json, buff_bin2);
+	cryptonote::COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::response resp2;
+	BOOST_REQUIRE(epee::serialization::load_t_from_binary(resp2, buff_bin2));
+	BOOST_REQUIRE(resp2.status == "OK" && resp2.untrusted);
+	BOOST_REQUIRE(resp2.blocks.size() == 2);
+	BOOST_REQUIRE(resp2.blocks[0].block == entry.block);
+	BOOST_REQUIRE(resp2.blocks[0].txs == entry.txs);
+	BOOST_REQUIRE(resp2.blocks[1].txs.empty());
+	//
+	// nulls and empty arrays are dropped; malformed input throws
+	binary_utils::json_to_binary("{\"a\": [ ], \"b\": null, \"c\": \"x\\u00e9\\u20ac\"}", buff_bin);
+	binary_utils::binary_to_json(buff_bin, buff_json);
+	BOOST_REQUIRE(buff_json == "{\"c\":\"x\\u00e9\\u00e2\\u0082\\u00ac\"}");
+	BOOST_REQUIRE_THROW(binary_utils::json_to_binary("{\"a\":[1,\"x\"]}", buff_bin), std::runtime_error);
+	BOOST_REQUIRE_THROW(binary_utils::json_to_binary("{\"a\":1", buff_bin), std::runtime_error);
+	binary_utils::json_to_binary("{\"a\":1}", buff_bin);
+	BOOST_REQUIRE_THROW(binary_utils::binary_to_json(buff_bin.substr(0, buff_bin.size() - 1), buff_json), std::runtime_error);
+	BOOST_REQUIRE_THROW(binary_utils::binary_to_json(string("not binary"), buff_json), std::runtime_error);
+	// which the bridge returns as an err_msg
+	boost::property_tree::ptree ret_root;
+	BOOST_REQUIRE(parsed_json_root(serial_bridge::malloc_binary_from_json("{\"a\":1"), ret_root));
+	BOOST_REQUIRE(ret_root.get<string>(ret_json_key__any__err_msg()).find("json_to_binary") != string::npos);
+	boost::property_tree::ptree alloc_root;
+	alloc_root.put("length", "10");
+	BOOST_REQUIRE(parsed_json_root(serial_bridge::alloc_buffer(args_string_from_root(alloc_root)), ret_root));
+	string handle = ret_root.get<string>("handle");
+	boost::property_tree::ptree fill_root;
+	fill_root.put("handle", handle);
+	fill_root.put("hex", epee::string_tools::buff_to_hex_nodelimer(string("not binary")));
+	BOOST_REQUIRE(serial_bridge::fill_buffer(args_string_from_root(fill_root)).find("err_msg") == string::npos);
+	boost::property_tree::ptree handle_root;
+	handle_root.put("handle", handle);
+	BOOST_REQUIRE(parsed_json_root(serial_bridge::binary_to_json(args_string_from_root(handle_root)), ret_root));
+	BOOST_REQUIRE(ret_root.get<string>(ret_json_key__any__err_msg()).find("binary_to_json") != string::npos);
+	serial_bridge::free_buffer(args_string_from_root(handle_root));
+}
+//
 //#include "../src/emscr_async_bridge_index.hpp"
 //BOOST_AUTO_TEST_CASE(emscr_bridge__send_funds__sweep)
 //{